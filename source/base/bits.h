@@ -0,0 +1,74 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__BITS_H
+#define BASE__BITS_H
+
+#include "build/build_config.h"
+
+#include <cstdint>
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#endif // defined(CC_MSVC)
+
+namespace base {
+
+// Returns the number of trailing zero bits in |value|. |value| must not be zero.
+FORCEINLINE int countTrailingZeros64(uint64_t value)
+{
+#if defined(CC_MSVC)
+    unsigned long index;
+#if defined(ARCH_CPU_64_BITS)
+    _BitScanForward64(&index, value);
+#else
+    const uint32_t low = static_cast<uint32_t>(value);
+    if (low)
+    {
+        _BitScanForward(&index, low);
+    }
+    else
+    {
+        _BitScanForward(&index, static_cast<uint32_t>(value >> 32));
+        index += 32;
+    }
+#endif // defined(ARCH_CPU_64_BITS)
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif // defined(CC_MSVC)
+}
+
+// Returns the number of set bits in |value|.
+FORCEINLINE int countSetBits64(uint64_t value)
+{
+#if defined(CC_MSVC)
+    // The POPCNT instruction is not available on all supported processors, so we use the
+    // portable version.
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((value * 0x0101010101010101ULL) >> 56);
+#else
+    return __builtin_popcountll(value);
+#endif // defined(CC_MSVC)
+}
+
+} // namespace base
+
+#endif // BASE__BITS_H
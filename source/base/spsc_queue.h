@@ -0,0 +1,106 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__SPSC_QUEUE_H
+#define BASE__SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// Bounded queue that passes items from one thread to another without locks. Only one thread may
+// push the items and only one thread may pop them. The queue does not wait: if it is full or
+// empty, the calls return false and the threads decide themselves whether to wait or to do
+// something else (for example, to skip a frame).
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : slots_(capacity + 1)
+    {
+        // Nothing
+    }
+
+    // Moves |item| to the queue. Returns false if the queue is full, |item| is not changed then.
+    // Called by the producer thread only.
+    bool tryPush(T&& item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t next = nextIndex(tail);
+
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+
+        slots_[tail] = std::move(item);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Moves the oldest item to |item|. Returns false if the queue is empty. Called by the
+    // consumer thread only.
+    bool tryPop(T* item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+
+        *item = std::move(slots_[head]);
+
+        // The resources of the item are released in the consumer thread.
+        slots_[head] = T();
+
+        head_.store(nextIndex(head), std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    bool isFull() const
+    {
+        return nextIndex(tail_.load(std::memory_order_acquire)) ==
+            head_.load(std::memory_order_acquire);
+    }
+
+private:
+    size_t nextIndex(size_t index) const
+    {
+        return (index + 1 == slots_.size()) ? 0 : index + 1;
+    }
+
+    // One slot always stays empty, so a full queue differs from an empty one.
+    std::vector<T> slots_;
+
+    // The indexes are modified by different threads and are kept in different cache lines.
+    alignas(64) std::atomic<size_t> head_ = 0;
+    alignas(64) std::atomic<size_t> tail_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(SpscQueue);
+};
+
+} // namespace base
+
+#endif // BASE__SPSC_QUEUE_H
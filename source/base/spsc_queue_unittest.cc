@@ -0,0 +1,94 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/spsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+namespace base {
+
+TEST(spsc_queue, bounded)
+{
+    SpscQueue<int> queue(2);
+
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_TRUE(queue.tryPush(1));
+    EXPECT_TRUE(queue.tryPush(2));
+    EXPECT_TRUE(queue.isFull());
+    EXPECT_FALSE(queue.tryPush(3));
+
+    int item = 0;
+
+    EXPECT_TRUE(queue.tryPop(&item));
+    EXPECT_EQ(item, 1);
+    EXPECT_TRUE(queue.tryPush(3));
+    EXPECT_TRUE(queue.tryPop(&item));
+    EXPECT_EQ(item, 2);
+    EXPECT_TRUE(queue.tryPop(&item));
+    EXPECT_EQ(item, 3);
+    EXPECT_FALSE(queue.tryPop(&item));
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(spsc_queue, full_queue_keeps_item)
+{
+    SpscQueue<std::unique_ptr<int>> queue(1);
+
+    EXPECT_TRUE(queue.tryPush(std::make_unique<int>(1)));
+
+    std::unique_ptr<int> item = std::make_unique<int>(2);
+    EXPECT_FALSE(queue.tryPush(std::move(item)));
+    ASSERT_TRUE(item);
+    EXPECT_EQ(*item, 2);
+}
+
+TEST(spsc_queue, threads)
+{
+    const int kItemCount = 100000;
+
+    SpscQueue<int> queue(16);
+
+    std::thread producer([&]()
+    {
+        for (int i = 0; i < kItemCount; ++i)
+        {
+            int item = i;
+
+            while (!queue.tryPush(std::move(item)))
+                std::this_thread::yield();
+        }
+    });
+
+    for (int i = 0; i < kItemCount; ++i)
+    {
+        int item = -1;
+
+        while (!queue.tryPop(&item))
+            std::this_thread::yield();
+
+        ASSERT_EQ(item, i);
+    }
+
+    producer.join();
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+} // namespace base
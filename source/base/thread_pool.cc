@@ -0,0 +1,138 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/thread_pool.h"
+
+#include <algorithm>
+
+namespace base {
+
+namespace {
+
+// More threads do not give a noticeable gain for the tasks we have (memory bandwidth becomes
+// the bottleneck), but take processor time from other processes.
+const int kMaxDefaultThreadCount = 8;
+
+} // namespace
+
+ThreadPool::ThreadPool(int thread_count)
+{
+    if (thread_count <= 0)
+        thread_count = defaultThreadCount();
+
+    // The calling thread also executes the tasks.
+    for (int i = 1; i < thread_count; ++i)
+        workers_.emplace_back(&ThreadPool::workerThread, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock(lock_);
+        terminate_ = true;
+    }
+
+    work_condition_.notify_all();
+
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(int count, const Task& task)
+{
+    if (count <= 0)
+        return;
+
+    if (workers_.empty() || count == 1)
+    {
+        for (int i = 0; i < count; ++i)
+            task(i, 0);
+        return;
+    }
+
+    {
+        std::scoped_lock lock(lock_);
+
+        task_ = &task;
+        task_count_ = count;
+        next_index_ = 0;
+        active_workers_ = static_cast<int>(workers_.size());
+
+        ++generation_;
+    }
+
+    work_condition_.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock lock(lock_);
+    done_condition_.wait(lock, [this]() { return active_workers_ == 0; });
+
+    task_ = nullptr;
+    task_count_ = 0;
+}
+
+// static
+int ThreadPool::defaultThreadCount()
+{
+    int count = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(count, 1, kMaxDefaultThreadCount);
+}
+
+void ThreadPool::workerThread(int thread_index)
+{
+    uint64_t generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(lock_);
+
+            work_condition_.wait(lock, [&]()
+            {
+                return terminate_ || generation_ != generation;
+            });
+
+            if (terminate_)
+                return;
+
+            generation = generation_;
+        }
+
+        runTasks(thread_index);
+
+        std::scoped_lock lock(lock_);
+
+        if (--active_workers_ == 0)
+            done_condition_.notify_one();
+    }
+}
+
+void ThreadPool::runTasks(int thread_index)
+{
+    while (true)
+    {
+        const int index = next_index_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= task_count_)
+            break;
+
+        (*task_)(index, thread_index);
+    }
+}
+
+} // namespace base
@@ -0,0 +1,85 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__THREAD_POOL_H
+#define BASE__THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// A fixed set of worker threads for data-parallel loops.
+// The pool is intended to be owned and used by a single thread. Calls to |parallelFor| block
+// until all tasks are completed, so the tasks may safely reference the caller's stack.
+class ThreadPool
+{
+public:
+    // Creates a pool that executes tasks on |thread_count| threads including the calling thread.
+    // If |thread_count| is less than or equal to zero, the number of threads is selected by the
+    // number of processor cores.
+    explicit ThreadPool(int thread_count);
+    ~ThreadPool();
+
+    // |task_index| is in the range [0, count). |thread_index| is in the range [0, threadCount())
+    // and identifies the thread executing the task (the calling thread always has index 0).
+    using Task = std::function<void(int task_index, int thread_index)>;
+
+    // Returns the number of threads that execute tasks, including the calling thread.
+    int threadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Calls |task| for each index in the range [0, count) and returns when all calls are
+    // completed. The order in which the indexes are processed is not defined.
+    void parallelFor(int count, const Task& task);
+
+    // Returns the recommended number of threads for the current processor.
+    static int defaultThreadCount();
+
+private:
+    void workerThread(int thread_index);
+    void runTasks(int thread_index);
+
+    std::vector<std::thread> workers_;
+
+    std::mutex lock_;
+    std::condition_variable work_condition_;
+    std::condition_variable done_condition_;
+
+    const Task* task_ = nullptr;
+    int task_count_ = 0;
+    std::atomic_int next_index_ = 0;
+
+    // Number of workers that have not yet finished the current job.
+    int active_workers_ = 0;
+
+    // Incremented each time a new job is published.
+    uint64_t generation_ = 0;
+    bool terminate_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+} // namespace base
+
+#endif // BASE__THREAD_POOL_H
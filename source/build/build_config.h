@@ -22,6 +22,9 @@
 // OS detection.
 #if defined(_WIN32)
 #define OS_WIN
+#elif defined(__linux__)
+#define OS_LINUX
+#define OS_POSIX
 #else
 #error Unknown OS
 #endif
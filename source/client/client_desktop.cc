@@ -22,11 +22,14 @@
 #include <QImage>
 #include <QPixmap>
 
+#include <cstring>
+
 #include "base/logging.h"
 #include "codec/cursor_decoder.h"
 #include "codec/video_decoder.h"
 #include "codec/video_util.h"
 #include "common/desktop_session_constants.h"
+#include "desktop/desktop_frame_simple.h"
 #include "desktop/mouse_cursor.h"
 
 namespace client {
@@ -146,7 +149,14 @@ void ClientDesktop::sendConfig(const proto::desktop::Config& config)
         cursor_decoder_.reset();
 
     outgoing_message_.Clear();
-    outgoing_message_.mutable_config()->CopyFrom(config);
+
+    proto::desktop::Config* outgoing_config = outgoing_message_.mutable_config();
+    outgoing_config->CopyFrom(config);
+
+    // We enable video features that are supported by both sides.
+    outgoing_config->set_video_features(
+        supported_video_features_ & common::kSupportedVideoFeatures);
+
     sendMessage(outgoing_message_);
 }
 
@@ -185,6 +195,9 @@ void ClientDesktop::readConfigRequest(const proto::desktop::ConfigRequest& confi
     // The list of supported video encodings is passed as a bit field.
     supported_video_encodings_ = config_request.video_encodings();
 
+    // The list of supported video features is passed as a bit field.
+    supported_video_features_ = config_request.video_features();
+
     // We notify the window about changes in the list of extensions.
     // A window can disable/enable some of its capabilities in accordance with this information.
     delegate_->extensionListChanged();
@@ -213,6 +226,19 @@ void ClientDesktop::readConfigRequest(const proto::desktop::ConfigRequest& confi
 
 void ClientDesktop::readVideoPacket(const proto::desktop::VideoPacket& packet)
 {
+    if (packet.has_stream())
+    {
+        readStreamPacket(packet);
+        return;
+    }
+
+    // The host sends the whole desktop in one stream again.
+    if (!video_streams_.empty())
+    {
+        video_streams_.clear();
+        streams_rect_ = QRect();
+    }
+
     if (video_encoding_ != packet.encoding())
     {
         video_decoder_ = codec::VideoDecoder::create(packet.encoding());
@@ -228,27 +254,16 @@ void ClientDesktop::readVideoPacket(const proto::desktop::VideoPacket& packet)
     if (packet.has_format())
     {
         QRect screen_rect = codec::VideoUtil::fromVideoRect(packet.format().screen_rect());
-
-        static const int kMaxValue = std::numeric_limits<uint16_t>::max();
-        static const int kMinValue = -std::numeric_limits<uint16_t>::max();
-
-        if (screen_rect.width()  <= 0 || screen_rect.width()  >= kMaxValue ||
-            screen_rect.height() <= 0 || screen_rect.height() >= kMaxValue)
-        {
-            onSessionError(tr("Wrong video frame size"));
+        if (!isValidScreenRect(screen_rect))
             return;
-        }
-
-        if (screen_rect.x() < kMinValue || screen_rect.x() >= kMaxValue ||
-            screen_rect.y() < kMinValue || screen_rect.y() >= kMaxValue)
-        {
-            onSessionError(tr("Wrong video frame position"));
-            return;
-        }
 
         delegate_->setDesktopRect(screen_rect);
     }
 
+    // The host scales the screen to the size of the window.
+    if (packet.has_source_rect())
+        delegate_->setSourceRect(codec::VideoUtil::fromVideoRect(packet.source_rect()));
+
     desktop::Frame* frame = delegate_->desktopFrame();
     if (!frame)
     {
@@ -265,6 +280,157 @@ void ClientDesktop::readVideoPacket(const proto::desktop::VideoPacket& packet)
     delegate_->drawDesktop();
 }
 
+void ClientDesktop::readStreamPacket(const proto::desktop::VideoPacket& packet)
+{
+    // The single stream of the desktop is ended.
+    video_decoder_.reset();
+    video_encoding_ = proto::desktop::VIDEO_ENCODING_UNKNOWN;
+
+    VideoStream& stream = video_streams_[packet.stream().screen_id()];
+
+    if (stream.encoding != packet.encoding())
+    {
+        stream.decoder = codec::VideoDecoder::create(packet.encoding());
+        stream.encoding = packet.encoding();
+    }
+
+    if (!stream.decoder)
+    {
+        onSessionError(tr("Video decoder not initialized"));
+        return;
+    }
+
+    if (packet.has_format())
+    {
+        QRect screen_rect = codec::VideoUtil::fromVideoRect(packet.format().screen_rect());
+        if (!isValidScreenRect(screen_rect))
+            return;
+
+        stream.frame =
+            desktop::FrameSimple::create(screen_rect.size(), desktop::PixelFormat::ARGB());
+        stream.screen_rect = screen_rect;
+    }
+
+    if (!stream.frame)
+    {
+        onSessionError(tr("The desktop frame is not initialized"));
+        return;
+    }
+
+    if (!stream.decoder->decode(packet, stream.frame.get()))
+    {
+        onSessionError(tr("The video packet could not be decoded"));
+        return;
+    }
+
+    QRegion changed_region;
+
+    if (packet.has_format())
+    {
+        changed_region = QRect(QPoint(), stream.screen_rect.size());
+    }
+    else
+    {
+        for (int i = 0; i < packet.dirty_rect_size(); ++i)
+            changed_region += codec::VideoUtil::fromVideoRect(packet.dirty_rect(i));
+
+        for (int i = 0; i < packet.move_rect_size(); ++i)
+        {
+            const proto::desktop::VideoMoveRect& move_rect = packet.move_rect(i);
+
+            changed_region += QRect(QPoint(move_rect.target_x(), move_rect.target_y()),
+                                    codec::VideoUtil::fromVideoRect(
+                                        move_rect.source_rect()).size());
+        }
+
+        for (int i = 0; i < packet.part_size(); ++i)
+        {
+            const proto::desktop::VideoPart& part = packet.part(i);
+
+            for (int j = 0; j < part.rect_size(); ++j)
+                changed_region += codec::VideoUtil::fromVideoRect(part.rect(j));
+        }
+    }
+
+    // If the desktop is resized, all streams are copied to it.
+    const QRect streams_rect = streams_rect_;
+    updateStreamsRect();
+
+    if (streams_rect_ == streams_rect)
+        copyStream(stream, changed_region);
+
+    delegate_->drawDesktop();
+}
+
+bool ClientDesktop::isValidScreenRect(const QRect& screen_rect)
+{
+    static const int kMaxValue = std::numeric_limits<uint16_t>::max();
+    static const int kMinValue = -std::numeric_limits<uint16_t>::max();
+
+    if (screen_rect.width()  <= 0 || screen_rect.width()  >= kMaxValue ||
+        screen_rect.height() <= 0 || screen_rect.height() >= kMaxValue)
+    {
+        onSessionError(tr("Wrong video frame size"));
+        return false;
+    }
+
+    if (screen_rect.x() < kMinValue || screen_rect.x() >= kMaxValue ||
+        screen_rect.y() < kMinValue || screen_rect.y() >= kMaxValue)
+    {
+        onSessionError(tr("Wrong video frame position"));
+        return false;
+    }
+
+    return true;
+}
+
+void ClientDesktop::updateStreamsRect()
+{
+    QRect streams_rect;
+
+    for (const auto& stream : video_streams_)
+    {
+        if (stream.second.frame)
+            streams_rect = streams_rect.united(stream.second.screen_rect);
+    }
+
+    if (streams_rect == streams_rect_ || streams_rect.isEmpty())
+        return;
+
+    streams_rect_ = streams_rect;
+    delegate_->setDesktopRect(streams_rect);
+
+    for (const auto& stream : video_streams_)
+    {
+        if (stream.second.frame)
+            copyStream(stream.second, QRect(QPoint(), stream.second.screen_rect.size()));
+    }
+}
+
+void ClientDesktop::copyStream(const VideoStream& stream, const QRegion& region)
+{
+    desktop::Frame* desktop_frame = delegate_->desktopFrame();
+    if (!desktop_frame)
+        return;
+
+    const QPoint offset = stream.screen_rect.topLeft() - streams_rect_.topLeft();
+    const int bytes_per_pixel = stream.frame->format().bytesPerPixel();
+
+    for (const auto& rect : region.intersected(QRect(QPoint(), stream.frame->size())))
+    {
+        const uint8_t* source = stream.frame->frameDataAtPos(rect.topLeft());
+        uint8_t* target = desktop_frame->frameDataAtPos(rect.topLeft() + offset);
+
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            memcpy(target, source, rect.width() * bytes_per_pixel);
+
+            source += stream.frame->stride();
+            target += desktop_frame->stride();
+        }
+    }
+}
+
 void ClientDesktop::readCursorShape(const proto::desktop::CursorShape& cursor_shape)
 {
     const ConnectData& connect_data = connectData();
@@ -321,6 +487,25 @@ void ClientDesktop::readExtension(const proto::desktop::Extension& extension)
             return;
         }
 
+        // The streams of the removed screens are dropped.
+        for (auto it = video_streams_.begin(); it != video_streams_.end();)
+        {
+            bool found = false;
+
+            for (int i = 0; i < screen_list.screen_size(); ++i)
+            {
+                if (screen_list.screen(i).id() == it->first)
+                    found = true;
+            }
+
+            if (found)
+                ++it;
+            else
+                it = video_streams_.erase(it);
+        }
+
+        updateStreamsRect();
+
         delegate_->setScreenList(screen_list);
     }
     else if (extension.name() == common::kSystemInfoExtension)
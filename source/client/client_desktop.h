@@ -19,6 +19,11 @@
 #ifndef CLIENT__CLIENT_DESKTOP_H
 #define CLIENT__CLIENT_DESKTOP_H
 
+#include <QRegion>
+
+#include <map>
+#include <memory>
+
 #include "client/client.h"
 #include "proto/desktop_session_extensions.pb.h"
 #include "proto/system_info.pb.h"
@@ -48,6 +53,7 @@ public:
         virtual void configRequered() = 0;
 
         virtual void setDesktopRect(const QRect& screen_rect) = 0;
+        virtual void setSourceRect(const QRect& source_rect) = 0;
         virtual void drawDesktop() = 0;
         virtual desktop::Frame* desktopFrame() = 0;
 
@@ -62,6 +68,7 @@ public:
 
     const QStringList& supportedExtensions() const { return supported_extensions_; }
     uint32_t supportedVideoEncodings() const { return supported_video_encodings_; }
+    uint32_t supportedVideoFeatures() const { return supported_video_features_; }
 
     void sendKeyEvent(uint32_t usb_keycode, uint32_t flags);
     void sendPointerEvent(const QPoint& pos, uint32_t mask);
@@ -77,13 +84,29 @@ protected:
     void messageReceived(const QByteArray& buffer) override;
 
 private:
+    // Stream of a screen if the host captures and encodes the screens separately. The decoded
+    // screens are copied to the desktop frame at their positions.
+    struct VideoStream
+    {
+        proto::desktop::VideoEncoding encoding = proto::desktop::VIDEO_ENCODING_UNKNOWN;
+        std::unique_ptr<codec::VideoDecoder> decoder;
+        std::unique_ptr<desktop::Frame> frame;
+        QRect screen_rect;
+    };
+
     void readConfigRequest(const proto::desktop::ConfigRequest& config_request);
     void readVideoPacket(const proto::desktop::VideoPacket& packet);
+    void readStreamPacket(const proto::desktop::VideoPacket& packet);
     void readCursorShape(const proto::desktop::CursorShape& cursor_shape);
     void readClipboardEvent(const proto::desktop::ClipboardEvent& clipboard_event);
     void readExtension(const proto::desktop::Extension& extension);
 
     void onSessionError(const QString& message);
+    bool isValidScreenRect(const QRect& screen_rect);
+
+    // Resizes the desktop to the bounding rectangle of the streams if it is changed.
+    void updateStreamsRect();
+    void copyStream(const VideoStream& stream, const QRegion& region);
 
     Delegate* delegate_;
 
@@ -92,11 +115,15 @@ private:
 
     QStringList supported_extensions_;
     uint32_t supported_video_encodings_ = 0;
+    uint32_t supported_video_features_ = 0;
 
     proto::desktop::VideoEncoding video_encoding_ = proto::desktop::VIDEO_ENCODING_UNKNOWN;
     std::unique_ptr<codec::VideoDecoder> video_decoder_;
     std::unique_ptr<codec::CursorDecoder> cursor_decoder_;
 
+    std::map<int64_t, VideoStream> video_streams_;
+    QRect streams_rect_;
+
     DISALLOW_COPY_AND_ASSIGN(ClientDesktop);
 };
 
@@ -60,6 +60,12 @@ DesktopConfigDialog::DesktopConfigDialog(proto::SessionType session_type,
     if (video_encodings & proto::desktop::VIDEO_ENCODING_ZSTD)
         combo_codec->addItem(QLatin1String("ZSTD"), proto::desktop::VIDEO_ENCODING_ZSTD);
 
+    if (video_encodings & proto::desktop::VIDEO_ENCODING_PALETTE)
+        combo_codec->addItem(QLatin1String("Palette"), proto::desktop::VIDEO_ENCODING_PALETTE);
+
+    if (video_encodings & proto::desktop::VIDEO_ENCODING_HYBRID)
+        combo_codec->addItem(QLatin1String("Hybrid"), proto::desktop::VIDEO_ENCODING_HYBRID);
+
     int current_codec = combo_codec->findData(config_.video_encoding());
     if (current_codec == -1)
         current_codec = 0;
@@ -137,8 +143,10 @@ DesktopConfigDialog::~DesktopConfigDialog() = default;
 
 void DesktopConfigDialog::onCodecChanged(int item_index)
 {
-    bool has_pixel_format =
-        (ui.combo_codec->itemData(item_index).toInt() == proto::desktop::VIDEO_ENCODING_ZSTD);
+    const int video_encoding = ui.combo_codec->itemData(item_index).toInt();
+    bool has_pixel_format = (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD ||
+                             video_encoding == proto::desktop::VIDEO_ENCODING_PALETTE ||
+                             video_encoding == proto::desktop::VIDEO_ENCODING_HYBRID);
 
     ui.label_color_depth->setEnabled(has_pixel_format);
     ui.combo_color_depth->setEnabled(has_pixel_format);
@@ -162,7 +170,9 @@ void DesktopConfigDialog::onButtonBoxClicked(QAbstractButton* button)
 
         config_.set_video_encoding(video_encoding);
 
-        if (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD)
+        if (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD ||
+            video_encoding == proto::desktop::VIDEO_ENCODING_PALETTE ||
+            video_encoding == proto::desktop::VIDEO_ENCODING_HYBRID)
         {
             desktop::PixelFormat pixel_format;
 
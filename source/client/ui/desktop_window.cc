@@ -180,6 +180,15 @@ void DesktopWindow::setDesktopRect(const QRect& screen_rect)
         onScalingChanged();
 
     screen_top_left_ = screen_rect.topLeft();
+
+    // The host sends the source rectangle with each change of the format if it scales the screen
+    // to the window.
+    source_rect_ = QRect();
+}
+
+void DesktopWindow::setSourceRect(const QRect& source_rect)
+{
+    source_rect_ = source_rect;
 }
 
 void DesktopWindow::drawDesktop()
@@ -277,6 +286,18 @@ void DesktopWindow::onPointerEvent(const QPoint& pos, uint32_t mask)
 
     ClientDesktop* client = desktopClient();
 
+    if (source_rect_.isValid())
+    {
+        // The position is mapped from the displayed size to the size of the remote screen.
+        const QSize& displayed_size = desktop_->size();
+
+        int x = pos.x() * source_rect_.width() / displayed_size.width() + source_rect_.x();
+        int y = pos.y() * source_rect_.height() / displayed_size.height() + source_rect_.y();
+
+        client->sendPointerEvent(QPoint(x, y), mask);
+        return;
+    }
+
     int remote_scale_factor = client->connectData().desktop_config.scale_factor();
     if (remote_scale_factor)
     {
@@ -390,6 +411,13 @@ void DesktopWindow::takeScreenshot()
 
 void DesktopWindow::onScalingChanged(bool enabled)
 {
+    static const int kTargetSizeDelay = 500; // ms
+
+    if (target_size_timer_id_)
+        killTimer(target_size_timer_id_);
+
+    target_size_timer_id_ = startTimer(kTargetSizeDelay);
+
     desktop::Frame* frame = desktopFrame();
     if (!frame)
         return;
@@ -404,6 +432,15 @@ void DesktopWindow::onScalingChanged(bool enabled)
 
 void DesktopWindow::timerEvent(QTimerEvent* event)
 {
+    if (event->timerId() == target_size_timer_id_)
+    {
+        killTimer(target_size_timer_id_);
+        target_size_timer_id_ = 0;
+
+        sendTargetSize();
+        return;
+    }
+
     if (event->timerId() == scroll_timer_id_)
     {
         if (scroll_delta_.x() != 0)
@@ -518,6 +555,33 @@ ClientDesktop* DesktopWindow::desktopClient()
     return static_cast<ClientDesktop*>(currentClient());
 }
 
+void DesktopWindow::sendTargetSize()
+{
+    ClientDesktop* client = desktopClient();
+
+    // Older hosts restart the video stream on the change of the scale.
+    if (!(client->supportedVideoFeatures() & proto::desktop::VIDEO_FEATURE_ADAPTIVE_SCALE))
+        return;
+
+    proto::desktop::Config config = client->connectData().desktop_config;
+
+    // Without the scaling the screen is shown in the original size.
+    QSize target_size(0, 0);
+    if (panel_->scaling())
+        target_size = size();
+
+    if (config.target_width() == static_cast<uint32_t>(target_size.width()) &&
+        config.target_height() == static_cast<uint32_t>(target_size.height()))
+    {
+        return;
+    }
+
+    config.set_target_width(target_size.width());
+    config.set_target_height(target_size.height());
+
+    onConfigChanged(config);
+}
+
 // static
 QString DesktopWindow::createWindowTitle(const ConnectData& connect_data)
 {
@@ -57,6 +57,7 @@ public:
     void extensionListChanged() override;
     void configRequered() override;
     void setDesktopRect(const QRect& screen_rect) override;
+    void setSourceRect(const QRect& source_rect) override;
     void drawDesktop() override;
     desktop::Frame* desktopFrame() override;
     void setRemoteCursor(const QCursor& cursor) override;
@@ -90,6 +91,9 @@ private slots:
 private:
     ClientDesktop* desktopClient();
 
+    // Sends the size of the window to the host, so the host scales the screen to it.
+    void sendTargetSize();
+
     static QString createWindowTitle(const ConnectData& connect_data);
 
     QHBoxLayout* layout_ = nullptr;
@@ -104,10 +108,16 @@ private:
     int scroll_timer_id_ = 0;
     QPoint scroll_delta_;
 
+    // The size of the window is sent after the resizing stops.
+    int target_size_timer_id_ = 0;
+
     bool is_maximized_ = false;
 
     QPoint screen_top_left_;
 
+    // Position and size of the remote screen before the scaling by the host.
+    QRect source_rect_;
+
     DISALLOW_COPY_AND_ASSIGN(DesktopWindow);
 };
 
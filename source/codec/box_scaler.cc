@@ -0,0 +1,303 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/box_scaler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/logging.h"
+
+namespace codec {
+
+namespace {
+
+// The averages of up to this number of pixels are calculated with a multiplication by the
+// fixed-point reciprocal of the number instead of a division. The result is exact in this range.
+// The larger boxes (deep downscales) are divided.
+const int kMaxReciprocalCount = 4096;
+
+// Range of the source pixels [begin, end) covered by a pixel of the scaled image.
+struct Span
+{
+    int begin;
+    int end;
+};
+
+struct Color
+{
+    int b;
+    int g;
+    int r;
+    int a;
+};
+
+Span sourceSpan(int target_pos, int source_length, int target_length)
+{
+    Span span;
+
+    span.begin = static_cast<int>(int64_t(target_pos) * source_length / target_length);
+    span.end = static_cast<int>(int64_t(target_pos + 1) * source_length / target_length);
+    span.end = std::min(std::max(span.end, span.begin + 1), source_length);
+
+    return span;
+}
+
+// Calculates the rows of the scaled image in the columns of |target_rect|.
+class RowScaler
+{
+public:
+    RowScaler(const uint8_t* source, int source_stride, const QSize& source_size,
+              const QSize& target_size, const QRect& target_rect);
+
+    // Calculates the row |y| of the scaled image.
+    void scaleRow(int y, Color* colors);
+
+private:
+    // Returns |sum| / |count| rounded to the nearest.
+    int average(uint32_t sum, uint32_t count) const;
+
+    const uint8_t* const source_;
+    const int source_stride_;
+    const QSize source_size_;
+    const QSize target_size_;
+
+    std::vector<Span> x_spans_;
+    int source_left_ = 0;
+    int source_width_ = 0;
+
+    // Reciprocals of the numbers of the pixels in 32.32 fixed point.
+    std::vector<uint64_t> reciprocals_;
+
+    // Sums of the channels of the source rows covered by a row of the scaled image.
+    std::vector<uint32_t> row_sums_;
+};
+
+RowScaler::RowScaler(const uint8_t* source, int source_stride, const QSize& source_size,
+                     const QSize& target_size, const QRect& target_rect)
+    : source_(source),
+      source_stride_(source_stride),
+      source_size_(source_size),
+      target_size_(target_size),
+      x_spans_(target_rect.width())
+{
+    DCHECK(QRect(QPoint(), target_size).contains(target_rect));
+    DCHECK_LE(target_size.width(), source_size.width());
+    DCHECK_LE(target_size.height(), source_size.height());
+
+    int max_span_width = 1;
+
+    for (int x = 0; x < target_rect.width(); ++x)
+    {
+        x_spans_[x] = sourceSpan(target_rect.x() + x, source_size.width(), target_size.width());
+        max_span_width = std::max(max_span_width, x_spans_[x].end - x_spans_[x].begin);
+    }
+
+    const int max_span_height =
+        (source_size.height() + target_size.height() - 1) / target_size.height() + 1;
+
+    const int64_t max_count = int64_t(max_span_width) * max_span_height;
+
+    reciprocals_.resize(std::min<int64_t>(max_count, kMaxReciprocalCount) + 1);
+    for (size_t count = 1; count < reciprocals_.size(); ++count)
+        reciprocals_[count] = ((uint64_t(1) << 32) + count - 1) / count;
+
+    source_left_ = x_spans_.front().begin;
+    source_width_ = x_spans_.back().end - source_left_;
+
+    row_sums_.resize(source_width_ * 4);
+}
+
+int RowScaler::average(uint32_t sum, uint32_t count) const
+{
+    const uint32_t rounded_sum = sum + count / 2;
+
+    if (count < reciprocals_.size())
+        return static_cast<int>((rounded_sum * reciprocals_[count]) >> 32);
+
+    return static_cast<int>(rounded_sum / count);
+}
+
+void RowScaler::scaleRow(int y, Color* colors)
+{
+    const Span y_span = sourceSpan(y, source_size_.height(), target_size_.height());
+    const int span_height = y_span.end - y_span.begin;
+    const int row_size = source_width_ * 4;
+
+    const uint8_t* source_row = source_ + y_span.begin * source_stride_ + source_left_ * 4;
+
+    for (int i = 0; i < row_size; ++i)
+        row_sums_[i] = source_row[i];
+
+    for (int i = 1; i < span_height; ++i)
+    {
+        source_row += source_stride_;
+
+        for (int j = 0; j < row_size; ++j)
+            row_sums_[j] += source_row[j];
+    }
+
+    const int width = static_cast<int>(x_spans_.size());
+
+    for (int x = 0; x < width; ++x)
+    {
+        const Span& x_span = x_spans_[x];
+        const uint32_t* sum = &row_sums_[(x_span.begin - source_left_) * 4];
+
+        uint32_t b = sum[0];
+        uint32_t g = sum[1];
+        uint32_t r = sum[2];
+        uint32_t a = sum[3];
+
+        for (int i = 1; i < x_span.end - x_span.begin; ++i)
+        {
+            b += sum[i * 4 + 0];
+            g += sum[i * 4 + 1];
+            r += sum[i * 4 + 2];
+            a += sum[i * 4 + 3];
+        }
+
+        const uint32_t count = (x_span.end - x_span.begin) * span_height;
+
+        colors[x].b = average(b, count);
+        colors[x].g = average(g, count);
+        colors[x].r = average(r, count);
+        colors[x].a = average(a, count);
+    }
+}
+
+// The coefficients are the same as in libyuv (BT.601, limited range).
+uint8_t toY(const Color& color)
+{
+    return static_cast<uint8_t>((66 * color.r + 129 * color.g + 25 * color.b + 0x1080) >> 8);
+}
+
+uint8_t toU(const Color& color)
+{
+    return static_cast<uint8_t>((112 * color.b - 74 * color.g - 38 * color.r + 0x8080) >> 8);
+}
+
+uint8_t toV(const Color& color)
+{
+    return static_cast<uint8_t>((112 * color.r - 94 * color.g - 18 * color.b + 0x8080) >> 8);
+}
+
+} // namespace
+
+void scaleARGB(const uint8_t* source, int source_stride, const QSize& source_size,
+               uint8_t* target, int target_stride, const QSize& target_size,
+               const QRect& target_rect)
+{
+    if (target_rect.isEmpty())
+        return;
+
+    RowScaler scaler(source, source_stride, source_size, target_size, target_rect);
+
+    const int width = target_rect.width();
+    std::vector<Color> colors(width);
+
+    for (int y = target_rect.top(); y <= target_rect.bottom(); ++y)
+    {
+        scaler.scaleRow(y, colors.data());
+
+        uint8_t* target_row = target + y * target_stride + target_rect.x() * 4;
+
+        for (int x = 0; x < width; ++x)
+        {
+            target_row[x * 4 + 0] = static_cast<uint8_t>(colors[x].b);
+            target_row[x * 4 + 1] = static_cast<uint8_t>(colors[x].g);
+            target_row[x * 4 + 2] = static_cast<uint8_t>(colors[x].r);
+            target_row[x * 4 + 3] = static_cast<uint8_t>(colors[x].a);
+        }
+    }
+}
+
+void scaleARGBToI420(const uint8_t* source, int source_stride, const QSize& source_size,
+                     const QSize& target_size, const QRect& target_rect,
+                     uint8_t* y_plane, int y_stride,
+                     uint8_t* u_plane, int u_stride,
+                     uint8_t* v_plane, int v_stride)
+{
+    DCHECK_EQ(target_rect.x() % 2, 0);
+    DCHECK_EQ(target_rect.y() % 2, 0);
+
+    if (target_rect.isEmpty())
+        return;
+
+    RowScaler scaler(source, source_stride, source_size, target_size, target_rect);
+
+    const int width = target_rect.width();
+
+    // Two rows of the scaled image for the chroma subsampling.
+    std::vector<Color> colors(width * 2);
+
+    // The chroma is the average of up to 4 pixels.
+    const uint32_t reciprocals[] = { 0, 65536, 65536 / 2, 65536 / 3, 65536 / 4 };
+
+    for (int y = target_rect.top(); y <= target_rect.bottom(); y += 2)
+    {
+        const int rows = std::min(2, target_rect.bottom() - y + 1);
+
+        for (int row = 0; row < rows; ++row)
+        {
+            Color* color = &colors[row * width];
+            uint8_t* y_data = y_plane + (y + row) * y_stride + target_rect.x();
+
+            scaler.scaleRow(y + row, color);
+
+            for (int x = 0; x < width; ++x)
+                y_data[x] = toY(color[x]);
+        }
+
+        uint8_t* u_data = u_plane + (y / 2) * u_stride + target_rect.x() / 2;
+        uint8_t* v_data = v_plane + (y / 2) * v_stride + target_rect.x() / 2;
+
+        for (int x = 0; x < width; x += 2)
+        {
+            const int columns = std::min(2, width - x);
+
+            uint32_t b = 0;
+            uint32_t g = 0;
+            uint32_t r = 0;
+
+            for (int row = 0; row < rows; ++row)
+            {
+                for (int column = 0; column < columns; ++column)
+                {
+                    const Color& color = colors[row * width + x + column];
+
+                    b += color.b;
+                    g += color.g;
+                    r += color.r;
+                }
+            }
+
+            const uint32_t reciprocal = reciprocals[rows * columns];
+
+            const Color average = { static_cast<int>((b * reciprocal + 32768) >> 16),
+                                    static_cast<int>((g * reciprocal + 32768) >> 16),
+                                    static_cast<int>((r * reciprocal + 32768) >> 16),
+                                    0 };
+
+            u_data[x / 2] = toU(average);
+            v_data[x / 2] = toV(average);
+        }
+    }
+}
+
+} // namespace codec
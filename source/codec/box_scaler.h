@@ -0,0 +1,50 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__BOX_SCALER_H
+#define CODEC__BOX_SCALER_H
+
+#include <QRect>
+
+#include <cstdint>
+
+namespace codec {
+
+// The functions scale the ARGB image of |source_size| down to |target_size| and write the area
+// |target_rect| of the scaled image. Each pixel of the scaled image is the average of the source
+// pixels that it covers (a box filter). The result depends only on the position of the pixel, so
+// the areas of the image can be scaled separately without seams between them, and the pixels at
+// the edges of the image are handled like any other.
+
+// |target| points to the top left corner of the target image.
+void scaleARGB(const uint8_t* source, int source_stride, const QSize& source_size,
+               uint8_t* target, int target_stride, const QSize& target_size,
+               const QRect& target_rect);
+
+// Converts the scaled pixels to I420 in the same pass. The scaled ARGB image is never stored, so
+// the pixels are read from the memory only once. |target_rect| must have even coordinates. The
+// planes point to the top left corner of the target image.
+void scaleARGBToI420(const uint8_t* source, int source_stride, const QSize& source_size,
+                     const QSize& target_size, const QRect& target_rect,
+                     uint8_t* y_plane, int y_stride,
+                     uint8_t* u_plane, int u_stride,
+                     uint8_t* v_plane, int v_stride);
+
+} // namespace codec
+
+#endif // CODEC__BOX_SCALER_H
@@ -0,0 +1,238 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/box_scaler.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace codec {
+
+namespace {
+
+struct Image
+{
+    explicit Image(const QSize& size)
+        : size(size),
+          y_stride(size.width()),
+          uv_stride((size.width() + 1) / 2),
+          y(y_stride * size.height()),
+          u(uv_stride * ((size.height() + 1) / 2)),
+          v(u.size())
+    {
+        // Nothing
+    }
+
+    void convert(const std::vector<uint32_t>& source, const QSize& source_size, const QRect& rect)
+    {
+        scaleARGBToI420(reinterpret_cast<const uint8_t*>(source.data()),
+                        source_size.width() * 4, source_size, size, rect,
+                        y.data(), y_stride, u.data(), uv_stride, v.data(), uv_stride);
+    }
+
+    const QSize size;
+    const int y_stride;
+    const int uv_stride;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+};
+
+std::vector<uint32_t> randomImage(const QSize& size)
+{
+    std::mt19937 random(1);
+    std::vector<uint32_t> image(size.width() * size.height());
+
+    for (auto& pixel : image)
+        pixel = random() | 0xFF000000;
+
+    return image;
+}
+
+} // namespace
+
+TEST(box_scaler, flat_color)
+{
+    const QSize source_size(100, 60);
+    const QSize target_size(75, 45);
+
+    // White and black in the limited range.
+    for (uint32_t color : { 0xFFFFFFFFu, 0xFF000000u })
+    {
+        std::vector<uint32_t> source(source_size.width() * source_size.height(), color);
+
+        Image image(target_size);
+        image.convert(source, source_size, QRect(QPoint(), target_size));
+
+        for (uint8_t value : image.y)
+            ASSERT_EQ(color == 0xFFFFFFFFu ? 235 : 16, value);
+
+        for (uint8_t value : image.u)
+            ASSERT_EQ(128, value);
+
+        for (uint8_t value : image.v)
+            ASSERT_EQ(128, value);
+    }
+}
+
+TEST(box_scaler, half_size_averages_blocks)
+{
+    const QSize source_size(64, 32);
+    const QSize target_size(32, 16);
+
+    std::vector<uint32_t> source(source_size.width() * source_size.height());
+
+    // Each 2x2 block contains gray levels 10, 20, 30 and 40.
+    for (int y = 0; y < source_size.height(); ++y)
+    {
+        for (int x = 0; x < source_size.width(); ++x)
+        {
+            const uint32_t level = 10 + 10 * ((y % 2) * 2 + (x % 2));
+            source[y * source_size.width() + x] = 0xFF000000 | level * 0x010101;
+        }
+    }
+
+    Image image(target_size);
+    image.convert(source, source_size, QRect(QPoint(), target_size));
+
+    // The average level is 25.
+    const int expected_y = (220 * 25 + 0x1080) >> 8;
+
+    for (uint8_t value : image.y)
+        ASSERT_EQ(expected_y, value);
+}
+
+TEST(box_scaler, areas_match_full_image)
+{
+    const QSize source_size(333, 201);
+
+    for (int scale_factor : { 50, 66, 75, 90, 100 })
+    {
+        const QSize target_size((source_size.width() * scale_factor + 99) / 100,
+                                (source_size.height() * scale_factor + 99) / 100);
+        const std::vector<uint32_t> source = randomImage(source_size);
+
+        Image full(target_size);
+        full.convert(source, source_size, QRect(QPoint(), target_size));
+
+        // The same image converted by areas with even coordinates.
+        Image parts(target_size);
+
+        for (int y = 0; y < target_size.height(); y += 16)
+        {
+            for (int x = 0; x < target_size.width(); x += 38)
+            {
+                parts.convert(source, source_size,
+                              QRect(x, y, 38, 16).intersected(QRect(QPoint(), target_size)));
+            }
+        }
+
+        EXPECT_EQ(full.y, parts.y) << scale_factor;
+        EXPECT_EQ(full.u, parts.u) << scale_factor;
+        EXPECT_EQ(full.v, parts.v) << scale_factor;
+    }
+}
+
+TEST(box_scaler, argb_areas_match_full_image)
+{
+    const QSize source_size(333, 201);
+    const std::vector<uint32_t> source = randomImage(source_size);
+    const uint8_t* source_data = reinterpret_cast<const uint8_t*>(source.data());
+
+    // Small sizes are used for the thumbnails. The sizes need not keep the aspect ratio.
+    for (const QSize& target_size : { QSize(333, 201), QSize(250, 150), QSize(200, 100),
+                                      QSize(33, 20), QSize(7, 5) })
+    {
+        const int stride = target_size.width() * 4;
+        const QRect target_rect(QPoint(), target_size);
+
+        std::vector<uint8_t> full(stride * target_size.height());
+        scaleARGB(source_data, source_size.width() * 4, source_size,
+                  full.data(), stride, target_size, target_rect);
+
+        // The areas include the right and the bottom edges of the image.
+        std::vector<uint8_t> parts(full.size());
+        for (int y = 0; y < target_size.height(); y += 3)
+        {
+            for (int x = 0; x < target_size.width(); x += 5)
+            {
+                scaleARGB(source_data, source_size.width() * 4, source_size,
+                          parts.data(), stride, target_size,
+                          QRect(x, y, 5, 3).intersected(target_rect));
+            }
+        }
+
+        EXPECT_EQ(full, parts) << target_size.width() << "x" << target_size.height();
+    }
+}
+
+TEST(box_scaler, argb_last_row_and_column)
+{
+    const QSize source_size(10, 10);
+    std::vector<uint32_t> source(source_size.width() * source_size.height(), 0xFF000000);
+
+    // Only the last row and the last column of the source are white.
+    for (int i = 0; i < source_size.width(); ++i)
+    {
+        source[(source_size.height() - 1) * source_size.width() + i] = 0xFFFFFFFF;
+        source[i * source_size.width() + source_size.width() - 1] = 0xFFFFFFFF;
+    }
+
+    const QSize target_size(5, 5);
+    std::vector<uint32_t> target(target_size.width() * target_size.height());
+
+    scaleARGB(reinterpret_cast<const uint8_t*>(source.data()), source_size.width() * 4,
+              source_size, reinterpret_cast<uint8_t*>(target.data()), target_size.width() * 4,
+              target_size, QRect(QPoint(), target_size));
+
+    // Half of the pixels of the edge blocks and 3 of 4 in the corner block are white.
+    EXPECT_EQ(0xFF000000u, target[0]);
+    EXPECT_EQ(0xFF808080u, target[4 * target_size.width()]);
+    EXPECT_EQ(0xFF808080u, target[target_size.width() - 1]);
+    EXPECT_EQ(0xFFBFBFBFu, target[target.size() - 1]);
+}
+
+TEST(box_scaler, argb_flat_color_large_ratio)
+{
+    // The boxes cover up to 8294400 pixels, the sums do not fit in 16 bits and the numbers of the
+    // pixels are larger than the table of the reciprocals.
+    const uint32_t color = 0xC8C80A64;
+    const QSize source_sizes[] = { QSize(64, 2160), QSize(3840, 2160), QSize(257, 259) };
+    const QSize target_sizes[] = { QSize(1, 5), QSize(1, 40), QSize(1, 1), QSize(3, 7) };
+
+    for (const QSize& source_size : source_sizes)
+    {
+        std::vector<uint32_t> source(source_size.width() * source_size.height(), color);
+
+        for (const QSize& target_size : target_sizes)
+        {
+            std::vector<uint32_t> target(target_size.width() * target_size.height());
+
+            scaleARGB(reinterpret_cast<const uint8_t*>(source.data()), source_size.width() * 4,
+                      source_size, reinterpret_cast<uint8_t*>(target.data()),
+                      target_size.width() * 4, target_size, QRect(QPoint(), target_size));
+
+            for (uint32_t pixel : target)
+                ASSERT_EQ(color, pixel);
+        }
+    }
+}
+
+} // namespace codec
@@ -0,0 +1,223 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/content_classifier.h"
+
+#include "base/bits.h"
+#include "desktop/desktop_frame.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+// A block is a candidate for the lossy encoding if it was changed in this number of the last
+// 8 frames.
+const int kMinVideoChanges = 5;
+
+// Blocks with fewer colors are text or user interface.
+const int kMaxUiColors = 64;
+
+// Neighboring pixels form a sharp edge if one of the channels differs by more than this value.
+const int kSharpEdgeThreshold = 80;
+
+// Blocks in which more than 1/kMinEdgeDivisor of the neighboring pixels form sharp edges are
+// text or user interface.
+const int kMinEdgeDivisor = 16;
+
+// Blocks in which more than 1/kMinFlatDivisor of the neighboring pixels are equal are filled
+// areas or gradients of the user interface. Noise makes the neighboring pixels of a video differ.
+const int kMinFlatDivisor = 2;
+
+// Every second row of the block is analyzed.
+const int kRowStep = 2;
+
+// Counts the colors of a block up to kMaxUiColors + 1.
+class ColorCounter
+{
+public:
+    ColorCounter()
+    {
+        memset(slots_, 0, sizeof(slots_));
+    }
+
+    // Returns false if the number of colors exceeds kMaxUiColors.
+    bool add(uint32_t color)
+    {
+        // Zero marks an empty slot, so the colors are stored with the highest bit set.
+        const uint32_t value = color | 0x80000000U;
+        uint32_t slot = (value * 0x9E3779B1U) >> (32 - kSlotBits);
+
+        while (slots_[slot])
+        {
+            if (slots_[slot] == value)
+                return true;
+
+            slot = (slot + 1) & (kSlotCount - 1);
+        }
+
+        slots_[slot] = value;
+        return ++count_ <= kMaxUiColors;
+    }
+
+private:
+    static const int kSlotBits = 8;
+    static const int kSlotCount = 1 << kSlotBits;
+
+    uint32_t slots_[kSlotCount];
+    int count_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(ColorCounter);
+};
+
+bool isSharpEdge(uint32_t pixel1, uint32_t pixel2)
+{
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        const int value1 = (pixel1 >> shift) & 0xFF;
+        const int value2 = (pixel2 >> shift) & 0xFF;
+
+        if (std::abs(value1 - value2) > kSharpEdgeThreshold)
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace
+
+bool ContentClassifier::isVideoContent(const desktop::Frame* frame, const QRegion& region) const
+{
+    ColorCounter colors;
+    bool many_colors = false;
+    int edges = 0;
+    int flat_pairs = 0;
+    int pairs = 0;
+
+    for (const auto& rect : region)
+    {
+        for (int y = rect.top(); y <= rect.bottom(); y += kRowStep)
+        {
+            const uint32_t* row = reinterpret_cast<const uint32_t*>(
+                frame->frameDataAtPos(rect.left(), y));
+
+            for (int x = 1; x < rect.width(); ++x)
+            {
+                // The alpha channel is not used.
+                const uint32_t pixel = row[x] & 0x00FFFFFF;
+
+                if (pixel == (row[x - 1] & 0x00FFFFFF))
+                {
+                    ++flat_pairs;
+                    continue;
+                }
+
+                if (!many_colors)
+                    many_colors = !colors.add(pixel);
+
+                if (isSharpEdge(row[x - 1], pixel))
+                    ++edges;
+            }
+
+            pairs += rect.width() - 1;
+        }
+    }
+
+    return many_colors &&
+           edges * kMinEdgeDivisor < pairs &&
+           flat_pairs * kMinFlatDivisor < pairs;
+}
+
+void ContentClassifier::classify(const desktop::Frame* frame,
+                                 QRegion* lossless_region,
+                                 QRegion* lossy_region)
+{
+    const QRect frame_rect(QPoint(), frame->size());
+    const QRegion& updated_region = frame->constUpdatedRegion();
+
+    const int block_columns = (frame_rect.width() + kBlockSize - 1) / kBlockSize;
+    const int block_rows = (frame_rect.height() + kBlockSize - 1) / kBlockSize;
+
+    if (block_columns != block_columns_ || block_rows != block_rows_)
+    {
+        block_columns_ = block_columns;
+        block_rows_ = block_rows;
+        change_history_.assign(block_columns * block_rows, 0);
+    }
+
+    for (auto& history : change_history_)
+        history <<= 1;
+
+    for (const auto& rect : updated_region)
+    {
+        for (int y = rect.top() / kBlockSize; y <= rect.bottom() / kBlockSize; ++y)
+        {
+            for (int x = rect.left() / kBlockSize; x <= rect.right() / kBlockSize; ++x)
+                change_history_[y * block_columns_ + x] |= 1;
+        }
+    }
+
+    QRegion video_region;
+
+    for (int y = 0; y < block_rows_; ++y)
+    {
+        const uint8_t* history = &change_history_[y * block_columns_];
+        int run_start = -1;
+
+        for (int x = 0; x <= block_columns_; ++x)
+        {
+            bool is_video = false;
+
+            if (x < block_columns_ && (history[x] & 1) &&
+                base::countSetBits64(history[x]) >= kMinVideoChanges)
+            {
+                const QRect block_rect(x * kBlockSize, y * kBlockSize, kBlockSize, kBlockSize);
+
+                // Only the changed pixels of the block are analyzed.
+                is_video = isVideoContent(frame, updated_region.intersected(block_rect));
+            }
+
+            // Adjacent video blocks of a row are added as one rectangle.
+            if (is_video && run_start < 0)
+            {
+                run_start = x;
+            }
+            else if (!is_video && run_start >= 0)
+            {
+                video_region += QRect(run_start * kBlockSize, y * kBlockSize,
+                                      (x - run_start) * kBlockSize, kBlockSize)
+                                    .intersected(frame_rect);
+                run_start = -1;
+            }
+        }
+    }
+
+    if (video_region.isEmpty())
+    {
+        *lossless_region = updated_region;
+        *lossy_region = QRegion();
+        return;
+    }
+
+    *lossy_region = updated_region.intersected(video_region);
+    *lossless_region = updated_region.subtracted(video_region);
+}
+
+} // namespace codec
@@ -0,0 +1,66 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__CONTENT_CLASSIFIER_H
+#define CODEC__CONTENT_CLASSIFIER_H
+
+#include "base/macros_magic.h"
+
+#include <QRegion>
+
+#include <vector>
+
+namespace desktop {
+class Frame;
+} // namespace desktop
+
+namespace codec {
+
+// Splits the updated region of the frames into the areas with text and user interface, which must
+// stay sharp, and the areas with video or animation, which can be encoded with losses. The frame
+// is divided into blocks. A block is classified as video if it changes in most of the recent
+// frames, has many colors, few sharp edges and few equal neighboring pixels. Text and user
+// interface have few colors, many sharp edges or large filled areas even if they change often
+// (for example, when typing or scrolling).
+class ContentClassifier
+{
+public:
+    ContentClassifier() = default;
+    ~ContentClassifier() = default;
+
+    // Size of the blocks. The blocks are aligned to the macroblocks of the VPX encoders.
+    static const int kBlockSize = 64;
+
+    void classify(const desktop::Frame* frame, QRegion* lossless_region, QRegion* lossy_region);
+
+private:
+    bool isVideoContent(const desktop::Frame* frame, const QRegion& region) const;
+
+    int block_columns_ = 0;
+    int block_rows_ = 0;
+
+    // The changes of each block in the last frames (one bit for each frame, the lowest bit is the
+    // last frame).
+    std::vector<uint8_t> change_history_;
+
+    DISALLOW_COPY_AND_ASSIGN(ContentClassifier);
+};
+
+} // namespace codec
+
+#endif // CODEC__CONTENT_CLASSIFIER_H
@@ -0,0 +1,93 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/content_classifier.h"
+
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_generator.h"
+
+#include <gtest/gtest.h>
+
+namespace codec {
+
+namespace {
+
+const QSize kScreenSize(1280, 720);
+const int kFrameCount = 20;
+
+// Classifies the frames of |scene| and returns the lossy region of the last frame.
+QRegion lossyRegion(desktop::FrameGenerator::Scene scene)
+{
+    desktop::FrameGenerator generator(scene, kScreenSize);
+    ContentClassifier classifier;
+
+    QRegion lossless_region;
+    QRegion lossy_region;
+
+    classifier.classify(generator.frame(), &lossless_region, &lossy_region);
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        const desktop::Frame* frame = generator.nextFrame();
+
+        classifier.classify(frame, &lossless_region, &lossy_region);
+
+        EXPECT_EQ(lossless_region + lossy_region, frame->constUpdatedRegion());
+        EXPECT_TRUE(lossless_region.intersected(lossy_region).isEmpty());
+    }
+
+    return lossy_region;
+}
+
+} // namespace
+
+TEST(content_classifier, first_frame_is_lossless)
+{
+    desktop::FrameGenerator generator(desktop::FrameGenerator::Scene::VIDEO, kScreenSize);
+    ContentClassifier classifier;
+
+    QRegion lossless_region;
+    QRegion lossy_region;
+
+    classifier.classify(generator.frame(), &lossless_region, &lossy_region);
+
+    EXPECT_TRUE(lossy_region.isEmpty());
+    EXPECT_EQ(lossless_region, QRegion(QRect(QPoint(), kScreenSize)));
+}
+
+TEST(content_classifier, video_is_lossy)
+{
+    desktop::FrameGenerator generator(desktop::FrameGenerator::Scene::VIDEO, kScreenSize);
+    const QRegion video_region = generator.nextFrame()->constUpdatedRegion();
+
+    const QRegion lossy_region = lossyRegion(desktop::FrameGenerator::Scene::VIDEO);
+
+    // The blocks at the edges of the video also have the static background.
+    EXPECT_FALSE(lossy_region.isEmpty());
+    EXPECT_GT(lossy_region.boundingRect().width() * lossy_region.boundingRect().height(),
+              video_region.boundingRect().width() * video_region.boundingRect().height() / 2);
+}
+
+TEST(content_classifier, text_is_lossless)
+{
+    EXPECT_TRUE(lossyRegion(desktop::FrameGenerator::Scene::TYPING).isEmpty());
+    EXPECT_TRUE(lossyRegion(desktop::FrameGenerator::Scene::SCROLLING).isEmpty());
+    EXPECT_TRUE(lossyRegion(desktop::FrameGenerator::Scene::MOVING_WINDOW).isEmpty());
+}
+
+} // namespace codec
@@ -40,20 +40,36 @@ bool CursorDecoder::decompressCursor(const proto::desktop::CursorShape& cursor_s
     if (data.empty())
         return false;
 
-    size_t ret = ZSTD_initDStream(stream_.get());
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    size_t ret;
+
+    // The persistent stream is started again with the cache reset command.
+    if (!cursor_shape.persistent_stream() ||
+        (cursor_shape.flags() & proto::desktop::CursorShape::RESET_CACHE))
+    {
+        ret = ZSTD_initDStream(stream_.get());
+        DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    }
 
     ZSTD_inBuffer input = { data.data(), data.size(), 0 };
     ZSTD_outBuffer output = { output_data, output_size, 0 };
 
     while (input.pos < input.size)
     {
+        const size_t last_pos = input.pos;
+
         ret = ZSTD_decompressStream(stream_.get(), &output, &input);
         if (ZSTD_isError(ret))
         {
             LOG(LS_WARNING) << "ZSTD_decompressStream failed: " << ZSTD_getErrorName(ret);
             return false;
         }
+
+        // The output is full, but the input remains.
+        if (input.pos == last_pos && output.pos == output.size)
+        {
+            LOG(LS_WARNING) << "Unexpected data after the cursor";
+            return false;
+        }
     }
 
     return true;
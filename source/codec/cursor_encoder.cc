@@ -46,11 +46,20 @@ CursorEncoder::CursorEncoder()
     static_assert(kCompressionRatio >= 1 && kCompressionRatio <= 22);
 }
 
+void CursorEncoder::enablePersistentStream()
+{
+    persistent_stream_ = true;
+}
+
 bool CursorEncoder::compressCursor(proto::desktop::CursorShape* cursor_shape,
                                    const desktop::MouseCursor* mouse_cursor)
 {
-    size_t ret = ZSTD_initCStream(stream_.get(), kCompressionRatio);
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    // The persistent stream is started again with the cache reset command.
+    if (!persistent_stream_ || cache_.isEmpty())
+    {
+        size_t ret = ZSTD_initCStream(stream_.get(), kCompressionRatio);
+        DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    }
 
     const size_t input_size = mouse_cursor->stride() * mouse_cursor->size().height();
     const uint8_t* input_data = mouse_cursor->data();
@@ -61,20 +70,31 @@ bool CursorEncoder::compressCursor(proto::desktop::CursorShape* cursor_shape,
     ZSTD_inBuffer input = { input_data, input_size, 0 };
     ZSTD_outBuffer output = { output_data, output_size, 0 };
 
-    while (input.pos < input.size)
+    // The persistent stream is flushed, but not finished.
+    const ZSTD_EndDirective end_op = persistent_stream_ ? ZSTD_e_flush : ZSTD_e_end;
+
+    for (;;)
     {
-        ret = ZSTD_compressStream(stream_.get(), &output, &input);
+        const size_t ret = ZSTD_compressStream2(stream_.get(), &output, &input, end_op);
         if (ZSTD_isError(ret))
         {
-            LOG(LS_WARNING) << "ZSTD_compressStream failed: " << ZSTD_getErrorName(ret);
+            LOG(LS_WARNING) << "ZSTD_compressStream2 failed: " << ZSTD_getErrorName(ret);
             return false;
         }
-    }
 
-    ret = ZSTD_endStream(stream_.get(), &output);
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+        // All the data is compressed and flushed.
+        if (!ret)
+            break;
+
+        if (output.pos == output.size)
+        {
+            LOG(LS_WARNING) << "Not enough space for the compressed cursor";
+            return false;
+        }
+    }
 
     cursor_shape->mutable_data()->resize(output.pos);
+    cursor_shape->set_persistent_stream(persistent_stream_);
     return true;
 }
 
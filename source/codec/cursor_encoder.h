@@ -32,6 +32,10 @@ public:
     CursorEncoder();
     ~CursorEncoder() = default;
 
+    // Keeps the compressed stream between the cursors (see VIDEO_FEATURE_ZSTD_CONTEXT). The
+    // cursors are often similar, so the previous cursors are used for the matching.
+    void enablePersistentStream();
+
     bool encode(std::unique_ptr<desktop::MouseCursor> mouse_cursor,
                 proto::desktop::CursorShape* cursor_shape);
 
@@ -40,6 +44,7 @@ private:
                         const desktop::MouseCursor* mouse_cursor);
 
     ScopedZstdCStream stream_;
+    bool persistent_stream_ = false;
     desktop::MouseCursorCache cache_;
 
     DISALLOW_COPY_AND_ASSIGN(CursorEncoder);
@@ -0,0 +1,80 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__PALETTE_TILE_H
+#define CODEC__PALETTE_TILE_H
+
+#include <cstdint>
+
+namespace codec {
+
+// Format of the data of VIDEO_ENCODING_PALETTE.
+//
+// Each rectangle of the packet is split into tiles of kPaletteTileSize x kPaletteTileSize pixels
+// (the tiles at the right and bottom edges are smaller). The tiles of all rectangles follow each
+// other in the order of the rectangles, the tiles of a rectangle go from left to right and from
+// top to bottom. The sequence of the tiles is compressed by ZSTD as one frame.
+//
+// Each tile starts with the type byte. The pixels are stored in the pixel format of the packet,
+// the palette has (count byte + 1) colors.
+//
+// PALETTE_TILE_RAW:    pixels of the tile row by row.
+// PALETTE_TILE_SOLID:  one color.
+// PALETTE_TILE_PACKED: count byte, palette, indices of the pixels row by row. The indices take
+//                      1, 2 or 4 bits (see packedIndexBits), the high bits of a byte come first,
+//                      each row starts with a new byte.
+// PALETTE_TILE_RLE:    count byte, palette, runs of the pixels of the tile. A run is the index
+//                      byte and the run length minus one as a varint (7 bits in a byte, the
+//                      lowest bits first, the high bit is set if more bytes follow).
+enum PaletteTileType : uint8_t
+{
+    PALETTE_TILE_RAW    = 0,
+    PALETTE_TILE_SOLID  = 1,
+    PALETTE_TILE_PACKED = 2,
+    PALETTE_TILE_RLE    = 3
+};
+
+const int kPaletteTileSize = 64;
+
+// Maximum number of colors in the palette of PALETTE_TILE_RLE.
+const int kMaxPaletteSize = 256;
+
+// Maximum number of colors in the palette of PALETTE_TILE_PACKED.
+const int kMaxPackedPaletteSize = 16;
+
+// Returns the number of bits of an index in PALETTE_TILE_PACKED.
+inline int packedIndexBits(int palette_size)
+{
+    if (palette_size <= 2)
+        return 1;
+
+    if (palette_size <= 4)
+        return 2;
+
+    return 4;
+}
+
+// Returns the size of a row of indices in PALETTE_TILE_PACKED.
+inline int packedRowSize(int width, int palette_size)
+{
+    return (width * packedIndexBits(palette_size) + 7) / 8;
+}
+
+} // namespace codec
+
+#endif // CODEC__PALETTE_TILE_H
@@ -20,6 +20,10 @@
 
 #include "build/build_config.h"
 #include "base/macros_magic.h"
+#include "codec/pixel_translator_avx2.h"
+#include "codec/pixel_translator_sse3.h"
+
+#include <cstring>
 
 namespace codec {
 
@@ -27,6 +31,71 @@ namespace {
 
 const int kBlockSize = 16;
 
+using TranslateRowFunc = void(*)(const uint8_t* src, uint8_t* dst, int width);
+using ShuffleRowFunc = void(*)(const uint8_t* src, uint8_t* dst, int width,
+                               const uint8_t* shuffle);
+
+struct TranslateRowFuncs
+{
+    desktop::PixelFormat (*source_format)();
+    desktop::PixelFormat (*target_format)();
+
+    // Functions indexed by SimdLevel.
+    TranslateRowFunc funcs[desktop::kSimdLevelCount];
+};
+
+const TranslateRowFuncs kTranslateRowFuncs[] =
+{
+    {
+        desktop::PixelFormat::ARGB, desktop::PixelFormat::RGB565,
+        { nullptr, nullptr, translateARGBToRGB565_SSE3, translateARGBToRGB565_AVX2, nullptr }
+    },
+    {
+        desktop::PixelFormat::ARGB, desktop::PixelFormat::RGB332,
+        { nullptr, nullptr, translateARGBToRGB332_SSE3, translateARGBToRGB332_AVX2, nullptr }
+    },
+    {
+        desktop::PixelFormat::ARGB, desktop::PixelFormat::RGB222,
+        { nullptr, nullptr, translateARGBToRGB222_SSE3, translateARGBToRGB222_AVX2, nullptr }
+    },
+    {
+        desktop::PixelFormat::ARGB, desktop::PixelFormat::RGB111,
+        { nullptr, nullptr, translateARGBToRGB111_SSE3, translateARGBToRGB111_AVX2, nullptr }
+    },
+    {
+        desktop::PixelFormat::RGB565, desktop::PixelFormat::ARGB,
+        { nullptr, nullptr, translateRGB565ToARGB_SSE3, translateRGB565ToARGB_AVX2, nullptr }
+    }
+};
+
+const ShuffleRowFunc kShuffleRowFuncs[desktop::kSimdLevelCount] =
+{
+    nullptr, nullptr, shufflePixels_SSE3, shufflePixels_AVX2, nullptr
+};
+
+// Returns true if the format has 32-bit pixels with 8-bit channels in different bytes.
+bool hasByteChannels(const desktop::PixelFormat& format)
+{
+    return format.bytesPerPixel() == 4 &&
+           format.redMax() == 255 && format.greenMax() == 255 && format.blueMax() == 255 &&
+           format.redShift() % 8 == 0 && format.greenShift() % 8 == 0 &&
+           format.blueShift() % 8 == 0 &&
+           format.redShift() != format.greenShift() &&
+           format.redShift() != format.blueShift() &&
+           format.greenShift() != format.blueShift();
+}
+
+// Returns true if all bits of the pixel belong to the channels.
+bool hasNoUnusedBits(const desktop::PixelFormat& format)
+{
+    const uint32_t channel_bits = (format.redMax() << format.redShift()) |
+                                  (format.greenMax() << format.greenShift()) |
+                                  (format.blueMax() << format.blueShift());
+
+    return format.bytesPerPixel() < 4 &&
+           channel_bits == (1U << format.bitsPerPixel()) - 1;
+}
+
 template<typename SourceT, typename TargetT>
 class PixelTranslatorT : public PixelTranslator
 {
@@ -210,12 +279,160 @@ private:
     DISALLOW_COPY_AND_ASSIGN(PixelTranslatorFrom8_16bppT);
 };
 
+// Translates the pixels with a function optimized for the pair of formats.
+class PixelTranslatorRow : public PixelTranslator
+{
+public:
+    explicit PixelTranslatorRow(TranslateRowFunc translate_row)
+        : translate_row_(translate_row)
+    {
+        // Nothing
+    }
+
+    void translate(const uint8_t* src, int src_stride,
+                   uint8_t* dst, int dst_stride,
+                   int width, int height) override
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            translate_row_(src, dst, width);
+
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+
+private:
+    TranslateRowFunc translate_row_;
+
+    DISALLOW_COPY_AND_ASSIGN(PixelTranslatorRow);
+};
+
+// Reorders the bytes of the pixels for the formats with 8-bit channels. The unused byte of the
+// target pixel is set to zero.
+class PixelTranslatorShuffle : public PixelTranslator
+{
+public:
+    PixelTranslatorShuffle(ShuffleRowFunc shuffle_row,
+                           const desktop::PixelFormat& source_format,
+                           const desktop::PixelFormat& target_format)
+        : shuffle_row_(shuffle_row)
+    {
+        memset(shuffle_, 0x80, sizeof(shuffle_));
+
+        for (int i = 0; i < 4; ++i)
+        {
+            uint8_t* pixel = shuffle_ + i * 4;
+            const uint8_t base = static_cast<uint8_t>(i * 4);
+
+            pixel[target_format.redShift() / 8] = base + source_format.redShift() / 8;
+            pixel[target_format.greenShift() / 8] = base + source_format.greenShift() / 8;
+            pixel[target_format.blueShift() / 8] = base + source_format.blueShift() / 8;
+        }
+    }
+
+    void translate(const uint8_t* src, int src_stride,
+                   uint8_t* dst, int dst_stride,
+                   int width, int height) override
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            shuffle_row_(src, dst, width, shuffle_);
+
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+
+private:
+    ShuffleRowFunc shuffle_row_;
+
+    // Index of the source byte for each byte of 4 target pixels.
+    uint8_t shuffle_[16];
+
+    DISALLOW_COPY_AND_ASSIGN(PixelTranslatorShuffle);
+};
+
+// Copies the pixels if the formats are equal and have no unused bits.
+class PixelTranslatorCopy : public PixelTranslator
+{
+public:
+    explicit PixelTranslatorCopy(int bytes_per_pixel)
+        : bytes_per_pixel_(bytes_per_pixel)
+    {
+        // Nothing
+    }
+
+    void translate(const uint8_t* src, int src_stride,
+                   uint8_t* dst, int dst_stride,
+                   int width, int height) override
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            memcpy(dst, src, width * bytes_per_pixel_);
+
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+
+private:
+    const int bytes_per_pixel_;
+
+    DISALLOW_COPY_AND_ASSIGN(PixelTranslatorCopy);
+};
+
+std::unique_ptr<PixelTranslator> createOptimized(const desktop::PixelFormat& source_format,
+                                                 const desktop::PixelFormat& target_format,
+                                                 desktop::SimdLevel max_level)
+{
+    if (source_format == target_format && hasNoUnusedBits(source_format))
+        return std::make_unique<PixelTranslatorCopy>(source_format.bytesPerPixel());
+
+    if (hasByteChannels(source_format) && hasByteChannels(target_format))
+    {
+        ShuffleRowFunc shuffle_row = desktop::simdDispatch(kShuffleRowFuncs, max_level);
+        if (!shuffle_row)
+            return nullptr;
+
+        return std::make_unique<PixelTranslatorShuffle>(
+            shuffle_row, source_format, target_format);
+    }
+
+    for (const auto& row_funcs : kTranslateRowFuncs)
+    {
+        if (row_funcs.source_format() != source_format ||
+            row_funcs.target_format() != target_format)
+        {
+            continue;
+        }
+
+        TranslateRowFunc translate_row = desktop::simdDispatch(row_funcs.funcs, max_level);
+        if (!translate_row)
+            return nullptr;
+
+        return std::make_unique<PixelTranslatorRow>(translate_row);
+    }
+
+    return nullptr;
+}
+
 } // namespace
 
 // static
 std::unique_ptr<PixelTranslator> PixelTranslator::create(
-    const desktop::PixelFormat& source_format, const desktop::PixelFormat& target_format)
+    const desktop::PixelFormat& source_format,
+    const desktop::PixelFormat& target_format,
+    desktop::SimdLevel max_level)
 {
+    if (max_level != desktop::SimdLevel::C)
+    {
+        std::unique_ptr<PixelTranslator> translator =
+            createOptimized(source_format, target_format, max_level);
+        if (translator)
+            return translator;
+    }
+
     switch (target_format.bytesPerPixel())
     {
         case 4:
@@ -22,6 +22,7 @@
 #include <memory>
 
 #include "desktop/pixel_format.h"
+#include "desktop/simd_dispatch.h"
 
 namespace codec {
 
@@ -30,8 +31,13 @@ class PixelTranslator
 public:
     virtual ~PixelTranslator() = default;
 
-    static std::unique_ptr<PixelTranslator> create(const desktop::PixelFormat& source_format,
-                                                   const desktop::PixelFormat& target_format);
+    // Creates a translator for the pair of formats. For the frequent pairs the translator uses
+    // the instruction sets up to |max_level|. With SimdLevel::C the translator with lookup tables
+    // is created for all pairs (it is the reference for the optimized translators).
+    static std::unique_ptr<PixelTranslator> create(
+        const desktop::PixelFormat& source_format,
+        const desktop::PixelFormat& target_format,
+        desktop::SimdLevel max_level = desktop::simdLevel());
 
     virtual void translate(const uint8_t* src,
                            int src_stride,
@@ -0,0 +1,194 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "codec/pixel_translator_avx2.h"
+#include "build/build_config.h"
+#include "codec/pixel_translator_sse3.h"
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+// The pixels that do not fill a whole vector are translated by the SSSE3 functions (the
+// processors with AVX2 always support SSSE3).
+
+namespace codec {
+
+namespace {
+
+// Scales 8-bit channels in 16-bit lanes to [0, max] with rounding. (v + 1 + (v >> 8)) >> 8 is
+// equal to v / 255 for all 16-bit values except 0xFFFF.
+__m256i scaleChannels(__m256i value, int max)
+{
+    value = _mm256_add_epi16(
+        _mm256_mullo_epi16(value, _mm256_set1_epi16(static_cast<short>(max))),
+        _mm256_set1_epi16(127));
+
+    return _mm256_srli_epi16(_mm256_add_epi16(
+        _mm256_add_epi16(value, _mm256_set1_epi16(1)), _mm256_srli_epi16(value, 8)), 8);
+}
+
+// Translates 16 pixels. The target pixels are returned in 16-bit lanes in the order 0-3, 8-11,
+// 4-7, 12-15 (the pack instructions work within 128-bit lanes).
+template <int kRedMax, int kGreenMax, int kBlueMax,
+          int kRedShift, int kGreenShift, int kBlueShift>
+__m256i translate16Pixels(const uint8_t* src)
+{
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+
+    const __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src) + 1);
+
+    const __m256i red = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+                                           _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+    const __m256i green = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                                             _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+    const __m256i blue = _mm256_packs_epi32(_mm256_and_si256(p0, mask),
+                                            _mm256_and_si256(p1, mask));
+
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_slli_epi16(scaleChannels(red, kRedMax), kRedShift),
+                        _mm256_slli_epi16(scaleChannels(green, kGreenMax), kGreenShift)),
+        _mm256_slli_epi16(scaleChannels(blue, kBlueMax), kBlueShift));
+}
+
+template <int kRedMax, int kGreenMax, int kBlueMax,
+          int kRedShift, int kGreenShift, int kBlueShift>
+int translateTo8bpp(const uint8_t* src, uint8_t* dst, int width)
+{
+    // Restores the order of 4-pixel groups after the packing.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32)
+    {
+        const __m256i low = translate16Pixels<kRedMax, kGreenMax, kBlueMax,
+                                              kRedShift, kGreenShift, kBlueShift>(src);
+        const __m256i high = translate16Pixels<kRedMax, kGreenMax, kBlueMax,
+                                               kRedShift, kGreenShift, kBlueShift>(src + 64);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),
+                            _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), order));
+
+        src += 128;
+        dst += 32;
+    }
+
+    return x;
+}
+
+} // namespace
+
+void translateARGBToRGB565_AVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m256i pixels = translate16Pixels<31, 63, 31, 11, 5, 0>(src + x * 4);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 2),
+                            _mm256_permute4x64_epi64(pixels, 0xD8));
+    }
+
+    translateARGBToRGB565_SSE3(src + x * 4, dst + x * 2, width - x);
+}
+
+void translateARGBToRGB332_AVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const int x = translateTo8bpp<7, 7, 3, 5, 2, 0>(src, dst, width);
+    translateARGBToRGB332_SSE3(src + x * 4, dst + x, width - x);
+}
+
+void translateARGBToRGB222_AVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const int x = translateTo8bpp<3, 3, 3, 4, 2, 0>(src, dst, width);
+    translateARGBToRGB222_SSE3(src + x * 4, dst + x, width - x);
+}
+
+void translateARGBToRGB111_AVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const int x = translateTo8bpp<1, 1, 1, 2, 1, 0>(src, dst, width);
+    translateARGBToRGB111_SSE3(src + x * 4, dst + x, width - x);
+}
+
+void translateRGB565ToARGB_AVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m256i mask_5bit = _mm256_set1_epi16(0x1F);
+    const __m256i mask_6bit = _mm256_set1_epi16(0x3F);
+    const __m256i max_8bit = _mm256_set1_epi16(255);
+
+    // c * 255 / 31 and c * 255 / 63 are calculated as (c * 255 * m) >> s.
+    const __m256i div_31 = _mm256_set1_epi16(8457);
+    const __m256i div_63 = _mm256_set1_epi16(16645);
+
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m256i pixels =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+
+        const __m256i red = _mm256_srli_epi16(_mm256_mulhi_epu16(
+            _mm256_mullo_epi16(_mm256_srli_epi16(pixels, 11), max_8bit), div_31), 2);
+        const __m256i green = _mm256_srli_epi16(_mm256_mulhi_epu16(
+            _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(pixels, 5), mask_6bit),
+                               max_8bit), div_63), 4);
+        const __m256i blue = _mm256_srli_epi16(_mm256_mulhi_epu16(
+            _mm256_mullo_epi16(_mm256_and_si256(pixels, mask_5bit), max_8bit), div_31), 2);
+
+        const __m256i green_blue = _mm256_or_si256(_mm256_slli_epi16(green, 8), blue);
+
+        // Pixels 0-3 and 8-11, 4-7 and 12-15.
+        const __m256i low = _mm256_unpacklo_epi16(green_blue, red);
+        const __m256i high = _mm256_unpackhi_epi16(green_blue, red);
+
+        __m256i* dst_ptr = reinterpret_cast<__m256i*>(dst + x * 4);
+
+        _mm256_storeu_si256(dst_ptr, _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256(dst_ptr + 1, _mm256_permute2x128_si256(low, high, 0x31));
+    }
+
+    translateRGB565ToARGB_SSE3(src + x * 2, dst + x * 4, width - x);
+}
+
+void shufflePixels_AVX2(const uint8_t* src, uint8_t* dst, int width, const uint8_t* shuffle)
+{
+    const __m256i mask = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle)));
+
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m256i* src_ptr = reinterpret_cast<const __m256i*>(src + x * 4);
+        __m256i* dst_ptr = reinterpret_cast<__m256i*>(dst + x * 4);
+
+        _mm256_storeu_si256(dst_ptr, _mm256_shuffle_epi8(_mm256_loadu_si256(src_ptr), mask));
+        _mm256_storeu_si256(dst_ptr + 1,
+                            _mm256_shuffle_epi8(_mm256_loadu_si256(src_ptr + 1), mask));
+    }
+
+    shufflePixels_SSE3(src + x * 4, dst + x * 4, width - x, shuffle);
+}
+
+} // namespace codec
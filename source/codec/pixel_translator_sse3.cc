@@ -0,0 +1,223 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "codec/pixel_translator_sse3.h"
+#include "build/build_config.h"
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#else
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+namespace codec {
+
+namespace {
+
+// Scales an 8-bit channel to [0, max] with rounding, as the lookup tables do.
+uint32_t scaleChannel(uint32_t value, uint32_t max)
+{
+    return (value * max + 127) / 255;
+}
+
+// Translates the pixels that do not fill a whole vector.
+template <typename TargetT,
+          int kRedMax, int kGreenMax, int kBlueMax,
+          int kRedShift, int kGreenShift, int kBlueShift>
+void translateFromARGB(const uint8_t* src, uint8_t* dst, int count)
+{
+    const uint32_t* src_ptr = reinterpret_cast<const uint32_t*>(src);
+    TargetT* dst_ptr = reinterpret_cast<TargetT*>(dst);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const uint32_t pixel = src_ptr[i];
+
+        dst_ptr[i] = static_cast<TargetT>(
+            (scaleChannel((pixel >> 16) & 0xFF, kRedMax) << kRedShift) |
+            (scaleChannel((pixel >> 8) & 0xFF, kGreenMax) << kGreenShift) |
+            (scaleChannel(pixel & 0xFF, kBlueMax) << kBlueShift));
+    }
+}
+
+// Scales 8-bit channels in 16-bit lanes to [0, max] with rounding. (v + 1 + (v >> 8)) >> 8 is
+// equal to v / 255 for all 16-bit values except 0xFFFF.
+__m128i scaleChannels(__m128i value, int max)
+{
+    value = _mm_add_epi16(_mm_mullo_epi16(value, _mm_set1_epi16(static_cast<short>(max))),
+                          _mm_set1_epi16(127));
+
+    return _mm_srli_epi16(
+        _mm_add_epi16(_mm_add_epi16(value, _mm_set1_epi16(1)), _mm_srli_epi16(value, 8)), 8);
+}
+
+// Translates 8 pixels. The target pixels are returned in 16-bit lanes.
+template <int kRedMax, int kGreenMax, int kBlueMax,
+          int kRedShift, int kGreenShift, int kBlueShift>
+__m128i translate8Pixels(const uint8_t* src)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+
+    const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 1);
+
+    const __m128i red = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                                        _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+    const __m128i green = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                                          _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    const __m128i blue = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+
+    return _mm_or_si128(
+        _mm_or_si128(_mm_slli_epi16(scaleChannels(red, kRedMax), kRedShift),
+                     _mm_slli_epi16(scaleChannels(green, kGreenMax), kGreenShift)),
+        _mm_slli_epi16(scaleChannels(blue, kBlueMax), kBlueShift));
+}
+
+template <int kRedMax, int kGreenMax, int kBlueMax,
+          int kRedShift, int kGreenShift, int kBlueShift>
+void translateTo8bpp(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i low = translate8Pixels<kRedMax, kGreenMax, kBlueMax,
+                                             kRedShift, kGreenShift, kBlueShift>(src);
+        const __m128i high = translate8Pixels<kRedMax, kGreenMax, kBlueMax,
+                                              kRedShift, kGreenShift, kBlueShift>(src + 32);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(low, high));
+
+        src += 64;
+        dst += 16;
+    }
+
+    translateFromARGB<uint8_t, kRedMax, kGreenMax, kBlueMax,
+                      kRedShift, kGreenShift, kBlueShift>(src, dst, width - x);
+}
+
+} // namespace
+
+void translateARGBToRGB565_SSE3(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                         translate8Pixels<31, 63, 31, 11, 5, 0>(src));
+        src += 32;
+        dst += 16;
+    }
+
+    translateFromARGB<uint16_t, 31, 63, 31, 11, 5, 0>(src, dst, width - x);
+}
+
+void translateARGBToRGB332_SSE3(const uint8_t* src, uint8_t* dst, int width)
+{
+    translateTo8bpp<7, 7, 3, 5, 2, 0>(src, dst, width);
+}
+
+void translateARGBToRGB222_SSE3(const uint8_t* src, uint8_t* dst, int width)
+{
+    translateTo8bpp<3, 3, 3, 4, 2, 0>(src, dst, width);
+}
+
+void translateARGBToRGB111_SSE3(const uint8_t* src, uint8_t* dst, int width)
+{
+    translateTo8bpp<1, 1, 1, 2, 1, 0>(src, dst, width);
+}
+
+void translateRGB565ToARGB_SSE3(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m128i mask_5bit = _mm_set1_epi16(0x1F);
+    const __m128i mask_6bit = _mm_set1_epi16(0x3F);
+    const __m128i max_8bit = _mm_set1_epi16(255);
+
+    // c * 255 / 31 and c * 255 / 63 are calculated as (c * 255 * m) >> s.
+    const __m128i div_31 = _mm_set1_epi16(8457);
+    const __m128i div_63 = _mm_set1_epi16(16645);
+
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+        const __m128i red = _mm_srli_epi16(_mm_mulhi_epu16(
+            _mm_mullo_epi16(_mm_srli_epi16(pixels, 11), max_8bit), div_31), 2);
+        const __m128i green = _mm_srli_epi16(_mm_mulhi_epu16(
+            _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(pixels, 5), mask_6bit), max_8bit),
+            div_63), 4);
+        const __m128i blue = _mm_srli_epi16(_mm_mulhi_epu16(
+            _mm_mullo_epi16(_mm_and_si128(pixels, mask_5bit), max_8bit), div_31), 2);
+
+        const __m128i green_blue = _mm_or_si128(_mm_slli_epi16(green, 8), blue);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(green_blue, red));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + 1,
+                         _mm_unpackhi_epi16(green_blue, red));
+
+        src += 16;
+        dst += 32;
+    }
+
+    const uint16_t* src_ptr = reinterpret_cast<const uint16_t*>(src);
+    uint32_t* dst_ptr = reinterpret_cast<uint32_t*>(dst);
+
+    for (int i = 0; i < width - x; ++i)
+    {
+        const uint32_t pixel = src_ptr[i];
+
+        dst_ptr[i] = (((pixel >> 11) & 0x1F) * 255 / 31) << 16 |
+                     (((pixel >> 5) & 0x3F) * 255 / 63) << 8 |
+                     ((pixel & 0x1F) * 255 / 31);
+    }
+}
+
+void shufflePixels_SSE3(const uint8_t* src, uint8_t* dst, int width, const uint8_t* shuffle)
+{
+    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle));
+
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m128i* src_ptr = reinterpret_cast<const __m128i*>(src);
+        __m128i* dst_ptr = reinterpret_cast<__m128i*>(dst);
+
+        _mm_storeu_si128(dst_ptr, _mm_shuffle_epi8(_mm_loadu_si128(src_ptr), mask));
+        _mm_storeu_si128(dst_ptr + 1, _mm_shuffle_epi8(_mm_loadu_si128(src_ptr + 1), mask));
+
+        src += 32;
+        dst += 32;
+    }
+
+    for (; x < width; ++x)
+    {
+        for (int i = 0; i < 4; ++i)
+            dst[i] = (shuffle[i] & 0x80) ? 0 : src[shuffle[i]];
+
+        src += 4;
+        dst += 4;
+    }
+}
+
+} // namespace codec
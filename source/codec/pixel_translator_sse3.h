@@ -0,0 +1,46 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef CODEC__PIXEL_TRANSLATOR_SSE3_H
+#define CODEC__PIXEL_TRANSLATOR_SSE3_H
+
+#include <cstdint>
+
+namespace codec {
+
+// The functions translate one row of |width| pixels. The results are equal to the results of the
+// scalar translator with lookup tables.
+
+void translateARGBToRGB565_SSE3(const uint8_t* src, uint8_t* dst, int width);
+
+void translateARGBToRGB332_SSE3(const uint8_t* src, uint8_t* dst, int width);
+
+void translateARGBToRGB222_SSE3(const uint8_t* src, uint8_t* dst, int width);
+
+void translateARGBToRGB111_SSE3(const uint8_t* src, uint8_t* dst, int width);
+
+void translateRGB565ToARGB_SSE3(const uint8_t* src, uint8_t* dst, int width);
+
+// Reorders the bytes of 32-bit pixels. |shuffle| contains the index of the source byte for each
+// byte of 4 target pixels. The index 0x80 sets the target byte to zero.
+void shufflePixels_SSE3(const uint8_t* src, uint8_t* dst, int width, const uint8_t* shuffle);
+
+} // namespace codec
+
+#endif // CODEC__PIXEL_TRANSLATOR_SSE3_H
@@ -0,0 +1,118 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/pixel_translator.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace codec {
+
+namespace {
+
+// The widths include the tails which are not multiples of the vector size.
+const int kWidths[] = { 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 100, 1366 };
+const int kHeight = 3;
+
+desktop::PixelFormat ABGR()
+{
+    return desktop::PixelFormat(32, 255, 255, 255, 0, 8, 16);
+}
+
+void generatePixels(std::vector<uint8_t>* pixels)
+{
+    std::mt19937 random(1);
+
+    // The unused bits of the pixels are filled too. The translators must ignore them.
+    for (auto& value : *pixels)
+        value = static_cast<uint8_t>(random());
+}
+
+// Compares the translator for |max_level| with the translator with lookup tables.
+void testTranslator(const desktop::PixelFormat& source_format,
+                    const desktop::PixelFormat& target_format,
+                    desktop::SimdLevel max_level)
+{
+    if (desktop::simdLevel() < max_level)
+        return;
+
+    std::unique_ptr<PixelTranslator> reference =
+        PixelTranslator::create(source_format, target_format, desktop::SimdLevel::C);
+    std::unique_ptr<PixelTranslator> optimized =
+        PixelTranslator::create(source_format, target_format, max_level);
+
+    ASSERT_TRUE(reference);
+    ASSERT_TRUE(optimized);
+
+    for (int width : kWidths)
+    {
+        // The strides are larger than the rows to check that the padding is not touched.
+        const int src_stride = width * source_format.bytesPerPixel() + 5;
+        const int dst_stride = width * target_format.bytesPerPixel() + 3;
+
+        std::vector<uint8_t> src(src_stride * kHeight);
+        generatePixels(&src);
+
+        std::vector<uint8_t> expected(dst_stride * kHeight, 0xAA);
+        std::vector<uint8_t> actual(dst_stride * kHeight, 0xAA);
+
+        reference->translate(src.data(), src_stride, expected.data(), dst_stride, width, kHeight);
+        optimized->translate(src.data(), src_stride, actual.data(), dst_stride, width, kHeight);
+
+        EXPECT_EQ(expected, actual) << "width: " << width;
+    }
+}
+
+void testAllFormats(desktop::SimdLevel max_level)
+{
+    const desktop::PixelFormat argb = desktop::PixelFormat::ARGB();
+
+    testTranslator(argb, desktop::PixelFormat::RGB565(), max_level);
+    testTranslator(argb, desktop::PixelFormat::RGB332(), max_level);
+    testTranslator(argb, desktop::PixelFormat::RGB222(), max_level);
+    testTranslator(argb, desktop::PixelFormat::RGB111(), max_level);
+    testTranslator(desktop::PixelFormat::RGB565(), argb, max_level);
+    testTranslator(argb, ABGR(), max_level);
+    testTranslator(ABGR(), argb, max_level);
+    testTranslator(argb, argb, max_level);
+    testTranslator(desktop::PixelFormat::RGB565(), desktop::PixelFormat::RGB565(), max_level);
+    testTranslator(desktop::PixelFormat::RGB332(), desktop::PixelFormat::RGB332(), max_level);
+}
+
+} // namespace
+
+TEST(pixel_translator, ssse3_equal_to_reference)
+{
+    testAllFormats(desktop::SimdLevel::SSSE3);
+}
+
+TEST(pixel_translator, avx2_equal_to_reference)
+{
+    testAllFormats(desktop::SimdLevel::AVX2);
+}
+
+TEST(pixel_translator, unsupported_level_uses_reference)
+{
+    // For SSE2 there are no optimized kernels except the copy of equal formats.
+    testTranslator(desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB565(),
+                   desktop::SimdLevel::SSE2);
+}
+
+} // namespace codec
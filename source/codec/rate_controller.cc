@@ -0,0 +1,177 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/rate_controller.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace codec {
+
+namespace {
+
+// Limits of the target bitrate in kilobits per second.
+const uint32_t kMinBitrate = 100;
+const uint32_t kMaxBitrate = 20000;
+const uint32_t kInitialBitrate = 1000;
+
+// The bitrate is raised by this value when the network is idle.
+const uint32_t kBitrateStep = 100;
+
+// Range of the quantizer for a fast network. It is the same as the encoders use by default.
+const int kMinQuantizer = 20;
+const int kMaxQuantizer = 30;
+
+// The range is moved up to these values for a slow network.
+const int kMinQuantizerLimit = 40;
+const int kMaxQuantizerLimit = 56;
+
+const std::chrono::milliseconds kMaxUpdateInterval(1000);
+
+// The frames are reduced (in percent) when the quantizers are already at the limits.
+const int kMinScale = 50;
+const int kMaxScale = 100;
+const int kScaleStep = 10;
+
+// The network is congested if a message waits longer than this time, or if the sending queue
+// can not be sent in this time.
+const std::chrono::milliseconds kMaxSendDelay(250);
+
+// The network is idle if the messages are sent faster than this time.
+const std::chrono::milliseconds kIdleSendDelay(50);
+
+// Small queues are not a sign of a congestion (for example, a single large packet).
+const int64_t kMinPendingBytes = 64 * 1024;
+
+} // namespace
+
+RateController::RateController(const std::chrono::milliseconds& update_interval)
+    : base_update_interval_(update_interval),
+      max_bitrate_(kMaxBitrate)
+{
+    settings_.bitrate = kInitialBitrate;
+    settings_.min_quantizer = kMinQuantizer;
+    settings_.max_quantizer = kMaxQuantizer;
+    settings_.update_interval = update_interval;
+    settings_.scale = kMaxScale;
+
+    stats_.min_bitrate = settings_.bitrate;
+    stats_.max_update_interval = update_interval;
+    stats_.min_scale = kMaxScale;
+}
+
+void RateController::setMaxBitrate(uint32_t bitrate)
+{
+    max_bitrate_ = bitrate ? std::clamp(bitrate, kMinBitrate, kMaxBitrate) : kMaxBitrate;
+}
+
+bool RateController::update(const Feedback& feedback)
+{
+    Settings settings = settings_;
+
+    if (isCongested(feedback))
+    {
+        // The bitrate is lowered below the rate at which the network accepts the data, so the
+        // queue is sent.
+        uint32_t bitrate = settings.bitrate * 7 / 10;
+
+        const uint32_t network_bitrate =
+            static_cast<uint32_t>(feedback.bytes_per_second * 8 / 1000);
+        if (network_bitrate)
+            bitrate = std::min(bitrate, network_bitrate * 8 / 10);
+
+        settings.bitrate = std::max(bitrate, kMinBitrate);
+
+        // If the quality can not be lowered more, the size of the frames is reduced.
+        if (settings.max_quantizer == kMaxQuantizerLimit)
+            settings.scale = std::max(settings.scale * 4 / 5, kMinScale);
+
+        settings.min_quantizer = std::min(settings.min_quantizer + 5, kMinQuantizerLimit);
+        settings.max_quantizer = std::min(settings.max_quantizer + 10, kMaxQuantizerLimit);
+        settings.update_interval =
+            std::min(settings.update_interval * 3 / 2, std::max(kMaxUpdateInterval,
+                                                                base_update_interval_));
+
+        ++stats_.congestions;
+    }
+    else if (isIdle(feedback))
+    {
+        // The size of the frames is restored first, then the quality.
+        if (settings.scale < kMaxScale)
+            settings.scale = std::min(settings.scale + kScaleStep, kMaxScale);
+        else
+            settings.max_quantizer = std::max(settings.max_quantizer - 2, kMaxQuantizer);
+
+        // The bitrate is not raised above the limit of the encoder, but it is not lowered either.
+        if (settings.bitrate < max_bitrate_)
+            settings.bitrate = std::min(settings.bitrate + kBitrateStep, max_bitrate_);
+
+        settings.min_quantizer = std::max(settings.min_quantizer - 1, kMinQuantizer);
+        settings.update_interval =
+            std::max(settings.update_interval * 4 / 5, base_update_interval_);
+    }
+
+    if (settings.bitrate == settings_.bitrate &&
+        settings.min_quantizer == settings_.min_quantizer &&
+        settings.max_quantizer == settings_.max_quantizer &&
+        settings.update_interval == settings_.update_interval &&
+        settings.scale == settings_.scale)
+    {
+        return false;
+    }
+
+    if (settings.bitrate < settings_.bitrate)
+    {
+        LOG(LS_INFO) << "Network congestion (delay: " << feedback.send_delay.count()
+                     << " ms, queue: " << feedback.pending_bytes << " bytes). Bitrate: "
+                     << settings.bitrate << " kbps, quantizer: " << settings.min_quantizer
+                     << "-" << settings.max_quantizer << ", update interval: "
+                     << settings.update_interval.count() << " ms, scale: " << settings.scale
+                     << "%";
+    }
+
+    settings_ = settings;
+
+    stats_.min_bitrate = std::min(stats_.min_bitrate, settings_.bitrate);
+    stats_.max_update_interval = std::max(stats_.max_update_interval, settings_.update_interval);
+    stats_.min_scale = std::min(stats_.min_scale, settings_.scale);
+    return true;
+}
+
+bool RateController::isCongested(const Feedback& feedback) const
+{
+    if (feedback.send_delay > kMaxSendDelay)
+        return true;
+
+    if (feedback.pending_bytes < kMinPendingBytes)
+        return false;
+
+    // Time in which the queue is sent at the current rate of the network.
+    const int64_t queue_time = feedback.pending_bytes * 1000 /
+        std::max(feedback.bytes_per_second, int64_t(1));
+
+    return queue_time > kMaxSendDelay.count();
+}
+
+bool RateController::isIdle(const Feedback& feedback) const
+{
+    return feedback.send_delay < kIdleSendDelay && feedback.pending_bytes < kMinPendingBytes;
+}
+
+} // namespace codec
@@ -0,0 +1,111 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__RATE_CONTROLLER_H
+#define CODEC__RATE_CONTROLLER_H
+
+#include "base/macros_magic.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace codec {
+
+// Adapts the rate of the video to the network. The controller gets the statistics of sending
+// the messages and lowers the bitrate, the quality and the frame rate when the sending queue
+// grows. If the quality is already at its lowest, the frames are reduced. When the queue is
+// empty, the values are raised back step by step.
+class RateController
+{
+public:
+    struct Feedback
+    {
+        // Number of bytes waiting in the sending queue.
+        int64_t pending_bytes = 0;
+
+        // Number of bytes sent per second.
+        int64_t bytes_per_second = 0;
+
+        // Time from the queuing to the sending of a message.
+        std::chrono::milliseconds send_delay { 0 };
+    };
+
+    struct Settings
+    {
+        // Target bitrate of the lossy encoders in kilobits per second.
+        uint32_t bitrate;
+
+        // Range of the quantizer of the lossy encoders.
+        int min_quantizer;
+        int max_quantizer;
+
+        // Interval between the captures of the screen.
+        std::chrono::milliseconds update_interval;
+
+        // Size of the frames in percent of the size selected by the client.
+        int scale;
+    };
+
+    struct Stats
+    {
+        // Number of the feedbacks that showed a congestion of the network.
+        int64_t congestions = 0;
+
+        // The lowest bitrate set since the start.
+        uint32_t min_bitrate = 0;
+
+        // The longest interval between the captures set since the start.
+        std::chrono::milliseconds max_update_interval { 0 };
+
+        // The smallest scale of the frames set since the start.
+        int min_scale = 0;
+    };
+
+    explicit RateController(const std::chrono::milliseconds& update_interval);
+    ~RateController() = default;
+
+    // Sets the highest bitrate in kilobits per second to which an idle network raises the
+    // bitrate (see VideoEncoder::maxBitrate). If |bitrate| is zero, the bitrate is limited only by
+    // the controller.
+    void setMaxBitrate(uint32_t bitrate);
+
+    // Updates the settings with the new statistics of the network. Returns true if the settings
+    // are changed.
+    bool update(const Feedback& feedback);
+
+    const Settings& settings() const { return settings_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    bool isCongested(const Feedback& feedback) const;
+    bool isIdle(const Feedback& feedback) const;
+
+    // Interval selected by the user. The controller never captures the screen more often.
+    const std::chrono::milliseconds base_update_interval_;
+
+    uint32_t max_bitrate_;
+
+    Settings settings_;
+    Stats stats_;
+
+    DISALLOW_COPY_AND_ASSIGN(RateController);
+};
+
+} // namespace codec
+
+#endif // CODEC__RATE_CONTROLLER_H
@@ -0,0 +1,155 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/rate_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace codec {
+
+namespace {
+
+const std::chrono::milliseconds kUpdateInterval(30);
+
+RateController::Feedback congestedNetwork()
+{
+    // 1 MB in the queue of a network that sends 100 KB per second.
+    RateController::Feedback feedback;
+    feedback.pending_bytes = 1024 * 1024;
+    feedback.bytes_per_second = 100 * 1024;
+    feedback.send_delay = std::chrono::milliseconds(2000);
+    return feedback;
+}
+
+RateController::Feedback idleNetwork()
+{
+    RateController::Feedback feedback;
+    feedback.bytes_per_second = 10 * 1024;
+    feedback.send_delay = std::chrono::milliseconds(5);
+    return feedback;
+}
+
+} // namespace
+
+TEST(rate_controller, congestion_lowers_rate)
+{
+    RateController controller(kUpdateInterval);
+    const RateController::Settings initial = controller.settings();
+
+    EXPECT_TRUE(controller.update(congestedNetwork()));
+
+    const RateController::Settings& settings = controller.settings();
+
+    // The bitrate is lower than the rate of the network (800 kbps).
+    EXPECT_LT(settings.bitrate, 800u);
+    EXPECT_GT(settings.min_quantizer, initial.min_quantizer);
+    EXPECT_GT(settings.max_quantizer, initial.max_quantizer);
+    EXPECT_GT(settings.update_interval, kUpdateInterval);
+
+    EXPECT_EQ(controller.stats().congestions, 1);
+    EXPECT_EQ(controller.stats().min_bitrate, settings.bitrate);
+
+    // The frames are reduced only when the quality can not be lowered more.
+    EXPECT_EQ(settings.scale, initial.scale);
+}
+
+TEST(rate_controller, rate_is_limited)
+{
+    RateController controller(kUpdateInterval);
+
+    for (int i = 0; i < 100; ++i)
+        controller.update(congestedNetwork());
+
+    const RateController::Settings& settings = controller.settings();
+
+    EXPECT_GT(settings.bitrate, 0u);
+    EXPECT_LE(settings.max_quantizer, 63);
+    EXPECT_LE(settings.min_quantizer, settings.max_quantizer);
+    EXPECT_LE(settings.update_interval, std::chrono::milliseconds(1000));
+    EXPECT_GE(settings.scale, 50);
+    EXPECT_LT(settings.scale, 100);
+
+    // Nothing changes at the limits.
+    EXPECT_FALSE(controller.update(congestedNetwork()));
+}
+
+TEST(rate_controller, idle_network_restores_rate)
+{
+    RateController controller(kUpdateInterval);
+    const RateController::Settings initial = controller.settings();
+
+    for (int i = 0; i < 10; ++i)
+        controller.update(congestedNetwork());
+
+    for (int i = 0; i < 100; ++i)
+        controller.update(idleNetwork());
+
+    const RateController::Settings& settings = controller.settings();
+
+    EXPECT_GE(settings.bitrate, initial.bitrate);
+    EXPECT_EQ(settings.min_quantizer, initial.min_quantizer);
+    EXPECT_EQ(settings.max_quantizer, initial.max_quantizer);
+    EXPECT_EQ(settings.scale, 100);
+
+    // The screen is never captured more often than the user selected.
+    EXPECT_EQ(settings.update_interval, kUpdateInterval);
+}
+
+TEST(rate_controller, idle_network_raises_rate_to_limit)
+{
+    RateController controller(kUpdateInterval);
+
+    for (int i = 0; i < 500; ++i)
+        controller.update(idleNetwork());
+
+    EXPECT_EQ(controller.settings().bitrate, 20000u);
+
+    // The encoder limits the bitrate.
+    RateController limited_controller(kUpdateInterval);
+    limited_controller.setMaxBitrate(1450);
+
+    for (int i = 0; i < 500; ++i)
+        limited_controller.update(idleNetwork());
+
+    EXPECT_EQ(limited_controller.settings().bitrate, 1450u);
+
+    // The bitrate above the new limit is kept.
+    limited_controller.setMaxBitrate(500);
+    limited_controller.update(idleNetwork());
+
+    EXPECT_EQ(limited_controller.settings().bitrate, 1450u);
+}
+
+TEST(rate_controller, small_queue_is_not_congestion)
+{
+    RateController controller(kUpdateInterval);
+
+    // A single packet of a full screen waits shortly in the queue.
+    RateController::Feedback feedback;
+    feedback.pending_bytes = 32 * 1024;
+    feedback.bytes_per_second = 1024 * 1024;
+    feedback.send_delay = std::chrono::milliseconds(100);
+
+    const RateController::Settings initial = controller.settings();
+
+    EXPECT_FALSE(controller.update(feedback));
+    EXPECT_EQ(controller.settings().bitrate, initial.bitrate);
+    EXPECT_EQ(controller.stats().congestions, 0);
+}
+
+} // namespace codec
@@ -0,0 +1,76 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/refinement_budget.h"
+
+#include <algorithm>
+
+namespace codec {
+
+namespace {
+
+// Bitrate in kilobits per second from which the whole area is refined. On the slower networks
+// the area is smaller in proportion.
+const uint32_t kMaxAreaBitrate = 8000;
+
+// Minimum area that is refined in one frame if the network is not congested.
+const int kMinArea = 64 * 64;
+
+} // namespace
+
+void RefinementBudget::setRateLimits(uint32_t bitrate, int max_quantizer)
+{
+    const bool congested =
+        bitrate_ && (bitrate < bitrate_ || max_quantizer > max_quantizer_);
+
+    bitrate_ = bitrate;
+    max_quantizer_ = max_quantizer;
+
+    if (congested)
+    {
+        area_ = 0;
+        return;
+    }
+
+    area_ = static_cast<int>(std::clamp<int64_t>(
+        int64_t(kMaxArea) * bitrate / kMaxAreaBitrate, kMinArea, kMaxArea));
+}
+
+// static
+QRegion RefinementBudget::limitRegion(const QRegion& region, int area)
+{
+    QRegion limited_region;
+
+    if (area <= 0)
+        return limited_region;
+
+    for (const auto& rect : region)
+    {
+        const int height = std::min(rect.height(), std::max(area / rect.width(), 1));
+
+        limited_region += QRect(rect.left(), rect.top(), rect.width(), height);
+
+        area -= rect.width() * height;
+        if (area <= 0)
+            break;
+    }
+
+    return limited_region;
+}
+
+} // namespace codec
@@ -0,0 +1,59 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__REFINEMENT_BUDGET_H
+#define CODEC__REFINEMENT_BUDGET_H
+
+#include <QRegion>
+
+#include <cstdint>
+
+namespace codec {
+
+// Limits the refinement of the areas that were encoded with losses (see VideoEncoderHybrid and
+// VideoEncoderVPX). The area refined in one frame follows the bitrate of the network, and the
+// refinement is paused while the network is congested.
+class RefinementBudget
+{
+public:
+    // Maximum area that is refined in one frame (the size of 4 tiles of 256x256 pixels).
+    static const int kMaxArea = 4 * 256 * 256;
+
+    // Updates the budget with the limits set by the rate controller (see
+    // VideoEncoder::setRateLimits). The controller lowers the bitrate and raises the quantizer
+    // when the network is congested. The refinement is paused until the limits are raised again.
+    void setRateLimits(uint32_t bitrate, int max_quantizer);
+
+    // Maximum area in pixels that is refined in one frame. Zero while the network is congested.
+    int area() const { return area_; }
+
+    // Returns the part of |region| that is not larger than |area|. Large rectangles are taken by
+    // bands, so they are refined over several frames.
+    static QRegion limitRegion(const QRegion& region, int area);
+
+private:
+    int area_ = kMaxArea;
+
+    // The last rate limits.
+    uint32_t bitrate_ = 0;
+    int max_quantizer_ = 0;
+};
+
+} // namespace codec
+
+#endif // CODEC__REFINEMENT_BUDGET_H
@@ -0,0 +1,104 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/refinement_budget.h"
+
+#include <gtest/gtest.h>
+
+namespace codec {
+
+namespace {
+
+const int kMaxArea = RefinementBudget::kMaxArea;
+
+int regionArea(const QRegion& region)
+{
+    int area = 0;
+
+    for (const auto& rect : region)
+        area += rect.width() * rect.height();
+
+    return area;
+}
+
+} // namespace
+
+TEST(refinement_budget, region_is_limited_by_bands)
+{
+    const QRegion region(QRect(0, 0, 100, 100));
+
+    // The whole rectangle fits the area.
+    EXPECT_EQ(RefinementBudget::limitRegion(region, 100 * 100), region);
+
+    // The large rectangle is taken by the band of the full width.
+    EXPECT_EQ(RefinementBudget::limitRegion(region, 100 * 30), QRegion(QRect(0, 0, 100, 30)));
+
+    // At least one row is taken if the area is smaller than the width.
+    EXPECT_EQ(RefinementBudget::limitRegion(region, 10), QRegion(QRect(0, 0, 100, 1)));
+
+    EXPECT_TRUE(RefinementBudget::limitRegion(region, 0).isEmpty());
+}
+
+TEST(refinement_budget, region_of_several_rects_is_limited)
+{
+    QRegion region;
+    region += QRect(0, 0, 10, 10);
+    region += QRect(0, 50, 10, 10);
+
+    const QRegion limited = RefinementBudget::limitRegion(region, 150);
+
+    EXPECT_EQ(regionArea(limited), 150);
+    EXPECT_TRUE(region.contains(limited.boundingRect().topLeft()));
+    EXPECT_TRUE(limited.subtracted(region).isEmpty());
+}
+
+TEST(refinement_budget, area_follows_bitrate)
+{
+    RefinementBudget budget;
+    EXPECT_EQ(budget.area(), kMaxArea);
+
+    budget.setRateLimits(20000, 30);
+    EXPECT_EQ(budget.area(), kMaxArea);
+
+    // On a slow network the area is smaller, but the refinement is not stopped.
+    RefinementBudget slow_budget;
+    slow_budget.setRateLimits(1000, 30);
+    EXPECT_GT(slow_budget.area(), 0);
+    EXPECT_LT(slow_budget.area(), kMaxArea);
+}
+
+TEST(refinement_budget, refinement_is_paused_on_congestion)
+{
+    RefinementBudget budget;
+    budget.setRateLimits(4000, 30);
+    EXPECT_GT(budget.area(), 0);
+
+    // The rate controller lowers the bitrate.
+    budget.setRateLimits(2000, 30);
+    EXPECT_EQ(budget.area(), 0);
+
+    // The rate controller raises the quantizer.
+    budget.setRateLimits(2000, 40);
+    EXPECT_EQ(budget.area(), 0);
+
+    // The limits are raised again.
+    budget.setRateLimits(2100, 38);
+    EXPECT_GT(budget.area(), 0);
+}
+
+} // namespace codec
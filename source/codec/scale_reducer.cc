@@ -18,43 +18,25 @@
 
 #include "codec/scale_reducer.h"
 
-#include <libyuv/scale_argb.h>
+#include <algorithm>
 
 #include "base/logging.h"
-#include "desktop/desktop_frame_aligned.h"
+#include "codec/box_scaler.h"
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_pool.h"
 
 namespace codec {
 
 namespace {
 
-const int kMinScaleFactor = 50;
+const int kMinScaleFactor = 10;
 const int kMaxScaleFactor = 100;
-const int kDefScaleFactor = 100;
 
 int div(int num, int div)
 {
     return (num + div - 1) / div;
 }
 
-QSize scaledSize(const QSize& source_size, int scale_factor)
-{
-    return QSize(div(source_size.width() * scale_factor, kDefScaleFactor),
-                 div(source_size.height() * scale_factor, kDefScaleFactor));
-}
-
-QRect scaledRect(const QRect& source_rect, int scale_factor)
-{
-    int left = (source_rect.left() * scale_factor) / kDefScaleFactor;
-    int top = (source_rect.top() * scale_factor) / kDefScaleFactor;
-    int right = div(source_rect.right() * scale_factor, kDefScaleFactor);
-    int bottom = div(source_rect.bottom() * scale_factor, kDefScaleFactor);
-
-    static const int kPadding = 1;
-
-    return QRect(QPoint(left - kPadding, top - kPadding),
-                 QPoint(right + kPadding, bottom + kPadding));
-}
-
 } // namespace
 
 ScaleReducer::ScaleReducer(int scale_factor)
@@ -72,66 +54,141 @@ ScaleReducer* ScaleReducer::create(int scale_factor)
     return new ScaleReducer(scale_factor);
 }
 
+bool ScaleReducer::setScaleFactor(int scale_factor)
+{
+    if (scale_factor < kMinScaleFactor || scale_factor > kMaxScaleFactor)
+        return false;
+
+    scale_factor_ = scale_factor;
+    return true;
+}
+
+void ScaleReducer::setTargetSize(const QSize& target_size)
+{
+    target_size_ = target_size;
+}
+
+void ScaleReducer::setReduction(int reduction)
+{
+    reduction_ = std::clamp(reduction, kMinScaleFactor, kMaxScaleFactor);
+}
+
+QSize ScaleReducer::scaledSize(const QSize& source_size) const
+{
+    const int64_t source_width = source_size.width();
+    const int64_t source_height = source_size.height();
+    int64_t width;
+    int64_t height;
+
+    if (target_size_.isEmpty())
+    {
+        width = div(source_width * scale_factor_, kDefScaleFactor);
+        height = div(source_height * scale_factor_, kDefScaleFactor);
+    }
+    else if (target_size_.width() * source_height <= target_size_.height() * source_width)
+    {
+        // The width limits the size.
+        width = std::min<int64_t>(target_size_.width(), source_width);
+        height = div(source_height * width, source_width);
+    }
+    else
+    {
+        height = std::min<int64_t>(target_size_.height(), source_height);
+        width = div(source_width * height, source_height);
+    }
+
+    width = div(width * reduction_, kDefScaleFactor);
+    height = div(height * reduction_, kDefScaleFactor);
+
+    // The target size is set by the client. The frames are never reduced more than by the
+    // smallest scale factor.
+    width = std::max<int64_t>(width, div(source_width * kMinScaleFactor, kDefScaleFactor));
+    height = std::max<int64_t>(height, div(source_height * kMinScaleFactor, kDefScaleFactor));
+
+    return QSize(std::max(static_cast<int>(width), 1), std::max(static_cast<int>(height), 1));
+}
+
+// static
+QRect ScaleReducer::scaledRect(const QRect& source_rect,
+                               const QSize& source_size,
+                               const QSize& scaled_size)
+{
+    // A pixel of the scaled frame covers the source pixels from x * source / scaled up to
+    // (x + 1) * source / scaled.
+    auto scale = [](int pos, int source_length, int scaled_length)
+    {
+        return static_cast<int>(int64_t(pos) * scaled_length / source_length);
+    };
+
+    int left = scale(source_rect.left(), source_size.width(), scaled_size.width());
+    int top = scale(source_rect.top(), source_size.height(), scaled_size.height());
+    int right = scale(source_rect.right(), source_size.width(), scaled_size.width());
+    int bottom = scale(source_rect.bottom(), source_size.height(), scaled_size.height());
+
+    static const int kPadding = 1;
+
+    return QRect(QPoint(left - kPadding, top - kPadding),
+                 QPoint(right + kPadding, bottom + kPadding));
+}
+
 const desktop::Frame* ScaleReducer::scaleFrame(const desktop::Frame* source_frame)
 {
+    // The frames without changes are passed too while the encoder refines the areas that were
+    // encoded with losses (see VideoEncoder::hasRefinement).
     DCHECK(source_frame);
-    DCHECK(!source_frame->constUpdatedRegion().isEmpty());
     DCHECK(source_frame->format() == desktop::PixelFormat::ARGB());
 
-    if (scale_factor_ == kDefScaleFactor)
+    const QSize& source_size = source_frame->size();
+    const QSize scaled_size = scaledSize(source_size);
+
+    // The frames are passed unchanged only while the previous frame was not scaled either, so the
+    // updated region of the source frame is valid for the receiver.
+    if (scaled_size == source_size && last_size_ == source_size)
         return source_frame;
 
-    if (screen_settings_tracker_.isSizeChanged(source_frame->size()))
-        scaled_frame_.reset();
+    // If the size is changed, the whole frame is scaled.
+    bool whole_frame = screen_settings_tracker_.isSizeChanged(source_size) ||
+                       scaled_size != last_size_;
 
-    if (!scaled_frame_)
+    if (!scaled_frame_ || scaled_frame_->size() != scaled_size)
     {
-        QSize size = scaledSize(source_frame->size(), scale_factor_);
-
-        scaled_frame_ = desktop::FrameAligned::create(size, source_frame->format(), 32);
+        scaled_frame_ = desktop::FramePool::instance()->create(scaled_size, source_frame->format());
         if (!scaled_frame_)
             return nullptr;
+
+        whole_frame = true;
     }
 
-    const QSize& source_size = source_frame->size();
-    const QSize& scaled_size = scaled_frame_->size();
+    last_size_ = scaled_size;
 
     QRect scaled_frame_rect = QRect(QPoint(), scaled_size);
     QRegion* updated_region = scaled_frame_->updatedRegion();
 
     *updated_region = QRegion();
 
-    for (const auto& rect : source_frame->constUpdatedRegion())
+    if (whole_frame)
+    {
+        *updated_region = scaled_frame_rect;
+    }
+    else
     {
-        QRect scaled_rect = scaledRect(rect, scale_factor_).intersected(scaled_frame_rect);
-
-#if 1
-        int height = scaled_rect.height();
-
-        // FIXME: A bug in libyuv? If the coordinate |bottom| of rectangle is equal to coordinate
-        // |bottom| in the frame, then a crash occurs.
-        if (scaled_rect.bottom() == scaled_frame_rect.bottom())
-            height -= 1;
-#endif
-
-        if (libyuv::ARGBScaleClip(source_frame->frameData(),
-                                  source_frame->stride(),
-                                  source_size.width(),
-                                  source_size.height(),
-                                  scaled_frame_->frameData(),
-                                  scaled_frame_->stride(),
-                                  scaled_size.width(),
-                                  scaled_size.height(),
-                                  scaled_rect.x(),
-                                  scaled_rect.y(),
-                                  scaled_rect.width(),
-                                  height,
-                                  libyuv::kFilterBox) == -1)
+        // Moves can not be scaled without losses, so the target areas are scaled as changed.
+        QRegion source_region = source_frame->constUpdatedRegion();
+        for (const auto& move : source_frame->constMoveList())
+            source_region += QRect(move.target_pos, move.source_rect.size());
+
+        for (const auto& rect : source_region)
         {
-            LOG(LS_WARNING) << "libyuv::ARGBScaleClip failed";
+            *updated_region +=
+                scaledRect(rect, source_size, scaled_size).intersected(scaled_frame_rect);
         }
+    }
 
-        *updated_region += scaled_rect;
+    for (const auto& rect : *updated_region)
+    {
+        scaleARGB(source_frame->frameData(), source_frame->stride(), source_size,
+                  scaled_frame_->frameData(), scaled_frame_->stride(), scaled_size,
+                  rect);
     }
 
     scaled_frame_->setTopLeft(source_frame->topLeft());
@@ -19,6 +19,8 @@
 #ifndef CODEC__SCALE_REDUCER_H
 #define CODEC__SCALE_REDUCER_H
 
+#include <QRect>
+
 #include <memory>
 
 #include "base/macros_magic.h"
@@ -35,15 +37,46 @@ class ScaleReducer
 public:
     ~ScaleReducer() = default;
 
+    // The frames are not scaled with this factor.
+    static const int kDefScaleFactor = 100;
+
+    // Returns nullptr if |scale_factor| is out of the supported range.
     static ScaleReducer* create(int scale_factor);
 
+    // Changes the scale of the frames during the session. Returns false if |scale_factor| is out
+    // of the supported range.
+    bool setScaleFactor(int scale_factor);
+
+    // The frames are scaled to fit into |target_size| (for example, the window of the client) with
+    // the aspect ratio kept, and the scale factor is not used. The frames are never enlarged. An
+    // empty size returns to the scale factor.
+    void setTargetSize(const QSize& target_size);
+
+    // Additional reduction of the frames in percent, selected by the bandwidth controller.
+    void setReduction(int reduction);
+
+    // Returns the size of the scaled frames for the frames of |source_size|.
+    QSize scaledSize(const QSize& source_size) const;
+
     const desktop::Frame* scaleFrame(const desktop::Frame* source_frame);
 
+    // Returns the area of the frame scaled from |source_size| to |scaled_size| that is changed by
+    // the change of |source_rect|. The area may exceed the scaled frame.
+    static QRect scaledRect(const QRect& source_rect,
+                            const QSize& source_size,
+                            const QSize& scaled_size);
+
 protected:
     explicit ScaleReducer(int scale_factor);
 
 private:
-    const int scale_factor_;
+    int scale_factor_;
+    int reduction_ = kDefScaleFactor;
+    QSize target_size_;
+
+    // Size of the last frame returned by scaleFrame().
+    QSize last_size_;
+
     std::unique_ptr<desktop::Frame> scaled_frame_;
     desktop::ScreenSettingsTracker screen_settings_tracker_;
 
@@ -0,0 +1,142 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/scale_reducer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "codec/box_scaler.h"
+#include "desktop/desktop_frame_aligned.h"
+
+namespace codec {
+
+namespace {
+
+void fillRect(desktop::Frame* frame, const QRect& rect, std::mt19937* random)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* pixels = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(rect.left(), y));
+
+        for (int x = 0; x < rect.width(); ++x)
+            pixels[x] = (*random)();
+    }
+}
+
+// Scales the whole |source| frame to |size|.
+std::vector<uint8_t> scaleWhole(const desktop::Frame* source, const QSize& size)
+{
+    std::vector<uint8_t> image(size.width() * size.height() * 4);
+
+    scaleARGB(source->frameData(), source->stride(), source->size(),
+              image.data(), size.width() * 4, size, QRect(QPoint(), size));
+    return image;
+}
+
+} // namespace
+
+TEST(scale_reducer, scaled_size)
+{
+    const QSize source_size(1920, 1080);
+
+    std::unique_ptr<ScaleReducer> scale_reducer(ScaleReducer::create(100));
+    ASSERT_TRUE(scale_reducer);
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), source_size);
+
+    // The aspect ratio is kept.
+    scale_reducer->setTargetSize(QSize(800, 800));
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), QSize(800, 450));
+
+    scale_reducer->setTargetSize(QSize(4000, 500));
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), QSize(889, 500));
+
+    // The frames are never enlarged.
+    scale_reducer->setTargetSize(QSize(4000, 4000));
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), source_size);
+
+    scale_reducer->setTargetSize(QSize());
+    EXPECT_TRUE(scale_reducer->setScaleFactor(20));
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), QSize(384, 216));
+
+    scale_reducer->setReduction(50);
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), QSize(192, 108));
+
+    // The frames are never reduced below the smallest scale factor.
+    scale_reducer->setTargetSize(QSize(1, 1));
+    scale_reducer->setReduction(10);
+    EXPECT_EQ(scale_reducer->scaledSize(source_size), QSize(192, 108));
+
+    EXPECT_FALSE(scale_reducer->setScaleFactor(5));
+    EXPECT_FALSE(ScaleReducer::create(101));
+}
+
+TEST(scale_reducer, updates_match_whole_frame)
+{
+    const QSize source_size(1366, 767);
+    const QRect source_rect(QPoint(), source_size);
+
+    std::mt19937 random(3);
+
+    std::unique_ptr<desktop::Frame> source =
+        desktop::FrameAligned::create(source_size, desktop::PixelFormat::ARGB(), 32);
+    fillRect(source.get(), source_rect, &random);
+
+    std::unique_ptr<ScaleReducer> scale_reducer(ScaleReducer::create(100));
+
+    // The size is changed during the session, including to the size of the source frame.
+    const QSize target_sizes[] = { QSize(), QSize(500, 500), QSize(1000, 300), source_size };
+
+    for (const auto& target_size : target_sizes)
+    {
+        scale_reducer->setTargetSize(target_size);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            QRegion* updated_region = source->updatedRegion();
+            *updated_region = QRegion();
+
+            for (int j = 0; j < 4; ++j)
+            {
+                QRect rect(random() % 1300, random() % 700, 1 + random() % 60, 1 + random() % 60);
+                rect = rect.intersected(source_rect);
+
+                fillRect(source.get(), rect, &random);
+                *updated_region += rect;
+            }
+
+            const desktop::Frame* scaled = scale_reducer->scaleFrame(source.get());
+            ASSERT_TRUE(scaled);
+
+            const QSize& scaled_size = scaled->size();
+            const std::vector<uint8_t> expected = scaleWhole(source.get(), scaled_size);
+            const int row_size = scaled_size.width() * 4;
+
+            for (int y = 0; y < scaled_size.height(); ++y)
+            {
+                ASSERT_EQ(memcmp(expected.data() + y * row_size,
+                                 scaled->frameData() + y * scaled->stride(), row_size), 0);
+            }
+        }
+    }
+}
+
+} // namespace codec
@@ -18,8 +18,13 @@
 
 #include "codec/video_decoder.h"
 
+#include "base/logging.h"
+#include "codec/video_decoder_hybrid.h"
+#include "codec/video_decoder_palette.h"
 #include "codec/video_decoder_vpx.h"
 #include "codec/video_decoder_zstd.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
 
 namespace codec {
 
@@ -37,9 +42,44 @@ std::unique_ptr<VideoDecoder> VideoDecoder::create(proto::desktop::VideoEncoding
         case proto::desktop::VIDEO_ENCODING_VP9:
             return VideoDecoderVPX::createVP9();
 
+        case proto::desktop::VIDEO_ENCODING_PALETTE:
+            return VideoDecoderPalette::create();
+
+        case proto::desktop::VIDEO_ENCODING_HYBRID:
+            return VideoDecoderHybrid::create();
+
         default:
             return nullptr;
     }
 }
 
+// static
+bool VideoDecoder::applyMoveRects(const proto::desktop::VideoPacket& packet,
+                                  desktop::Frame* frame)
+{
+    const QRect frame_rect(QPoint(), frame->size());
+
+    for (int i = 0; i < packet.move_rect_size(); ++i)
+    {
+        const proto::desktop::VideoMoveRect& move_rect = packet.move_rect(i);
+
+        const QRect source_rect = VideoUtil::fromVideoRect(move_rect.source_rect());
+        const QPoint target_pos(move_rect.target_x(), move_rect.target_y());
+
+        // QRect::contains() normalizes the rectangles, so the rectangles with negative sizes are
+        // rejected separately.
+        if (source_rect.isEmpty() ||
+            !frame_rect.contains(source_rect) ||
+            !frame_rect.contains(QRect(target_pos, source_rect.size())))
+        {
+            LOG(LS_WARNING) << "The moved area is outside the screen area";
+            return false;
+        }
+
+        frame->moveRect(source_rect, target_pos);
+    }
+
+    return true;
+}
+
 } // namespace codec
@@ -37,6 +37,10 @@ public:
     static std::unique_ptr<VideoDecoder> create(proto::desktop::VideoEncoding encoding);
 
     virtual bool decode(const proto::desktop::VideoPacket& packet, desktop::Frame* frame) = 0;
+
+protected:
+    // Applies the moves from |packet| to |frame|. Returns false if a move is outside the frame.
+    static bool applyMoveRects(const proto::desktop::VideoPacket& packet, desktop::Frame* frame);
 };
 
 } // namespace codec
@@ -0,0 +1,141 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder_hybrid.h"
+
+#include "base/logging.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_pool.h"
+
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+void copyRect(const desktop::Frame* source_frame, const QRect& rect, desktop::Frame* target_frame)
+{
+    const size_t row_size = rect.width() * target_frame->format().bytesPerPixel();
+
+    const uint8_t* source = source_frame->frameDataAtPos(rect.topLeft());
+    uint8_t* target = target_frame->frameDataAtPos(rect.topLeft());
+
+    for (int y = 0; y < rect.height(); ++y)
+    {
+        memcpy(target, source, row_size);
+
+        source += source_frame->stride();
+        target += target_frame->stride();
+    }
+}
+
+} // namespace
+
+VideoDecoderHybrid::VideoDecoderHybrid() = default;
+
+VideoDecoderHybrid::~VideoDecoderHybrid() = default;
+
+// static
+std::unique_ptr<VideoDecoderHybrid> VideoDecoderHybrid::create()
+{
+    return std::unique_ptr<VideoDecoderHybrid>(new VideoDecoderHybrid());
+}
+
+VideoDecoderHybrid::Part* VideoDecoderHybrid::partDecoder(proto::desktop::VideoEncoding encoding,
+                                                          const desktop::Frame* target_frame)
+{
+    for (auto& part : parts_)
+    {
+        if (part.encoding == encoding)
+            return &part;
+    }
+
+    if (encoding == proto::desktop::VIDEO_ENCODING_HYBRID)
+        return nullptr;
+
+    Part part;
+    part.encoding = encoding;
+    part.decoder = VideoDecoder::create(encoding);
+    part.frame = desktop::FramePool::instance()->create(screen_size_, target_frame->format());
+
+    if (!part.decoder || !part.frame)
+        return nullptr;
+
+    parts_.emplace_back(std::move(part));
+    return &parts_.back();
+}
+
+bool VideoDecoderHybrid::decode(const proto::desktop::VideoPacket& packet,
+                                desktop::Frame* target_frame)
+{
+    if (packet.has_format())
+    {
+        const proto::desktop::Rect& screen_rect = packet.format().screen_rect();
+
+        // The encoders of the parts start again after a change of the format.
+        screen_size_ = QSize(screen_rect.width(), screen_rect.height());
+        parts_.clear();
+    }
+
+    if (screen_size_.isEmpty())
+    {
+        LOG(LS_WARNING) << "A packet with image information was not received";
+        return false;
+    }
+
+    DCHECK(screen_size_ == target_frame->size());
+
+    if (!applyMoveRects(packet, target_frame))
+        return false;
+
+    const QRect frame_rect(QPoint(), screen_size_);
+
+    for (int i = 0; i < packet.part_size(); ++i)
+    {
+        const proto::desktop::VideoPart& video_part = packet.part(i);
+
+        Part* part = partDecoder(video_part.packet().encoding(), target_frame);
+        if (!part)
+        {
+            LOG(LS_WARNING) << "Unsupported encoding of the part: "
+                            << video_part.packet().encoding();
+            return false;
+        }
+
+        if (!part->decoder->decode(video_part.packet(), part->frame.get()))
+            return false;
+
+        for (int j = 0; j < video_part.rect_size(); ++j)
+        {
+            const QRect rect = VideoUtil::fromVideoRect(video_part.rect(j));
+
+            if (!frame_rect.contains(rect))
+            {
+                LOG(LS_WARNING) << "The rectangle is outside the screen area";
+                return false;
+            }
+
+            copyRect(part->frame.get(), rect, target_frame);
+        }
+    }
+
+    return true;
+}
+
+} // namespace codec
@@ -0,0 +1,364 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder_palette.h"
+
+#include "base/logging.h"
+#include "codec/palette_tile.h"
+#include "codec/pixel_translator.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+const int kMaxTilePixels = kPaletteTileSize * kPaletteTileSize;
+
+// Maximum size of a varint with a 32-bit value.
+const int kMaxVarintSize = 5;
+
+bool readVarint(const uint8_t** data, const uint8_t* end, uint32_t* value)
+{
+    const uint8_t* pos = *data;
+    uint32_t result = 0;
+
+    for (int i = 0; i < kMaxVarintSize; ++i)
+    {
+        if (pos == end)
+            return false;
+
+        const uint8_t byte = *pos++;
+        result |= static_cast<uint32_t>(byte & 0x7F) << (i * 7);
+
+        if (!(byte & 0x80))
+        {
+            *data = pos;
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename PixelType>
+bool unpackIndices(const uint8_t* data, int width, int height,
+                   const PixelType* palette, int palette_size, PixelType* pixels)
+{
+    const int bits = packedIndexBits(palette_size);
+    const int mask = (1 << bits) - 1;
+    const int row_size = packedRowSize(width, palette_size);
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uint8_t* row = data;
+        int shift = 8;
+
+        for (int x = 0; x < width; ++x)
+        {
+            shift -= bits;
+
+            const int index = (*row >> shift) & mask;
+            if (index >= palette_size)
+                return false;
+
+            pixels[x] = palette[index];
+
+            if (!shift)
+            {
+                ++row;
+                shift = 8;
+            }
+        }
+
+        data += row_size;
+        pixels += width;
+    }
+
+    return true;
+}
+
+template <typename PixelType>
+bool unpackRuns(const uint8_t** data, const uint8_t* end, int count,
+                const PixelType* palette, int palette_size, PixelType* pixels)
+{
+    const uint8_t* pos = *data;
+    int i = 0;
+
+    while (i < count)
+    {
+        if (pos == end)
+            return false;
+
+        const int index = *pos++;
+        if (index >= palette_size)
+            return false;
+
+        uint32_t run_length;
+        if (!readVarint(&pos, end, &run_length) || run_length >= static_cast<uint32_t>(count - i))
+            return false;
+
+        std::fill_n(pixels + i, run_length + 1, palette[index]);
+        i += run_length + 1;
+    }
+
+    *data = pos;
+    return true;
+}
+
+} // namespace
+
+VideoDecoderPalette::VideoDecoderPalette()
+    : stream_(ZSTD_createDStream()),
+      tile_pixels_(std::make_unique<uint8_t[]>(kMaxTilePixels * sizeof(uint32_t)))
+{
+    // Nothing
+}
+
+VideoDecoderPalette::~VideoDecoderPalette() = default;
+
+// static
+std::unique_ptr<VideoDecoderPalette> VideoDecoderPalette::create()
+{
+    return std::unique_ptr<VideoDecoderPalette>(new VideoDecoderPalette());
+}
+
+template <typename PixelType>
+bool VideoDecoderPalette::decodeTile(const uint8_t** data, const uint8_t* end,
+                                     int width, int height)
+{
+    const int pixel_count = width * height;
+    const uint8_t* pos = *data;
+
+    if (pos == end)
+        return false;
+
+    const uint8_t type = *pos++;
+
+    PixelType* tile_pixels = reinterpret_cast<PixelType*>(tile_pixels_.get());
+
+    switch (type)
+    {
+        case PALETTE_TILE_RAW:
+        {
+            const size_t raw_size = pixel_count * sizeof(PixelType);
+            if (static_cast<size_t>(end - pos) < raw_size)
+                return false;
+
+            // The pixels are copied to keep the alignment of the pixels for the translator.
+            memcpy(tile_pixels, pos, raw_size);
+            pos += raw_size;
+        }
+        break;
+
+        case PALETTE_TILE_SOLID:
+        {
+            if (static_cast<size_t>(end - pos) < sizeof(PixelType))
+                return false;
+
+            PixelType color;
+            memcpy(&color, pos, sizeof(PixelType));
+            pos += sizeof(PixelType);
+
+            std::fill_n(tile_pixels, pixel_count, color);
+        }
+        break;
+
+        case PALETTE_TILE_PACKED:
+        case PALETTE_TILE_RLE:
+        {
+            if (pos == end)
+                return false;
+
+            const int palette_size = *pos++ + 1;
+            const size_t palette_bytes = palette_size * sizeof(PixelType);
+
+            if (static_cast<size_t>(end - pos) < palette_bytes)
+                return false;
+
+            PixelType palette[kMaxPaletteSize];
+            memcpy(palette, pos, palette_bytes);
+            pos += palette_bytes;
+
+            if (type == PALETTE_TILE_RLE)
+            {
+                if (!unpackRuns(&pos, end, pixel_count, palette, palette_size, tile_pixels))
+                    return false;
+                break;
+            }
+
+            const size_t indices_size = packedRowSize(width, palette_size) * height;
+
+            if (palette_size > kMaxPackedPaletteSize ||
+                static_cast<size_t>(end - pos) < indices_size)
+            {
+                return false;
+            }
+
+            if (!unpackIndices(pos, width, height, palette, palette_size, tile_pixels))
+                return false;
+
+            pos += indices_size;
+        }
+        break;
+
+        default:
+            return false;
+    }
+
+    *data = pos;
+    return true;
+}
+
+template <typename PixelType>
+bool VideoDecoderPalette::decodeTiles(desktop::Frame* target_frame)
+{
+    const uint8_t* data = tile_data_.data();
+    const uint8_t* end = data + tile_data_size_;
+
+    for (const auto& rect : rects_)
+    {
+        for (int y = rect.top(); y <= rect.bottom(); y += kPaletteTileSize)
+        {
+            const int height = std::min(kPaletteTileSize, rect.bottom() + 1 - y);
+
+            for (int x = rect.left(); x <= rect.right(); x += kPaletteTileSize)
+            {
+                const int width = std::min(kPaletteTileSize, rect.right() + 1 - x);
+
+                if (!decodeTile<PixelType>(&data, end, width, height))
+                {
+                    LOG(LS_WARNING) << "Invalid tile data";
+                    return false;
+                }
+
+                translator_->translate(tile_pixels_.get(), width * sizeof(PixelType),
+                                       target_frame->frameDataAtPos(x, y),
+                                       target_frame->stride(),
+                                       width, height);
+            }
+        }
+    }
+
+    if (data != end)
+    {
+        LOG(LS_WARNING) << "Unexpected data after the tiles";
+        return false;
+    }
+
+    return true;
+}
+
+bool VideoDecoderPalette::decode(const proto::desktop::VideoPacket& packet,
+                                 desktop::Frame* target_frame)
+{
+    if (packet.has_format())
+    {
+        const proto::desktop::VideoPacketFormat& format = packet.format();
+
+        const desktop::PixelFormat source_format =
+            VideoUtil::fromVideoPixelFormat(format.pixel_format());
+
+        screen_size_ = QSize(format.screen_rect().width(), format.screen_rect().height());
+        bytes_per_pixel_ = source_format.bytesPerPixel();
+        translator_ = PixelTranslator::create(source_format, target_frame->format());
+    }
+
+    if (!translator_)
+    {
+        LOG(LS_WARNING) << "A packet with image information was not received";
+        return false;
+    }
+
+    DCHECK(screen_size_ == target_frame->size());
+
+    if (!applyMoveRects(packet, target_frame))
+        return false;
+
+    const QRect frame_rect(QPoint(), screen_size_);
+
+    // Each tile is not larger than its raw pixels with the type byte.
+    size_t max_data_size = 0;
+
+    rects_.clear();
+
+    for (int i = 0; i < packet.dirty_rect_size(); ++i)
+    {
+        QRect rect = VideoUtil::fromVideoRect(packet.dirty_rect(i));
+
+        // QRect::contains() accepts the rectangles with negative sizes, and the size of the data
+        // is calculated from them.
+        if (rect.isEmpty())
+        {
+            LOG(LS_WARNING) << "Empty rectangle in the packet";
+            return false;
+        }
+
+        if (!frame_rect.contains(rect))
+        {
+            LOG(LS_WARNING) << "The rectangle is outside the screen area";
+            return false;
+        }
+
+        const size_t tile_count =
+            ((rect.width() + kPaletteTileSize - 1) / kPaletteTileSize) *
+            ((rect.height() + kPaletteTileSize - 1) / kPaletteTileSize);
+
+        max_data_size += tile_count + rect.width() * rect.height() * bytes_per_pixel_;
+        rects_.push_back(rect);
+    }
+
+    if (rects_.empty())
+        return true;
+
+    if (tile_data_.size() < max_data_size)
+        tile_data_.resize(max_data_size);
+
+    tile_data_size_ = ZSTD_decompressDCtx(stream_.get(),
+                                          tile_data_.data(),
+                                          max_data_size,
+                                          packet.data().data(),
+                                          packet.data().size());
+    if (ZSTD_isError(tile_data_size_))
+    {
+        LOG(LS_WARNING) << "ZSTD_decompressDCtx failed: " << ZSTD_getErrorName(tile_data_size_);
+        return false;
+    }
+
+    switch (bytes_per_pixel_)
+    {
+        case 4:
+            return decodeTiles<uint32_t>(target_frame);
+
+        case 2:
+            return decodeTiles<uint16_t>(target_frame);
+
+        case 1:
+            return decodeTiles<uint8_t>(target_frame);
+
+        default:
+            LOG(LS_WARNING) << "Unsupported pixel format";
+            return false;
+    }
+}
+
+} // namespace codec
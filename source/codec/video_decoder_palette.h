@@ -0,0 +1,73 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VIDEO_DECODER_PALETTE_H
+#define CODEC__VIDEO_DECODER_PALETTE_H
+
+#include "base/macros_magic.h"
+#include "codec/scoped_zstd_stream.h"
+#include "codec/video_decoder.h"
+
+#include <QRect>
+
+#include <vector>
+
+namespace codec {
+
+class PixelTranslator;
+
+class VideoDecoderPalette : public VideoDecoder
+{
+public:
+    ~VideoDecoderPalette();
+
+    static std::unique_ptr<VideoDecoderPalette> create();
+
+    bool decode(const proto::desktop::VideoPacket& packet, desktop::Frame* target_frame) override;
+
+private:
+    VideoDecoderPalette();
+
+    template <typename PixelType>
+    bool decodeTiles(desktop::Frame* target_frame);
+
+    // Unpacks the tile at |*data| into |tile_pixels_| and moves |*data| to the next tile.
+    template <typename PixelType>
+    bool decodeTile(const uint8_t** data, const uint8_t* end, int width, int height);
+
+    ScopedZstdDStream stream_;
+    std::unique_ptr<PixelTranslator> translator_;
+
+    QSize screen_size_;
+    int bytes_per_pixel_ = 0;
+
+    std::vector<QRect> rects_;
+
+    // The decompressed tiles of the packet.
+    std::vector<uint8_t> tile_data_;
+    size_t tile_data_size_ = 0;
+
+    // Unpacked pixels of the current tile.
+    std::unique_ptr<uint8_t[]> tile_pixels_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoDecoderPalette);
+};
+
+} // namespace codec
+
+#endif // CODEC__VIDEO_DECODER_PALETTE_H
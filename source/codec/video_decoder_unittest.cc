@@ -0,0 +1,102 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder.h"
+#include "codec/video_encoder_zstd.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame_simple.h"
+
+#include <gtest/gtest.h>
+
+namespace codec {
+
+namespace {
+
+const QSize kScreenSize(64, 48);
+
+// Returns a packet with the format and the whole screen.
+proto::desktop::VideoPacket firstPacket()
+{
+    std::unique_ptr<VideoEncoderZstd> encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1));
+
+    std::unique_ptr<desktop::FrameSimple> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+    memset(frame->frameData(), 0x80, frame->stride() * kScreenSize.height());
+    *frame->updatedRegion() = QRect(QPoint(), kScreenSize);
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+    return packet;
+}
+
+} // namespace
+
+TEST(video_decoder, move_with_negative_size_is_rejected)
+{
+    std::unique_ptr<VideoDecoder> decoder =
+        VideoDecoder::create(proto::desktop::VIDEO_ENCODING_ZSTD);
+    ASSERT_TRUE(decoder);
+
+    std::unique_ptr<desktop::FrameSimple> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+
+    ASSERT_TRUE(decoder->decode(firstPacket(), frame.get()));
+
+    // QRect::contains() accepts these rectangles after the normalization.
+    const QRect source_rects[] = { QRect(20, 10, -10, 8), QRect(10, 20, 8, -10),
+                                   QRect(10, 10, 0, 8) };
+
+    for (const QRect& source_rect : source_rects)
+    {
+        proto::desktop::VideoPacket packet;
+
+        proto::desktop::VideoMoveRect* move_rect = packet.add_move_rect();
+        VideoUtil::toVideoRect(source_rect, move_rect->mutable_source_rect());
+        move_rect->set_target_x(30);
+        move_rect->set_target_y(20);
+
+        EXPECT_FALSE(decoder->decode(packet, frame.get()));
+    }
+}
+
+TEST(video_decoder, zstd_empty_rect_is_rejected)
+{
+    std::unique_ptr<VideoDecoder> decoder =
+        VideoDecoder::create(proto::desktop::VIDEO_ENCODING_ZSTD);
+    ASSERT_TRUE(decoder);
+
+    std::unique_ptr<desktop::FrameSimple> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+
+    const proto::desktop::VideoPacket first_packet = firstPacket();
+    ASSERT_TRUE(decoder->decode(first_packet, frame.get()));
+
+    const QRect rects[] = { QRect(10, 10, 0, 8), QRect(10, 10, 8, 0), QRect(20, 10, -10, 8) };
+
+    for (const QRect& rect : rects)
+    {
+        proto::desktop::VideoPacket packet;
+        packet.set_data(first_packet.data());
+        VideoUtil::toVideoRect(rect, packet.add_dirty_rect());
+
+        EXPECT_FALSE(decoder->decode(packet, frame.get()));
+    }
+}
+
+} // namespace codec
@@ -19,18 +19,69 @@
 #include "codec/video_decoder_zstd.h"
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "codec/pixel_translator.h"
 #include "codec/video_util.h"
-#include "desktop/desktop_frame_aligned.h"
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace codec {
 
+namespace {
+
+// Maximum number of persistent tile streams. The decoder keeps the window for each stream.
+const uint32_t kMaxPersistentStreams = 64;
+
+// The decompressed rows are translated in chunks of this size, so the pixels are translated while
+// they are in the cache.
+const size_t kChunkSize = 64 * 1024;
+
+// XORs |data| with |delta|.
+void xorRow(uint8_t* data, const uint8_t* delta, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t value;
+        uint64_t delta_value;
+
+        memcpy(&value, data + i, sizeof(value));
+        memcpy(&delta_value, delta + i, sizeof(delta_value));
+
+        value ^= delta_value;
+        memcpy(data + i, &value, sizeof(value));
+    }
+
+    for (; i < size; ++i)
+        data[i] ^= delta[i];
+}
+
+bool isSupportedPrediction(proto::desktop::VideoPrediction prediction)
+{
+    return prediction == proto::desktop::VIDEO_PREDICTION_NONE ||
+           prediction == proto::desktop::VIDEO_PREDICTION_XOR;
+}
+
+bool isPredicted(proto::desktop::VideoPrediction prediction)
+{
+    return prediction == proto::desktop::VIDEO_PREDICTION_XOR;
+}
+
+} // namespace
+
 VideoDecoderZstd::VideoDecoderZstd()
     : stream_(ZSTD_createDStream())
 {
     // Nothing
 }
 
+VideoDecoderZstd::~VideoDecoderZstd() = default;
+
 // static
 std::unique_ptr<VideoDecoderZstd> VideoDecoderZstd::create()
 {
@@ -44,11 +95,25 @@ bool VideoDecoderZstd::decode(const proto::desktop::VideoPacket& packet,
     {
         const proto::desktop::VideoPacketFormat& format = packet.format();
 
-        source_frame_ = desktop::FrameAligned::create(
+        // The previous frame is released first, so its buffer can be reused.
+        source_frame_.reset();
+        source_frame_ = desktop::FramePool::instance()->create(
             QSize(format.screen_rect().width(), format.screen_rect().height()),
-            VideoUtil::fromVideoPixelFormat(format.pixel_format()), 32);
+            VideoUtil::fromVideoPixelFormat(format.pixel_format()));
+        if (!source_frame_)
+            return false;
+
+        // The encoder predicts the first frame after a change of the format from zeros.
+        memset(source_frame_->frameData(), 0,
+               source_frame_->stride() * source_frame_->size().height());
 
         translator_ = PixelTranslator::create(source_frame_->format(), target_frame->format());
+
+        // The encoder starts new persistent streams after a change of the format.
+        size_t ret = ZSTD_initDStream(stream_.get());
+        DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+
+        persistent_streams_.clear();
     }
 
     DCHECK(source_frame_->size() == target_frame->size());
@@ -59,31 +124,220 @@ bool VideoDecoderZstd::decode(const proto::desktop::VideoPacket& packet,
         return false;
     }
 
-    size_t ret = ZSTD_initDStream(stream_.get());
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    if (!applyMoveRects(packet, target_frame))
+        return false;
+
+    // The source frame is kept equal to the encoder's reference frame for the prediction.
+    if (!applyMoveRects(packet, source_frame_.get()))
+        return false;
+
+    if (!isSupportedPrediction(packet.prediction()))
+    {
+        LOG(LS_WARNING) << "Unsupported prediction: " << packet.prediction();
+        return false;
+    }
+
+    row_size_ = source_frame_->size().width() * source_frame_->format().bytesPerPixel();
 
-    QRect frame_rect(QPoint(), source_frame_->size());
-    ZSTD_inBuffer input = { packet.data().data(), packet.data().size(), 0 };
+    const QRect frame_rect(QPoint(), source_frame_->size());
+
+    rects_.clear();
 
     for (int i = 0; i < packet.dirty_rect_size(); ++i)
     {
         QRect rect = VideoUtil::fromVideoRect(packet.dirty_rect(i));
 
+        // The sizes of the rows and of the chunks are calculated from the width.
+        if (rect.isEmpty())
+        {
+            LOG(LS_WARNING) << "Empty rectangle in the packet";
+            return false;
+        }
+
         if (!frame_rect.contains(rect))
         {
             LOG(LS_WARNING) << "The rectangle is outside the screen area";
             return false;
         }
 
+        rects_.push_back(rect);
+    }
+
+    if (packet.tile_size())
+        return decodeTiles(packet, target_frame);
+
+    if (row_buffers_.size() < row_size_)
+        row_buffers_.resize(row_size_);
+
+    return decompressRects(stream_.get(),
+                           packet.persistent_stream(),
+                           reinterpret_cast<const uint8_t*>(packet.data().data()),
+                           packet.data().size(),
+                           rects_.data(),
+                           static_cast<int>(rects_.size()),
+                           isPredicted(packet.prediction()) ? row_buffers_.data() : nullptr,
+                           target_frame);
+}
+
+bool VideoDecoderZstd::decodeTiles(const proto::desktop::VideoPacket& packet,
+                                   desktop::Frame* target_frame)
+{
+    const size_t data_size = packet.data().size();
+    size_t rect_count = 0;
+
+    for (int i = 0; i < packet.tile_size(); ++i)
+    {
+        const proto::desktop::VideoTile& tile = packet.tile(i);
+
+        if (tile.data_offset() > data_size || tile.data_size() > data_size - tile.data_offset())
+        {
+            LOG(LS_WARNING) << "The tile is outside the packet data";
+            return false;
+        }
+
+        if (!isSupportedPrediction(tile.prediction()))
+        {
+            LOG(LS_WARNING) << "Unsupported prediction: " << tile.prediction();
+            return false;
+        }
+
+        if (packet.persistent_stream() && tile.stream() >= kMaxPersistentStreams)
+        {
+            LOG(LS_WARNING) << "Invalid stream of the tile: " << tile.stream();
+            return false;
+        }
+
+        rect_count += tile.rect_count();
+    }
+
+    if (rect_count != rects_.size())
+    {
+        LOG(LS_WARNING) << "Invalid number of rectangles in the tiles";
+        return false;
+    }
+
+    if (!thread_pool_)
+    {
+        thread_pool_ = std::make_unique<base::ThreadPool>(0);
+
+        for (int i = 0; i < thread_pool_->threadCount(); ++i)
+            tile_streams_.emplace_back(ZSTD_createDStream());
+    }
+
+    const size_t row_buffers_size = row_size_ * thread_pool_->threadCount();
+    if (row_buffers_.size() < row_buffers_size)
+        row_buffers_.resize(row_buffers_size);
+
+    // Index of the first rectangle of each tile.
+    std::vector<int> first_rects(packet.tile_size());
+    for (int i = 1; i < packet.tile_size(); ++i)
+        first_rects[i] = first_rects[i - 1] + packet.tile(i - 1).rect_count();
+
+    if (packet.persistent_stream())
+        return decodePersistentTiles(packet, first_rects, target_frame);
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(packet.data().data());
+    std::atomic_bool result = true;
+
+    thread_pool_->parallelFor(packet.tile_size(), [&](int index, int thread_index)
+    {
+        const proto::desktop::VideoTile& tile = packet.tile(index);
+
+        if (!decompressRects(tile_streams_[thread_index].get(),
+                             false,
+                             data + tile.data_offset(),
+                             tile.data_size(),
+                             rects_.data() + first_rects[index],
+                             tile.rect_count(),
+                             isPredicted(tile.prediction()) ?
+                                 row_buffers_.data() + row_size_ * thread_index : nullptr,
+                             target_frame))
+        {
+            result = false;
+        }
+    });
+
+    return result;
+}
+
+//
+// The tiles of one persistent stream are decompressed in order on one thread.
+//
+bool VideoDecoderZstd::decodePersistentTiles(const proto::desktop::VideoPacket& packet,
+                                             const std::vector<int>& first_rects,
+                                             desktop::Frame* target_frame)
+{
+    uint32_t stream_count = 0;
+    for (int i = 0; i < packet.tile_size(); ++i)
+        stream_count = std::max(stream_count, packet.tile(i).stream() + 1);
+
+    // New streams are started by the encoder when they get the first tile.
+    while (persistent_streams_.size() < stream_count)
+        persistent_streams_.emplace_back(ZSTD_createDStream());
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(packet.data().data());
+    std::atomic_bool result = true;
+
+    thread_pool_->parallelFor(static_cast<int>(stream_count), [&](int stream_index,
+                                                                  int thread_index)
+    {
+        for (int index = 0; index < packet.tile_size() && result; ++index)
+        {
+            const proto::desktop::VideoTile& tile = packet.tile(index);
+            if (tile.stream() != static_cast<uint32_t>(stream_index))
+                continue;
+
+            if (!decompressRects(persistent_streams_[stream_index].get(),
+                                 true,
+                                 data + tile.data_offset(),
+                                 tile.data_size(),
+                                 rects_.data() + first_rects[index],
+                                 tile.rect_count(),
+                                 isPredicted(tile.prediction()) ?
+                                     row_buffers_.data() + row_size_ * thread_index : nullptr,
+                                 target_frame))
+            {
+                result = false;
+            }
+        }
+    });
+
+    return result;
+}
+
+bool VideoDecoderZstd::decompressRects(ZSTD_DStream* stream, bool persistent,
+                                       const uint8_t* data, size_t size,
+                                       const QRect* rects, int count, uint8_t* row_buffer,
+                                       desktop::Frame* target_frame)
+{
+    size_t ret;
+
+    if (!persistent)
+    {
+        ret = ZSTD_initDStream(stream);
+        DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    }
+
+    ZSTD_inBuffer input = { data, size, 0 };
+
+    for (int i = 0; i < count; ++i)
+    {
+        const QRect& rect = rects[i];
+
         uint8_t* output_data = source_frame_->frameDataAtPos(rect.x(), rect.y());
         const size_t output_size = rect.width() * source_frame_->format().bytesPerPixel();
 
-        ZSTD_outBuffer output = { output_data, output_size, 0 };
+        // The predicted rows are unpacked into the buffer and then applied to the frame.
+        ZSTD_outBuffer output = { row_buffer ? row_buffer : output_data, output_size, 0 };
+        const int chunk_rows = std::max(static_cast<int>(kChunkSize / output_size), 1);
         int row_y = 0;
+        int translated_y = 0;
 
         while (row_y < rect.height())
         {
-            ret = ZSTD_decompressStream(stream_.get(), &output, &input);
+            const size_t last_pos = output.pos;
+
+            ret = ZSTD_decompressStream(stream, &output, &input);
             if (ZSTD_isError(ret))
             {
                 LOG(LS_WARNING) << "ZSTD_decompressStream failed: " << ZSTD_getErrorName(ret);
@@ -93,19 +347,43 @@ bool VideoDecoderZstd::decode(const proto::desktop::VideoPacket& packet,
             // If we completely unpacked the row in the rectangle.
             if (output.pos == output.size)
             {
+                if (row_buffer)
+                    xorRow(output_data, row_buffer, output_size);
+
                 ++row_y;
                 output_data += source_frame_->stride();
-                output.dst = output_data;
+
+                if (!row_buffer)
+                    output.dst = output_data;
+
                 output.pos = 0;
+
+                if (row_y - translated_y == chunk_rows || row_y == rect.height())
+                {
+                    const QPoint top_left(rect.left(), rect.top() + translated_y);
+
+                    translator_->translate(source_frame_->frameDataAtPos(top_left),
+                                           source_frame_->stride(),
+                                           target_frame->frameDataAtPos(top_left),
+                                           target_frame->stride(),
+                                           rect.width(),
+                                           row_y - translated_y);
+                    translated_y = row_y;
+                }
+            }
+            else if (input.pos == input.size && output.pos == last_pos)
+            {
+                LOG(LS_WARNING) << "Not enough data for the rectangle";
+                return false;
             }
         }
+    }
 
-        translator_->translate(source_frame_->frameDataAtPos(rect.topLeft()),
-                               source_frame_->stride(),
-                               target_frame->frameDataAtPos(rect.topLeft()),
-                               target_frame->stride(),
-                               rect.width(),
-                               rect.height());
+    // The next packet continues the stream from the end of the data.
+    if (persistent && input.pos != input.size)
+    {
+        LOG(LS_WARNING) << "Unexpected data after the rectangles";
+        return false;
     }
 
     return true;
@@ -23,6 +23,14 @@
 #include "codec/scoped_zstd_stream.h"
 #include "codec/video_decoder.h"
 
+#include <QRect>
+
+#include <vector>
+
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace codec {
 
 class PixelTranslator;
@@ -30,7 +38,7 @@ class PixelTranslator;
 class VideoDecoderZstd : public VideoDecoder
 {
 public:
-    ~VideoDecoderZstd() = default;
+    ~VideoDecoderZstd();
 
     static std::unique_ptr<VideoDecoderZstd> create();
 
@@ -39,8 +47,31 @@ public:
 private:
     VideoDecoderZstd();
 
+    bool decodeTiles(const proto::desktop::VideoPacket& packet, desktop::Frame* target_frame);
+    bool decodePersistentTiles(const proto::desktop::VideoPacket& packet,
+                               const std::vector<int>& first_rects,
+                               desktop::Frame* target_frame);
+    // If |row_buffer| is not null, then the rectangles are XORed with the previous frame. If
+    // |persistent| is true, then the data continues the stream of the previous packet.
+    bool decompressRects(ZSTD_DStream* stream, bool persistent, const uint8_t* data, size_t size,
+                         const QRect* rects, int count, uint8_t* row_buffer,
+                         desktop::Frame* target_frame);
+
     ScopedZstdDStream stream_;
 
+    // The pool and the streams (one for each thread) for packets with tiles.
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+    std::vector<ScopedZstdDStream> tile_streams_;
+
+    // The persistent streams of the tiles (see VIDEO_FEATURE_ZSTD_CONTEXT).
+    std::vector<ScopedZstdDStream> persistent_streams_;
+
+    std::vector<QRect> rects_;
+
+    // Buffers for one row of the frame (one for each thread) to unpack the predicted rows.
+    std::vector<uint8_t> row_buffers_;
+    size_t row_size_ = 0;
+
     std::unique_ptr<PixelTranslator> translator_;
     std::unique_ptr<desktop::Frame> source_frame_;
 
@@ -18,24 +18,68 @@
 
 #include "codec/video_encoder.h"
 
+#include "codec/video_util.h"
 #include "desktop/desktop_frame.h"
 
 namespace codec {
 
+void VideoEncoder::setRateLimits(uint32_t /* bitrate */,
+                                 int /* min_quantizer */,
+                                 int /* max_quantizer */)
+{
+    // Nothing
+}
+
+bool VideoEncoder::hasRefinement() const
+{
+    return false;
+}
+
+uint32_t VideoEncoder::maxBitrate() const
+{
+    return 0;
+}
+
+void VideoEncoder::restart()
+{
+    restart_ = true;
+}
+
 void VideoEncoder::fillPacketInfo(proto::desktop::VideoEncoding encoding,
                                   const desktop::Frame* frame,
                                   proto::desktop::VideoPacket* packet)
+{
+    fillPacketInfo(encoding, QRect(frame->topLeft(), frame->size()), packet);
+}
+
+void VideoEncoder::fillPacketInfo(proto::desktop::VideoEncoding encoding,
+                                  const QRect& screen_rect,
+                                  proto::desktop::VideoPacket* packet)
 {
     packet->set_encoding(encoding);
 
-    if (screen_settings_tracker_.isRectChanged(QRect(frame->topLeft(), frame->size())))
+    if (screen_settings_tracker_.isRectChanged(screen_rect) || restart_)
     {
+        restart_ = false;
+
         proto::desktop::Rect* rect = packet->mutable_format()->mutable_screen_rect();
 
-        rect->set_x(frame->topLeft().x());
-        rect->set_y(frame->topLeft().y());
-        rect->set_width(frame->size().width());
-        rect->set_height(frame->size().height());
+        rect->set_x(screen_rect.x());
+        rect->set_y(screen_rect.y());
+        rect->set_width(screen_rect.width());
+        rect->set_height(screen_rect.height());
+    }
+}
+
+void VideoEncoder::fillMoveRects(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
+{
+    for (const auto& move : frame->constMoveList())
+    {
+        proto::desktop::VideoMoveRect* move_rect = packet->add_move_rect();
+
+        VideoUtil::toVideoRect(move.source_rect, move_rect->mutable_source_rect());
+        move_rect->set_target_x(move.target_pos.x());
+        move_rect->set_target_y(move.target_pos.y());
     }
 }
 
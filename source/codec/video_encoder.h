@@ -35,13 +35,37 @@ public:
 
     virtual void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) = 0;
 
+    // Sets the target bitrate in kilobits per second and the range of the quantizer (see
+    // RateController). Only the lossy encoders use them, the others ignore the call.
+    virtual void setRateLimits(uint32_t bitrate, int min_quantizer, int max_quantizer);
+
+    // Returns true if the encoder improves the areas that were encoded with losses when it gets
+    // the frames without changes. The frames are then encoded even if the screen is not changed.
+    virtual bool hasRefinement() const;
+
+    // Returns the highest bitrate in kilobits per second that is useful for the encoder, or 0 if
+    // it is not limited. The rate controller does not raise the bitrate above it.
+    virtual uint32_t maxBitrate() const;
+
+    // The next packet has the format and does not depend on the previous packets, as after a
+    // change of the screen. Used when the decoder is created again.
+    virtual void restart();
+
 protected:
     void fillPacketInfo(proto::desktop::VideoEncoding encoding,
                         const desktop::Frame* frame,
                         proto::desktop::VideoPacket* packet);
 
+    // |screen_rect| is the position and the size of the encoded image if it differs from the
+    // frame (for example, if the encoder scales the frame).
+    void fillPacketInfo(proto::desktop::VideoEncoding encoding,
+                        const QRect& screen_rect,
+                        proto::desktop::VideoPacket* packet);
+    void fillMoveRects(const desktop::Frame* frame, proto::desktop::VideoPacket* packet);
+
 private:
     desktop::ScreenSettingsTracker screen_settings_tracker_;
+    bool restart_ = false;
 };
 
 } // namespace codec
@@ -0,0 +1,192 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_encoder_hybrid.h"
+
+#include "base/logging.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
+
+namespace codec {
+
+namespace {
+
+int regionArea(const QRegion& region)
+{
+    int area = 0;
+
+    for (const auto& rect : region)
+        area += rect.width() * rect.height();
+
+    return area;
+}
+
+// Frame that uses the pixels of another frame with its own updated region and moves. Each
+// encoder of the parts gets only its areas.
+class FramePart : public desktop::Frame
+{
+public:
+    explicit FramePart(const desktop::Frame* frame)
+        : Frame(frame->size(), frame->format(), frame->stride(), frame->frameData())
+    {
+        setTopLeft(frame->topLeft());
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(FramePart);
+};
+
+void addPartRects(const QRegion& region, proto::desktop::VideoPart* part)
+{
+    for (const auto& rect : region)
+        VideoUtil::toVideoRect(rect, part->add_rect());
+}
+
+} // namespace
+
+VideoEncoderHybrid::VideoEncoderHybrid(std::unique_ptr<VideoEncoder> lossless_encoder,
+                                       std::unique_ptr<VideoEncoder> lossy_encoder)
+    : lossless_encoder_(std::move(lossless_encoder)),
+      lossy_encoder_(std::move(lossy_encoder))
+{
+    // Nothing
+}
+
+VideoEncoderHybrid::~VideoEncoderHybrid() = default;
+
+// static
+VideoEncoderHybrid* VideoEncoderHybrid::create(std::unique_ptr<VideoEncoder> lossless_encoder,
+                                               std::unique_ptr<VideoEncoder> lossy_encoder)
+{
+    if (!lossless_encoder || !lossy_encoder)
+    {
+        LOG(LS_WARNING) << "Unable to create the encoders of the parts";
+        return nullptr;
+    }
+
+    return new VideoEncoderHybrid(std::move(lossless_encoder), std::move(lossy_encoder));
+}
+
+void VideoEncoderHybrid::setRateLimits(uint32_t bitrate, int min_quantizer, int max_quantizer)
+{
+    lossy_encoder_->setRateLimits(bitrate, min_quantizer, max_quantizer);
+    refinement_budget_.setRateLimits(bitrate, max_quantizer);
+}
+
+bool VideoEncoderHybrid::hasRefinement() const
+{
+    return !lossy_state_.isEmpty() && refinement_budget_.area() > 0;
+}
+
+uint32_t VideoEncoderHybrid::maxBitrate() const
+{
+    // Only the lossy encoder follows the bitrate.
+    return lossy_encoder_->maxBitrate();
+}
+
+void VideoEncoderHybrid::applyMoves(const desktop::Frame* frame)
+{
+    for (const auto& move : frame->constMoveList())
+    {
+        const QRect target_rect(move.target_pos, move.source_rect.size());
+
+        // The target area gets the pixels of the source area with their losses.
+        const QRegion moved_state = lossy_state_.intersected(move.source_rect)
+            .translated(move.target_pos - move.source_rect.topLeft());
+
+        lossy_state_ = lossy_state_.subtracted(target_rect).united(moved_state);
+    }
+}
+
+QRegion VideoEncoderHybrid::refinementRegion(const QRegion& lossless_region) const
+{
+    if (lossy_state_.isEmpty())
+        return QRegion();
+
+    // The changes of the frame have priority over the refinement.
+    const int budget = refinement_budget_.area() - regionArea(lossless_region);
+    if (budget <= 0)
+        return QRegion();
+
+    QRegion stable_region = lossy_state_;
+
+    for (const auto& updated_region : recent_updates_)
+        stable_region = stable_region.subtracted(updated_region);
+
+    return RefinementBudget::limitRegion(stable_region, budget);
+}
+
+void VideoEncoderHybrid::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
+{
+    DCHECK_EQ(frame->format().bytesPerPixel(), 4);
+
+    fillPacketInfo(proto::desktop::VIDEO_ENCODING_HYBRID, frame, packet);
+    fillMoveRects(frame, packet);
+
+    if (packet->has_format())
+    {
+        // The client creates the decoders of the parts again. Their encoders may have the same
+        // screen as before (A -> B -> A) and would continue their streams.
+        lossless_encoder_->restart();
+        lossy_encoder_->restart();
+
+        // The client starts with an empty screen.
+        lossy_state_ = QRegion();
+
+        for (auto& updated_region : recent_updates_)
+            updated_region = QRegion();
+    }
+
+    QRegion lossless_region;
+    QRegion lossy_region;
+
+    classifier_.classify(frame, &lossless_region, &lossy_region);
+
+    applyMoves(frame);
+
+    recent_updates_[recent_index_] = frame->constUpdatedRegion();
+    recent_index_ = (recent_index_ + 1) % kRefinementDelay;
+
+    lossless_region += refinementRegion(lossless_region);
+
+    lossy_state_ = lossy_state_.subtracted(lossless_region).united(lossy_region);
+
+    if (!lossy_region.isEmpty())
+    {
+        // The lossy encoder gets no moves. It would encode the target areas of the moves.
+        FramePart lossy_frame(frame);
+        *lossy_frame.updatedRegion() = lossy_region;
+
+        proto::desktop::VideoPart* part = packet->add_part();
+        lossy_encoder_->encode(&lossy_frame, part->mutable_packet());
+        addPartRects(lossy_region, part);
+    }
+
+    if (!lossless_region.isEmpty() || !frame->constMoveList().isEmpty())
+    {
+        FramePart lossless_frame(frame);
+        *lossless_frame.updatedRegion() = lossless_region;
+        *lossless_frame.moveList() = frame->constMoveList();
+
+        proto::desktop::VideoPart* part = packet->add_part();
+        lossless_encoder_->encode(&lossless_frame, part->mutable_packet());
+        addPartRects(lossless_region, part);
+    }
+}
+
+} // namespace codec
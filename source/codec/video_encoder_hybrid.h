@@ -0,0 +1,83 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VIDEO_ENCODER_HYBRID_H
+#define CODEC__VIDEO_ENCODER_HYBRID_H
+
+#include "base/macros_magic.h"
+#include "codec/content_classifier.h"
+#include "codec/refinement_budget.h"
+#include "codec/video_encoder.h"
+
+#include <array>
+#include <memory>
+
+namespace codec {
+
+// Encodes the text and user interface without losses and the areas with video with a lossy
+// encoder (see VIDEO_ENCODING_HYBRID). The areas are selected by ContentClassifier.
+// The areas that were encoded with losses and then stopped changing are sent again without
+// losses, so the screen of the client becomes exact when the video is stopped.
+class VideoEncoderHybrid : public VideoEncoder
+{
+public:
+    ~VideoEncoderHybrid();
+
+    // |lossless_encoder| must transmit the moves (ZSTD or palette).
+    static VideoEncoderHybrid* create(std::unique_ptr<VideoEncoder> lossless_encoder,
+                                      std::unique_ptr<VideoEncoder> lossy_encoder);
+
+    void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
+    void setRateLimits(uint32_t bitrate, int min_quantizer, int max_quantizer) override;
+    bool hasRefinement() const override;
+    uint32_t maxBitrate() const override;
+
+private:
+    VideoEncoderHybrid(std::unique_ptr<VideoEncoder> lossless_encoder,
+                       std::unique_ptr<VideoEncoder> lossy_encoder);
+
+    // Updates |lossy_state_| after the moves of |frame|.
+    void applyMoves(const desktop::Frame* frame);
+
+    // Returns the areas that are encoded with losses on the client and were not changed in the
+    // last frames. The area is limited by |refinement_budget_|, so the refinement does not
+    // compete with the changes.
+    QRegion refinementRegion(const QRegion& lossless_region) const;
+
+    static const int kRefinementDelay = 8;
+
+    std::unique_ptr<VideoEncoder> lossless_encoder_;
+    std::unique_ptr<VideoEncoder> lossy_encoder_;
+
+    ContentClassifier classifier_;
+
+    // Areas of the screen of the client that were decoded with losses.
+    QRegion lossy_state_;
+
+    // Updated regions of the last frames.
+    std::array<QRegion, kRefinementDelay> recent_updates_;
+    int recent_index_ = 0;
+
+    RefinementBudget refinement_budget_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoEncoderHybrid);
+};
+
+} // namespace codec
+
+#endif // CODEC__VIDEO_ENCODER_HYBRID_H
@@ -0,0 +1,260 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder.h"
+#include "codec/video_encoder_hybrid.h"
+#include "codec/video_encoder_palette.h"
+#include "codec/video_encoder_zstd.h"
+#include "desktop/desktop_frame_simple.h"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <random>
+
+namespace codec {
+
+namespace {
+
+const QSize kScreenSize(640, 384);
+const QRect kVideoRect(128, 64, 256, 256);
+
+const int kVideoFrames = 12;
+const int kIdleFrames = 12;
+
+// Lossy encoder for the tests. Drops the low bits of the pixels and encodes the result without
+// losses.
+class QuantizingEncoder : public VideoEncoder
+{
+public:
+    QuantizingEncoder()
+        : encoder_(VideoEncoderPalette::create(desktop::PixelFormat::ARGB(), 1))
+    {
+        // Nothing
+    }
+
+    void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override
+    {
+        if (!quantized_frame_ || quantized_frame_->size() != frame->size())
+            quantized_frame_ = desktop::FrameSimple::create(frame->size(), frame->format());
+
+        for (const auto& rect : frame->constUpdatedRegion())
+        {
+            for (int y = rect.top(); y <= rect.bottom(); ++y)
+            {
+                const uint32_t* source =
+                    reinterpret_cast<const uint32_t*>(frame->frameDataAtPos(rect.left(), y));
+                uint32_t* target = reinterpret_cast<uint32_t*>(
+                    quantized_frame_->frameDataAtPos(rect.left(), y));
+
+                for (int x = 0; x < rect.width(); ++x)
+                    target[x] = source[x] & 0xFFF0F0F0;
+            }
+        }
+
+        *quantized_frame_->updatedRegion() = frame->constUpdatedRegion();
+        encoder_->encode(quantized_frame_.get(), packet);
+    }
+
+    void restart() override
+    {
+        encoder_->restart();
+    }
+
+private:
+    std::unique_ptr<VideoEncoderPalette> encoder_;
+    std::unique_ptr<desktop::FrameSimple> quantized_frame_;
+};
+
+bool isEqual(const desktop::Frame* frame1, const desktop::Frame* frame2)
+{
+    for (int y = 0; y < frame1->size().height(); ++y)
+    {
+        const uint32_t* row1 = reinterpret_cast<const uint32_t*>(frame1->frameDataAtPos(0, y));
+        const uint32_t* row2 = reinterpret_cast<const uint32_t*>(frame2->frameDataAtPos(0, y));
+
+        for (int x = 0; x < frame1->size().width(); ++x)
+        {
+            // The alpha channel is not used.
+            if ((row1[x] ^ row2[x]) & 0x00FFFFFF)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Draws the frame |index| of a moving gradient with noise like in a video.
+void drawVideo(desktop::Frame* frame, int index, std::mt19937& random)
+{
+    for (int y = kVideoRect.top(); y <= kVideoRect.bottom(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(kVideoRect.left(), y));
+
+        for (int x = 0; x < kVideoRect.width(); ++x)
+        {
+            row[x] = 0xFF000000 | (((x + index) & 0xFF) << 16) | ((y & 0xFF) << 8) |
+                (random() & 0x3F);
+        }
+    }
+
+    *frame->updatedRegion() += kVideoRect;
+}
+
+} // namespace
+
+TEST(video_encoder_hybrid, video_is_refined_when_stopped)
+{
+    std::unique_ptr<VideoEncoder> encoder(VideoEncoderHybrid::create(
+        std::unique_ptr<VideoEncoder>(VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1)),
+        std::make_unique<QuantizingEncoder>()));
+    ASSERT_TRUE(encoder);
+
+    std::unique_ptr<VideoDecoder> decoder =
+        VideoDecoder::create(proto::desktop::VIDEO_ENCODING_HYBRID);
+    ASSERT_TRUE(decoder);
+
+    std::unique_ptr<desktop::FrameSimple> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+    std::unique_ptr<desktop::FrameSimple> client_frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+
+    memset(frame->frameData(), 0x80, frame->stride() * kScreenSize.height());
+    *frame->updatedRegion() = QRect(QPoint(), kScreenSize);
+
+    std::mt19937 random(1);
+    bool had_losses = false;
+
+    for (int i = 0; i < kVideoFrames + kIdleFrames; ++i)
+    {
+        if (i > 0)
+            *frame->updatedRegion() = QRegion();
+
+        if (i < kVideoFrames)
+        {
+            drawVideo(frame.get(), i, random);
+        }
+
+        proto::desktop::VideoPacket packet;
+        encoder->encode(frame.get(), &packet);
+
+        ASSERT_TRUE(decoder->decode(packet, client_frame.get()));
+
+        if (i < kVideoFrames && !isEqual(frame.get(), client_frame.get()))
+            had_losses = true;
+    }
+
+    EXPECT_TRUE(had_losses);
+    EXPECT_TRUE(isEqual(frame.get(), client_frame.get()));
+}
+
+TEST(video_encoder_hybrid, refinement_is_paused_on_congestion)
+{
+    std::unique_ptr<VideoEncoder> encoder(VideoEncoderHybrid::create(
+        std::unique_ptr<VideoEncoder>(VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1)),
+        std::make_unique<QuantizingEncoder>()));
+    ASSERT_TRUE(encoder);
+
+    std::unique_ptr<VideoDecoder> decoder =
+        VideoDecoder::create(proto::desktop::VIDEO_ENCODING_HYBRID);
+    ASSERT_TRUE(decoder);
+
+    std::unique_ptr<desktop::FrameSimple> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+    std::unique_ptr<desktop::FrameSimple> client_frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+
+    memset(frame->frameData(), 0x80, frame->stride() * kScreenSize.height());
+    *frame->updatedRegion() = QRect(QPoint(), kScreenSize);
+
+    std::mt19937 random(1);
+
+    auto encodeFrames = [&](int count, bool video)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (video)
+                drawVideo(frame.get(), i, random);
+
+            proto::desktop::VideoPacket packet;
+            encoder->encode(frame.get(), &packet);
+
+            ASSERT_TRUE(decoder->decode(packet, client_frame.get()));
+            *frame->updatedRegion() = QRegion();
+        }
+    };
+
+    encoder->setRateLimits(1000, 20, 30);
+    encodeFrames(kVideoFrames, true);
+
+    // The rate controller lowers the bitrate when the network is congested.
+    encoder->setRateLimits(800, 25, 40);
+    encodeFrames(kIdleFrames, false);
+    EXPECT_FALSE(isEqual(frame.get(), client_frame.get()));
+
+    // The refinement is resumed when the rate is raised.
+    encoder->setRateLimits(900, 24, 38);
+    encodeFrames(kIdleFrames, false);
+    EXPECT_TRUE(isEqual(frame.get(), client_frame.get()));
+}
+
+TEST(video_encoder_hybrid, parts_restart_after_screen_is_changed_back)
+{
+    std::unique_ptr<VideoEncoder> encoder(VideoEncoderHybrid::create(
+        std::unique_ptr<VideoEncoder>(VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1)),
+        std::make_unique<QuantizingEncoder>()));
+    ASSERT_TRUE(encoder);
+
+    std::unique_ptr<VideoDecoder> decoder =
+        VideoDecoder::create(proto::desktop::VIDEO_ENCODING_HYBRID);
+    ASSERT_TRUE(decoder);
+
+    std::mt19937 random(1);
+
+    // The video is shown on the screen A, then the screen B without video is selected and then
+    // the screen A again.
+    const QSize screen_sizes[] = { kScreenSize, QSize(320, 192), kScreenSize };
+
+    for (size_t i = 0; i < std::size(screen_sizes); ++i)
+    {
+        const QSize& screen_size = screen_sizes[i];
+        const bool has_video = screen_size == kScreenSize;
+
+        std::unique_ptr<desktop::FrameSimple> frame =
+            desktop::FrameSimple::create(screen_size, desktop::PixelFormat::ARGB());
+        std::unique_ptr<desktop::FrameSimple> client_frame =
+            desktop::FrameSimple::create(screen_size, desktop::PixelFormat::ARGB());
+
+        memset(frame->frameData(), 0x80, frame->stride() * screen_size.height());
+        *frame->updatedRegion() = QRect(QPoint(), screen_size);
+
+        for (int j = 0; j < kVideoFrames; ++j)
+        {
+            if (has_video)
+                drawVideo(frame.get(), j, random);
+
+            proto::desktop::VideoPacket packet;
+            encoder->encode(frame.get(), &packet);
+
+            ASSERT_TRUE(decoder->decode(packet, client_frame.get())) << "screen " << i;
+            *frame->updatedRegion() = QRegion();
+        }
+    }
+}
+
+} // namespace codec
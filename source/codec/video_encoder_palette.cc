@@ -0,0 +1,409 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_encoder_palette.h"
+
+#include "base/logging.h"
+#include "codec/palette_tile.h"
+#include "codec/pixel_translator.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+const int kMaxTilePixels = kPaletteTileSize * kPaletteTileSize;
+
+// Hash table of the colors of a tile. The colors get the indices in the order of appearance.
+class ColorTable
+{
+public:
+    ColorTable() = default;
+
+    void clear()
+    {
+        memset(slots_, 0xFF, sizeof(slots_));
+        count_ = 0;
+    }
+
+    // Returns the index of |color|. If the color is new and the table is full, returns -1.
+    int indexOf(uint32_t color)
+    {
+        uint32_t slot = (color * 0x9E3779B1U) >> (32 - kSlotBits);
+
+        for (;;)
+        {
+            const int index = slots_[slot];
+
+            if (index < 0)
+            {
+                if (count_ == kMaxPaletteSize)
+                    return -1;
+
+                colors_[count_] = color;
+                slots_[slot] = static_cast<int16_t>(count_);
+                return count_++;
+            }
+
+            if (colors_[index] == color)
+                return index;
+
+            // The table is filled at most by a quarter, so a free slot is always found.
+            slot = (slot + 1) & (kSlotCount - 1);
+        }
+    }
+
+    int count() const { return count_; }
+    uint32_t color(int index) const { return colors_[index]; }
+
+private:
+    static const int kSlotBits = 10;
+    static const int kSlotCount = 1 << kSlotBits;
+
+    int16_t slots_[kSlotCount];
+    uint32_t colors_[kMaxPaletteSize];
+    int count_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(ColorTable);
+};
+
+size_t varintSize(uint32_t value)
+{
+    size_t size = 1;
+
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        ++size;
+    }
+
+    return size;
+}
+
+void appendVarint(uint32_t value, std::vector<uint8_t>* data)
+{
+    while (value >= 0x80)
+    {
+        data->push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    data->push_back(static_cast<uint8_t>(value));
+}
+
+size_t runSize(int run_length)
+{
+    return 1 + varintSize(run_length - 1);
+}
+
+// Builds the palette of |count| pixels and the index of each pixel. Returns the size of the
+// pixels in PALETTE_TILE_RLE or 0 if the pixels have more than kMaxPaletteSize colors.
+template <typename PixelType>
+size_t buildPalette(const uint8_t* pixels, int count, ColorTable* table, uint8_t* indices)
+{
+    const PixelType* src = reinterpret_cast<const PixelType*>(pixels);
+
+    table->clear();
+
+    PixelType previous = src[0];
+    int index = table->indexOf(previous);
+    int run_length = 0;
+    size_t rle_size = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        // The neighboring pixels are often equal, so the lookup is done only for a new color.
+        if (src[i] != previous)
+        {
+            index = table->indexOf(src[i]);
+            if (index < 0)
+                return 0;
+
+            rle_size += runSize(run_length);
+            run_length = 0;
+            previous = src[i];
+        }
+
+        indices[i] = static_cast<uint8_t>(index);
+        ++run_length;
+    }
+
+    return rle_size + runSize(run_length);
+}
+
+size_t buildPalette(const uint8_t* pixels, int count, int bytes_per_pixel,
+                    ColorTable* table, uint8_t* indices)
+{
+    switch (bytes_per_pixel)
+    {
+        case 4:
+            return buildPalette<uint32_t>(pixels, count, table, indices);
+
+        case 2:
+            return buildPalette<uint16_t>(pixels, count, table, indices);
+
+        case 1:
+            return buildPalette<uint8_t>(pixels, count, table, indices);
+
+        default:
+            NOTREACHED();
+            return 0;
+    }
+}
+
+void appendColor(uint32_t color, int bytes_per_pixel, std::vector<uint8_t>* data)
+{
+    // The colors are stored in the same byte order as the pixels.
+    uint8_t bytes[sizeof(uint32_t)];
+
+    switch (bytes_per_pixel)
+    {
+        case 4:
+            memcpy(bytes, &color, sizeof(uint32_t));
+            break;
+
+        case 2:
+        {
+            const uint16_t value = static_cast<uint16_t>(color);
+            memcpy(bytes, &value, sizeof(uint16_t));
+        }
+        break;
+
+        default:
+            bytes[0] = static_cast<uint8_t>(color);
+            break;
+    }
+
+    data->insert(data->end(), bytes, bytes + bytes_per_pixel);
+}
+
+void appendPalette(const ColorTable& table, int bytes_per_pixel, std::vector<uint8_t>* data)
+{
+    data->push_back(static_cast<uint8_t>(table.count() - 1));
+
+    for (int i = 0; i < table.count(); ++i)
+        appendColor(table.color(i), bytes_per_pixel, data);
+}
+
+void appendPackedIndices(const uint8_t* indices, int width, int height, int palette_size,
+                         std::vector<uint8_t>* data)
+{
+    const int bits = packedIndexBits(palette_size);
+    const int row_size = packedRowSize(width, palette_size);
+
+    size_t offset = data->size();
+    data->resize(offset + row_size * height);
+
+    for (int y = 0; y < height; ++y)
+    {
+        uint8_t* row = data->data() + offset;
+        int shift = 8;
+
+        memset(row, 0, row_size);
+
+        for (int x = 0; x < width; ++x)
+        {
+            shift -= bits;
+            *row |= static_cast<uint8_t>(indices[x] << shift);
+
+            if (!shift)
+            {
+                ++row;
+                shift = 8;
+            }
+        }
+
+        indices += width;
+        offset += row_size;
+    }
+}
+
+void appendRuns(const uint8_t* indices, int count, std::vector<uint8_t>* data)
+{
+    int i = 0;
+
+    while (i < count)
+    {
+        const uint8_t index = indices[i];
+        int run_length = 1;
+
+        while (i + run_length < count && indices[i + run_length] == index)
+            ++run_length;
+
+        data->push_back(index);
+        appendVarint(run_length - 1, data);
+
+        i += run_length;
+    }
+}
+
+} // namespace
+
+VideoEncoderPalette::VideoEncoderPalette(std::unique_ptr<PixelTranslator> translator,
+                                         const desktop::PixelFormat& target_format,
+                                         int compression_ratio)
+    : target_format_(target_format),
+      compress_ratio_(compression_ratio),
+      stream_(ZSTD_createCStream()),
+      translator_(std::move(translator)),
+      tile_pixels_(std::make_unique<uint8_t[]>(kMaxTilePixels * sizeof(uint32_t))),
+      tile_indices_(std::make_unique<uint8_t[]>(kMaxTilePixels))
+{
+    // Nothing
+}
+
+VideoEncoderPalette::~VideoEncoderPalette() = default;
+
+// static
+VideoEncoderPalette* VideoEncoderPalette::create(
+    const desktop::PixelFormat& target_format, int compression_ratio)
+{
+    if (compression_ratio > ZSTD_maxCLevel())
+        compression_ratio = ZSTD_maxCLevel();
+    else if (compression_ratio < 1)
+        compression_ratio = 1;
+
+    std::unique_ptr<PixelTranslator> translator =
+        PixelTranslator::create(desktop::PixelFormat::ARGB(), target_format);
+    if (!translator)
+    {
+        LOG(LS_WARNING) << "Unsupported pixel format";
+        return nullptr;
+    }
+
+    return new VideoEncoderPalette(std::move(translator), target_format, compression_ratio);
+}
+
+void VideoEncoderPalette::encodeTile(const desktop::Frame* frame, const QRect& tile)
+{
+    const int bytes_per_pixel = target_format_.bytesPerPixel();
+    const int width = tile.width();
+    const int height = tile.height();
+    const int pixel_count = width * height;
+    const size_t raw_size = pixel_count * bytes_per_pixel;
+
+    translator_->translate(frame->frameDataAtPos(tile.topLeft()), frame->stride(),
+                           tile_pixels_.get(), width * bytes_per_pixel,
+                           width, height);
+
+    ColorTable table;
+
+    const size_t rle_size = buildPalette(
+        tile_pixels_.get(), pixel_count, bytes_per_pixel, &table, tile_indices_.get());
+
+    // Photographic content has too many colors. The pixels are compressed by ZSTD only.
+    if (!rle_size)
+    {
+        tile_data_.push_back(PALETTE_TILE_RAW);
+        tile_data_.insert(tile_data_.end(), tile_pixels_.get(), tile_pixels_.get() + raw_size);
+        return;
+    }
+
+    const int palette_size = table.count();
+
+    if (palette_size == 1)
+    {
+        tile_data_.push_back(PALETTE_TILE_SOLID);
+        appendColor(table.color(0), bytes_per_pixel, &tile_data_);
+        return;
+    }
+
+    // The smallest representation is selected.
+    const size_t palette_bytes = 1 + palette_size * bytes_per_pixel;
+    const size_t runs_size = palette_bytes + rle_size;
+    size_t packed_size = SIZE_MAX;
+
+    if (palette_size <= kMaxPackedPaletteSize)
+        packed_size = palette_bytes + packedRowSize(width, palette_size) * height;
+
+    if (raw_size <= std::min(packed_size, runs_size))
+    {
+        tile_data_.push_back(PALETTE_TILE_RAW);
+        tile_data_.insert(tile_data_.end(), tile_pixels_.get(), tile_pixels_.get() + raw_size);
+    }
+    else if (packed_size <= runs_size)
+    {
+        tile_data_.push_back(PALETTE_TILE_PACKED);
+        appendPalette(table, bytes_per_pixel, &tile_data_);
+        appendPackedIndices(tile_indices_.get(), width, height, palette_size, &tile_data_);
+    }
+    else
+    {
+        tile_data_.push_back(PALETTE_TILE_RLE);
+        appendPalette(table, bytes_per_pixel, &tile_data_);
+        appendRuns(tile_indices_.get(), pixel_count, &tile_data_);
+    }
+}
+
+void VideoEncoderPalette::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
+{
+    fillPacketInfo(proto::desktop::VIDEO_ENCODING_PALETTE, frame, packet);
+
+    if (packet->has_format())
+    {
+        VideoUtil::toVideoPixelFormat(
+            target_format_, packet->mutable_format()->mutable_pixel_format());
+    }
+
+    fillMoveRects(frame, packet);
+
+    tile_data_.clear();
+
+    for (const auto& rect : frame->constUpdatedRegion())
+    {
+        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+
+        for (int y = rect.top(); y <= rect.bottom(); y += kPaletteTileSize)
+        {
+            const int height = std::min(kPaletteTileSize, rect.bottom() + 1 - y);
+
+            for (int x = rect.left(); x <= rect.right(); x += kPaletteTileSize)
+            {
+                const int width = std::min(kPaletteTileSize, rect.right() + 1 - x);
+                encodeTile(frame, QRect(x, y, width, height));
+            }
+        }
+    }
+
+    if (tile_data_.empty())
+        return;
+
+    packet->mutable_data()->resize(ZSTD_compressBound(tile_data_.size()));
+
+    const size_t ret = ZSTD_compressCCtx(stream_.get(),
+                                         packet->mutable_data()->data(),
+                                         packet->mutable_data()->size(),
+                                         tile_data_.data(),
+                                         tile_data_.size(),
+                                         compress_ratio_);
+    if (ZSTD_isError(ret))
+    {
+        LOG(LS_WARNING) << "ZSTD_compressCCtx failed: " << ZSTD_getErrorName(ret);
+        packet->clear_data();
+        return;
+    }
+
+    packet->mutable_data()->resize(ret);
+}
+
+} // namespace codec
@@ -0,0 +1,72 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VIDEO_ENCODER_PALETTE_H
+#define CODEC__VIDEO_ENCODER_PALETTE_H
+
+#include "base/macros_magic.h"
+#include "codec/scoped_zstd_stream.h"
+#include "codec/video_encoder.h"
+#include "desktop/pixel_format.h"
+
+#include <QRect>
+
+#include <vector>
+
+namespace codec {
+
+class PixelTranslator;
+
+// Lossless encoder for the screens with few colors (see VIDEO_ENCODING_PALETTE). The tiles with
+// up to 256 colors are stored as a palette with indices, the other tiles are stored as raw pixels
+// and compressed by ZSTD together with the rest of the packet.
+class VideoEncoderPalette : public VideoEncoder
+{
+public:
+    ~VideoEncoderPalette();
+
+    static VideoEncoderPalette* create(
+        const desktop::PixelFormat& target_format, int compression_ratio);
+
+    void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
+
+private:
+    VideoEncoderPalette(std::unique_ptr<PixelTranslator> translator,
+                        const desktop::PixelFormat& target_format,
+                        int compression_ratio);
+    void encodeTile(const desktop::Frame* frame, const QRect& tile);
+
+    // Client's pixel format
+    desktop::PixelFormat target_format_;
+    int compress_ratio_;
+    ScopedZstdCStream stream_;
+    std::unique_ptr<PixelTranslator> translator_;
+
+    // Translated pixels of the current tile and the palette indices of the pixels.
+    std::unique_ptr<uint8_t[]> tile_pixels_;
+    std::unique_ptr<uint8_t[]> tile_indices_;
+
+    // The tiles of the packet before the compression.
+    std::vector<uint8_t> tile_data_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoEncoderPalette);
+};
+
+} // namespace codec
+
+#endif // CODEC__VIDEO_ENCODER_PALETTE_H
@@ -0,0 +1,209 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder_palette.h"
+#include "codec/video_encoder_palette.h"
+#include "codec/pixel_translator.h"
+#include "desktop/desktop_frame_simple.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace codec {
+
+namespace {
+
+const QSize kScreenSize(300, 200);
+
+// Fills the frame with areas of different kinds: one color, few colors (like text), many colors
+// (like a photo).
+void generateFrame(desktop::Frame* frame)
+{
+    std::mt19937 random(1);
+
+    for (int y = 0; y < frame->size().height(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, y));
+
+        for (int x = 0; x < frame->size().width(); ++x)
+        {
+            if (x < 100)
+                row[x] = 0xFF336699;
+            else if (x < 130)
+                row[x] = (x + y) % 3 ? 0xFFFFFFFF : 0xFF000000;
+            else if (x < 200)
+                row[x] = 0xFF000000 | ((random() % 12) * 0x0A0B0C);
+            else
+                row[x] = static_cast<uint32_t>(random());
+        }
+    }
+}
+
+// Returns the frame as the client sees it after the translation to |format| and back.
+std::unique_ptr<desktop::Frame> expectedFrame(const desktop::Frame* frame,
+                                              const desktop::PixelFormat& format)
+{
+    const QSize& size = frame->size();
+    const int stride = size.width() * format.bytesPerPixel();
+
+    std::vector<uint8_t> buffer(stride * size.height());
+    std::unique_ptr<desktop::Frame> expected =
+        desktop::FrameSimple::create(size, desktop::PixelFormat::ARGB());
+
+    PixelTranslator::create(frame->format(), format)->translate(
+        frame->frameData(), frame->stride(), buffer.data(), stride,
+        size.width(), size.height());
+    PixelTranslator::create(format, expected->format())->translate(
+        buffer.data(), stride, expected->frameData(), expected->stride(),
+        size.width(), size.height());
+
+    return expected;
+}
+
+bool isEqual(const desktop::Frame* frame1, const desktop::Frame* frame2)
+{
+    for (int y = 0; y < frame1->size().height(); ++y)
+    {
+        if (memcmp(frame1->frameDataAtPos(0, y), frame2->frameDataAtPos(0, y),
+                   frame1->size().width() * frame1->format().bytesPerPixel()) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void testFormat(const desktop::PixelFormat& format)
+{
+    std::unique_ptr<desktop::Frame> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+    generateFrame(frame.get());
+
+    std::unique_ptr<desktop::Frame> decoded =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+
+    std::unique_ptr<VideoEncoderPalette> encoder(VideoEncoderPalette::create(format, 8));
+    std::unique_ptr<VideoDecoderPalette> decoder = VideoDecoderPalette::create();
+
+    ASSERT_TRUE(encoder);
+
+    // The full frame and then a few rectangles that are not aligned to the tiles.
+    *frame->updatedRegion() = QRect(QPoint(), kScreenSize);
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    EXPECT_EQ(packet.encoding(), proto::desktop::VIDEO_ENCODING_PALETTE);
+    ASSERT_TRUE(decoder->decode(packet, decoded.get()));
+    EXPECT_TRUE(isEqual(expectedFrame(frame.get(), format).get(), decoded.get()));
+
+    for (int x = 0; x < kScreenSize.width(); ++x)
+        *reinterpret_cast<uint32_t*>(frame->frameDataAtPos(x, x % kScreenSize.height())) ^= x;
+
+    *frame->updatedRegion() = QRegion(QRect(3, 5, 130, 71)) + QRect(150, 100, 150, 100);
+
+    packet.Clear();
+    encoder->encode(frame.get(), &packet);
+
+    EXPECT_FALSE(packet.has_format());
+    ASSERT_TRUE(decoder->decode(packet, decoded.get()));
+
+    // The rectangles are decoded, the rest of the frame has the old pixels.
+    std::unique_ptr<desktop::Frame> expected = expectedFrame(frame.get(), format);
+
+    for (const auto& rect : frame->constUpdatedRegion())
+    {
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            EXPECT_EQ(memcmp(expected->frameDataAtPos(rect.left(), y),
+                             decoded->frameDataAtPos(rect.left(), y),
+                             rect.width() * sizeof(uint32_t)), 0);
+        }
+    }
+}
+
+} // namespace
+
+TEST(video_encoder_palette, argb)
+{
+    testFormat(desktop::PixelFormat::ARGB());
+}
+
+TEST(video_encoder_palette, rgb565)
+{
+    testFormat(desktop::PixelFormat::RGB565());
+}
+
+TEST(video_encoder_palette, rgb332)
+{
+    testFormat(desktop::PixelFormat::RGB332());
+}
+
+TEST(video_encoder_palette, few_colors_are_compressed_better_than_raw_pixels)
+{
+    std::unique_ptr<desktop::Frame> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+    generateFrame(frame.get());
+
+    *frame->updatedRegion() = QRect(0, 0, 200, kScreenSize.height());
+
+    std::unique_ptr<VideoEncoderPalette> encoder(
+        VideoEncoderPalette::create(desktop::PixelFormat::ARGB(), 1));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    EXPECT_LT(packet.data().size(), 200 * kScreenSize.height() / 4);
+}
+
+TEST(video_encoder_palette, invalid_data)
+{
+    std::unique_ptr<desktop::Frame> frame =
+        desktop::FrameSimple::create(kScreenSize, desktop::PixelFormat::ARGB());
+    generateFrame(frame.get());
+
+    *frame->updatedRegion() = QRect(QPoint(), kScreenSize);
+
+    std::unique_ptr<VideoEncoderPalette> encoder(
+        VideoEncoderPalette::create(desktop::PixelFormat::ARGB(), 8));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    // The packet with the data for a smaller area.
+    proto::desktop::VideoPacket small_packet = packet;
+    small_packet.mutable_dirty_rect(0)->set_width(kScreenSize.width() - 1);
+    EXPECT_FALSE(VideoDecoderPalette::create()->decode(small_packet, frame.get()));
+
+    // The rectangles with empty and negative sizes.
+    for (int width : { 0, 2 - kScreenSize.width() })
+    {
+        proto::desktop::VideoPacket empty_packet = packet;
+        empty_packet.mutable_dirty_rect(0)->set_x(kScreenSize.width() - 1);
+        empty_packet.mutable_dirty_rect(0)->set_width(width);
+        EXPECT_FALSE(VideoDecoderPalette::create()->decode(empty_packet, frame.get()));
+    }
+
+    // The truncated data.
+    packet.mutable_data()->resize(packet.data().size() / 2);
+    EXPECT_FALSE(VideoDecoderPalette::create()->decode(packet, frame.get()));
+}
+
+} // namespace codec
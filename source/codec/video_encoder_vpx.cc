@@ -18,12 +18,16 @@
 
 #include "codec/video_encoder_vpx.h"
 
-#include <thread>
+#include <algorithm>
+#include <iterator>
 
 #include <libyuv/convert_from_argb.h>
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
+#include "codec/box_scaler.h"
 #include "codec/video_util.h"
+#include "codec/vpx_threading.h"
 #include "desktop/desktop_frame.h"
 
 namespace codec {
@@ -33,13 +37,25 @@ namespace {
 // Defines the dimension of a macro block. This is used to compute the active map for the encoder.
 const int kMacroBlockSize = 16;
 
+// Updates from this area (in pixels of the encoded image) are converted by several threads.
+const int kMinParallelArea = 256 * 256;
+
 // Magic encoder profile numbers for I444 input formats.
 const int kVp9I420ProfileNumber = 0;
 
 // Magic encoder constant for adaptive quantization strategy.
 const int kVp9AqModeCyclicRefresh = 3;
 
-void setCommonCodecParameters(vpx_codec_enc_cfg_t* config, const QSize& size)
+// The rate controller raises the bitrate up to this multiple of the default bitrate of the codec.
+// A higher bitrate improves the image little and only fills the network.
+const uint32_t kMaxBitrateMultiple = 2;
+
+// Quantizers of the steps of the refinement of the areas that stopped changing.
+const int kRefinementQuantizers[] = { 16, 8, 0 };
+
+void setCommonCodecParameters(vpx_codec_enc_cfg_t* config,
+                              const QSize& size,
+                              const VpxThreading& threading)
 {
     // Use millisecond granularity time base.
     config->g_timebase.num = 1;
@@ -58,11 +74,11 @@ void setCommonCodecParameters(vpx_codec_enc_cfg_t* config, const QSize& size)
     config->kf_min_dist = 10000;
     config->kf_max_dist = 10000;
 
-    // Using 2 threads gives a great boost in performance for most systems with
-    // adequate processing power. NB: Going to multiple threads on low end
-    // windows systems can really hurt performance.
+    // The number of threads depends on the size of the screen and on the share of the processor
+    // allowed in the settings of the host. NB: Going to multiple threads on low end windows
+    // systems can really hurt performance.
     // http://crbug.com/99179
-    config->g_threads = (std::thread::hardware_concurrency() > 2) ? 2 : 1;
+    config->g_threads = threading.threads;
 }
 
 void createImage(const QSize& size,
@@ -120,6 +136,16 @@ int roundToTwosMultiple(int x)
     return x & (~1);
 }
 
+QRect alignToMacroBlocks(const QRect& rect)
+{
+    const int left = rect.left() & ~(kMacroBlockSize - 1);
+    const int top = rect.top() & ~(kMacroBlockSize - 1);
+    const int right = (rect.right() | (kMacroBlockSize - 1)) + 1;
+    const int bottom = (rect.bottom() | (kMacroBlockSize - 1)) + 1;
+
+    return QRect(left, top, right - left, bottom - top);
+}
+
 QRect alignRect(const QRect& rect)
 {
     int x = roundToTwosMultiple(rect.left());
@@ -133,22 +159,140 @@ QRect alignRect(const QRect& rect)
 } // namespace
 
 // static
-VideoEncoderVPX* VideoEncoderVPX::createVP8()
+VideoEncoderVPX* VideoEncoderVPX::createVP8(int max_threads)
 {
-    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP8);
+    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP8, max_threads);
 }
 
 // static
-VideoEncoderVPX* VideoEncoderVPX::createVP9()
+VideoEncoderVPX* VideoEncoderVPX::createVP9(int max_threads)
 {
-    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP9);
+    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP9, max_threads);
 }
 
-VideoEncoderVPX::VideoEncoderVPX(proto::desktop::VideoEncoding encoding)
-    : encoding_(encoding)
+VideoEncoderVPX::VideoEncoderVPX(proto::desktop::VideoEncoding encoding, int max_threads)
+    : encoding_(encoding),
+      max_threads_(max_threads)
 {
+    memset(&config_, 0, sizeof(config_));
     memset(&active_map_, 0, sizeof(active_map_));
     memset(&image_, 0, sizeof(image_));
+
+    if (max_threads_ > 1)
+        thread_pool_ = std::make_unique<base::ThreadPool>(max_threads_);
+}
+
+VideoEncoderVPX::~VideoEncoderVPX() = default;
+
+void VideoEncoderVPX::setScaleReducer(const ScaleReducer* scale_reducer)
+{
+    scale_reducer_ = scale_reducer;
+}
+
+void VideoEncoderVPX::setRateLimits(uint32_t bitrate, int min_quantizer, int max_quantizer)
+{
+    bitrate_ = bitrate;
+    min_quantizer_ = min_quantizer;
+    max_quantizer_ = max_quantizer;
+
+    refinement_budget_.setRateLimits(bitrate, max_quantizer);
+
+    // If the codec is not created yet, the limits are applied after its creation.
+    if (codec_)
+        applyRateLimits();
+}
+
+bool VideoEncoderVPX::hasRefinement() const
+{
+    if (!codec_ || refinement_budget_.area() <= 0)
+        return false;
+
+    for (const auto& region : refinement_regions_)
+    {
+        if (!region.isEmpty())
+            return true;
+    }
+
+    return false;
+}
+
+uint32_t VideoEncoderVPX::maxBitrate() const
+{
+    return max_bitrate_;
+}
+
+void VideoEncoderVPX::applyRateLimits()
+{
+    config_.rc_target_bitrate = bitrate_;
+    config_.rc_min_quantizer = min_quantizer_;
+    config_.rc_max_quantizer = max_quantizer_;
+
+    vpx_codec_err_t ret = vpx_codec_enc_config_set(codec_.get(), &config_);
+    if (ret != VPX_CODEC_OK)
+        LOG(LS_WARNING) << "vpx_codec_enc_config_set failed: " << ret;
+
+    // The normal range of the quantizer is set again.
+    refinement_quantizer_ = -1;
+}
+
+void VideoEncoderVPX::setQuantizerRange(int min_quantizer, int max_quantizer)
+{
+    config_.rc_min_quantizer = min_quantizer;
+    config_.rc_max_quantizer = max_quantizer;
+
+    vpx_codec_err_t ret = vpx_codec_enc_config_set(codec_.get(), &config_);
+    if (ret != VPX_CODEC_OK)
+        LOG(LS_WARNING) << "vpx_codec_enc_config_set failed: " << ret;
+}
+
+void VideoEncoderVPX::updateRefinement(const QRegion& updated_region)
+{
+    recent_updates_[recent_index_] = updated_region;
+    recent_index_ = (recent_index_ + 1) % kRefinementDelay;
+
+    if (updated_region.isEmpty())
+        return;
+
+    // The changed areas are encoded with the normal quantizer and start the refinement again.
+    for (auto& region : refinement_regions_)
+        region = region.subtracted(updated_region);
+
+    refinement_regions_[0] += updated_region;
+}
+
+QRegion VideoEncoderVPX::takeRefinementRegion(int* quantizer)
+{
+    static_assert(std::size(kRefinementQuantizers) == kRefinementSteps);
+
+    const QRect image_rect(0, 0, image_->w, image_->h);
+
+    for (int step = 0; step < kRefinementSteps; ++step)
+    {
+        QRegion stable_region = refinement_regions_[step];
+
+        for (const auto& updated_region : recent_updates_)
+            stable_region = stable_region.subtracted(updated_region);
+
+        if (stable_region.isEmpty())
+            continue;
+
+        // The active map selects whole macroblocks.
+        QRegion region;
+        for (const auto& rect : RefinementBudget::limitRegion(stable_region,
+                                                              refinement_budget_.area()))
+        {
+            region += alignToMacroBlocks(rect).intersected(image_rect);
+        }
+
+        refinement_regions_[step] = refinement_regions_[step].subtracted(region);
+        if (step + 1 < kRefinementSteps)
+            refinement_regions_[step + 1] += region;
+
+        *quantizer = kRefinementQuantizers[step];
+        return region;
+    }
+
+    return QRegion();
 }
 
 void VideoEncoderVPX::createActiveMap(const QSize& size)
@@ -166,35 +310,41 @@ void VideoEncoderVPX::createVp8Codec(const QSize& size)
 {
     codec_.reset(new vpx_codec_ctx_t());
 
-    vpx_codec_enc_cfg_t config = { 0 };
+    memset(&config_, 0, sizeof(config_));
 
     // Configure the encoder.
     vpx_codec_iface_t* algo = vpx_codec_vp8_cx();
 
-    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config, 0);
+    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
     // Adjust default target bit-rate to account for actual desktop size.
-    config.rc_target_bitrate = size.width() * size.height() *
-        config.rc_target_bitrate / config.g_w / config.g_h;
+    config_.rc_target_bitrate = size.width() * size.height() *
+        config_.rc_target_bitrate / config_.g_w / config_.g_h;
 
-    setCommonCodecParameters(&config, size);
+    const VpxThreading threading = vpxThreading(size, max_threads_);
+
+    setCommonCodecParameters(&config_, size, threading);
 
     // Value of 2 means using the real time profile. This is basically a redundant option since we
     // explicitly select real time mode when doing encoding.
-    config.g_profile = 2;
+    config_.g_profile = 2;
 
     // Clamping the quantizer constrains the worst-case quality and CPU usage.
-    config.rc_min_quantizer = 20;
-    config.rc_max_quantizer = 30;
+    config_.rc_min_quantizer = 20;
+    config_.rc_max_quantizer = 30;
 
-    ret = vpx_codec_enc_init(codec_.get(), algo, &config, 0);
+    ret = vpx_codec_enc_init(codec_.get(), algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
     // Value of 16 will have the smallest CPU load. This turns off subpixel motion search.
     ret = vpx_codec_control(codec_.get(), VP8E_SET_CPUUSED, 16);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
+    // Each thread writes its own partitions of the tokens.
+    ret = vpx_codec_control(codec_.get(), VP8E_SET_TOKEN_PARTITIONS, threading.token_partitions);
+    DCHECK_EQ(VPX_CODEC_OK, ret);
+
     ret = vpx_codec_control(codec_.get(), VP8E_SET_SCREEN_CONTENT_MODE, 1);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
@@ -208,27 +358,29 @@ void VideoEncoderVPX::createVp9Codec(const QSize& size)
 {
     codec_.reset(new vpx_codec_ctx_t());
 
-    vpx_codec_enc_cfg_t config = { 0 };
+    memset(&config_, 0, sizeof(config_));
 
     // Configure the encoder.
     vpx_codec_iface_t* algo = vpx_codec_vp9_cx();
 
-    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config, 0);
+    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
-    setCommonCodecParameters(&config, size);
+    const VpxThreading threading = vpxThreading(size, max_threads_);
+
+    setCommonCodecParameters(&config_, size, threading);
 
     // Configure VP9 for I420 source frames.
-    config.g_profile = kVp9I420ProfileNumber;
-    config.rc_min_quantizer = 20;
-    config.rc_max_quantizer = 30;
-    config.rc_end_usage = VPX_CBR;
+    config_.g_profile = kVp9I420ProfileNumber;
+    config_.rc_min_quantizer = 20;
+    config_.rc_max_quantizer = 30;
+    config_.rc_end_usage = VPX_CBR;
 
-    // In the absence of a good bandwidth estimator set the target bitrate to a
-    // conservative default.
-    config.rc_target_bitrate = 500;
+    // Conservative default until the bitrate is set by the rate control of the session (see
+    // setRateLimits).
+    config_.rc_target_bitrate = 500;
 
-    ret = vpx_codec_enc_init(codec_.get(), algo, &config, 0);
+    ret = vpx_codec_enc_init(codec_.get(), algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
     // Request the lowest-CPU usage that VP9 supports, which depends on whether we are encoding
@@ -239,6 +391,14 @@ void VideoEncoderVPX::createVp9Codec(const QSize& size)
     ret = vpx_codec_control(codec_.get(), VP9E_SET_TUNE_CONTENT, VP9E_CONTENT_SCREEN);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
+    // The tile columns are encoded in parallel. Row based multithreading also splits the rows of
+    // the columns between the threads.
+    ret = vpx_codec_control(codec_.get(), VP9E_SET_TILE_COLUMNS, threading.tile_columns);
+    DCHECK_EQ(VPX_CODEC_OK, ret);
+
+    ret = vpx_codec_control(codec_.get(), VP9E_SET_ROW_MT, threading.row_mt ? 1U : 0U);
+    DCHECK_EQ(VPX_CODEC_OK, ret);
+
     // Use the lowest level of noise sensitivity so as to spend less time on motion estimation and
     // inter-prediction mode.
     ret = vpx_codec_control(codec_.get(), VP8E_SET_NOISE_SENSITIVITY, 0);
@@ -273,10 +433,26 @@ void VideoEncoderVPX::prepareImageAndActiveMap(
     const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
 {
     int padding = ((encoding_ == proto::desktop::VIDEO_ENCODING_VP9) ? 8 : 3);
+    const QSize image_size(image_->w, image_->h);
     QRegion updated_region;
+    QRegion frame_region = frame->constUpdatedRegion();
+
+    // The encoder does not transmit moves, so the target areas are encoded as changed.
+    for (const auto& move : frame->constMoveList())
+        frame_region += QRect(move.target_pos, move.source_rect.size());
 
-    for (const auto& rect : frame->constUpdatedRegion())
+    // The image is created again when the format is changed. The scaled size may change while the
+    // frame size is the same, so the whole frame is converted.
+    if (packet->has_format())
+        frame_region = QRect(QPoint(), frame->size());
+
+    for (const auto& source_rect : frame_region)
     {
+        QRect rect = source_rect;
+
+        if (image_size != frame->size())
+            rect = ScaleReducer::scaledRect(source_rect, frame->size(), image_size);
+
         // Pad each rectangle to avoid the block-artefact filters in libvpx from introducing
         // artefacts; VP9 includes up to 8px either side, and VP8 up to 3px, so unchanged pixels
         // up to that far out may still be affected by the changes in the updated region, and so
@@ -293,41 +469,89 @@ void VideoEncoderVPX::prepareImageAndActiveMap(
     // Clip back to the screen dimensions, in case they're not macroblock aligned. The conversion
     // routines don't require even width & height, so this is safe even if the source dimensions
     // are not even.
-    updated_region = updated_region.intersected(QRect(QPoint(), QSize(image_->w, image_->h)));
+    updated_region = updated_region.intersected(QRect(QPoint(), image_size));
+
+    updateRefinement(updated_region);
 
     memset(active_map_.active_map, 0, active_map_size_);
 
+    // The rectangles are converted by rows of macroblocks. The rows of large updates are
+    // distributed between the threads.
+    bands_.clear();
+    int area = 0;
+
+    for (const auto& rect : updated_region)
+    {
+        for (int top = rect.top(); top <= rect.bottom(); top += kMacroBlockSize)
+        {
+            bands_.emplace_back(rect.left(), top, rect.width(),
+                                std::min(kMacroBlockSize, rect.bottom() - top + 1));
+        }
+
+        area += rect.width() * rect.height();
+
+        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+        setActiveMap(rect);
+    }
+
+    const int band_count = static_cast<int>(bands_.size());
+
+    if (thread_pool_ && area >= kMinParallelArea)
+    {
+        thread_pool_->parallelFor(band_count, [&](int index, int /* thread_index */)
+        {
+            convertRect(frame, bands_[index]);
+        });
+    }
+    else
+    {
+        for (int index = 0; index < band_count; ++index)
+            convertRect(frame, bands_[index]);
+    }
+}
+
+void VideoEncoderVPX::convertRect(const desktop::Frame* frame, const QRect& rect)
+{
     int y_stride = image_->stride[0];
     int uv_stride = image_->stride[1];
     uint8_t* y_data = image_->planes[0];
     uint8_t* u_data = image_->planes[1];
     uint8_t* v_data = image_->planes[2];
 
-    for (const auto& rect : updated_region)
+    if (frame->size() != QSize(image_->w, image_->h))
     {
-        int y_offset = y_stride * rect.y() + rect.x();
-        int uv_offset = uv_stride * rect.y() / 2 + rect.x() / 2;
+        // The scaled frame is not stored: the source pixels are scaled directly to the planes.
+        scaleARGBToI420(frame->frameData(), frame->stride(), frame->size(),
+                        QSize(image_->w, image_->h), rect,
+                        y_data, y_stride,
+                        u_data, uv_stride,
+                        v_data, uv_stride);
+        return;
+    }
 
-        libyuv::ARGBToI420(frame->frameDataAtPos(rect.topLeft()),
-                           frame->stride(),
-                           y_data + y_offset, y_stride,
-                           u_data + uv_offset, uv_stride,
-                           v_data + uv_offset, uv_stride,
-                           rect.width(),
-                           rect.height());
+    int y_offset = y_stride * rect.y() + rect.x();
+    int uv_offset = uv_stride * rect.y() / 2 + rect.x() / 2;
 
-        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
-        setActiveMap(rect);
-    }
+    libyuv::ARGBToI420(frame->frameDataAtPos(rect.topLeft()),
+                       frame->stride(),
+                       y_data + y_offset, y_stride,
+                       u_data + uv_offset, uv_stride,
+                       v_data + uv_offset, uv_stride,
+                       rect.width(),
+                       rect.height());
 }
 
 void VideoEncoderVPX::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
 {
-    fillPacketInfo(encoding_, frame, packet);
+    QSize screen_size = frame->size();
+
+    if (scale_reducer_)
+        screen_size = scale_reducer_->scaledSize(screen_size);
+
+    fillPacketInfo(encoding_, QRect(frame->topLeft(), screen_size), packet);
 
     if (packet->has_format())
     {
-        const QSize& screen_size = frame->size();
 
         createImage(screen_size, &image_, &image_buffer_);
         createActiveMap(screen_size);
@@ -341,18 +565,79 @@ void VideoEncoderVPX::encode(const desktop::Frame* frame, proto::desktop::VideoP
             DCHECK_EQ(encoding_, proto::desktop::VIDEO_ENCODING_VP9);
             createVp9Codec(screen_size);
         }
+
+        max_bitrate_ = config_.rc_target_bitrate * kMaxBitrateMultiple;
+
+        refinement_quantizer_ = -1;
+
+        for (auto& region : refinement_regions_)
+            region = QRegion();
+
+        for (auto& updated_region : recent_updates_)
+            updated_region = QRegion();
+
+        if (bitrate_)
+            applyRateLimits();
+
+        start_time_ = std::chrono::steady_clock::now();
+        last_timestamp_ = -1;
     }
 
     // Convert the updated capture data ready for encode.
     // Update active map based on updated region.
     prepareImageAndActiveMap(frame, packet);
 
+    // The frames without changes refine the areas that stopped changing. The image already
+    // contains their pixels, only the quantizer is lower.
+    int quantizer = -1;
+
+    if (!packet->dirty_rect_size() && refinement_budget_.area() > 0)
+    {
+        for (const auto& rect : takeRefinementRegion(&quantizer))
+        {
+            VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+            setActiveMap(rect);
+        }
+    }
+
+    if (quantizer >= 0)
+    {
+        if (refinement_quantizer_ < 0)
+        {
+            normal_min_quantizer_ = config_.rc_min_quantizer;
+            normal_max_quantizer_ = config_.rc_max_quantizer;
+        }
+
+        setQuantizerRange(quantizer, quantizer);
+    }
+    else if (refinement_quantizer_ >= 0)
+    {
+        setQuantizerRange(normal_min_quantizer_, normal_max_quantizer_);
+    }
+
+    refinement_quantizer_ = quantizer;
+
+    // The frame without changes is not encoded if nothing is refined. The client does not get
+    // it, so the codec must not use it as a reference.
+    if (!packet->dirty_rect_size() && !packet->has_format() &&
+        frame->constUpdatedRegion().isEmpty() && frame->constMoveList().isEmpty())
+    {
+        return;
+    }
+
     // Apply active map to the encoder.
     vpx_codec_err_t ret = vpx_codec_control(codec_.get(), VP8E_SET_ACTIVEMAP, &active_map_);
     DCHECK_EQ(ret, VPX_CODEC_OK);
 
+    // The time base of the codec is 1 millisecond.
+    const int64_t timestamp = std::max(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time_).count(), last_timestamp_ + 1);
+    const unsigned long duration =
+        static_cast<unsigned long>(last_timestamp_ < 0 ? 1 : timestamp - last_timestamp_);
+    last_timestamp_ = timestamp;
+
     // Do the actual encoding.
-    ret = vpx_codec_encode(codec_.get(), image_.get(), 0, 1, 0, VPX_DL_REALTIME);
+    ret = vpx_codec_encode(codec_.get(), image_.get(), timestamp, duration, 0, VPX_DL_REALTIME);
     DCHECK_EQ(ret, VPX_CODEC_OK);
 
     // Read the encoded data.
@@ -24,23 +24,42 @@
 #include <vpx/vp8cx.h>
 
 #include "base/macros_magic.h"
+#include "codec/refinement_budget.h"
+#include "codec/scale_reducer.h"
 #include "codec/scoped_vpx_codec.h"
 #include "codec/video_encoder.h"
 
+#include <array>
+#include <chrono>
+#include <vector>
+
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace codec {
 
 class VideoEncoderVPX : public VideoEncoder
 {
 public:
-    ~VideoEncoderVPX() = default;
+    ~VideoEncoderVPX();
 
-    static VideoEncoderVPX* createVP8();
-    static VideoEncoderVPX* createVP9();
+    // |max_threads| limits the number of the encoding threads (see vpxThreadLimit).
+    static VideoEncoderVPX* createVP8(int max_threads);
+    static VideoEncoderVPX* createVP9(int max_threads);
 
     void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
+    void setRateLimits(uint32_t bitrate, int min_quantizer, int max_quantizer) override;
+    bool hasRefinement() const override;
+    uint32_t maxBitrate() const override;
+
+    // Scales the frames to the size selected by |scale_reducer| while they are converted to I420,
+    // so the frames need not be scaled by ScaleReducer before the encoder. The settings of
+    // |scale_reducer| may be changed between the frames.
+    void setScaleReducer(const ScaleReducer* scale_reducer);
 
 private:
-    VideoEncoderVPX(proto::desktop::VideoEncoding encoding);
+    VideoEncoderVPX(proto::desktop::VideoEncoding encoding, int max_threads);
 
     void createActiveMap(const QSize& size);
     void createVp8Codec(const QSize& size);
@@ -48,9 +67,63 @@ private:
     void prepareImageAndActiveMap(const desktop::Frame* frame, proto::desktop::VideoPacket* packet);
     void setActiveMap(const QRect& rect);
 
+    // Converts (and scales) the area |rect| of the image.
+    void convertRect(const desktop::Frame* frame, const QRect& rect);
+    void applyRateLimits();
+
+    // Adds the encoded areas |updated_region| to the areas that are refined later.
+    void updateRefinement(const QRegion& updated_region);
+
+    // Returns the areas that were not changed in the last frames and are encoded again with the
+    // quantizer |*quantizer| to reduce their losses.
+    QRegion takeRefinementRegion(int* quantizer);
+
+    // Sets the range of the quantizer of the codec for the next frame.
+    void setQuantizerRange(int min_quantizer, int max_quantizer);
+
+    static const int kRefinementSteps = 3;
+    static const int kRefinementDelay = 8;
+
     const proto::desktop::VideoEncoding encoding_;
+    const int max_threads_;
+
+    const ScaleReducer* scale_reducer_ = nullptr;
+
+    // Converts the large updates in parallel.
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+    std::vector<QRect> bands_;
 
     ScopedVpxCodec codec_ = nullptr;
+    vpx_codec_enc_cfg_t config_;
+
+    // Limits set by setRateLimits(). Zero bitrate means that the defaults of the codec are used.
+    uint32_t bitrate_ = 0;
+    int min_quantizer_ = 0;
+    int max_quantizer_ = 0;
+
+    // Highest bitrate for the size of the screen (a multiple of the default bitrate of the codec).
+    uint32_t max_bitrate_ = 0;
+
+    // Timestamps of the frames are passed to the codec, so the rate control of the codec knows
+    // the real frame rate.
+    std::chrono::steady_clock::time_point start_time_;
+    int64_t last_timestamp_ = 0;
+
+    // The areas of the image that are refined in the frames without changes. Each step lowers
+    // the quantizer of the areas, so the image of the client becomes close to the source when
+    // the screen is not changed. The index is the next step of the areas.
+    std::array<QRegion, kRefinementSteps> refinement_regions_;
+
+    // Updated regions of the last frames. The areas are refined when they stop changing.
+    std::array<QRegion, kRefinementDelay> recent_updates_;
+    int recent_index_ = 0;
+
+    RefinementBudget refinement_budget_;
+
+    // Quantizer of the last refinement frame or -1 if the codec uses the normal range.
+    int refinement_quantizer_ = -1;
+    int normal_min_quantizer_ = 0;
+    int normal_max_quantizer_ = 0;
 
     size_t active_map_size_ = 0;
 
@@ -19,14 +19,33 @@
 #include "codec/video_encoder_zstd.h"
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "codec/pixel_translator.h"
 #include "codec/video_util.h"
 #include "desktop/desktop_frame.h"
+#include "desktop/frame_pool.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace codec {
 
 namespace {
 
+// Maximum number of pixels in one tile. Smaller tiles are compressed worse, larger tiles give
+// fewer parallel tasks (a full update of a 1920x1080 screen is split into 32 tiles).
+const int kMaxTilePixels = 64 * 1024;
+
+// Window of the persistent stream. A window of 32 MB holds a full update of a 3840x2160 screen
+// in 32-bit format. Each tile stream gets a part of the screen, so its window is smaller (the
+// decoder allocates the window for each stream).
+const int kPersistentWindowLog = 25;
+const int kPersistentTileWindowLog = 23;
+
+// The rows of the rectangles are translated and compressed in chunks of this size, so the
+// translated pixels are compressed while they are in the cache.
+const size_t kChunkSize = 64 * 1024;
+
 // Retrieves a pointer to the output buffer in |update| used for storing the
 // encoded rectangle data. Will resize the buffer to |size|.
 uint8_t* outputBuffer(proto::desktop::VideoPacket* packet, size_t size)
@@ -35,6 +54,81 @@ uint8_t* outputBuffer(proto::desktop::VideoPacket* packet, size_t size)
     return reinterpret_cast<uint8_t*>(packet->mutable_data()->data());
 }
 
+// The prediction is selected by the compression of a sample of the data with and without it.
+// The sample consists of several chunks evenly spaced in the data.
+const size_t kSampleChunkSize = 4 * 1024;
+const int kSampleChunkCount = 4;
+const size_t kSampleSize = kSampleChunkSize * kSampleChunkCount;
+const int kSampleCompressionLevel = 1;
+
+// Two samples and the compressed sample.
+const size_t kSampleBufferSize = kSampleSize * 2 + ZSTD_COMPRESSBOUND(kSampleSize);
+
+// XORs |data| with |reference|.
+void xorRow(uint8_t* data, const uint8_t* reference, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t value;
+        uint64_t previous;
+
+        memcpy(&value, data + i, sizeof(value));
+        memcpy(&previous, reference + i, sizeof(previous));
+
+        value ^= previous;
+        memcpy(data + i, &value, sizeof(value));
+    }
+
+    for (; i < size; ++i)
+        data[i] ^= reference[i];
+}
+
+// Replaces |data| with the XOR of |data| and |reference| and stores the original |data| to
+// |reference|.
+void predictRow(uint8_t* data, uint8_t* reference, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t value;
+        uint64_t previous;
+
+        memcpy(&value, data + i, sizeof(value));
+        memcpy(&previous, reference + i, sizeof(previous));
+
+        previous ^= value;
+
+        memcpy(data + i, &previous, sizeof(previous));
+        memcpy(reference + i, &value, sizeof(value));
+    }
+
+    for (; i < size; ++i)
+    {
+        const uint8_t value = data[i];
+
+        data[i] ^= reference[i];
+        reference[i] = value;
+    }
+}
+
+void startStream(ZSTD_CStream* stream, int compression_ratio, int window_log)
+{
+    size_t ret = ZSTD_CCtx_reset(stream, ZSTD_reset_session_and_parameters);
+    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+
+    ret = ZSTD_CCtx_setParameter(stream, ZSTD_c_compressionLevel, compression_ratio);
+    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+
+    ret = ZSTD_CCtx_setParameter(stream, ZSTD_c_enableLongDistanceMatching, 1);
+    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+
+    ret = ZSTD_CCtx_setParameter(stream, ZSTD_c_windowLog, window_log);
+    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+}
+
 } // namespace
 
 VideoEncoderZstd::VideoEncoderZstd(std::unique_ptr<PixelTranslator> translator,
@@ -48,6 +142,8 @@ VideoEncoderZstd::VideoEncoderZstd(std::unique_ptr<PixelTranslator> translator,
     // Nothing
 }
 
+VideoEncoderZstd::~VideoEncoderZstd() = default;
+
 // static
 VideoEncoderZstd* VideoEncoderZstd::create(
     const desktop::PixelFormat& target_format, int compression_ratio)
@@ -68,36 +164,476 @@ VideoEncoderZstd* VideoEncoderZstd::create(
     return new VideoEncoderZstd(std::move(translator), target_format, compression_ratio);
 }
 
-void VideoEncoderZstd::compressPacket(proto::desktop::VideoPacket* packet,
-                                      const uint8_t* input_data,
-                                      size_t input_size)
+void VideoEncoderZstd::enableTiles(int thread_count)
 {
-    size_t ret = ZSTD_initCStream(stream_.get(), compress_ratio_);
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    thread_pool_ = std::make_unique<base::ThreadPool>(thread_count);
 
-    const size_t output_size = ZSTD_compressBound(input_size);
-    uint8_t* output_data = outputBuffer(packet, output_size);
+    tile_streams_.clear();
+    for (int i = 0; i < thread_pool_->threadCount(); ++i)
+        tile_streams_.emplace_back(ZSTD_createCStream());
+
+    // The buffers are allocated for the new number of threads.
+    sample_buffers_.reset();
+    sample_contexts_.clear();
+    chunk_buffers_.reset();
+    chunk_buffer_size_ = 0;
+
+    streams_started_ = false;
+}
+
+void VideoEncoderZstd::enablePrediction()
+{
+    prediction_enabled_ = true;
+}
+
+void VideoEncoderZstd::enablePersistentStreams()
+{
+    persistent_streams_ = true;
+    streams_started_ = false;
+}
+
+void VideoEncoderZstd::startStreams()
+{
+    startStream(stream_.get(), compress_ratio_, kPersistentWindowLog);
 
-    ZSTD_inBuffer input = { input_data, input_size, 0 };
+    for (auto& stream : tile_streams_)
+        startStream(stream.get(), compress_ratio_, kPersistentTileWindowLog);
+
+    streams_started_ = true;
+}
+
+//
+// Translates the rectangles in chunks of rows and compresses each chunk. If |predicted| is true,
+// then the chunks are XORed with the reference frame. The reference frame is updated with the
+// translated pixels. Returns the size of the compressed data. On error sets
+// |compression_failed_| and returns 0.
+//
+size_t VideoEncoderZstd::compressRects(ZSTD_CStream* stream,
+                                       uint8_t* chunk_buffer,
+                                       const desktop::Frame* frame,
+                                       const QRect* rects,
+                                       int count,
+                                       bool predicted,
+                                       uint8_t* output_data,
+                                       size_t output_size)
+{
+    ZSTD_EndDirective end_op = ZSTD_e_end;
+
+    if (persistent_streams_)
+    {
+        // Nothing to flush.
+        if (!count)
+            return 0;
+
+        // The stream is not finished, the next packets continue it.
+        end_op = ZSTD_e_flush;
+    }
+    else
+    {
+        size_t ret = ZSTD_initCStream(stream, compress_ratio_);
+        DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    }
+
+    const int bytes_per_pixel = target_format_.bytesPerPixel();
     ZSTD_outBuffer output = { output_data, output_size, 0 };
 
-    while (input.pos < input.size)
+    for (int i = 0; i < count; ++i)
     {
-        ret = ZSTD_compressStream(stream_.get(), &output, &input);
+        const QRect& rect = rects[i];
+        const size_t row_size = rect.width() * bytes_per_pixel;
+        const int chunk_rows = std::max(static_cast<int>(kChunkSize / row_size), 1);
+
+        for (int top = rect.top(); top <= rect.bottom(); top += chunk_rows)
+        {
+            const int rows = std::min(chunk_rows, rect.bottom() - top + 1);
+
+            translator_->translate(frame->frameDataAtPos(rect.left(), top),
+                                   frame->stride(),
+                                   chunk_buffer,
+                                   static_cast<int>(row_size),
+                                   rect.width(),
+                                   rows);
+
+            if (reference_frame_)
+            {
+                uint8_t* reference = reference_frame_->frameDataAtPos(rect.left(), top);
+                uint8_t* data = chunk_buffer;
+
+                for (int y = 0; y < rows; ++y)
+                {
+                    if (predicted)
+                        predictRow(data, reference, row_size);
+                    else
+                        memcpy(reference, data, row_size);
+
+                    data += row_size;
+                    reference += reference_frame_->stride();
+                }
+            }
+
+            ZSTD_inBuffer input = { chunk_buffer, row_size * rows, 0 };
+
+            while (input.pos < input.size)
+            {
+                const size_t ret = ZSTD_compressStream2(stream, &output, &input, ZSTD_e_continue);
+                if (ZSTD_isError(ret))
+                {
+                    LOG(LS_WARNING) << "ZSTD_compressStream2 failed: " << ZSTD_getErrorName(ret);
+                    compression_failed_ = true;
+                    return 0;
+                }
+
+                if (input.pos < input.size && output.pos == output.size)
+                {
+                    LOG(LS_WARNING) << "Not enough space for the compressed data";
+                    compression_failed_ = true;
+                    return 0;
+                }
+            }
+        }
+    }
+
+    ZSTD_inBuffer input = { nullptr, 0, 0 };
+
+    for (;;)
+    {
+        const size_t ret = ZSTD_compressStream2(stream, &output, &input, end_op);
         if (ZSTD_isError(ret))
         {
-            LOG(LS_WARNING) << "ZSTD_compressStream failed: " << ZSTD_getErrorName(ret);
+            LOG(LS_WARNING) << "ZSTD_compressStream2 failed: " << ZSTD_getErrorName(ret);
+            compression_failed_ = true;
+            return 0;
+        }
+
+        // All the data is compressed and flushed.
+        if (!ret)
+            break;
+
+        if (output.pos == output.size)
+        {
+            LOG(LS_WARNING) << "Not enough space for the compressed data";
+            compression_failed_ = true;
+            return 0;
+        }
+    }
+
+    return output.pos;
+}
+
+//
+// Splits the region into tiles of at most |kMaxTilePixels| pixels. Small rectangles are grouped
+// into one tile, large rectangles are cut into horizontal strips.
+//
+void VideoEncoderZstd::splitIntoTiles(const QRegion& region)
+{
+    const int bytes_per_pixel = target_format_.bytesPerPixel();
+
+    tile_rects_.clear();
+    tiles_.clear();
+
+    Tile tile;
+    int tile_pixels = 0;
+
+    for (const auto& rect : region)
+    {
+        const int strip_height = std::max(kMaxTilePixels / rect.width(), 1);
+
+        for (int top = rect.top(); top <= rect.bottom(); top += strip_height)
+        {
+            const QRect strip(rect.left(), top,
+                              rect.width(), std::min(strip_height, rect.bottom() - top + 1));
+            const int strip_pixels = strip.width() * strip.height();
+
+            if (tile_pixels && tile_pixels + strip_pixels > kMaxTilePixels)
+            {
+                tiles_.push_back(tile);
+
+                tile.first_rect = static_cast<int>(tile_rects_.size());
+                tile.rect_count = 0;
+                tile.input_size = 0;
+                tile_pixels = 0;
+            }
+
+            tile_rects_.push_back(strip);
+            ++tile.rect_count;
+            tile.input_size += static_cast<size_t>(strip_pixels) * bytes_per_pixel;
+            tile_pixels += strip_pixels;
+        }
+    }
+
+    if (tile.rect_count)
+        tiles_.push_back(tile);
+
+    size_t output_offset = 0;
+
+    for (auto& tile : tiles_)
+    {
+        tile.output_offset = output_offset;
+        output_offset += ZSTD_compressBound(tile.input_size);
+    }
+}
+
+//
+// Each tile is translated and compressed on its own thread into its own part of the packet
+// data. Then the compressed tiles are moved together. The tiles of one persistent stream are
+// compressed in order on one thread.
+//
+void VideoEncoderZstd::encodeTiles(const desktop::Frame* frame,
+                                   const QRegion& region,
+                                   proto::desktop::VideoPacket* packet)
+{
+    splitIntoTiles(region);
+    if (tiles_.empty())
+        return;
+
+    const Tile& last_tile = tiles_.back();
+
+    resizeChunkBuffers(frame->size().width());
+
+    uint8_t* output_data = outputBuffer(
+        packet, last_tile.output_offset + ZSTD_compressBound(last_tile.input_size));
+
+    const int tile_count = static_cast<int>(tiles_.size());
+    const int stream_count = static_cast<int>(tile_streams_.size());
+
+    if (persistent_streams_)
+    {
+        thread_pool_->parallelFor(stream_count, [&](int stream_index, int thread_index)
+        {
+            for (int index = stream_index; index < tile_count; index += stream_count)
+            {
+                encodeTile(frame, &tiles_[index], thread_index,
+                           tile_streams_[stream_index].get(), output_data);
+            }
+        });
+    }
+    else
+    {
+        thread_pool_->parallelFor(tile_count, [&](int index, int thread_index)
+        {
+            encodeTile(frame, &tiles_[index], thread_index,
+                       tile_streams_[thread_index].get(), output_data);
+        });
+    }
+
+    size_t data_size = 0;
+
+    for (int index = 0; index < tile_count; ++index)
+    {
+        const Tile& tile = tiles_[index];
+
+        // The compressed data is never larger than the bound, so a tile is moved only to the
+        // left and does not overwrite the tiles that have not been moved yet.
+        memmove(output_data + data_size, output_data + tile.output_offset, tile.output_size);
+
+        proto::desktop::VideoTile* video_tile = packet->add_tile();
+        video_tile->set_rect_count(tile.rect_count);
+        video_tile->set_data_offset(static_cast<uint32_t>(data_size));
+        video_tile->set_data_size(static_cast<uint32_t>(tile.output_size));
+
+        if (tile.predicted)
+            video_tile->set_prediction(proto::desktop::VIDEO_PREDICTION_XOR);
+
+        if (persistent_streams_)
+            video_tile->set_stream(index % stream_count);
+
+        data_size += tile.output_size;
+    }
+
+    packet->mutable_data()->resize(data_size);
+
+    for (const auto& rect : tile_rects_)
+        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+}
+
+void VideoEncoderZstd::encodeTile(const desktop::Frame* frame, Tile* tile, int thread_index,
+                                  ZSTD_CStream* stream, uint8_t* output_data)
+{
+    const QRect* rects = &tile_rects_[tile->first_rect];
+
+    // The rectangles do not intersect, so the tiles update different parts of the reference
+    // frame.
+    tile->predicted = reference_frame_ &&
+        selectPrediction(sample_contexts_[thread_index].get(),
+                         sample_buffers_.get() + kSampleBufferSize * thread_index,
+                         frame, rects, tile->rect_count, tile->input_size);
+
+    tile->output_size = compressRects(stream,
+                                      chunk_buffers_.get() + chunk_buffer_size_ * thread_index,
+                                      frame,
+                                      rects,
+                                      tile->rect_count,
+                                      tile->predicted,
+                                      output_data + tile->output_offset,
+                                      ZSTD_compressBound(tile->input_size));
+}
+
+//
+// Brings the reference frame to the state in which the client has the previous frame before
+// the rectangles of the packet are decoded.
+//
+void VideoEncoderZstd::updateReferenceFrame(const desktop::Frame* frame,
+                                            proto::desktop::VideoPacket* packet)
+{
+    // After a change of the format the client starts with a frame filled with zeros.
+    if (packet->has_format() || !reference_frame_)
+    {
+        reference_frame_.reset();
+        reference_frame_ = desktop::FramePool::instance()->create(frame->size(), target_format_);
+        if (!reference_frame_)
+        {
+            LOG(LS_WARNING) << "Failed to create reference frame, prediction disabled";
+            prediction_enabled_ = false;
             return;
         }
+
+        memset(reference_frame_->frameData(), 0,
+               reference_frame_->stride() * reference_frame_->size().height());
     }
 
-    ret = ZSTD_endStream(stream_.get(), &output);
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    if (!sample_buffers_)
+    {
+        const int thread_count = thread_pool_ ? thread_pool_->threadCount() : 1;
+        sample_buffers_ = std::make_unique<uint8_t[]>(kSampleBufferSize * thread_count);
+
+        for (int i = 0; i < thread_count; ++i)
+            sample_contexts_.emplace_back(ZSTD_createCStream());
+    }
 
-    packet->mutable_data()->resize(output.pos);
+    for (const auto& move : frame->constMoveList())
+        reference_frame_->moveRect(move.source_rect, move.target_pos);
+}
+
+//
+// Returns true if the rectangles should be XORed with the reference frame.
+// The prediction pays off if the rectangles contain many unchanged or slightly changed pixels.
+// But the moved or scrolled content becomes noise after the prediction, and text on a plain
+// background is compressed better without it. So the sample of the rectangles is compressed
+// (fast) in both ways and the smaller one is selected. The sample consists of several chunks of
+// rows evenly spaced in the translated data of |size| bytes.
+//
+bool VideoEncoderZstd::selectPrediction(ZSTD_CCtx* sample_context, uint8_t* sample_buffer,
+                                        const desktop::Frame* frame, const QRect* rects,
+                                        int count, size_t size)
+{
+    if (!size)
+        return false;
+
+    const int bytes_per_pixel = target_format_.bytesPerPixel();
+
+    uint8_t* raw_sample = sample_buffer;
+    uint8_t* predicted_sample = raw_sample + kSampleSize;
+    uint8_t* sample_output = predicted_sample + kSampleSize;
+    const size_t sample_output_size = ZSTD_compressBound(kSampleSize);
+
+    const int chunk_count = size <= kSampleSize ? 1 : kSampleChunkCount;
+    const size_t chunk_size = size <= kSampleSize ? size : kSampleChunkSize;
+
+    size_t sample_size = 0;
+
+    for (int chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        size_t offset = chunk_count > 1 ? (size - chunk_size) * chunk / (chunk_count - 1) : 0;
+
+        // Search for the row at the offset. The chunk starts from the beginning of the row.
+        int index = 0;
+        size_t rect_size = rects[0].width() * rects[0].height() * bytes_per_pixel;
+
+        while (offset >= rect_size)
+        {
+            offset -= rect_size;
+            ++index;
+            rect_size = rects[index].width() * rects[index].height() * bytes_per_pixel;
+        }
+
+        int row = static_cast<int>(offset / (rects[index].width() * bytes_per_pixel));
+        int pixels = static_cast<int>(chunk_size / bytes_per_pixel);
+
+        while (pixels > 0 && index < count)
+        {
+            const QRect& rect = rects[index];
+            const int width = std::min(rect.width(), pixels);
+            const size_t row_size = width * bytes_per_pixel;
+            const int y = rect.top() + row;
+
+            translator_->translate(frame->frameDataAtPos(rect.left(), y),
+                                   frame->stride(),
+                                   raw_sample + sample_size,
+                                   static_cast<int>(row_size),
+                                   width,
+                                   1);
+
+            memcpy(predicted_sample + sample_size, raw_sample + sample_size, row_size);
+            xorRow(predicted_sample + sample_size,
+                   reference_frame_->frameDataAtPos(rect.left(), y),
+                   row_size);
+
+            sample_size += row_size;
+            pixels -= width;
+
+            if (++row == rect.height())
+            {
+                row = 0;
+                ++index;
+            }
+        }
+    }
+
+    const size_t raw_size = ZSTD_compressCCtx(sample_context, sample_output, sample_output_size,
+                                              raw_sample, sample_size, kSampleCompressionLevel);
+    const size_t predicted_size = ZSTD_compressCCtx(sample_context, sample_output,
+                                                    sample_output_size, predicted_sample,
+                                                    sample_size, kSampleCompressionLevel);
+
+    return !ZSTD_isError(predicted_size) && (ZSTD_isError(raw_size) || predicted_size < raw_size);
+}
+
+void VideoEncoderZstd::resizeChunkBuffers(int frame_width)
+{
+    // A chunk holds at least one row of the frame.
+    const size_t size = std::max(
+        kChunkSize, static_cast<size_t>(frame_width) * target_format_.bytesPerPixel());
+
+    if (chunk_buffer_size_ < size)
+    {
+        const int thread_count = thread_pool_ ? thread_pool_->threadCount() : 1;
+
+        chunk_buffers_.reset(static_cast<uint8_t*>(base::alignedAlloc(size * thread_count, 32)));
+        chunk_buffer_size_ = size;
+    }
 }
 
 void VideoEncoderZstd::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
+{
+    compression_failed_ = false;
+
+    encodeRegion(frame, frame->constUpdatedRegion(), packet);
+    if (!compression_failed_)
+        return;
+
+    // The streams and the reference frame already contain the data that the client does not get,
+    // so the next packets would be decoded wrong. The whole frame is encoded again as a restart,
+    // which starts new streams and does not depend on the previous packets.
+    LOG(LS_WARNING) << "Compression failed, the encoder is restarted";
+
+    packet->Clear();
+    restart();
+    compression_failed_ = false;
+
+    encodeRegion(frame, QRect(QPoint(), frame->size()), packet);
+    if (!compression_failed_)
+        return;
+
+    // The client gets only the format and clears the screen. The next packet is a restart again.
+    packet->clear_dirty_rect();
+    packet->clear_tile();
+    packet->clear_data();
+    restart();
+}
+
+void VideoEncoderZstd::encodeRegion(const desktop::Frame* frame,
+                                    const QRegion& region,
+                                    proto::desktop::VideoPacket* packet)
 {
     fillPacketInfo(proto::desktop::VIDEO_ENCODING_ZSTD, frame, packet);
 
@@ -107,38 +643,54 @@ void VideoEncoderZstd::encode(const desktop::Frame* frame, proto::desktop::Video
             target_format_, packet->mutable_format()->mutable_pixel_format());
     }
 
-    size_t data_size = 0;
+    fillMoveRects(frame, packet);
 
-    for (const auto& rect : frame->constUpdatedRegion())
+    if (persistent_streams_)
     {
-        data_size += rect.width() * rect.height() * target_format_.bytesPerPixel();
-        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+        // After a change of the format the client starts new streams.
+        if (packet->has_format() || !streams_started_)
+            startStreams();
+
+        packet->set_persistent_stream(true);
     }
 
-    if (translate_buffer_size_ < data_size)
+    if (prediction_enabled_)
+        updateReferenceFrame(frame, packet);
+
+    if (thread_pool_)
     {
-        translate_buffer_.reset(static_cast<uint8_t*>(base::alignedAlloc(data_size, 32)));
-        translate_buffer_size_ = data_size;
+        encodeTiles(frame, region, packet);
+        return;
     }
 
-    uint8_t* translate_pos = translate_buffer_.get();
+    size_t data_size = 0;
 
-    for (const auto& rect : frame->constUpdatedRegion())
+    for (const auto& rect : region)
     {
-        const int stride = rect.width() * target_format_.bytesPerPixel();
+        data_size += rect.width() * rect.height() * target_format_.bytesPerPixel();
+        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+    }
 
-        translator_->translate(frame->frameDataAtPos(rect.topLeft()),
-                               frame->stride(),
-                               translate_pos,
-                               stride,
-                               rect.width(),
-                               rect.height());
+    resizeChunkBuffers(frame->size().width());
 
-        translate_pos += rect.height() * stride;
-    }
+    const bool predicted = reference_frame_ &&
+        selectPrediction(sample_contexts_[0].get(), sample_buffers_.get(),
+                         frame, region.begin(), region.rectCount(), data_size);
+    if (predicted)
+        packet->set_prediction(proto::desktop::VIDEO_PREDICTION_XOR);
+
+    const size_t output_size = ZSTD_compressBound(data_size);
+    uint8_t* output_data = outputBuffer(packet, output_size);
 
     // Compress data with using Zstd compressor.
-    compressPacket(packet, translate_buffer_.get(), data_size);
+    packet->mutable_data()->resize(compressRects(stream_.get(),
+                                                 chunk_buffers_.get(),
+                                                 frame,
+                                                 region.begin(),
+                                                 region.rectCount(),
+                                                 predicted,
+                                                 output_data,
+                                                 output_size));
 }
 
 } // namespace codec
@@ -24,6 +24,13 @@
 #include "codec/video_encoder.h"
 #include "desktop/pixel_format.h"
 
+#include <atomic>
+#include <vector>
+
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace codec {
 
 class PixelTranslator;
@@ -31,28 +38,108 @@ class PixelTranslator;
 class VideoEncoderZstd : public VideoEncoder
 {
 public:
-    ~VideoEncoderZstd() = default;
+    ~VideoEncoderZstd();
 
     static VideoEncoderZstd* create(
         const desktop::PixelFormat& target_format, int compression_ratio);
 
+    // Enables splitting of the updated region into tiles that are compressed independently on
+    // |thread_count| threads (see VIDEO_FEATURE_ZSTD_TILES). If |thread_count| is zero, then the
+    // number of threads is selected by the number of processor cores.
+    void enableTiles(int thread_count = 0);
+
+    // Enables XOR of the changed pixels with the previous frame before the compression (see
+    // VIDEO_FEATURE_ZSTD_PREDICTION). The unchanged pixels inside the changed rectangles become
+    // zeros and are compressed much better. The prediction is selected for each packet (or tile)
+    // by the content.
+    void enablePrediction();
+
+    // Keeps the compressed streams between the packets (see VIDEO_FEATURE_ZSTD_CONTEXT). The data
+    // of each packet (or tile) is flushed, but the stream is not finished, so the content of the
+    // previous packets is used for the matching. The long distance matching finds the content
+    // that appears again far back in the stream (for example, a window that was shown before).
+    void enablePersistentStreams();
+
     void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
 
 private:
+    struct Tile
+    {
+        // Range of the rectangles in |tile_rects_|.
+        int first_rect = 0;
+        int rect_count = 0;
+
+        // Size of the translated data.
+        size_t input_size = 0;
+
+        // Position of the compressed data in the packet.
+        size_t output_offset = 0;
+        size_t output_size = 0;
+
+        // True if the tile data is XORed with the previous frame.
+        bool predicted = false;
+    };
+
     VideoEncoderZstd(std::unique_ptr<PixelTranslator> translator,
                      const desktop::PixelFormat& target_format,
                      int compression_ratio);
-    void compressPacket(proto::desktop::VideoPacket* packet,
-                        const uint8_t* input_data,
-                        size_t input_size);
+    size_t compressRects(ZSTD_CStream* stream,
+                         uint8_t* chunk_buffer,
+                         const desktop::Frame* frame,
+                         const QRect* rects,
+                         int count,
+                         bool predicted,
+                         uint8_t* output_data,
+                         size_t output_size);
+    void splitIntoTiles(const QRegion& region);
+    void encodeRegion(const desktop::Frame* frame,
+                      const QRegion& region,
+                      proto::desktop::VideoPacket* packet);
+    void encodeTiles(const desktop::Frame* frame,
+                     const QRegion& region,
+                     proto::desktop::VideoPacket* packet);
+    void encodeTile(const desktop::Frame* frame, Tile* tile, int thread_index,
+                    ZSTD_CStream* stream, uint8_t* output_data);
+    void startStreams();
+    void updateReferenceFrame(const desktop::Frame* frame, proto::desktop::VideoPacket* packet);
+    bool selectPrediction(ZSTD_CCtx* sample_context, uint8_t* sample_buffer,
+                          const desktop::Frame* frame, const QRect* rects, int count,
+                          size_t size);
+    void resizeChunkBuffers(int frame_width);
 
     // Client's pixel format
     desktop::PixelFormat target_format_;
     int compress_ratio_;
     ScopedZstdCStream stream_;
     std::unique_ptr<PixelTranslator> translator_;
-    std::unique_ptr<uint8_t[], base::AlignedFreeDeleter> translate_buffer_;
-    size_t translate_buffer_size_ = 0;
+
+    // Buffers for the translated chunks of rows (one for each thread).
+    std::unique_ptr<uint8_t[], base::AlignedFreeDeleter> chunk_buffers_;
+    size_t chunk_buffer_size_ = 0;
+
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+
+    // One stream for each thread of the pool. The persistent streams are assigned to the tiles
+    // in turn.
+    std::vector<ScopedZstdCStream> tile_streams_;
+
+    bool persistent_streams_ = false;
+    bool streams_started_ = false;
+
+    // Set if the compression of the packet (or of any of its tiles) failed.
+    std::atomic_bool compression_failed_ { false };
+
+    std::vector<QRect> tile_rects_;
+    std::vector<Tile> tiles_;
+
+    // The previous frame in the client's pixel format (as the client has it).
+    bool prediction_enabled_ = false;
+    std::unique_ptr<desktop::Frame> reference_frame_;
+
+    // Buffers and contexts to select the prediction (one for each thread). The contexts are
+    // separate from the streams, which may keep the previous packets.
+    std::unique_ptr<uint8_t[]> sample_buffers_;
+    std::vector<ScopedZstdCStream> sample_contexts_;
 
     DISALLOW_COPY_AND_ASSIGN(VideoEncoderZstd);
 };
@@ -0,0 +1,80 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/vpx_threading.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace codec {
+
+namespace {
+
+// Each thread gets at least this number of pixels.
+const int kMinPixelsPerThread = 640 * 360;
+
+// VP9 tile columns must be at least 256 pixels wide. More than 64 (2^6) columns are not allowed.
+const int kMinTileWidth = 256;
+const int kMaxLog2TileColumns = 6;
+
+// VP8 supports up to 8 (2^3) token partitions.
+const int kMaxLog2TokenPartitions = 3;
+
+// Returns the largest |n| for which 2^n <= |value|.
+int floorLog2(int value)
+{
+    int result = 0;
+
+    while (value >>= 1)
+        ++result;
+
+    return result;
+}
+
+} // namespace
+
+int vpxThreadLimit(int cpu_budget)
+{
+    const int core_count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    return std::max(core_count * std::clamp(cpu_budget, 0, 100) / 100, 1);
+}
+
+VpxThreading vpxThreading(const QSize& size, int max_threads)
+{
+    VpxThreading threading;
+
+    const int pixels = size.width() * size.height();
+
+    threading.threads = std::clamp(pixels / kMinPixelsPerThread, 1, std::max(max_threads, 1));
+    if (threading.threads == 1)
+        return threading;
+
+    // Each thread encodes its own tile columns. Row based multithreading lets the threads share
+    // the columns if there are fewer columns than threads.
+    const int max_tile_columns = std::min(floorLog2(std::max(size.width() / kMinTileWidth, 1)),
+                                          kMaxLog2TileColumns);
+
+    threading.tile_columns = std::min(floorLog2(threading.threads), max_tile_columns);
+    threading.row_mt = true;
+
+    threading.token_partitions = std::min(floorLog2(threading.threads), kMaxLog2TokenPartitions);
+
+    return threading;
+}
+
+} // namespace codec
@@ -0,0 +1,51 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VPX_THREADING_H
+#define CODEC__VPX_THREADING_H
+
+#include <QSize>
+
+namespace codec {
+
+// Threading parameters of the VPX encoders.
+struct VpxThreading
+{
+    // Value of g_threads.
+    int threads = 1;
+
+    // VP9 only: log2 of the number of tile columns (VP9E_SET_TILE_COLUMNS) and the row based
+    // multithreading (VP9E_SET_ROW_MT).
+    int tile_columns = 0;
+    bool row_mt = false;
+
+    // VP8 only: log2 of the number of token partitions (VP8E_SET_TOKEN_PARTITIONS).
+    int token_partitions = 0;
+};
+
+// Returns the number of threads that the encoder may use with |cpu_budget| percent of the
+// processor cores.
+int vpxThreadLimit(int cpu_budget);
+
+// Returns the threading parameters for the screen of |size|. Small screens use fewer threads,
+// since the synchronization of the threads costs more than it saves.
+VpxThreading vpxThreading(const QSize& size, int max_threads);
+
+} // namespace codec
+
+#endif // CODEC__VPX_THREADING_H
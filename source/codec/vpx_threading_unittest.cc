@@ -0,0 +1,69 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/vpx_threading.h"
+
+#include <gtest/gtest.h>
+
+namespace codec {
+
+TEST(vpx_threading, small_screen_uses_one_thread)
+{
+    VpxThreading threading = vpxThreading(QSize(640, 480), 8);
+
+    EXPECT_EQ(threading.threads, 1);
+    EXPECT_EQ(threading.tile_columns, 0);
+    EXPECT_FALSE(threading.row_mt);
+    EXPECT_EQ(threading.token_partitions, 0);
+}
+
+TEST(vpx_threading, threads_are_limited)
+{
+    for (int max_threads = 1; max_threads <= 16; ++max_threads)
+    {
+        VpxThreading threading = vpxThreading(QSize(3840, 2160), max_threads);
+        EXPECT_EQ(threading.threads, max_threads);
+    }
+
+    EXPECT_EQ(vpxThreading(QSize(1920, 1080), 0).threads, 1);
+}
+
+TEST(vpx_threading, tile_columns_fit_width)
+{
+    VpxThreading threading = vpxThreading(QSize(1920, 1080), 8);
+
+    // 1920 pixels fit 4 columns of at least 256 pixels.
+    EXPECT_EQ(threading.threads, 8);
+    EXPECT_EQ(threading.tile_columns, 2);
+    EXPECT_TRUE(threading.row_mt);
+    EXPECT_EQ(threading.token_partitions, 3);
+
+    threading = vpxThreading(QSize(3840, 2160), 4);
+
+    EXPECT_EQ(threading.tile_columns, 2);
+    EXPECT_EQ(threading.token_partitions, 2);
+}
+
+TEST(vpx_threading, thread_limit)
+{
+    EXPECT_GE(vpxThreadLimit(0), 1);
+    EXPECT_GE(vpxThreadLimit(100), vpxThreadLimit(50));
+    EXPECT_EQ(vpxThreadLimit(200), vpxThreadLimit(100));
+}
+
+} // namespace codec
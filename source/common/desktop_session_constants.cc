@@ -27,6 +27,10 @@ const char kPowerControlExtension[] = "power_control";
 const char kRemoteUpdateExtension[] = "remote_update";
 const char kSystemInfoExtension[] = "system_info";
 
+// The extension is sent by the host service to the session process and is not announced to the
+// client.
+const char kNetworkFeedbackExtension[] = "network_feedback";
+
 const char kSupportedExtensionsForManage[] =
     "select_screen;power_control;remote_update;system_info";
 
@@ -35,6 +39,12 @@ const char kSupportedExtensionsForView[] =
 
 const uint32_t kSupportedVideoEncodings =
     proto::desktop::VIDEO_ENCODING_VP8 | proto::desktop::VIDEO_ENCODING_VP9 |
-    proto::desktop::VIDEO_ENCODING_ZSTD;
+    proto::desktop::VIDEO_ENCODING_ZSTD | proto::desktop::VIDEO_ENCODING_PALETTE |
+    proto::desktop::VIDEO_ENCODING_HYBRID;
+
+const uint32_t kSupportedVideoFeatures =
+    proto::desktop::VIDEO_FEATURE_MOVE_RECT | proto::desktop::VIDEO_FEATURE_ZSTD_TILES |
+    proto::desktop::VIDEO_FEATURE_ZSTD_PREDICTION | proto::desktop::VIDEO_FEATURE_ZSTD_CONTEXT |
+    proto::desktop::VIDEO_FEATURE_ADAPTIVE_SCALE | proto::desktop::VIDEO_FEATURE_SCREEN_STREAMS;
 
 } // namespace common
@@ -27,11 +27,13 @@ extern const char kSelectScreenExtension[];
 extern const char kPowerControlExtension[];
 extern const char kRemoteUpdateExtension[];
 extern const char kSystemInfoExtension[];
+extern const char kNetworkFeedbackExtension[];
 
 extern const char kSupportedExtensionsForManage[];
 extern const char kSupportedExtensionsForView[];
 
 extern const uint32_t kSupportedVideoEncodings;
+extern const uint32_t kSupportedVideoFeatures;
 
 } // namespace common
 
@@ -55,6 +55,8 @@ void ComputerDialogDesktop::restoreSettings(
     combo_codec->addItem(QLatin1String("VP9"), proto::desktop::VIDEO_ENCODING_VP9);
     combo_codec->addItem(QLatin1String("VP8"), proto::desktop::VIDEO_ENCODING_VP8);
     combo_codec->addItem(QLatin1String("ZSTD"), proto::desktop::VIDEO_ENCODING_ZSTD);
+    combo_codec->addItem(QLatin1String("Palette"), proto::desktop::VIDEO_ENCODING_PALETTE);
+    combo_codec->addItem(QLatin1String("Hybrid"), proto::desktop::VIDEO_ENCODING_HYBRID);
 
     QComboBox* combo_color_depth = ui.combo_color_depth;
     combo_color_depth->addItem(tr("True color (32 bit)"), COLOR_DEPTH_ARGB);
@@ -130,7 +132,9 @@ void ComputerDialogDesktop::saveSettings(proto::desktop::Config* config)
 
     config->set_video_encoding(video_encoding);
 
-    if (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD)
+    if (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD ||
+        video_encoding == proto::desktop::VIDEO_ENCODING_PALETTE ||
+        video_encoding == proto::desktop::VIDEO_ENCODING_HYBRID)
     {
         desktop::PixelFormat pixel_format;
 
@@ -191,8 +195,10 @@ void ComputerDialogDesktop::saveSettings(proto::desktop::Config* config)
 
 void ComputerDialogDesktop::onCodecChanged(int item_index)
 {
-    bool has_pixel_format =
-        (ui.combo_codec->itemData(item_index).toInt() == proto::desktop::VIDEO_ENCODING_ZSTD);
+    const int video_encoding = ui.combo_codec->itemData(item_index).toInt();
+    bool has_pixel_format = (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD ||
+                             video_encoding == proto::desktop::VIDEO_ENCODING_PALETTE ||
+                             video_encoding == proto::desktop::VIDEO_ENCODING_HYBRID);
 
     ui.label_color_depth->setEnabled(has_pixel_format);
     ui.combo_color_depth->setEnabled(has_pixel_format);
@@ -18,33 +18,95 @@
 
 #include "desktop/capture_scheduler.h"
 
+#include <algorithm>
+
 namespace desktop {
 
+namespace {
+
+// Maximum interval between the captures when the screen does not change. The first change after
+// an idle period (for example, the echo of a key press) is delayed no more than this, so the
+// interval stays within a few frames.
+constexpr std::chrono::milliseconds kMaxIdleInterval(60);
+
+// Maximum time the unsent data may take to be sent before capturing is paused.
+constexpr std::chrono::milliseconds kLatencyTarget(200);
+
+// Maximum pause of capturing. After the pause the screen is captured even if the latency is not
+// known to be lower.
+constexpr std::chrono::milliseconds kMaxPause(1000);
+
+} // namespace
+
 CaptureScheduler::CaptureScheduler(const std::chrono::milliseconds& update_interval)
-    : update_interval_(update_interval)
+    : update_interval_(update_interval),
+      idle_interval_(update_interval)
 {
     // Nothing
 }
 
+void CaptureScheduler::setUpdateInterval(const std::chrono::milliseconds& update_interval)
+{
+    update_interval_ = update_interval;
+    idle_interval_ = std::max(idle_interval_, update_interval_);
+}
+
+void CaptureScheduler::setLatency(const std::chrono::milliseconds& latency)
+{
+    latency_ = latency;
+    latency_time_ = Clock::now();
+}
+
 void CaptureScheduler::beginCapture()
 {
-    begin_time_ = std::chrono::high_resolution_clock::now();
+    begin_time_ = Clock::now();
 }
 
-void CaptureScheduler::endCapture()
+void CaptureScheduler::endCapture(bool has_changes)
 {
-    end_time_ = std::chrono::high_resolution_clock::now();
+    end_time_ = Clock::now();
+
+    if (has_changes)
+    {
+        idle_interval_ = update_interval_;
+    }
+    else
+    {
+        idle_interval_ = std::max(update_interval_, std::min(idle_interval_ * 2, kMaxIdleInterval));
+        ++stats_.idle_captures;
+    }
+
+    if (currentLatency() > kLatencyTarget)
+        ++stats_.paused_captures;
 }
 
 std::chrono::milliseconds CaptureScheduler::nextCaptureDelay() const
 {
+    std::chrono::milliseconds interval = idle_interval_;
+
+    // Capturing is paused until the data above the target is sent.
+    const std::chrono::milliseconds latency = currentLatency();
+    if (latency > kLatencyTarget)
+        interval = std::max(interval, std::min(latency - kLatencyTarget, kMaxPause));
+
     std::chrono::milliseconds diff_time =
         std::chrono::duration_cast<std::chrono::milliseconds>(end_time_ - begin_time_);
 
-    if (diff_time > update_interval_)
-        diff_time = update_interval_;
+    if (diff_time > interval)
+        diff_time = interval;
+
+    return interval - diff_time;
+}
+
+std::chrono::milliseconds CaptureScheduler::currentLatency() const
+{
+    const std::chrono::milliseconds elapsed_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - latency_time_);
+
+    if (elapsed_time >= latency_)
+        return std::chrono::milliseconds(0);
 
-    return update_interval_ - diff_time;
+    return latency_ - elapsed_time;
 }
 
 } // namespace desktop
@@ -20,25 +20,62 @@
 #define DESKTOP__CAPTURE_SCHEDULER_H
 
 #include <chrono>
+#include <cstdint>
 
 #include "base/macros_magic.h"
 
 namespace desktop {
 
+// Calculates the delay before the next capture of the screen. While the screen is changing, the
+// screen is captured with the update interval. When the screen does not change, the delay grows
+// exponentially, so an idle host does not spend the processor time. If the data that is not yet
+// sent exceeds the latency target, capturing is paused until the data is sent.
 class CaptureScheduler
 {
 public:
     explicit CaptureScheduler(const std::chrono::milliseconds& update_interval);
     ~CaptureScheduler() = default;
 
+    struct Stats
+    {
+        // Number of the captures without changes.
+        int64_t idle_captures = 0;
+
+        // Number of the captures delayed because of the unsent data.
+        int64_t paused_captures = 0;
+    };
+
+    // Changes the interval between the captures (for example, when the network is slow).
+    void setUpdateInterval(const std::chrono::milliseconds& update_interval);
+
+    // Sets the time required to send the data that is queued for sending. The value decreases
+    // by the time passed until the next call.
+    void setLatency(const std::chrono::milliseconds& latency);
+
     void beginCapture();
-    void endCapture();
+
+    // |has_changes| is true if the captured frame differs from the previous one.
+    void endCapture(bool has_changes);
+
     std::chrono::milliseconds nextCaptureDelay() const;
 
+    const Stats& stats() const { return stats_; }
+
 private:
+    using Clock = std::chrono::steady_clock;
+
+    std::chrono::milliseconds currentLatency() const;
+
     std::chrono::milliseconds update_interval_;
-    std::chrono::time_point<std::chrono::high_resolution_clock> begin_time_;
-    std::chrono::time_point<std::chrono::high_resolution_clock> end_time_;
+    std::chrono::milliseconds idle_interval_;
+
+    std::chrono::milliseconds latency_ { 0 };
+    Clock::time_point latency_time_;
+
+    Clock::time_point begin_time_;
+    Clock::time_point end_time_;
+
+    Stats stats_;
 
     DISALLOW_COPY_AND_ASSIGN(CaptureScheduler);
 };
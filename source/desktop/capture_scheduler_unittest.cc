@@ -0,0 +1,85 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "desktop/capture_scheduler.h"
+
+namespace desktop {
+
+namespace {
+
+std::chrono::milliseconds capture(CaptureScheduler* scheduler, bool has_changes)
+{
+    scheduler->beginCapture();
+    scheduler->endCapture(has_changes);
+    return scheduler->nextCaptureDelay();
+}
+
+} // namespace
+
+TEST(capture_scheduler_test, idle_backoff)
+{
+    CaptureScheduler scheduler(std::chrono::milliseconds(15));
+
+    EXPECT_EQ(15, capture(&scheduler, true).count());
+    EXPECT_EQ(30, capture(&scheduler, false).count());
+    EXPECT_EQ(60, capture(&scheduler, false).count());
+    EXPECT_EQ(60, capture(&scheduler, false).count());
+
+    // The first change returns to the update interval.
+    EXPECT_EQ(15, capture(&scheduler, true).count());
+    EXPECT_EQ(3, scheduler.stats().idle_captures);
+}
+
+TEST(capture_scheduler_test, slow_update_interval)
+{
+    CaptureScheduler scheduler(std::chrono::milliseconds(30));
+
+    scheduler.setUpdateInterval(std::chrono::milliseconds(500));
+    EXPECT_EQ(500, capture(&scheduler, false).count());
+    EXPECT_EQ(500, capture(&scheduler, true).count());
+}
+
+TEST(capture_scheduler_test, latency_pause)
+{
+    CaptureScheduler scheduler(std::chrono::milliseconds(30));
+
+    // The latency below the target does not delay the captures.
+    scheduler.setLatency(std::chrono::milliseconds(150));
+    EXPECT_EQ(30, capture(&scheduler, true).count());
+    EXPECT_EQ(0, scheduler.stats().paused_captures);
+
+    // Capturing is paused until the data above the target is sent.
+    scheduler.setLatency(std::chrono::milliseconds(700));
+    std::chrono::milliseconds delay = capture(&scheduler, true);
+    EXPECT_LE(delay.count(), 500);
+    EXPECT_GT(delay.count(), 400);
+    EXPECT_EQ(1, scheduler.stats().paused_captures);
+
+    // The pause is limited.
+    scheduler.setLatency(std::chrono::milliseconds(10000));
+    delay = capture(&scheduler, true);
+    EXPECT_LE(delay.count(), 1000);
+    EXPECT_GT(delay.count(), 900);
+
+    scheduler.setLatency(std::chrono::milliseconds(0));
+    EXPECT_EQ(30, capture(&scheduler, true).count());
+}
+
+} // namespace desktop
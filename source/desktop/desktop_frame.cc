@@ -18,6 +18,8 @@
 
 #include "desktop/desktop_frame.h"
 
+#include <cstring>
+
 namespace desktop {
 
 Frame::Frame(const QSize& size, const PixelFormat& format, int stride, uint8_t* data)
@@ -44,4 +46,30 @@ uint8_t* Frame::frameDataAtPos(int x, int y) const
     return frameData() + stride() * y + format_.bytesPerPixel() * x;
 }
 
+void Frame::moveRect(const QRect& source_rect, const QPoint& target_pos)
+{
+    const size_t bytes_per_row = source_rect.width() * format_.bytesPerPixel();
+
+    const uint8_t* source = frameDataAtPos(source_rect.topLeft());
+    uint8_t* target = frameDataAtPos(target_pos);
+    int row_stride = stride_;
+
+    // When moving down, the rows are copied from the bottom so as not to overwrite the rows that
+    // have not been copied yet.
+    if (target_pos.y() > source_rect.y())
+    {
+        source += stride_ * (source_rect.height() - 1);
+        target += stride_ * (source_rect.height() - 1);
+        row_stride = -stride_;
+    }
+
+    for (int y = 0; y < source_rect.height(); ++y)
+    {
+        memmove(target, source, bytes_per_row);
+
+        source += row_stride;
+        target += row_stride;
+    }
+}
+
 } // namespace desktop
@@ -20,6 +20,7 @@
 #define DESKTOP__DESKTOP_FRAME_H
 
 #include <QRegion>
+#include <QVector>
 
 #include "base/macros_magic.h"
 #include "desktop/pixel_format.h"
@@ -31,6 +32,16 @@ class Frame
 public:
     virtual ~Frame() = default;
 
+    // Describes the area of the previous frame that was moved to a new position (for example,
+    // when scrolling).
+    struct Move
+    {
+        QRect source_rect;
+        QPoint target_pos;
+    };
+
+    using MoveList = QVector<Move>;
+
     uint8_t* frameDataAtPos(const QPoint& pos) const;
     uint8_t* frameDataAtPos(int x, int y) const;
     uint8_t* frameData() const { return data_; }
@@ -42,6 +53,14 @@ public:
     const QRegion& constUpdatedRegion() const { return updated_region_; }
     QRegion* updatedRegion() { return &updated_region_; }
 
+    // Moves are applied to the previous frame before the updated region. The target areas of
+    // the moves are not included in the updated region.
+    const MoveList& constMoveList() const { return move_list_; }
+    MoveList* moveList() { return &move_list_; }
+
+    // Copies the pixels of |source_rect| to the position |target_pos|. The areas may overlap.
+    void moveRect(const QRect& source_rect, const QPoint& target_pos);
+
     const QPoint& topLeft() const { return top_left_; }
     void setTopLeft(const QPoint& top_left) { top_left_ = top_left; }
 
@@ -59,6 +78,7 @@ private:
     const int stride_;
 
     QRegion updated_region_;
+    MoveList move_list_;
     QPoint top_left_;
 
     DISALLOW_COPY_AND_ASSIGN(Frame);
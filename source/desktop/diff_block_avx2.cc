@@ -22,41 +22,29 @@
 #if defined(CC_MSVC)
 #include <intrin.h>
 #else
-#include <mmintrin.h>
-#include <emmintrin.h>
+#include <immintrin.h>
 #endif
 
 namespace desktop {
 
 uint8_t diffFullBlock_32x32_AVX2(const uint8_t* image1, const uint8_t* image2, int bytes_per_row)
 {
-    __m256i acc = _mm256_setzero_si256();
-    __m256i sad;
-    __m128i sad128;
-
     for (int i = 0; i < 32; ++i)
     {
         const __m256i* i1 = reinterpret_cast<const __m256i*>(image1);
         const __m256i* i2 = reinterpret_cast<const __m256i*>(image2);
 
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 0), _mm256_loadu_si256(i2 + 0));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 1), _mm256_loadu_si256(i2 + 1));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 2), _mm256_loadu_si256(i2 + 2));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 3), _mm256_loadu_si256(i2 + 3));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_srli_si256(acc, 8);
-        sad = _mm256_add_epi32(acc, sad);
-        sad128 = _mm256_extracti128_si256(sad, 1);
-        sad128 = _mm_add_epi32(_mm256_castsi256_si128(sad), sad128);
-
-        if (_mm_cvtsi128_si32(sad128))
+        // Bits that differ in the images are set to 1.
+        __m256i diff = _mm256_xor_si256(_mm256_loadu_si256(i1 + 0), _mm256_loadu_si256(i2 + 0));
+        diff = _mm256_or_si256(
+            diff, _mm256_xor_si256(_mm256_loadu_si256(i1 + 1), _mm256_loadu_si256(i2 + 1)));
+        diff = _mm256_or_si256(
+            diff, _mm256_xor_si256(_mm256_loadu_si256(i1 + 2), _mm256_loadu_si256(i2 + 2)));
+        diff = _mm256_or_si256(
+            diff, _mm256_xor_si256(_mm256_loadu_si256(i1 + 3), _mm256_loadu_si256(i2 + 3)));
+
+        // If the row has differences.
+        if (!_mm256_testz_si256(diff, diff))
             return 1U;
 
         image1 += bytes_per_row;
@@ -68,27 +56,18 @@ uint8_t diffFullBlock_32x32_AVX2(const uint8_t* image1, const uint8_t* image2, i
 
 uint8_t diffFullBlock_16x16_AVX2(const uint8_t* image1, const uint8_t* image2, int bytes_per_row)
 {
-    __m256i acc = _mm256_setzero_si256();
-    __m256i sad;
-    __m128i sad128;
-
     for (int i = 0; i < 16; ++i)
     {
         const __m256i* i1 = reinterpret_cast<const __m256i*>(image1);
         const __m256i* i2 = reinterpret_cast<const __m256i*>(image2);
 
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 0), _mm256_loadu_si256(i2 + 0));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 1), _mm256_loadu_si256(i2 + 1));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_srli_si256(acc, 8);
-        sad = _mm256_add_epi32(acc, sad);
-        sad128 = _mm256_extracti128_si256(sad, 1);
-        sad128 = _mm_add_epi32(_mm256_castsi256_si128(sad), sad128);
+        // Bits that differ in the images are set to 1.
+        __m256i diff = _mm256_xor_si256(_mm256_loadu_si256(i1 + 0), _mm256_loadu_si256(i2 + 0));
+        diff = _mm256_or_si256(
+            diff, _mm256_xor_si256(_mm256_loadu_si256(i1 + 1), _mm256_loadu_si256(i2 + 1)));
 
-        if (_mm_cvtsi128_si32(sad128))
+        // If the row has differences.
+        if (!_mm256_testz_si256(diff, diff))
             return 1U;
 
         image1 += bytes_per_row;
@@ -100,24 +79,16 @@ uint8_t diffFullBlock_16x16_AVX2(const uint8_t* image1, const uint8_t* image2, i
 
 uint8_t diffFullBlock_8x8_AVX2(const uint8_t* image1, const uint8_t* image2, int bytes_per_row)
 {
-    __m256i acc = _mm256_setzero_si256();
-    __m256i sad;
-    __m128i sad128;
-
     for (int i = 0; i < 8; ++i)
     {
         const __m256i* i1 = reinterpret_cast<const __m256i*>(image1);
         const __m256i* i2 = reinterpret_cast<const __m256i*>(image2);
 
-        sad = _mm256_sad_epu8(_mm256_loadu_si256(i1 + 0), _mm256_loadu_si256(i2 + 0));
-        acc = _mm256_add_epi32(acc, sad);
-
-        sad = _mm256_srli_si256(acc, 8);
-        sad = _mm256_add_epi32(acc, sad);
-        sad128 = _mm256_extracti128_si256(sad, 1);
-        sad128 = _mm_add_epi32(_mm256_castsi256_si128(sad), sad128);
+        // Bits that differ in the images are set to 1.
+        __m256i diff = _mm256_xor_si256(_mm256_loadu_si256(i1 + 0), _mm256_loadu_si256(i2 + 0));
 
-        if (_mm_cvtsi128_si32(sad128))
+        // If the row has differences.
+        if (!_mm256_testz_si256(diff, diff))
             return 1U;
 
         image1 += bytes_per_row;
@@ -0,0 +1,95 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/diff_block_avx512.h"
+#include "build/build_config.h"
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+namespace desktop {
+
+uint8_t diffFullBlock_32x32_AVX512(const uint8_t* image1, const uint8_t* image2, int bytes_per_row)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        const __m512i* i1 = reinterpret_cast<const __m512i*>(image1);
+        const __m512i* i2 = reinterpret_cast<const __m512i*>(image2);
+
+        // Bits of the mask are set for the bytes that differ in the images.
+        __mmask64 diff = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(i1 + 0),
+                                                 _mm512_loadu_si512(i2 + 0));
+        diff |= _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(i1 + 1), _mm512_loadu_si512(i2 + 1));
+
+        // If the row has differences.
+        if (diff)
+            return 1U;
+
+        image1 += bytes_per_row;
+        image2 += bytes_per_row;
+    }
+
+    return 0U;
+}
+
+uint8_t diffFullBlock_16x16_AVX512(const uint8_t* image1, const uint8_t* image2, int bytes_per_row)
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        // If the row has differences.
+        if (_mm512_cmpneq_epi8_mask(_mm512_loadu_si512(image1), _mm512_loadu_si512(image2)))
+            return 1U;
+
+        image1 += bytes_per_row;
+        image2 += bytes_per_row;
+    }
+
+    return 0U;
+}
+
+uint8_t diffFullBlock_8x8_AVX512(const uint8_t* image1, const uint8_t* image2, int bytes_per_row)
+{
+    // A row of the block takes 32 bytes, so two rows are compared at once. The first row is
+    // loaded to the lower half and the second row to the upper half by the masked loads (the
+    // address of the second load is moved back by 32 bytes). The masked loads leave no undefined
+    // lanes, unlike the insertion of a 256-bit value.
+    const int second_row = bytes_per_row - 32;
+
+    for (int i = 0; i < 8; i += 2)
+    {
+        const __m512i rows1 = _mm512_mask_loadu_epi64(
+            _mm512_maskz_loadu_epi64(0x0F, image1), 0xF0, image1 + second_row);
+
+        const __m512i rows2 = _mm512_mask_loadu_epi64(
+            _mm512_maskz_loadu_epi64(0x0F, image2), 0xF0, image2 + second_row);
+
+        // If the rows have differences.
+        if (_mm512_cmpneq_epi8_mask(rows1, rows2))
+            return 1U;
+
+        image1 += bytes_per_row * 2;
+        image2 += bytes_per_row * 2;
+    }
+
+    return 0U;
+}
+
+} // namespace desktop
@@ -18,27 +18,133 @@
 
 #include "desktop/differ.h"
 
+#include "base/bits.h"
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "desktop/diff_block_avx2.h"
+#include "desktop/diff_block_avx512.h"
 #include "desktop/diff_block_sse2.h"
 #include "desktop/diff_block_sse3.h"
 #include "desktop/diff_block_c.h"
+#include "desktop/simd_dispatch.h"
 
-#include <libyuv/cpu_id.h>
+#include <algorithm>
 
 namespace desktop {
 
 namespace {
 
 const int kBytesPerPixel = 4;
-const int kBlockSize = 8;
-const int kBytesPerBlock = kBytesPerPixel * kBlockSize;
+const int kBitsPerWord = 64;
+
+// Supported block sizes. The index of the size in the list is also the index of the function in
+// the tables below.
+const int kBlockSizes[] = { 8, 16, 32 };
+const int kBlockSizeCount = 3;
+
+const int kMinBlockSize = 8;
+const int kMaxBlockSize = 32;
+
+// Without this limit, the synchronization overhead on small screens exceeds the gain.
+const int kMinBandRows = 4;
+
+// Default upper limit of threads for the differ. The capture thread shares the processor with
+// the encoder.
+const int kMaxAutoThreadCount = 4;
+
+// Each thread gets several bands so that a thread that got unchanged (fast) bands can help
+// the others.
+const int kBandsPerThread = 4;
+
+// Weight of the last frame in the average density of changes.
+const double kDensitySmoothing = 0.2;
+
+// If the average fraction of changed blocks exceeds the |up| threshold, the next larger block
+// is selected. If it is less than the |down| threshold, the next smaller block is selected.
+// The gap between the thresholds keeps the size from switching back and forth.
+struct BlockSizeThresholds
+{
+    double up;
+    double down;
+};
+
+const BlockSizeThresholds kThresholds[kBlockSizeCount] =
+{
+    { 0.10, 0.0  }, // 8x8
+    { 0.30, 0.04 }, // 16x16
+    { 1.0,  0.15 }  // 32x32
+};
+
+// The thresholds are given for 1920x1080. On larger screens the comparison is more expensive,
+// so larger blocks are selected earlier, on smaller screens later.
+const int kReferenceScreenArea = 1920 * 1080;
+const double kMinThresholdScale = 0.5;
+const double kMaxThresholdScale = 2.0;
+
+// The number of frames after a change of the block size before the next change is possible.
+const int kMinFramesBetweenChanges = 8;
+
+// The hint rectangles are extended by this number of pixels on each side. The damaged areas
+// reported by the system are not always exact (for example, for anti-aliased edges).
+const int kHintMargin = 8;
+
+// Default number of frames with a hint region after which the whole screen is compared.
+const int kDefaultFullScanInterval = 30;
+
+using DiffFullBlockFunc = uint8_t(*)(const uint8_t*, const uint8_t*, int);
+
+const DiffFullBlockFunc kDiffFullBlockAVX512[kBlockSizeCount] =
+{
+    diffFullBlock_8x8_AVX512, diffFullBlock_16x16_AVX512, diffFullBlock_32x32_AVX512
+};
+
+const DiffFullBlockFunc kDiffFullBlockAVX2[kBlockSizeCount] =
+{
+    diffFullBlock_8x8_AVX2, diffFullBlock_16x16_AVX2, diffFullBlock_32x32_AVX2
+};
+
+const DiffFullBlockFunc kDiffFullBlockSSE3[kBlockSizeCount] =
+{
+    diffFullBlock_8x8_SSE3, diffFullBlock_16x16_SSE3, diffFullBlock_32x32_SSE3
+};
+
+const DiffFullBlockFunc kDiffFullBlockSSE2[kBlockSizeCount] =
+{
+    diffFullBlock_8x8_SSE2, diffFullBlock_16x16_SSE2, diffFullBlock_32x32_SSE2
+};
+
+const DiffFullBlockFunc kDiffFullBlockC[kBlockSizeCount] =
+{
+    diffFullBlock_8x8_C, diffFullBlock_16x16_C, diffFullBlock_32x32_C
+};
+
+// Indexed by SimdLevel.
+const DiffFullBlockFunc* const kDiffFullBlockFuncs[kSimdLevelCount] =
+{
+    kDiffFullBlockC,
+    kDiffFullBlockSSE2,
+    kDiffFullBlockSSE3,
+    kDiffFullBlockAVX2,
+    kDiffFullBlockAVX512
+};
+
+int blockSizeIndex(int block_size)
+{
+    for (int i = 0; i < kBlockSizeCount; ++i)
+    {
+        if (kBlockSizes[i] == block_size)
+            return i;
+    }
+
+    NOTREACHED();
+    return 0;
+}
 
 //
 // Check for diffs in upper-left portion of the block. The size of the portion
 // to check is specified by the |width| and |height| values.
 // Note that if we force the capturer to always return images whose width and
-// height are multiples of kBlockSize, then this will never be called.
+// height are multiples of the block size, then this will never be called.
 //
 uint8_t diffPartialBlock(const uint8_t* prev_image,
                         const uint8_t* curr_image,
@@ -58,260 +164,494 @@ uint8_t diffPartialBlock(const uint8_t* prev_image,
     return 0U;
 }
 
+// Sets bits [first, last] in the row of the map.
+void setBitRange(uint64_t* row_bits, int first, int last)
+{
+    const int first_word = first / kBitsPerWord;
+    const int last_word = last / kBitsPerWord;
+
+    const uint64_t first_mask = ~0ULL << (first % kBitsPerWord);
+    const uint64_t last_mask = ~0ULL >> (kBitsPerWord - 1 - last % kBitsPerWord);
+
+    if (first_word == last_word)
+    {
+        row_bits[first_word] |= first_mask & last_mask;
+        return;
+    }
+
+    row_bits[first_word] |= first_mask;
+
+    for (int i = first_word + 1; i < last_word; ++i)
+        row_bits[i] = ~0ULL;
+
+    row_bits[last_word] |= last_mask;
+}
+
 } // namespace
 
-Differ::Differ(const QSize& size)
+Differ::Differ(const QSize& size, int thread_count)
     : screen_rect_(QRect(QPoint(), size)),
       bytes_per_row_(size.width() * kBytesPerPixel),
-      diff_width_(((size.width() + kBlockSize - 1) / kBlockSize) + 1),
-      diff_height_(((size.height() + kBlockSize - 1) / kBlockSize) + 1),
-      full_blocks_x_(size.width() / kBlockSize),
-      full_blocks_y_(size.height() / kBlockSize)
+      full_scan_interval_(kDefaultFullScanInterval)
 {
-    const int diff_info_size = diff_width_ * diff_height_;
+    // The dirty map is allocated for the smallest block size and is suitable for any size.
+    const int max_block_columns = (size.width() + kMinBlockSize - 1) / kMinBlockSize;
+    const int max_block_rows = (size.height() + kMinBlockSize - 1) / kMinBlockSize;
+
+    const size_t dirty_map_size =
+        static_cast<size_t>((max_block_columns + kBitsPerWord - 1) / kBitsPerWord) *
+        max_block_rows;
 
-    diff_info_ = std::make_unique<uint8_t[]>(diff_info_size);
-    memset(diff_info_.get(), 0, diff_info_size);
+    dirty_map_ = std::make_unique<uint64_t[]>(dirty_map_size);
+    memset(dirty_map_.get(), 0, dirty_map_size * sizeof(uint64_t));
+
+    hint_map_ = std::make_unique<uint64_t[]>(dirty_map_size);
+
+    if (thread_count <= 0)
+        thread_count = std::min(base::ThreadPool::defaultThreadCount(), kMaxAutoThreadCount);
+
+    thread_count = std::max(std::min(thread_count, max_block_rows / kMinBandRows), 1);
+
+    if (thread_count > 1)
+        thread_pool_ = std::make_unique<base::ThreadPool>(thread_count);
+
+    diff_full_block_funcs_ = simdDispatch(kDiffFullBlockFuncs);
+
+    updateGeometry(kMinBlockSize);
+}
+
+Differ::~Differ() = default;
+
+int Differ::threadCount() const
+{
+    return thread_pool_ ? thread_pool_->threadCount() : 1;
+}
+
+void Differ::setBlockSize(int block_size)
+{
+    auto_block_size_ = (block_size == 0);
+
+    if (!auto_block_size_)
+        updateGeometry(block_size);
+}
+
+void Differ::setFullScanInterval(int interval)
+{
+    DCHECK_GE(interval, 0);
+    full_scan_interval_ = interval;
+}
+
+void Differ::updateGeometry(int block_size)
+{
+    DCHECK(block_size >= kMinBlockSize && block_size <= kMaxBlockSize);
+
+    block_size_ = block_size;
+    bytes_per_block_ = block_size * kBytesPerPixel;
+
+    diff_full_block_func_ = diff_full_block_funcs_[blockSizeIndex(block_size)];
+
+    full_blocks_x_ = screen_rect_.width() / block_size;
+    full_blocks_y_ = screen_rect_.height() / block_size;
 
     // Calc size of partial blocks which may be present on right and bottom edge.
-    partial_column_width_ = size.width() - (full_blocks_x_ * kBlockSize);
-    partial_row_height_ = size.height() - (full_blocks_y_ * kBlockSize);
+    partial_column_width_ = screen_rect_.width() - (full_blocks_x_ * block_size);
+    partial_row_height_ = screen_rect_.height() - (full_blocks_y_ * block_size);
 
     // Offset from the start of one block-row to the next.
-    block_stride_y_ = bytes_per_row_ * kBlockSize;
+    block_stride_y_ = bytes_per_row_ * block_size;
+
+    block_columns_ = full_blocks_x_ + (partial_column_width_ != 0 ? 1 : 0);
+    block_rows_ = full_blocks_y_ + (partial_row_height_ != 0 ? 1 : 0);
+    row_words_ = (block_columns_ + kBitsPerWord - 1) / kBitsPerWord;
+
+    const int band_count = threadCount() * kBandsPerThread;
+    band_rows_ = std::max((block_rows_ + band_count - 1) / band_count, kMinBandRows);
+
+    frames_since_block_size_change_ = 0;
+    stats_.block_size = block_size;
+}
+
+//
+// Selects the block size for the next frame by the average density of changes.
+// The map of dirty blocks is rebuilt for each frame, so the size can be changed between any
+// two frames without a full update.
+//
+void Differ::selectBlockSize(int dirty_blocks)
+{
+    const double density = static_cast<double>(dirty_blocks) / (block_columns_ * block_rows_);
+
+    stats_.change_density =
+        stats_.change_density * (1.0 - kDensitySmoothing) + density * kDensitySmoothing;
+
+    if (!auto_block_size_ || ++frames_since_block_size_change_ < kMinFramesBetweenChanges)
+        return;
+
+    const double screen_area = static_cast<double>(screen_rect_.width()) * screen_rect_.height();
+    const double threshold_scale = std::clamp(
+        kReferenceScreenArea / screen_area, kMinThresholdScale, kMaxThresholdScale);
+
+    const BlockSizeThresholds& thresholds = kThresholds[blockSizeIndex(block_size_)];
+    int block_size = block_size_;
+
+    if (stats_.change_density > thresholds.up * threshold_scale)
+        block_size = std::min(block_size_ * 2, kMaxBlockSize);
+    else if (stats_.change_density < thresholds.down * threshold_scale)
+        block_size = std::max(block_size_ / 2, kMinBlockSize);
+
+    if (block_size == block_size_)
+        return;
+
+    DLOG(LS_INFO) << "Differ block size changed from " << block_size_ << " to " << block_size
+                  << " (density of changes: " << stats_.change_density << ")";
+
+    updateGeometry(block_size);
+    ++stats_.block_size_changes;
+}
+
+//
+// Marks the blocks that intersect the hint region in |hint_map_|.
+//
+void Differ::markHintBlocks(const QRegion& hint_region)
+{
+    memset(hint_map_.get(), 0, row_words_ * block_rows_ * sizeof(uint64_t));
 
-    if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+    for (const auto& hint_rect : hint_region)
     {
-        LOG(LS_INFO) << "AVX2 differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_AVX2;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_AVX2;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_AVX2;
+        const QRect rect = hint_rect.adjusted(-kHintMargin, -kHintMargin, kHintMargin, kHintMargin)
+            .intersected(screen_rect_);
+        if (rect.isEmpty())
+            continue;
+
+        const int first_column = rect.left() / block_size_;
+        const int last_column = rect.right() / block_size_;
+        const int last_row = rect.bottom() / block_size_;
+
+        for (int y = rect.top() / block_size_; y <= last_row; ++y)
+            setBitRange(hint_map_.get() + y * row_words_, first_column, last_column);
     }
-    else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+
+    stats_.compared_blocks = 0;
+    for (int i = 0; i < row_words_ * block_rows_; ++i)
+        stats_.compared_blocks += base::countSetBits64(hint_map_[i]);
+}
+
+//
+// Identify all of the blocks that contain changed pixels.
+// Bands of block rows are processed in parallel. Each band writes only its own rows of
+// |dirty_map_|, so the result is the same as for the single-threaded pass.
+//
+void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image, bool use_hint)
+{
+    auto mark_band = [&](int first_row, int last_row)
     {
-        LOG(LS_INFO) << "SSE3 differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_SSE3;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_SSE3;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_SSE3;
-    }
-    else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+        if (use_hint)
+            markHintedDirtyBlocks(prev_image, curr_image, first_row, last_row);
+        else
+            markDirtyBlocks(prev_image, curr_image, first_row, last_row);
+    };
+
+    // A few hinted blocks are compared faster than the threads are woken up.
+    if (!thread_pool_ || (use_hint && stats_.compared_blocks < band_rows_ * block_columns_))
     {
-        LOG(LS_INFO) << "SSE2 differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_SSE2;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_SSE2;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_SSE2;
+        mark_band(0, block_rows_);
+        return;
     }
-    else
+
+    const int band_count = (block_rows_ + band_rows_ - 1) / band_rows_;
+
+    thread_pool_->parallelFor(band_count, [&](int band, int /* thread_index */)
     {
-        LOG(LS_INFO) << "C differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_C;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_C;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_C;
-    }
+        const int first_row = band * band_rows_;
+        const int last_row = std::min(first_row + band_rows_, block_rows_);
+
+        mark_band(first_row, last_row);
+    });
 }
 
 //
-// Identify all of the blocks that contain changed pixels.
+// Identify the blocks that contain changed pixels in block rows [first_row, last_row).
 //
-void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image)
+void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image,
+                             int first_row, int last_row)
 {
-    const uint8_t* prev_block_row_start = prev_image;
-    const uint8_t* curr_block_row_start = curr_image;
+    const uint8_t* prev_block_row_start = prev_image + first_row * block_stride_y_;
+    const uint8_t* curr_block_row_start = curr_image + first_row * block_stride_y_;
 
-    // Offset from the start of one diff_info row to the next.
-    const int diff_stride = diff_width_;
+    uint64_t* row_bits = dirty_map_.get() + first_row * row_words_;
 
-    uint8_t* is_diff_row_start = diff_info_.get();
+    const int last_full_row = std::min(last_row, full_blocks_y_);
 
-    for (int y = 0; y < full_blocks_y_; ++y)
+    for (int y = first_row; y < last_full_row; ++y)
     {
         const uint8_t* prev_block = prev_block_row_start;
         const uint8_t* curr_block = curr_block_row_start;
 
-        uint8_t* is_different = is_diff_row_start;
+        uint64_t word = 0;
 
         for (int x = 0; x < full_blocks_x_; ++x)
         {
             // Mark this block as being modified so that it gets
             // incorporated into a dirty rect.
-            *is_different = diff_full_block_func_(prev_block, curr_block, bytes_per_row_);
+            const uint64_t is_different =
+                diff_full_block_func_(prev_block, curr_block, bytes_per_row_);
 
-            prev_block += kBytesPerBlock;
-            curr_block += kBytesPerBlock;
+            word |= is_different << (x % kBitsPerWord);
 
-            ++is_different;
+            if (x % kBitsPerWord == kBitsPerWord - 1)
+            {
+                row_bits[x / kBitsPerWord] = word;
+                word = 0;
+            }
+
+            prev_block += bytes_per_block_;
+            curr_block += bytes_per_block_;
         }
 
         // If there is a partial column at the end, handle it.
         // This condition should rarely, if ever, occur.
         if (partial_column_width_ != 0)
         {
-            *is_different = diffPartialBlock(prev_block,
-                                             curr_block,
-                                             bytes_per_row_,
-                                             kBytesPerBlock,
-                                             kBlockSize);
+            const uint64_t is_different =
+                diffPartialBlock(prev_block,
+                                 curr_block,
+                                 bytes_per_row_,
+                                 partial_column_width_ * kBytesPerPixel,
+                                 block_size_);
+
+            word |= is_different << (full_blocks_x_ % kBitsPerWord);
         }
 
+        // The last word is stored if it has bits that are not stored in the loop. If the partial
+        // column is the last bit of the word, |block_columns_| is a multiple of the word size.
+        if (full_blocks_x_ % kBitsPerWord != 0 || partial_column_width_ != 0)
+            row_bits[(block_columns_ - 1) / kBitsPerWord] = word;
+
         // Update pointers for next row.
         prev_block_row_start += block_stride_y_;
         curr_block_row_start += block_stride_y_;
 
-        is_diff_row_start += diff_stride;
+        row_bits += row_words_;
     }
 
     // If the screen height is not a multiple of the block size, then this
     // handles the last partial row. This situation is far more common than
     // the 'partial column' case.
-    if (partial_row_height_ != 0)
+    if (partial_row_height_ != 0 && last_row > full_blocks_y_)
     {
         const uint8_t* prev_block = prev_block_row_start;
         const uint8_t* curr_block = curr_block_row_start;
 
-        uint8_t* is_different = is_diff_row_start;
+        memset(row_bits, 0, row_words_ * sizeof(uint64_t));
 
         for (int x = 0; x < full_blocks_x_; ++x)
         {
-            *is_different = diffPartialBlock(prev_block,
-                                             curr_block,
-                                             bytes_per_row_,
-                                             kBytesPerBlock,
-                                             partial_row_height_);
-
-            prev_block += kBytesPerBlock;
-            curr_block += kBytesPerBlock;
-            ++is_different;
+            const uint64_t is_different = diffPartialBlock(prev_block,
+                                                           curr_block,
+                                                           bytes_per_row_,
+                                                           bytes_per_block_,
+                                                           partial_row_height_);
+
+            row_bits[x / kBitsPerWord] |= is_different << (x % kBitsPerWord);
+
+            prev_block += bytes_per_block_;
+            curr_block += bytes_per_block_;
         }
 
         if (partial_column_width_ != 0)
         {
-            *is_different =
+            const uint64_t is_different =
                 diffPartialBlock(prev_block,
                                  curr_block,
                                  bytes_per_row_,
                                  partial_column_width_ * kBytesPerPixel,
                                  partial_row_height_);
+
+            row_bits[full_blocks_x_ / kBitsPerWord] |=
+                is_different << (full_blocks_x_ % kBitsPerWord);
         }
     }
 }
 
+//
+// Identify the changed blocks in block rows [first_row, last_row) among the blocks marked in
+// |hint_map_|. The other blocks are considered unchanged.
+//
+void Differ::markHintedDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image,
+                                   int first_row, int last_row)
+{
+    for (int y = first_row; y < last_row; ++y)
+    {
+        const uint64_t* hint_bits = hint_map_.get() + y * row_words_;
+        uint64_t* row_bits = dirty_map_.get() + y * row_words_;
+
+        for (int i = 0; i < row_words_; ++i)
+        {
+            uint64_t hint = hint_bits[i];
+            uint64_t word = 0;
+
+            while (hint)
+            {
+                const int bit = base::countTrailingZeros64(hint);
+                hint &= hint - 1;
+
+                const uint64_t is_different =
+                    diffBlock(prev_image, curr_image, i * kBitsPerWord + bit, y);
+
+                word |= is_different << bit;
+            }
+
+            row_bits[i] = word;
+        }
+    }
+}
+
+uint8_t Differ::diffBlock(const uint8_t* prev_image, const uint8_t* curr_image,
+                          int x, int y) const
+{
+    const size_t offset = static_cast<size_t>(y) * block_stride_y_ + x * bytes_per_block_;
+
+    const int width = (x < full_blocks_x_) ? block_size_ : partial_column_width_;
+    const int height = (y < full_blocks_y_) ? block_size_ : partial_row_height_;
+
+    if (width == block_size_ && height == block_size_)
+        return diff_full_block_func_(prev_image + offset, curr_image + offset, bytes_per_row_);
+
+    return diffPartialBlock(prev_image + offset, curr_image + offset,
+                            bytes_per_row_, width * kBytesPerPixel, height);
+}
+
 //
 // After the dirty blocks have been identified, this routine merges adjacent
 // blocks into a region.
-// The goal is to minimize the region that covers the dirty blocks.
+// Consecutive block rows with the same bits form one band, and each run of set bits in the
+// band gives one rectangle. The rectangles are produced in the order required by
+// QRegion::setRects (sorted by Y, then by X, without horizontal neighbors and with the same
+// height within a band), so the region is built in one pass without unions.
 //
-void Differ::mergeBlocks(QRegion* dirty_region)
+int Differ::mergeBlocks(QRegion* dirty_region)
+{
+    const uint64_t* map = dirty_map_.get();
+    const int map_size = row_words_ * block_rows_;
+
+    int dirty_blocks = 0;
+    for (int i = 0; i < map_size; ++i)
+        dirty_blocks += base::countSetBits64(map[i]);
+
+    if (!dirty_blocks)
+        return 0;
+
+    // Fast path for full-screen changes (for example, video playback).
+    if (dirty_blocks == block_columns_ * block_rows_)
+    {
+        *dirty_region = screen_rect_;
+        return dirty_blocks;
+    }
+
+    QVector<QRect> rects;
+
+    const size_t row_size = row_words_ * sizeof(uint64_t);
+    int band_top = 0;
+
+    for (int y = 1; y <= block_rows_; ++y)
+    {
+        const uint64_t* band_bits = map + band_top * row_words_;
+
+        if (y < block_rows_ && memcmp(band_bits, map + y * row_words_, row_size) == 0)
+            continue;
+
+        addBlockRuns(band_bits, band_top, y - band_top, &rects);
+        band_top = y;
+    }
+
+    dirty_region->setRects(rects.data(), rects.size());
+    return dirty_blocks;
+}
+
+void Differ::addBlockRuns(const uint64_t* row_bits, int top_row, int row_count,
+                          QVector<QRect>* rects) const
 {
-    uint8_t* is_diff_row_start = diff_info_.get();
-    const int diff_stride = diff_width_;
+    // Start of the current run of set bits or -1 if there is no run.
+    int run_start = -1;
 
-    for (int y = 0; y < diff_height_; ++y)
+    for (int i = 0; i < row_words_; ++i)
     {
-        uint8_t* is_different = is_diff_row_start;
+        const uint64_t word = row_bits[i];
+        int pos = 0;
 
-        for (int x = 0; x < diff_width_; ++x)
+        while (pos < kBitsPerWord)
         {
-            // We've found a modified block. Look at blocks to the right and
-            // below to group this block with as many others as we can.
-            if (*is_different != 0)
+            if (run_start < 0)
             {
-                // Width and height of the rectangle in blocks.
-                int width  = 1;
-                int height = 1;
-
-                *is_different = 0;
-
-                // Group with blocks to the right.
-                // We can keep looking until we find an unchanged block because
-                // we have a boundary block which is never marked as having
-                // diffs.
-                uint8_t* right = is_different + 1;
-
-                while (*right != 0)
-                {
-                    *right++ = 0;
-                    ++width;
-                }
-
-                // Group with blocks below.
-                // The entire width of blocks that we matched above much match
-                // for each row that we add.
-                uint8_t* bottom = is_different;
-                bool found_new_row;
-
-                do
-                {
-                    found_new_row = true;
-                    bottom += diff_stride;
-                    right = bottom;
-
-                    for (int x2 = 0; x2 < width; ++x2)
-                    {
-                        if (*right++ == 0)
-                            found_new_row = false;
-                    }
-
-                    if (found_new_row)
-                    {
-                        ++height;
-
-                        // We need to go back and erase the diff markers so
-                        // that we don't try to add these blocks a second time.
-                        right = bottom;
-
-                        for (int x2 = 0; x2 < width; ++x2)
-                        {
-                            *right++ = 0;
-                        }
-                    }
-                } while (found_new_row);
-
-                QRect dirty_rect = QRect(x * kBlockSize, y * kBlockSize,
-                                         width * kBlockSize, height * kBlockSize);
-
-                // Add rect to region.
-                *dirty_region += dirty_rect.intersected(screen_rect_);
+                // Looking for the next set bit.
+                const uint64_t rest = word >> pos;
+                if (!rest)
+                    break;
+
+                pos += base::countTrailingZeros64(rest);
+                run_start = i * kBitsPerWord + pos;
             }
 
-            // Increment to next block in this row.
-            ++is_different;
+            // Looking for the next clear bit.
+            const uint64_t rest = ~word >> pos;
+            if (!rest)
+            {
+                // The run continues in the next word.
+                break;
+            }
+
+            pos += base::countTrailingZeros64(rest);
+
+            QRect rect(run_start * block_size_, top_row * block_size_,
+                       (i * kBitsPerWord + pos - run_start) * block_size_, row_count * block_size_);
+
+            rects->push_back(rect.intersected(screen_rect_));
+            run_start = -1;
         }
+    }
 
-        // Go to start of next row.
-        is_diff_row_start += diff_stride;
+    // Bits beyond the last block column are always clear, so a run can end at the end of the row
+    // only if the number of columns is a multiple of the word size.
+    if (run_start >= 0)
+    {
+        QRect rect(run_start * block_size_, top_row * block_size_,
+                   (block_columns_ - run_start) * block_size_, row_count * block_size_);
+
+        rects->push_back(rect.intersected(screen_rect_));
     }
 }
 
 void Differ::calcDirtyRegion(const uint8_t* prev_image,
                              const uint8_t* curr_image,
-                             QRegion* dirty_region)
+                             QRegion* dirty_region,
+                             const QRegion* hint_region)
 {
     *dirty_region = QRegion();
 
+    const bool use_hint = hint_region &&
+        (!full_scan_interval_ || frames_since_full_scan_ + 1 < full_scan_interval_);
+
+    if (use_hint)
+    {
+        ++frames_since_full_scan_;
+        markHintBlocks(*hint_region);
+    }
+    else
+    {
+        frames_since_full_scan_ = 0;
+        stats_.compared_blocks = block_columns_ * block_rows_;
+    }
+
     // Identify all the blocks that contain changed pixels.
-    markDirtyBlocks(prev_image, curr_image);
+    markDirtyBlocks(prev_image, curr_image, use_hint);
 
     //
     // Now that we've identified the blocks that have changed, merge adjacent
     // blocks to minimize the number of rects that we return.
     //
-    mergeBlocks(dirty_region);
+    const int dirty_blocks = mergeBlocks(dirty_region);
+
+    // The block size may change for the next frame.
+    selectBlockSize(dirty_blocks);
 }
 
 } // namespace desktop
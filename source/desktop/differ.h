@@ -20,47 +20,130 @@
 #define DESKTOP__DIFFER_H
 
 #include <QRegion>
+#include <QVector>
 #include <memory>
 
 #include "base/macros_magic.h"
 
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace desktop {
 
 // Class to search for changed regions of the screen.
 class Differ
 {
 public:
-    explicit Differ(const QSize& size);
-    ~Differ() = default;
-
+    // The screen is split into horizontal bands of blocks, which are compared on |thread_count|
+    // threads. If |thread_count| is zero, then the number of threads is selected automatically.
+    // The result does not depend on the number of threads.
+    explicit Differ(const QSize& size, int thread_count = 0);
+    ~Differ();
+
+    // Calculates the region of |curr_image| that differs from |prev_image|.
+    // If |hint_region| is not null, then only the blocks that intersect the region (extended by
+    // a small margin) are compared and the others are considered unchanged. The capturers that
+    // know the damaged areas of the screen (for example, from the system) pass them as the hint.
+    // Every few frames the whole screen is compared anyway to catch the changes that were missed
+    // by the hints.
     void calcDirtyRegion(const uint8_t* prev_image,
                          const uint8_t* curr_image,
-                         QRegion* changed_region);
+                         QRegion* changed_region,
+                         const QRegion* hint_region = nullptr);
+
+    int threadCount() const;
+
+    // Sets the size of the compared blocks (8, 16 or 32 pixels). If |block_size| is zero, then the
+    // size is selected automatically after each frame (default). Large changes are compared in
+    // large blocks (fewer comparisons), small changes in small blocks (tighter regions).
+    void setBlockSize(int block_size);
+
+    // Sets the number of frames with a hint region after which the whole screen is compared.
+    // If |interval| is zero, then the hints are always trusted.
+    void setFullScanInterval(int interval);
+
+    struct Stats
+    {
+        // The size of the blocks used for the next frame.
+        int block_size = 0;
+
+        // Average fraction of the changed blocks in recent frames (from 0 to 1).
+        double change_density = 0;
+
+        // Number of times the block size was changed.
+        int block_size_changes = 0;
+
+        // Number of blocks compared in the last frame.
+        int compared_blocks = 0;
+    };
+
+    const Stats& stats() const { return stats_; }
 
 private:
-    void markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image);
-    void mergeBlocks(QRegion* dirty_region);
+    void updateGeometry(int block_size);
+    void selectBlockSize(int dirty_blocks);
+
+    void markHintBlocks(const QRegion& hint_region);
+    void markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image, bool use_hint);
+    void markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image,
+                         int first_row, int last_row);
+    void markHintedDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image,
+                               int first_row, int last_row);
+    uint8_t diffBlock(const uint8_t* prev_image, const uint8_t* curr_image, int x, int y) const;
+    int mergeBlocks(QRegion* dirty_region);
+    void addBlockRuns(const uint64_t* row_bits, int top_row, int row_count,
+                      QVector<QRect>* rects) const;
 
     const QRect screen_rect_;
 
     const int bytes_per_row_;
 
-    const int full_blocks_x_;
-    const int full_blocks_y_;
+    // Size of the blocks in pixels and the number of bytes in one row of a block.
+    int block_size_ = 0;
+    int bytes_per_block_ = 0;
+
+    int full_blocks_x_;
+    int full_blocks_y_;
 
     int partial_column_width_;
     int partial_row_height_;
 
     int block_stride_y_;
 
-    const int diff_width_;
-    const int diff_height_;
+    // Number of block columns (including the partial column) and the number of 64-bit words
+    // in one row of the dirty map.
+    int block_columns_;
+    int row_words_;
+
+    // One bit for each block. Bits beyond |block_columns_| in the last word of a row are
+    // always zero. The map is allocated for the smallest block size.
+    std::unique_ptr<uint64_t[]> dirty_map_;
 
-    std::unique_ptr<uint8_t[]> diff_info_;
+    // The blocks to compare when the hint region is used. Has the same layout as |dirty_map_|.
+    std::unique_ptr<uint64_t[]> hint_map_;
+
+    int full_scan_interval_;
+    int frames_since_full_scan_ = 0;
 
     typedef uint8_t(*DiffFullBlockFunc)(const uint8_t*, const uint8_t*, int);
+
+    // Functions for each supported block size and the function for the current size.
+    const DiffFullBlockFunc* diff_full_block_funcs_;
     DiffFullBlockFunc diff_full_block_func_;
 
+    // True if the block size is selected automatically.
+    bool auto_block_size_ = true;
+    int frames_since_block_size_change_ = 0;
+
+    Stats stats_;
+
+    // Number of block rows (including the partial row) and the number of rows in one band.
+    int block_rows_;
+    int band_rows_;
+
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+
     DISALLOW_COPY_AND_ASSIGN(Differ);
 };
 
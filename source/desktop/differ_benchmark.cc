@@ -0,0 +1,287 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/diff_block_avx2.h"
+#include "desktop/diff_block_avx512.h"
+#include "desktop/diff_block_c.h"
+#include "desktop/diff_block_sse2.h"
+#include "desktop/diff_block_sse3.h"
+#include "desktop/differ.h"
+#include "desktop/frame_generator.h"
+#include "desktop/frame_trace_reader.h"
+#include "desktop/simd_dispatch.h"
+
+namespace desktop {
+
+namespace {
+
+const QSize kScreenSizes[] = { QSize(1920, 1080), QSize(2560, 1440), QSize(3840, 2160) };
+const int kScreenSizeCount = sizeof(kScreenSizes) / sizeof(kScreenSizes[0]);
+
+const int kBytesPerPixel = 4;
+
+using DiffFullBlockFunc = uint8_t(*)(const uint8_t*, const uint8_t*, int);
+
+struct Kernel
+{
+    const char* name;
+    DiffFullBlockFunc func;
+    int block_size;
+    SimdLevel level;
+};
+
+const Kernel kKernels[] =
+{
+    { "C/8x8",         diffFullBlock_8x8_C,          8, SimdLevel::C },
+    { "C/16x16",       diffFullBlock_16x16_C,       16, SimdLevel::C },
+    { "C/32x32",       diffFullBlock_32x32_C,       32, SimdLevel::C },
+    { "SSE2/8x8",      diffFullBlock_8x8_SSE2,       8, SimdLevel::SSE2 },
+    { "SSE2/16x16",    diffFullBlock_16x16_SSE2,    16, SimdLevel::SSE2 },
+    { "SSE2/32x32",    diffFullBlock_32x32_SSE2,    32, SimdLevel::SSE2 },
+    { "SSE3/8x8",      diffFullBlock_8x8_SSE3,       8, SimdLevel::SSSE3 },
+    { "SSE3/16x16",    diffFullBlock_16x16_SSE3,    16, SimdLevel::SSSE3 },
+    { "SSE3/32x32",    diffFullBlock_32x32_SSE3,    32, SimdLevel::SSSE3 },
+    { "AVX2/8x8",      diffFullBlock_8x8_AVX2,       8, SimdLevel::AVX2 },
+    { "AVX2/16x16",    diffFullBlock_16x16_AVX2,    16, SimdLevel::AVX2 },
+    { "AVX2/32x32",    diffFullBlock_32x32_AVX2,    32, SimdLevel::AVX2 },
+    { "AVX512/8x8",    diffFullBlock_8x8_AVX512,     8, SimdLevel::AVX512BW },
+    { "AVX512/16x16",  diffFullBlock_16x16_AVX512,  16, SimdLevel::AVX512BW },
+    { "AVX512/32x32",  diffFullBlock_32x32_AVX512,  32, SimdLevel::AVX512BW }
+};
+
+const int kKernelCount = sizeof(kKernels) / sizeof(kKernels[0]);
+
+std::string sizeName(const QSize& size)
+{
+    return std::to_string(size.width()) + "x" + std::to_string(size.height());
+}
+
+std::unique_ptr<Frame> copyFrame(const Frame* source)
+{
+    std::unique_ptr<Frame> frame = FrameAligned::create(source->size(), source->format(), 32);
+    memcpy(frame->frameData(), source->frameData(), source->stride() * source->size().height());
+    return frame;
+}
+
+// Reports the throughput in bytes of the compared frames and in frames per second. The time of
+// one iteration is the time per frame.
+void setFrameCounters(benchmark::State& state, const QSize& size)
+{
+    const int64_t frame_bytes = static_cast<int64_t>(size.width()) * size.height() *
+        kBytesPerPixel;
+
+    state.SetBytesProcessed(state.iterations() * frame_bytes * 2);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void sceneArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int scene = 0; scene <= static_cast<int>(FrameGenerator::Scene::FULLSCREEN_VIDEO); ++scene)
+    {
+        for (int size = 0; size < kScreenSizeCount; ++size)
+            benchmark->Args({ scene, size });
+    }
+}
+
+void BM_DifferCalcDirtyRegion(benchmark::State& state)
+{
+    const FrameGenerator::Scene scene = static_cast<FrameGenerator::Scene>(state.range(0));
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(scene, size);
+
+    std::unique_ptr<Frame> prev_frame = copyFrame(generator.frame());
+    const Frame* curr_frame = generator.nextFrame();
+
+    Differ differ(size);
+    QRegion dirty_region;
+
+    for (auto _ : state)
+    {
+        differ.calcDirtyRegion(prev_frame->frameData(), curr_frame->frameData(), &dirty_region);
+        benchmark::DoNotOptimize(dirty_region);
+    }
+
+    setFrameCounters(state, size);
+    state.SetLabel(std::string(FrameGenerator::sceneName(scene)) + "/" + sizeName(size));
+}
+
+BENCHMARK(BM_DifferCalcDirtyRegion)->Apply(sceneArguments);
+
+// The same as BM_DifferCalcDirtyRegion, but the region updated by the generator is passed to
+// Differ as the hint (as a capturer with the damage reported by the system does). The periodic
+// full scan is disabled, so only the cost of the hinted comparison is measured.
+void BM_DifferCalcDirtyRegionHinted(benchmark::State& state)
+{
+    const FrameGenerator::Scene scene = static_cast<FrameGenerator::Scene>(state.range(0));
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(scene, size);
+
+    std::unique_ptr<Frame> prev_frame = copyFrame(generator.frame());
+    const Frame* curr_frame = generator.nextFrame();
+
+    Differ differ(size);
+    differ.setFullScanInterval(0);
+
+    QRegion dirty_region;
+
+    for (auto _ : state)
+    {
+        differ.calcDirtyRegion(prev_frame->frameData(), curr_frame->frameData(), &dirty_region,
+                               &curr_frame->constUpdatedRegion());
+        benchmark::DoNotOptimize(dirty_region);
+    }
+
+    setFrameCounters(state, size);
+    state.counters["compared_blocks"] = differ.stats().compared_blocks;
+    state.SetLabel(std::string(FrameGenerator::sceneName(scene)) + "/" + sizeName(size));
+}
+
+BENCHMARK(BM_DifferCalcDirtyRegionHinted)->Apply(sceneArguments);
+
+// Runs Differ over the consecutive frames of the trace from the environment variable
+// ASPIA_BENCHMARK_TRACE (see FrameTraceWriter). The trace is decoded outside of the measured time.
+void BM_DifferCalcDirtyRegionTrace(benchmark::State& state)
+{
+    const char* trace_path = getenv("ASPIA_BENCHMARK_TRACE");
+    if (!trace_path)
+    {
+        state.SkipWithError("ASPIA_BENCHMARK_TRACE is not set");
+        return;
+    }
+
+    std::unique_ptr<FrameTraceReader> reader =
+        FrameTraceReader::open(QString::fromLocal8Bit(trace_path));
+    if (!reader || reader->frameCount() < 2)
+    {
+        state.SkipWithError("Unable to read the trace");
+        return;
+    }
+
+    std::unique_ptr<Frame> prev_frame;
+    std::unique_ptr<Differ> differ;
+    QRegion dirty_region;
+    int index = 0;
+    int64_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+
+        const Frame* curr_frame = reader->frame(index);
+        if (!curr_frame || !prev_frame || prev_frame->size() != curr_frame->size())
+        {
+            // Start over at the first frame or after a change of the screen size.
+            index = 0;
+            curr_frame = reader->frame(index);
+            if (!curr_frame)
+            {
+                state.SkipWithError("Unable to decode the trace");
+                break;
+            }
+
+            prev_frame = copyFrame(curr_frame);
+            differ = std::make_unique<Differ>(curr_frame->size());
+
+            curr_frame = reader->frame(++index);
+            if (!curr_frame || curr_frame->size() != prev_frame->size())
+            {
+                state.SkipWithError("Unable to decode the trace");
+                break;
+            }
+        }
+
+        state.ResumeTiming();
+
+        differ->calcDirtyRegion(prev_frame->frameData(), curr_frame->frameData(), &dirty_region);
+        benchmark::DoNotOptimize(dirty_region);
+
+        state.PauseTiming();
+        bytes += curr_frame->stride() * curr_frame->size().height() * 2;
+        prev_frame = copyFrame(curr_frame);
+        ++index;
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_DifferCalcDirtyRegionTrace);
+
+// Compares all blocks of two equal 1920x1080 images. This is the worst case for the kernels
+// because no block can be left early.
+void BM_DiffFullBlock(benchmark::State& state)
+{
+    const Kernel& kernel = kKernels[state.range(0)];
+    state.SetLabel(kernel.name);
+
+    if (simdLevel() < kernel.level)
+    {
+        state.SkipWithError("Not supported by the processor");
+        return;
+    }
+
+    const QSize& size = kScreenSizes[0];
+    const int bytes_per_row = size.width() * kBytesPerPixel;
+    const int bytes_per_block = kernel.block_size * kBytesPerPixel;
+    const int block_rows = size.height() / kernel.block_size;
+    const int block_columns = size.width() / kernel.block_size;
+
+    FrameGenerator generator(FrameGenerator::Scene::IDLE, size);
+    std::unique_ptr<Frame> prev_frame = copyFrame(generator.frame());
+    const Frame* curr_frame = generator.nextFrame();
+
+    for (auto _ : state)
+    {
+        uint8_t result = 0;
+
+        for (int y = 0; y < block_rows; ++y)
+        {
+            const int offset = y * kernel.block_size * bytes_per_row;
+            const uint8_t* prev = prev_frame->frameData() + offset;
+            const uint8_t* curr = curr_frame->frameData() + offset;
+
+            for (int x = 0; x < block_columns; ++x)
+            {
+                result |= kernel.func(prev, curr, bytes_per_row);
+
+                prev += bytes_per_block;
+                curr += bytes_per_block;
+            }
+        }
+
+        benchmark::DoNotOptimize(result);
+    }
+
+    setFrameCounters(state, size);
+}
+
+BENCHMARK(BM_DiffFullBlock)->DenseRange(0, kKernelCount - 1);
+
+} // namespace
+
+} // namespace desktop
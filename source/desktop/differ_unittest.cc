@@ -0,0 +1,379 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "desktop/differ.h"
+
+namespace desktop {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+
+// Number of frames compared for each screen size.
+const int kFrameCount = 20;
+
+class TestImages
+{
+public:
+    explicit TestImages(const QSize& size)
+        : size_(size),
+          prev_(size.width() * size.height() * kBytesPerPixel),
+          curr_(prev_.size()),
+          random_(size.width() * size.height())
+    {
+        for (auto& byte : prev_)
+            byte = static_cast<uint8_t>(random_());
+
+        curr_ = prev_;
+    }
+
+    const QSize& size() const { return size_; }
+    const uint8_t* prev() const { return prev_.data(); }
+    const uint8_t* curr() const { return curr_.data(); }
+
+    // Changes one pixel of |curr| image.
+    void modifyPixel(int x, int y)
+    {
+        prev_ = curr_;
+        changePixel(x, y);
+    }
+
+    // Changes all pixels of |curr| image.
+    void modifyAll()
+    {
+        prev_ = curr_;
+
+        for (auto& byte : curr_)
+            byte = ~byte;
+    }
+
+    // Changes random pixels and rectangles of |curr| image.
+    void modify()
+    {
+        prev_ = curr_;
+
+        std::uniform_int_distribution<int> x_dist(0, size_.width() - 1);
+        std::uniform_int_distribution<int> y_dist(0, size_.height() - 1);
+
+        for (int i = 0; i < 32; ++i)
+            changePixel(x_dist(random_), y_dist(random_));
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const int left = x_dist(random_);
+            const int top = y_dist(random_);
+            const int right = std::min(left + x_dist(random_) / 4, size_.width() - 1);
+            const int bottom = std::min(top + y_dist(random_) / 4, size_.height() - 1);
+
+            for (int y = top; y <= bottom; ++y)
+            {
+                for (int x = left; x <= right; ++x)
+                    changePixel(x, y);
+            }
+        }
+
+        // The last pixel of the screen is in the partial block (if it exists).
+        changePixel(size_.width() - 1, size_.height() - 1);
+    }
+
+private:
+    void changePixel(int x, int y)
+    {
+        curr_[(y * size_.width() + x) * kBytesPerPixel] += 1;
+    }
+
+    const QSize size_;
+    std::vector<uint8_t> prev_;
+    std::vector<uint8_t> curr_;
+    std::mt19937 random_;
+};
+
+void compareThreadCounts(const QSize& size, int thread_count)
+{
+    Differ single_differ(size, 1);
+    Differ multi_differ(size, thread_count);
+
+    EXPECT_EQ(1, single_differ.threadCount());
+
+    TestImages images(size);
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        images.modify();
+
+        QRegion single_region;
+        QRegion multi_region;
+
+        single_differ.calcDirtyRegion(images.prev(), images.curr(), &single_region);
+        multi_differ.calcDirtyRegion(images.prev(), images.curr(), &multi_region);
+
+        EXPECT_FALSE(single_region.isEmpty());
+        EXPECT_TRUE(single_region == multi_region);
+        EXPECT_TRUE(single_region.contains(QPoint(size.width() - 1, size.height() - 1)));
+    }
+}
+
+// Compares the images block by block and returns the region of the changed blocks.
+QRegion changedBlocks(const TestImages& images, int block_size)
+{
+    const QSize& size = images.size();
+    QRegion region;
+
+    for (int top = 0; top < size.height(); top += block_size)
+    {
+        for (int left = 0; left < size.width(); left += block_size)
+        {
+            const QRect block =
+                QRect(left, top, block_size, block_size).intersected(QRect(QPoint(), size));
+
+            for (int y = block.top(); y <= block.bottom(); ++y)
+            {
+                const size_t offset = (y * size.width() + block.left()) * kBytesPerPixel;
+
+                if (memcmp(images.prev() + offset, images.curr() + offset,
+                           block.width() * kBytesPerPixel) != 0)
+                {
+                    region += block;
+                    break;
+                }
+            }
+        }
+    }
+
+    return region;
+}
+
+void compareWithChangedBlocks(const QSize& size, int block_size)
+{
+    Differ differ(size, 1);
+    differ.setBlockSize(block_size);
+
+    TestImages images(size);
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        images.modify();
+
+        QRegion region;
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region);
+
+        EXPECT_EQ(block_size, differ.stats().block_size);
+        EXPECT_TRUE(region == changedBlocks(images, block_size));
+    }
+}
+
+} // namespace
+
+TEST(differ_test, same_images)
+{
+    const QSize size(1280, 720);
+
+    Differ differ(size, 4);
+    TestImages images(size);
+
+    QRegion region;
+    differ.calcDirtyRegion(images.prev(), images.prev(), &region);
+
+    EXPECT_TRUE(region.isEmpty());
+}
+
+TEST(differ_test, multi_thread_same_as_single_thread)
+{
+    compareThreadCounts(QSize(1920, 1080), 4);
+    compareThreadCounts(QSize(3840, 2160), 8);
+}
+
+TEST(differ_test, multi_thread_partial_blocks)
+{
+    // Width and height are not multiples of the block size.
+    compareThreadCounts(QSize(1366, 767), 3);
+    compareThreadCounts(QSize(1023, 61), 2);
+}
+
+TEST(differ_test, region_matches_changed_blocks)
+{
+    // The number of block columns is less than, equal to and greater than the number of bits
+    // in a word of the dirty map.
+    for (int block_size : { 8, 16, 32 })
+    {
+        compareWithChangedBlocks(QSize(400, 300), block_size);
+        compareWithChangedBlocks(QSize(512, 64), block_size);
+        compareWithChangedBlocks(QSize(1366, 767), block_size);
+    }
+}
+
+TEST(differ_test, partial_column_is_last_bit_of_word)
+{
+    // The partial column is the last bit of a word of the dirty map, so the number of block
+    // columns is a multiple of the word size.
+    compareWithChangedBlocks(QSize(1017, 64), 8);
+    compareWithChangedBlocks(QSize(1020, 64), 8);
+    compareWithChangedBlocks(QSize(1023, 64), 8);
+    compareWithChangedBlocks(QSize(1009, 64), 16);
+    compareWithChangedBlocks(QSize(1023, 64), 16);
+    compareWithChangedBlocks(QSize(2017, 64), 32);
+    compareWithChangedBlocks(QSize(2047, 64), 32);
+    compareWithChangedBlocks(QSize(4065, 64), 32);
+    compareWithChangedBlocks(QSize(4095, 64), 32);
+}
+
+TEST(differ_test, adaptive_block_size)
+{
+    const QSize size(1366, 767);
+
+    Differ differ(size, 1);
+    TestImages images(size);
+
+    EXPECT_EQ(8, differ.stats().block_size);
+
+    // Full-screen changes switch the differ to the largest blocks.
+    for (int i = 0; i < 50; ++i)
+    {
+        const int block_size = differ.stats().block_size;
+
+        images.modifyAll();
+
+        QRegion region;
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region);
+
+        EXPECT_TRUE(region == changedBlocks(images, block_size));
+    }
+
+    EXPECT_EQ(32, differ.stats().block_size);
+    EXPECT_EQ(2, differ.stats().block_size_changes);
+
+    // Small changes switch it back to the smallest blocks.
+    for (int i = 0; i < 100; ++i)
+    {
+        const int block_size = differ.stats().block_size;
+
+        images.modifyPixel((i * 37) % size.width(), (i * 11) % size.height());
+
+        QRegion region;
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region);
+
+        EXPECT_TRUE(region == changedBlocks(images, block_size));
+    }
+
+    EXPECT_EQ(8, differ.stats().block_size);
+    EXPECT_EQ(4, differ.stats().block_size_changes);
+}
+
+TEST(differ_test, full_screen_change)
+{
+    const QSize size(1366, 767);
+
+    Differ differ(size, 1);
+    TestImages images(size);
+
+    std::vector<uint8_t> inverted(images.prev(),
+                                  images.prev() + size.width() * size.height() * kBytesPerPixel);
+    for (auto& byte : inverted)
+        byte = ~byte;
+
+    QRegion region;
+    differ.calcDirtyRegion(images.prev(), inverted.data(), &region);
+
+    EXPECT_TRUE(region == QRegion(QRect(QPoint(), size)));
+}
+
+TEST(differ_test, hint_region)
+{
+    const QSize size(1366, 767);
+
+    for (int thread_count : { 1, 4 })
+    {
+        Differ differ(size, thread_count);
+        differ.setBlockSize(16);
+        differ.setFullScanInterval(0);
+
+        TestImages images(size);
+        QRegion region;
+
+        // The hinted changes are found exactly as without the hint.
+        images.modify();
+        const QRegion changed_blocks = changedBlocks(images, 16);
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region, &changed_blocks);
+        EXPECT_TRUE(region == changed_blocks);
+
+        // The changes near the hint are found due to the margin.
+        images.modifyPixel(105, 203);
+        const QRegion near_hint(QRect(100, 200, 4, 2));
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region, &near_hint);
+        EXPECT_TRUE(region == QRegion(QRect(96, 192, 16, 16)));
+
+        // The changes far from the hint are not found.
+        images.modifyPixel(size.width() - 1, size.height() - 1);
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region, &near_hint);
+        EXPECT_TRUE(region.isEmpty());
+        EXPECT_LT(differ.stats().compared_blocks, 16);
+
+        // An empty hint means that nothing was changed.
+        const QRegion empty_hint;
+        images.modifyAll();
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region, &empty_hint);
+        EXPECT_TRUE(region.isEmpty());
+        EXPECT_EQ(0, differ.stats().compared_blocks);
+    }
+}
+
+TEST(differ_test, full_scan_catches_missed_hints)
+{
+    const QSize size(1280, 720);
+    const int interval = 10;
+
+    Differ differ(size, 1);
+    differ.setBlockSize(8);
+    differ.setFullScanInterval(interval);
+
+    TestImages images(size);
+
+    const QRegion empty_hint;
+    QRegion region;
+
+    for (int i = 1; i <= interval * 2; ++i)
+    {
+        images.modifyPixel(size.width() / 2, size.height() / 2);
+        differ.calcDirtyRegion(images.prev(), images.curr(), &region, &empty_hint);
+
+        // Every |interval| frame compares the whole screen.
+        if (i % interval == 0)
+        {
+            EXPECT_TRUE(region == QRegion(QRect(640, 360, 8, 8)));
+            EXPECT_EQ(160 * 90, differ.stats().compared_blocks);
+        }
+        else
+        {
+            EXPECT_TRUE(region.isEmpty());
+        }
+    }
+}
+
+TEST(differ_test, thread_count_limited_for_small_screen)
+{
+    Differ differ(QSize(64, 16), 8);
+    EXPECT_EQ(1, differ.threadCount());
+}
+
+} // namespace desktop
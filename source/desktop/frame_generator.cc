@@ -0,0 +1,368 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/frame_generator.h"
+
+#include "base/logging.h"
+#include "desktop/desktop_frame_aligned.h"
+
+#include <cstring>
+
+namespace desktop {
+
+namespace {
+
+const int kGlyphWidth = 8;
+const int kGlyphHeight = 16;
+
+// Number of text lines that are scrolled per frame.
+const int kScrollLines = 3;
+
+// Distance in pixels by which the window is moved per frame.
+const int kWindowStep = 12;
+
+const int kTitleHeight = 24;
+const int kBorderWidth = 8;
+
+const uint32_t kPaperColor = 0xFFFFFFFF;
+const uint32_t kTextColor = 0xFF202020;
+const uint32_t kTitleColor = 0xFF2B579A;
+const uint32_t kBorderColor = 0xFFE0E0E0;
+
+uint32_t* pixelAt(Frame* frame, int x, int y)
+{
+    return reinterpret_cast<uint32_t*>(frame->frameDataAtPos(x, y));
+}
+
+void fillRect(Frame* frame, const QRect& rect, uint32_t color)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* pixel = pixelAt(frame, rect.left(), y);
+
+        for (int x = 0; x < rect.width(); ++x)
+            pixel[x] = color;
+    }
+}
+
+} // namespace
+
+FrameGenerator::FrameGenerator(Scene scene, const QSize& size, uint32_t seed)
+    : scene_(scene),
+      random_state_(seed * 2654435761U + 1)
+{
+    frame_ = FrameAligned::create(size, PixelFormat::ARGB(), 32);
+    CHECK(frame_);
+
+    const QRect screen_rect(QPoint(), size);
+
+    // The text is aligned to the glyph grid.
+    content_rect_ = QRect(size.width() / 8, size.height() / 8,
+                          (size.width() * 3 / 4) / kGlyphWidth * kGlyphWidth,
+                          (size.height() * 3 / 4) / kGlyphHeight * kGlyphHeight);
+
+    drawBackground(screen_rect);
+
+    switch (scene_)
+    {
+        case Scene::IDLE:
+        case Scene::SCROLLING:
+            drawFrame(content_rect_);
+            drawText(content_rect_);
+            break;
+
+        case Scene::TYPING:
+            drawFrame(content_rect_);
+            fillRect(frame_.get(), content_rect_, kPaperColor);
+            cursor_pos_ = content_rect_.topLeft();
+            break;
+
+        case Scene::MOVING_WINDOW:
+        {
+            window_rect_ = QRect(size.width() / 10, size.height() / 10,
+                                 size.width() / 3, size.height() / 3);
+            window_step_ = QPoint(kWindowStep, kWindowStep / 2);
+
+            // The window picture is drawn once in place and then kept aside.
+            fillRect(frame_.get(), QRect(window_rect_.topLeft(),
+                                         QSize(window_rect_.width(), kTitleHeight)),
+                     kTitleColor);
+            drawText(window_rect_.adjusted(0, kTitleHeight, 0, 0));
+
+            window_image_.resize(window_rect_.width() * window_rect_.height());
+            for (int y = 0; y < window_rect_.height(); ++y)
+            {
+                memcpy(&window_image_[y * window_rect_.width()],
+                       pixelAt(frame_.get(), window_rect_.left(), window_rect_.top() + y),
+                       window_rect_.width() * sizeof(uint32_t));
+            }
+        }
+        break;
+
+        case Scene::VIDEO:
+        {
+            // 16:9 video in the middle of the screen.
+            const int width = size.width() / 2;
+            const int height = width * 9 / 16;
+
+            content_rect_ = QRect((size.width() - width) / 2, (size.height() - height) / 2,
+                                  width, height);
+            drawVideo(content_rect_);
+        }
+        break;
+
+        case Scene::FULLSCREEN_VIDEO:
+            content_rect_ = screen_rect;
+            drawVideo(content_rect_);
+            break;
+
+        default:
+            NOTREACHED();
+            break;
+    }
+
+    *frame_->updatedRegion() = QRegion(screen_rect);
+}
+
+FrameGenerator::~FrameGenerator() = default;
+
+// static
+const char* FrameGenerator::sceneName(Scene scene)
+{
+    switch (scene)
+    {
+        case Scene::IDLE:
+            return "idle";
+
+        case Scene::TYPING:
+            return "typing";
+
+        case Scene::SCROLLING:
+            return "scrolling";
+
+        case Scene::MOVING_WINDOW:
+            return "moving_window";
+
+        case Scene::VIDEO:
+            return "video";
+
+        case Scene::FULLSCREEN_VIDEO:
+            return "fullscreen_video";
+
+        default:
+            NOTREACHED();
+            return "unknown";
+    }
+}
+
+Frame* FrameGenerator::nextFrame()
+{
+    ++frame_number_;
+
+    *frame_->updatedRegion() = QRegion();
+    frame_->moveList()->clear();
+
+    switch (scene_)
+    {
+        case Scene::IDLE:
+            break;
+
+        case Scene::TYPING:
+            typeCharacter();
+            break;
+
+        case Scene::SCROLLING:
+            scrollText();
+            break;
+
+        case Scene::MOVING_WINDOW:
+            moveWindow();
+            break;
+
+        case Scene::VIDEO:
+        case Scene::FULLSCREEN_VIDEO:
+            drawVideo(content_rect_);
+            *frame_->updatedRegion() += content_rect_;
+            break;
+
+        default:
+            NOTREACHED();
+            break;
+    }
+
+    return frame_.get();
+}
+
+uint32_t FrameGenerator::nextRandom()
+{
+    // Xorshift is enough here and much faster than the generators from <random>.
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 17;
+    random_state_ ^= random_state_ << 5;
+    return random_state_;
+}
+
+uint32_t FrameGenerator::backgroundPixel(int x, int y) const
+{
+    const QSize& size = frame_->size();
+
+    return 0xFF000080 |
+        static_cast<uint32_t>(x * 255 / size.width()) << 16 |
+        static_cast<uint32_t>(y * 255 / size.height()) << 8;
+}
+
+void FrameGenerator::drawBackground(const QRect& rect)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* pixel = pixelAt(frame_.get(), rect.left(), y);
+
+        for (int x = 0; x < rect.width(); ++x)
+            pixel[x] = backgroundPixel(rect.left() + x, y);
+    }
+}
+
+void FrameGenerator::drawFrame(const QRect& rect)
+{
+    const QRect screen_rect(QPoint(), frame_->size());
+    const QRect frame_rect =
+        rect.adjusted(-kBorderWidth, -kTitleHeight, kBorderWidth, kBorderWidth);
+    const QRect title_rect(frame_rect.topLeft(), QSize(frame_rect.width(), kTitleHeight));
+
+    fillRect(frame_.get(), frame_rect.intersected(screen_rect), kBorderColor);
+    fillRect(frame_.get(), title_rect.intersected(screen_rect), kTitleColor);
+}
+
+void FrameGenerator::drawGlyph(const QPoint& pos)
+{
+    // The top and bottom rows of the glyph are left empty as the line spacing.
+    for (int y = 0; y < kGlyphHeight; ++y)
+    {
+        uint32_t* pixel = pixelAt(frame_.get(), pos.x(), pos.y() + y);
+        const uint32_t bits = (y >= 3 && y < kGlyphHeight - 3) ? nextRandom() : 0;
+
+        for (int x = 0; x < kGlyphWidth; ++x)
+            pixel[x] = (bits & (1 << x)) ? kTextColor : kPaperColor;
+    }
+}
+
+void FrameGenerator::drawText(const QRect& rect)
+{
+    fillRect(frame_.get(), rect, kPaperColor);
+
+    for (int y = rect.top(); y + kGlyphHeight <= rect.bottom() + 1; y += kGlyphHeight)
+    {
+        // Lines have different lengths.
+        const int line_length = rect.width() / 2 + nextRandom() % (rect.width() / 2 + 1);
+
+        for (int x = 0; x + kGlyphWidth <= line_length; x += kGlyphWidth)
+        {
+            // Spaces between words.
+            if (nextRandom() % 6 == 0)
+                continue;
+
+            drawGlyph(QPoint(rect.left() + x, y));
+        }
+    }
+}
+
+void FrameGenerator::drawWindow()
+{
+    for (int y = 0; y < window_rect_.height(); ++y)
+    {
+        memcpy(pixelAt(frame_.get(), window_rect_.left(), window_rect_.top() + y),
+               &window_image_[y * window_rect_.width()],
+               window_rect_.width() * sizeof(uint32_t));
+    }
+}
+
+void FrameGenerator::drawVideo(const QRect& rect)
+{
+    // A moving gradient with noise. Every pixel is changed in each frame, as in a real video.
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* pixel = pixelAt(frame_.get(), rect.left(), y);
+        const uint32_t green = static_cast<uint32_t>(y + frame_number_ * 2) & 0xFF;
+
+        for (int x = 0; x < rect.width(); ++x)
+        {
+            const uint32_t red = static_cast<uint32_t>(x + frame_number_ * 4) & 0xFF;
+            pixel[x] = 0xFF000000 | red << 16 | green << 8 | (nextRandom() & 0x3F);
+        }
+    }
+}
+
+void FrameGenerator::typeCharacter()
+{
+    QRegion* updated_region = frame_->updatedRegion();
+
+    // The page is full. Start a new one.
+    if (cursor_pos_.y() + kGlyphHeight > content_rect_.bottom() + 1)
+    {
+        fillRect(frame_.get(), content_rect_, kPaperColor);
+        *updated_region += content_rect_;
+        cursor_pos_ = content_rect_.topLeft();
+    }
+
+    drawGlyph(cursor_pos_);
+    *updated_region += QRect(cursor_pos_, QSize(kGlyphWidth, kGlyphHeight));
+
+    cursor_pos_.setX(cursor_pos_.x() + kGlyphWidth);
+
+    if (cursor_pos_.x() + kGlyphWidth > content_rect_.right() + 1 || nextRandom() % 60 == 0)
+    {
+        cursor_pos_.setX(content_rect_.left());
+        cursor_pos_.setY(cursor_pos_.y() + kGlyphHeight);
+    }
+}
+
+void FrameGenerator::scrollText()
+{
+    const int offset = kScrollLines * kGlyphHeight;
+
+    frame_->moveRect(content_rect_.adjusted(0, offset, 0, 0), content_rect_.topLeft());
+    drawText(QRect(content_rect_.left(), content_rect_.bottom() - offset + 1,
+                   content_rect_.width(), offset));
+
+    *frame_->updatedRegion() += content_rect_;
+}
+
+void FrameGenerator::moveWindow()
+{
+    const QRect screen_rect(QPoint(), frame_->size());
+    const QRect old_rect = window_rect_;
+
+    QRect new_rect = old_rect.translated(window_step_);
+
+    // Bounce off the edges of the screen.
+    if (new_rect.left() < 0 || new_rect.right() > screen_rect.right())
+        window_step_.setX(-window_step_.x());
+    if (new_rect.top() < 0 || new_rect.bottom() > screen_rect.bottom())
+        window_step_.setY(-window_step_.y());
+
+    window_rect_ = old_rect.translated(window_step_);
+
+    drawBackground(old_rect);
+    drawWindow();
+
+    QRegion* updated_region = frame_->updatedRegion();
+    *updated_region += old_rect;
+    *updated_region += window_rect_;
+}
+
+} // namespace desktop
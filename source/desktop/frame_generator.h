@@ -0,0 +1,99 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_GENERATOR_H
+#define DESKTOP__FRAME_GENERATOR_H
+
+#include <QRect>
+
+#include <memory>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace desktop {
+
+class Frame;
+
+// Draws a deterministic sequence of synthetic screen frames that looks like typical desktop
+// activity. It is used for benchmarks and for testing the capture pipeline without a real
+// screen. The same scene, size and seed always produce the same frames.
+class FrameGenerator
+{
+public:
+    enum class Scene
+    {
+        IDLE,             // Nothing changes.
+        TYPING,           // One character is printed in a text window per frame.
+        SCROLLING,        // The text window is scrolled by several lines per frame.
+        MOVING_WINDOW,    // A window is dragged across the desktop.
+        VIDEO,            // A video is played in a window.
+        FULLSCREEN_VIDEO  // A video is played on the whole screen.
+    };
+
+    FrameGenerator(Scene scene, const QSize& size, uint32_t seed = 0);
+    ~FrameGenerator();
+
+    static const char* sceneName(Scene scene);
+
+    // Draws the next frame and returns it. The updated region of the frame contains the areas
+    // that were changed since the previous frame. The frame is valid until the next call.
+    Frame* nextFrame();
+
+    // Returns the last drawn frame. Before the first call of nextFrame() the frame contains the
+    // initial picture with the whole screen in the updated region.
+    Frame* frame() const { return frame_.get(); }
+
+private:
+    uint32_t nextRandom();
+
+    uint32_t backgroundPixel(int x, int y) const;
+    void drawBackground(const QRect& rect);
+
+    // Draws the title and the border of a window around |rect|.
+    void drawFrame(const QRect& rect);
+    void drawGlyph(const QPoint& pos);
+    void drawText(const QRect& rect);
+    void drawWindow();
+    void drawVideo(const QRect& rect);
+
+    void typeCharacter();
+    void scrollText();
+    void moveWindow();
+
+    const Scene scene_;
+    std::unique_ptr<Frame> frame_;
+
+    // Area of the text window or the video.
+    QRect content_rect_;
+
+    // Window for Scene::MOVING_WINDOW. Its picture is stored in |window_image_|.
+    QRect window_rect_;
+    QPoint window_step_;
+    std::vector<uint32_t> window_image_;
+
+    QPoint cursor_pos_;
+    uint32_t random_state_;
+    int frame_number_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(FrameGenerator);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_GENERATOR_H
@@ -0,0 +1,214 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/frame_pool.h"
+
+#include "base/aligned_memory.h"
+#include "base/logging.h"
+#include "desktop/desktop_frame.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace desktop {
+
+namespace {
+
+const size_t kAlignment = 64;
+
+// The buffer sizes are rounded up to this value, so frames of close sizes get the same buffers.
+const size_t kBufferGranularity = 64 * 1024;
+
+// The page size is at least 4 kB on all supported platforms.
+const size_t kPageSize = 4096;
+
+size_t bufferCapacity(size_t size)
+{
+    return (size + kBufferGranularity - 1) / kBufferGranularity * kBufferGranularity;
+}
+
+} // namespace
+
+class FramePool::Core
+{
+public:
+    explicit Core(size_t max_cached_bytes)
+        : max_cached_bytes_(max_cached_bytes)
+    {
+        // Nothing
+    }
+
+    ~Core()
+    {
+        clear();
+    }
+
+    uint8_t* acquire(size_t size, size_t* capacity)
+    {
+        {
+            std::scoped_lock lock(lock_);
+
+            // The smallest buffer that is large enough.
+            auto it = buffers_.lower_bound(size);
+            if (it != buffers_.end() && it->first - size <= it->first / 4)
+            {
+                uint8_t* data = it->second;
+                *capacity = it->first;
+
+                cached_bytes_ -= it->first;
+                buffers_.erase(it);
+                ++stats_.hits;
+                return data;
+            }
+
+            ++stats_.misses;
+        }
+
+        *capacity = bufferCapacity(size);
+
+        uint8_t* data = reinterpret_cast<uint8_t*>(base::alignedAlloc(*capacity, kAlignment));
+        if (!data)
+            return nullptr;
+
+        // Touch each page to commit the memory now rather than on the first access.
+        for (size_t offset = 0; offset < *capacity; offset += kPageSize)
+            data[offset] = 0;
+
+        return data;
+    }
+
+    void release(uint8_t* data, size_t capacity)
+    {
+        {
+            std::scoped_lock lock(lock_);
+
+            if (cached_bytes_ + capacity <= max_cached_bytes_)
+            {
+                buffers_.emplace(capacity, data);
+                cached_bytes_ += capacity;
+                return;
+            }
+        }
+
+        base::alignedFree(data);
+    }
+
+    void clear()
+    {
+        std::multimap<size_t, uint8_t*> buffers;
+
+        {
+            std::scoped_lock lock(lock_);
+            buffers.swap(buffers_);
+            cached_bytes_ = 0;
+        }
+
+        for (const auto& buffer : buffers)
+            base::alignedFree(buffer.second);
+    }
+
+    Stats stats() const
+    {
+        std::scoped_lock lock(lock_);
+
+        Stats stats = stats_;
+        stats.cached_buffers = static_cast<int>(buffers_.size());
+        stats.cached_bytes = static_cast<int64_t>(cached_bytes_);
+        return stats;
+    }
+
+private:
+    const size_t max_cached_bytes_;
+
+    mutable std::mutex lock_;
+    std::multimap<size_t, uint8_t*> buffers_;
+    size_t cached_bytes_ = 0;
+    Stats stats_;
+
+    DISALLOW_COPY_AND_ASSIGN(Core);
+};
+
+class FramePool::PooledFrame : public Frame
+{
+public:
+    PooledFrame(const QSize& size, const PixelFormat& format, int stride, uint8_t* data,
+                size_t capacity, std::shared_ptr<Core> core)
+        : Frame(size, format, stride, data),
+          capacity_(capacity),
+          core_(std::move(core))
+    {
+        // Nothing
+    }
+
+    ~PooledFrame()
+    {
+        core_->release(data_, capacity_);
+    }
+
+private:
+    const size_t capacity_;
+    std::shared_ptr<Core> core_;
+
+    DISALLOW_COPY_AND_ASSIGN(PooledFrame);
+};
+
+FramePool::FramePool(size_t max_cached_bytes)
+    : core_(std::make_shared<Core>(max_cached_bytes))
+{
+    // Nothing
+}
+
+FramePool::~FramePool() = default;
+
+// static
+FramePool* FramePool::instance()
+{
+    static FramePool pool;
+    return &pool;
+}
+
+std::unique_ptr<Frame> FramePool::create(const QSize& size, const PixelFormat& format)
+{
+    if (size.isEmpty())
+        return nullptr;
+
+    const int stride = size.width() * format.bytesPerPixel();
+
+    size_t capacity;
+    uint8_t* data = core_->acquire(static_cast<size_t>(stride) * size.height(), &capacity);
+    if (!data)
+    {
+        LOG(LS_WARNING) << "Unable to allocate frame buffer";
+        return nullptr;
+    }
+
+    return std::make_unique<PooledFrame>(size, format, stride, data, capacity, core_);
+}
+
+void FramePool::clear()
+{
+    core_->clear();
+}
+
+FramePool::Stats FramePool::stats() const
+{
+    return core_->stats();
+}
+
+} // namespace desktop
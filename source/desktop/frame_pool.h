@@ -0,0 +1,86 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_POOL_H
+#define DESKTOP__FRAME_POOL_H
+
+#include <QSize>
+
+#include <cstdint>
+#include <memory>
+
+#include "base/macros_magic.h"
+
+namespace desktop {
+
+class Frame;
+class PixelFormat;
+
+// Recycles the buffers of frames. Screen frames take several megabytes and are reallocated each
+// time the screen size, the scale or the pixel format changes. Allocating them anew causes
+// allocation spikes and page faults in the capture thread.
+//
+// The frames created by the pool return their buffers to it when they are destroyed. A released
+// buffer is reused for any frame that fits into it without wasting more than a quarter of the
+// buffer. New buffers are touched once when allocated, so the pages are committed before the
+// frame is used. The pool is thread-safe and the frames may outlive it.
+class FramePool
+{
+public:
+    struct Stats
+    {
+        // Number of frames created with a recycled buffer.
+        int64_t hits = 0;
+
+        // Number of frames for which a new buffer was allocated.
+        int64_t misses = 0;
+
+        // Number and total size of the buffers that are waiting for reuse.
+        int cached_buffers = 0;
+        int64_t cached_bytes = 0;
+    };
+
+    explicit FramePool(size_t max_cached_bytes = kDefaultMaxCachedBytes);
+    ~FramePool();
+
+    // The pool shared by all frame producers of the process.
+    static FramePool* instance();
+
+    // Creates a frame. Its stride is |size.width() * format.bytesPerPixel()| and the data is
+    // aligned to 64 bytes. The pixels are not initialized. Returns nullptr if there is no memory.
+    std::unique_ptr<Frame> create(const QSize& size, const PixelFormat& format);
+
+    // Frees all cached buffers.
+    void clear();
+
+    Stats stats() const;
+
+private:
+    static const size_t kDefaultMaxCachedBytes = 256 * 1024 * 1024;
+
+    class Core;
+    class PooledFrame;
+
+    std::shared_ptr<Core> core_;
+
+    DISALLOW_COPY_AND_ASSIGN(FramePool);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_POOL_H
@@ -0,0 +1,99 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_pool.h"
+
+namespace desktop {
+
+TEST(frame_pool_test, reuse)
+{
+    FramePool pool;
+
+    std::unique_ptr<Frame> frame = pool.create(QSize(1920, 1080), PixelFormat::ARGB());
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(QSize(1920, 1080), frame->size());
+    EXPECT_EQ(1920 * 4, frame->stride());
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(frame->frameData()) % 64);
+
+    uint8_t* data = frame->frameData();
+    frame.reset();
+
+    EXPECT_EQ(1, pool.stats().cached_buffers);
+
+    // The same size.
+    frame = pool.create(QSize(1920, 1080), PixelFormat::ARGB());
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(data, frame->frameData());
+    frame.reset();
+
+    // A slightly smaller frame uses the same buffer.
+    frame = pool.create(QSize(1910, 1070), PixelFormat::ARGB());
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(data, frame->frameData());
+    frame.reset();
+
+    // The buffer is too large for this frame.
+    frame = pool.create(QSize(640, 480), PixelFormat::ARGB());
+    ASSERT_TRUE(frame);
+    EXPECT_NE(data, frame->frameData());
+
+    FramePool::Stats stats = pool.stats();
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(2, stats.misses);
+    EXPECT_EQ(1, stats.cached_buffers);
+
+    pool.clear();
+    EXPECT_EQ(0, pool.stats().cached_buffers);
+    EXPECT_EQ(0, pool.stats().cached_bytes);
+}
+
+TEST(frame_pool_test, cache_limit)
+{
+    FramePool pool(300 * 1024);
+
+    std::unique_ptr<Frame> frame1 = pool.create(QSize(256, 256), PixelFormat::ARGB());
+    std::unique_ptr<Frame> frame2 = pool.create(QSize(256, 256), PixelFormat::ARGB());
+    ASSERT_TRUE(frame1 && frame2);
+
+    frame1.reset();
+    frame2.reset();
+
+    // Only one buffer fits into the limit.
+    EXPECT_EQ(1, pool.stats().cached_buffers);
+    EXPECT_EQ(256 * 256 * 4, pool.stats().cached_bytes);
+}
+
+TEST(frame_pool_test, frame_outlives_pool)
+{
+    std::unique_ptr<Frame> frame;
+
+    {
+        FramePool pool;
+        frame = pool.create(QSize(100, 100), PixelFormat::RGB565());
+        ASSERT_TRUE(frame);
+        EXPECT_EQ(200, frame->stride());
+    }
+
+    memset(frame->frameData(), 0, frame->stride() * frame->size().height());
+    frame.reset();
+}
+
+} // namespace desktop
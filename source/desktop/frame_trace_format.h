@@ -0,0 +1,97 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_TRACE_FORMAT_H
+#define DESKTOP__FRAME_TRACE_FORMAT_H
+
+#include <cstdint>
+
+// Layout of the frame trace file. All values are little-endian.
+//
+// The file starts with TraceHeader and is followed by the frame records. Each record consists of
+// TraceFrameHeader, the rectangles of the updated region (TraceRect), the moves (TraceMove) and
+// the pixel data compressed with zstd. The index (an array of TraceIndexEntry, one per frame) is
+// written at the end of the file when the recording is finished.
+//
+// A key frame contains all pixels of the frame. A delta frame contains the pixels of the updated
+// region and of the move targets XORed with the previous frame after the moves are applied to it.
+// The rectangles are stored row by row in the order of the region rectangles followed by the
+// move targets.
+
+namespace desktop {
+
+const char kTraceMagic[8] = { 'A', 'S', 'P', 'T', 'R', 'A', 'C', 'E' };
+const uint32_t kTraceVersion = 1;
+
+enum TraceFrameType : uint32_t
+{
+    TRACE_KEY_FRAME = 0,
+    TRACE_DELTA_FRAME = 1
+};
+
+struct TraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t frame_count;
+    uint64_t index_offset;
+};
+
+struct TraceFrameHeader
+{
+    uint32_t type;
+    int32_t width;
+    int32_t height;
+    uint32_t rect_count;
+    uint32_t move_count;
+    uint32_t data_size;
+    int64_t timestamp_us;
+};
+
+struct TraceRect
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+struct TraceMove
+{
+    TraceRect source_rect;
+    int32_t target_x;
+    int32_t target_y;
+};
+
+struct TraceIndexEntry
+{
+    uint64_t offset;
+    int64_t timestamp_us;
+    uint32_t key_frame;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TraceHeader) == 24, "Unexpected size of TraceHeader");
+static_assert(sizeof(TraceFrameHeader) == 32, "Unexpected size of TraceFrameHeader");
+static_assert(sizeof(TraceRect) == 16, "Unexpected size of TraceRect");
+static_assert(sizeof(TraceMove) == 24, "Unexpected size of TraceMove");
+static_assert(sizeof(TraceIndexEntry) == 24, "Unexpected size of TraceIndexEntry");
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_TRACE_FORMAT_H
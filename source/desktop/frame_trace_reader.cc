@@ -0,0 +1,305 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/frame_trace_reader.h"
+
+#include <QFile>
+
+#include <zstd.h>
+
+#include "base/logging.h"
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_pool.h"
+
+#include <cstring>
+
+namespace desktop {
+
+namespace {
+
+// Maximum width and height of a frame in the trace. Protects from huge allocations when the file
+// is damaged.
+const int kMaxFrameSize = 16384;
+
+QRect toQRect(const TraceRect& rect)
+{
+    return QRect(rect.x, rect.y, rect.width, rect.height);
+}
+
+template <typename T>
+bool readValue(const uint8_t* data, uint64_t size, uint64_t* offset, T* value)
+{
+    if (*offset > size || size - *offset < sizeof(T))
+        return false;
+
+    memcpy(value, data + *offset, sizeof(T));
+    *offset += sizeof(T);
+    return true;
+}
+
+} // namespace
+
+FrameTraceReader::FrameTraceReader(std::unique_ptr<QFile> file, const uint8_t* data, uint64_t size)
+    : file_(std::move(file)),
+      data_(data),
+      size_(size)
+{
+    // Nothing
+}
+
+FrameTraceReader::~FrameTraceReader() = default;
+
+// static
+std::unique_ptr<FrameTraceReader> FrameTraceReader::open(const QString& file_path)
+{
+    std::unique_ptr<QFile> file = std::make_unique<QFile>(file_path);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        LOG(LS_WARNING) << "Unable to open trace file: " << file_path.toStdString();
+        return nullptr;
+    }
+
+    const qint64 size = file->size();
+
+    const uint8_t* data = file->map(0, size);
+    if (!data)
+    {
+        LOG(LS_WARNING) << "Unable to map trace file: " << file_path.toStdString();
+        return nullptr;
+    }
+
+    std::unique_ptr<FrameTraceReader> reader(
+        new FrameTraceReader(std::move(file), data, static_cast<uint64_t>(size)));
+
+    if (!reader->readHeader())
+    {
+        LOG(LS_WARNING) << "Invalid trace file: " << file_path.toStdString();
+        return nullptr;
+    }
+
+    return reader;
+}
+
+std::chrono::microseconds FrameTraceReader::timestamp(int index) const
+{
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, frameCount());
+
+    return std::chrono::microseconds(indexEntry(index).timestamp_us);
+}
+
+const Frame* FrameTraceReader::frame(int index)
+{
+    if (index < 0 || index >= frameCount())
+        return nullptr;
+
+    if (index == current_index_)
+        return frame_.get();
+
+    const int key_frame = static_cast<int>(indexEntry(index).key_frame);
+    if (key_frame > index)
+        return nullptr;
+
+    // If the current frame is between the key frame and the requested one, we continue from it.
+    int first = key_frame;
+    if (current_index_ >= key_frame && current_index_ < index)
+        first = current_index_ + 1;
+
+    for (int i = first; i <= index; ++i)
+    {
+        if (!decodeFrame(i))
+        {
+            LOG(LS_WARNING) << "Unable to decode frame " << i << " of the trace";
+            current_index_ = -1;
+            return nullptr;
+        }
+
+        current_index_ = i;
+    }
+
+    return frame_.get();
+}
+
+bool FrameTraceReader::readHeader()
+{
+    uint64_t offset = 0;
+
+    TraceHeader header;
+    if (!readValue(data_, size_, &offset, &header))
+        return false;
+
+    if (memcmp(header.magic, kTraceMagic, sizeof(header.magic)) != 0 ||
+        header.version != kTraceVersion)
+    {
+        return false;
+    }
+
+    // The index is written when the recording is finished. If it is missing, the recording was
+    // interrupted.
+    if (header.index_offset < sizeof(TraceHeader) || header.index_offset > size_ ||
+        (size_ - header.index_offset) / sizeof(TraceIndexEntry) < header.frame_count)
+    {
+        return false;
+    }
+
+    index_ = data_ + header.index_offset;
+    frame_count_ = header.frame_count;
+    records_end_ = header.index_offset;
+    return true;
+}
+
+TraceIndexEntry FrameTraceReader::indexEntry(int index) const
+{
+    // The index follows the records of variable size and may be unaligned.
+    TraceIndexEntry entry;
+    memcpy(&entry, index_ + index * sizeof(TraceIndexEntry), sizeof(entry));
+    return entry;
+}
+
+bool FrameTraceReader::decodeFrame(int index)
+{
+    uint64_t offset = indexEntry(index).offset;
+
+    TraceFrameHeader header;
+    if (!readValue(data_, records_end_, &offset, &header))
+        return false;
+
+    if (header.width <= 0 || header.height <= 0 ||
+        header.width > kMaxFrameSize || header.height > kMaxFrameSize)
+    {
+        return false;
+    }
+
+    const QSize size(header.width, header.height);
+    const QRect frame_rect(QPoint(), size);
+
+    if (header.type == TRACE_KEY_FRAME)
+    {
+        if (!frame_ || frame_->size() != size)
+        {
+            frame_.reset();
+            frame_ = FramePool::instance()->create(size, PixelFormat::ARGB());
+            if (!frame_)
+                return false;
+        }
+    }
+    else if (header.type != TRACE_DELTA_FRAME || !frame_ || frame_->size() != size ||
+             current_index_ != index - 1)
+    {
+        return false;
+    }
+
+    rects_.clear();
+
+    for (uint32_t i = 0; i < header.rect_count; ++i)
+    {
+        TraceRect trace_rect;
+        if (!readValue(data_, records_end_, &offset, &trace_rect))
+            return false;
+
+        QRect rect = toQRect(trace_rect);
+        if (rect.isEmpty() || !frame_rect.contains(rect))
+            return false;
+
+        rects_.push_back(rect);
+    }
+
+    QRegion* updated_region = frame_->updatedRegion();
+    updated_region->setRects(rects_.data(), static_cast<int>(rects_.size()));
+
+    Frame::MoveList* move_list = frame_->moveList();
+    move_list->clear();
+
+    for (uint32_t i = 0; i < header.move_count; ++i)
+    {
+        TraceMove trace_move;
+        if (!readValue(data_, records_end_, &offset, &trace_move))
+            return false;
+
+        QRect source_rect = toQRect(trace_move.source_rect);
+        QPoint target_pos(trace_move.target_x, trace_move.target_y);
+
+        if (source_rect.isEmpty() || !frame_rect.contains(source_rect) ||
+            !frame_rect.contains(QRect(target_pos, source_rect.size())))
+        {
+            return false;
+        }
+
+        move_list->push_back({ source_rect, target_pos });
+    }
+
+    if (offset > records_end_ || records_end_ - offset < header.data_size)
+        return false;
+
+    const bool is_key_frame = header.type == TRACE_KEY_FRAME;
+
+    // The same rectangles as in FrameTraceWriter::addFrame.
+    if (is_key_frame)
+    {
+        rects_.assign(1, frame_rect);
+    }
+    else
+    {
+        for (const auto& move : *move_list)
+        {
+            frame_->moveRect(move.source_rect, move.target_pos);
+            rects_.emplace_back(move.target_pos, move.source_rect.size());
+        }
+    }
+
+    const int bytes_per_pixel = frame_->format().bytesPerPixel();
+
+    size_t pixels_size = 0;
+    for (const auto& rect : rects_)
+        pixels_size += rect.width() * rect.height() * bytes_per_pixel;
+
+    pixels_.resize(pixels_size);
+
+    size_t result = ZSTD_decompress(pixels_.data(), pixels_size,
+                                    data_ + offset, header.data_size);
+    if (ZSTD_isError(result) || result != pixels_size)
+        return false;
+
+    const uint8_t* in = pixels_.data();
+
+    for (const auto& rect : rects_)
+    {
+        const size_t row_size = rect.width() * bytes_per_pixel;
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            uint8_t* pixel = frame_->frameDataAtPos(rect.left(), y);
+
+            if (is_key_frame)
+            {
+                memcpy(pixel, in, row_size);
+            }
+            else
+            {
+                for (size_t i = 0; i < row_size; ++i)
+                    pixel[i] ^= in[i];
+            }
+
+            in += row_size;
+        }
+    }
+
+    return true;
+}
+
+} // namespace desktop
@@ -0,0 +1,83 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_TRACE_READER_H
+#define DESKTOP__FRAME_TRACE_READER_H
+
+#include <QString>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "base/macros_magic.h"
+#include "desktop/frame_trace_format.h"
+
+class QFile;
+
+namespace desktop {
+
+class Frame;
+
+// Reads a trace file written by FrameTraceWriter. The file is mapped to memory and the position
+// of each frame is taken from the index, so any frame can be found without reading the file.
+// To restore a frame, the nearest previous key frame and the following delta frames are decoded.
+// When the frames are read in order, only one frame is decoded per call.
+class FrameTraceReader
+{
+public:
+    ~FrameTraceReader();
+
+    static std::unique_ptr<FrameTraceReader> open(const QString& file_path);
+
+    int frameCount() const { return static_cast<int>(frame_count_); }
+    std::chrono::microseconds timestamp(int index) const;
+
+    // Returns the frame with the number |index| with its updated region and moves, or nullptr if
+    // the frame can not be read. The frame is valid until the next call.
+    const Frame* frame(int index);
+
+private:
+    FrameTraceReader(std::unique_ptr<QFile> file, const uint8_t* data, uint64_t size);
+
+    bool readHeader();
+    TraceIndexEntry indexEntry(int index) const;
+    bool decodeFrame(int index);
+
+    std::unique_ptr<QFile> file_;
+    const uint8_t* const data_;
+    const uint64_t size_;
+
+    const uint8_t* index_ = nullptr;
+    uint32_t frame_count_ = 0;
+
+    // End of the frame records (the beginning of the index).
+    uint64_t records_end_ = 0;
+
+    std::unique_ptr<Frame> frame_;
+    int current_index_ = -1;
+
+    std::vector<QRect> rects_;
+    std::vector<uint8_t> pixels_;
+
+    DISALLOW_COPY_AND_ASSIGN(FrameTraceReader);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_TRACE_READER_H
@@ -0,0 +1,142 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include <QDir>
+#include <QFile>
+
+#include <cstring>
+#include <vector>
+
+#include "desktop/desktop_frame.h"
+#include "desktop/frame_trace_reader.h"
+#include "desktop/frame_trace_writer.h"
+#include "desktop/screen_capturer_replay.h"
+
+namespace desktop {
+
+namespace {
+
+const QSize kScreenSize(640, 480);
+const int kFrameCount = 20;
+
+QString traceFilePath()
+{
+    return QDir::tempPath() + QStringLiteral("/aspia_frame_trace_unittest.trace");
+}
+
+std::vector<uint8_t> frameData(const Frame* frame)
+{
+    return std::vector<uint8_t>(frame->frameData(),
+                                frame->frameData() + frame->stride() * frame->size().height());
+}
+
+// Records |kFrameCount| frames of |scene| and returns their pixels.
+std::vector<std::vector<uint8_t>> recordTrace(FrameGenerator::Scene scene)
+{
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::createGenerated(
+        scene, kScreenSize, ScreenCapturer::DETECT_MOVES);
+
+    std::unique_ptr<FrameTraceWriter> writer = FrameTraceWriter::create(traceFilePath());
+    EXPECT_TRUE(writer);
+
+    std::vector<std::vector<uint8_t>> frames;
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        const Frame* frame = capturer->captureFrame();
+        EXPECT_TRUE(writer->addFrame(frame, std::chrono::microseconds(i * 1000)));
+
+        frames.push_back(frameData(frame));
+    }
+
+    EXPECT_TRUE(writer->finish());
+    return frames;
+}
+
+} // namespace
+
+TEST(frame_trace_test, sequential_read)
+{
+    for (auto scene : { FrameGenerator::Scene::SCROLLING,
+                        FrameGenerator::Scene::MOVING_WINDOW,
+                        FrameGenerator::Scene::VIDEO })
+    {
+        std::vector<std::vector<uint8_t>> frames = recordTrace(scene);
+
+        std::unique_ptr<FrameTraceReader> reader = FrameTraceReader::open(traceFilePath());
+        ASSERT_TRUE(reader);
+        ASSERT_EQ(kFrameCount, reader->frameCount());
+
+        for (int i = 0; i < kFrameCount; ++i)
+        {
+            const Frame* frame = reader->frame(i);
+            ASSERT_TRUE(frame);
+            EXPECT_EQ(kScreenSize, frame->size());
+            EXPECT_EQ(std::chrono::microseconds(i * 1000), reader->timestamp(i));
+            EXPECT_TRUE(frames[i] == frameData(frame));
+        }
+    }
+
+    QFile::remove(traceFilePath());
+}
+
+TEST(frame_trace_test, random_access)
+{
+    std::vector<std::vector<uint8_t>> frames = recordTrace(FrameGenerator::Scene::SCROLLING);
+
+    std::unique_ptr<FrameTraceReader> reader = FrameTraceReader::open(traceFilePath());
+    ASSERT_TRUE(reader);
+
+    for (int index : { 15, 3, 19, 0, 7, 8, 2 })
+    {
+        const Frame* frame = reader->frame(index);
+        ASSERT_TRUE(frame);
+        EXPECT_TRUE(frames[index] == frameData(frame));
+    }
+
+    EXPECT_FALSE(reader->frame(kFrameCount));
+    EXPECT_FALSE(reader->frame(-1));
+
+    QFile::remove(traceFilePath());
+}
+
+TEST(frame_trace_test, empty_and_damaged_trace)
+{
+    {
+        std::unique_ptr<FrameTraceWriter> writer = FrameTraceWriter::create(traceFilePath());
+        ASSERT_TRUE(writer);
+    }
+
+    // The writer is finished in the destructor.
+    std::unique_ptr<FrameTraceReader> reader = FrameTraceReader::open(traceFilePath());
+    ASSERT_TRUE(reader);
+    EXPECT_EQ(0, reader->frameCount());
+
+    QFile file(traceFilePath());
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("ASPTRACE", 8);
+    file.close();
+
+    EXPECT_FALSE(FrameTraceReader::open(traceFilePath()));
+
+    QFile::remove(traceFilePath());
+}
+
+} // namespace desktop
@@ -0,0 +1,246 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/frame_trace_writer.h"
+
+#include <QFile>
+
+#include <zstd.h>
+
+#include "base/logging.h"
+#include "desktop/desktop_frame_aligned.h"
+
+#include <cstring>
+
+namespace desktop {
+
+namespace {
+
+// Maximum number of frames between key frames. It limits the number of frames that must be
+// decoded to get a random frame.
+const uint32_t kKeyFrameInterval = 300;
+
+// Fast compression. The recording must not slow down the capture.
+const int kCompressionLevel = 1;
+
+TraceRect toTraceRect(const QRect& rect)
+{
+    return { rect.x(), rect.y(), rect.width(), rect.height() };
+}
+
+} // namespace
+
+FrameTraceWriter::FrameTraceWriter(std::unique_ptr<QFile> file)
+    : file_(std::move(file))
+{
+    // Nothing
+}
+
+FrameTraceWriter::~FrameTraceWriter()
+{
+    finish();
+}
+
+// static
+std::unique_ptr<FrameTraceWriter> FrameTraceWriter::create(const QString& file_path)
+{
+    std::unique_ptr<QFile> file = std::make_unique<QFile>(file_path);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LOG(LS_WARNING) << "Unable to create trace file: " << file_path.toStdString();
+        return nullptr;
+    }
+
+    std::unique_ptr<FrameTraceWriter> writer(new FrameTraceWriter(std::move(file)));
+
+    // The header is written again with the index position when the recording is finished.
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+    header.version = kTraceVersion;
+
+    if (!writer->write(&header, sizeof(header)))
+        return nullptr;
+
+    return writer;
+}
+
+bool FrameTraceWriter::addFrame(const Frame* frame, std::chrono::microseconds timestamp)
+{
+    DCHECK(frame);
+    DCHECK(!is_finished_);
+
+    if (is_finished_)
+        return false;
+
+    const QSize& size = frame->size();
+    const int bytes_per_pixel = frame->format().bytesPerPixel();
+    const uint32_t frame_number = static_cast<uint32_t>(index_.size());
+
+    const bool is_key_frame = !prev_frame_ || prev_frame_->size() != size ||
+        prev_frame_->format() != frame->format() ||
+        frame_number - key_frame_ >= kKeyFrameInterval;
+
+    if (is_key_frame)
+    {
+        prev_frame_ = FrameAligned::create(size, frame->format(), 32);
+        if (!prev_frame_)
+            return false;
+
+        key_frame_ = frame_number;
+    }
+
+    // The rectangles to store: the whole frame for a key frame, the updated region and the
+    // targets of the moves for a delta frame.
+    std::vector<QRect> rects;
+
+    if (is_key_frame)
+    {
+        rects.emplace_back(QPoint(), size);
+    }
+    else
+    {
+        for (const auto& move : frame->constMoveList())
+            prev_frame_->moveRect(move.source_rect, move.target_pos);
+
+        for (const auto& rect : frame->constUpdatedRegion())
+            rects.push_back(rect);
+
+        for (const auto& move : frame->constMoveList())
+            rects.emplace_back(move.target_pos, move.source_rect.size());
+    }
+
+    size_t pixels_size = 0;
+    for (const auto& rect : rects)
+        pixels_size += rect.width() * rect.height() * bytes_per_pixel;
+
+    pixels_.resize(pixels_size);
+    uint8_t* out = pixels_.data();
+
+    for (const auto& rect : rects)
+    {
+        const size_t row_size = rect.width() * bytes_per_pixel;
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            const uint8_t* curr = frame->frameDataAtPos(rect.left(), y);
+            uint8_t* prev = prev_frame_->frameDataAtPos(rect.left(), y);
+
+            // For a key frame the previous frame is empty and the pixels are stored as is.
+            if (is_key_frame)
+            {
+                memcpy(out, curr, row_size);
+            }
+            else
+            {
+                for (size_t i = 0; i < row_size; ++i)
+                    out[i] = curr[i] ^ prev[i];
+            }
+
+            memcpy(prev, curr, row_size);
+            out += row_size;
+        }
+    }
+
+    compressed_.resize(ZSTD_compressBound(pixels_size));
+
+    size_t compressed_size = ZSTD_compress(compressed_.data(), compressed_.size(),
+                                           pixels_.data(), pixels_size, kCompressionLevel);
+    if (ZSTD_isError(compressed_size))
+    {
+        LOG(LS_WARNING) << "ZSTD_compress failed: " << ZSTD_getErrorName(compressed_size);
+        return false;
+    }
+
+    TraceIndexEntry entry;
+    entry.offset = static_cast<uint64_t>(file_->pos());
+    entry.timestamp_us = timestamp.count();
+    entry.key_frame = key_frame_;
+    entry.reserved = 0;
+
+    TraceFrameHeader header;
+    header.type = is_key_frame ? TRACE_KEY_FRAME : TRACE_DELTA_FRAME;
+    header.width = size.width();
+    header.height = size.height();
+    header.rect_count = static_cast<uint32_t>(frame->constUpdatedRegion().rectCount());
+    header.move_count = static_cast<uint32_t>(frame->constMoveList().size());
+    header.data_size = static_cast<uint32_t>(compressed_size);
+    header.timestamp_us = timestamp.count();
+
+    if (!write(&header, sizeof(header)))
+        return false;
+
+    for (const auto& rect : frame->constUpdatedRegion())
+    {
+        TraceRect trace_rect = toTraceRect(rect);
+        if (!write(&trace_rect, sizeof(trace_rect)))
+            return false;
+    }
+
+    for (const auto& move : frame->constMoveList())
+    {
+        TraceMove trace_move;
+        trace_move.source_rect = toTraceRect(move.source_rect);
+        trace_move.target_x = move.target_pos.x();
+        trace_move.target_y = move.target_pos.y();
+
+        if (!write(&trace_move, sizeof(trace_move)))
+            return false;
+    }
+
+    if (!write(compressed_.data(), compressed_size))
+        return false;
+
+    index_.push_back(entry);
+    return true;
+}
+
+bool FrameTraceWriter::finish()
+{
+    if (is_finished_)
+        return true;
+
+    is_finished_ = true;
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+    header.version = kTraceVersion;
+    header.frame_count = static_cast<uint32_t>(index_.size());
+    header.index_offset = static_cast<uint64_t>(file_->pos());
+
+    bool result = write(index_.data(), index_.size() * sizeof(TraceIndexEntry)) &&
+                  file_->seek(0) &&
+                  write(&header, sizeof(header));
+
+    file_->close();
+    return result;
+}
+
+bool FrameTraceWriter::write(const void* data, size_t size)
+{
+    if (file_->write(reinterpret_cast<const char*>(data), size) != static_cast<qint64>(size))
+    {
+        LOG(LS_WARNING) << "Unable to write trace file";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace desktop
@@ -0,0 +1,78 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_TRACE_WRITER_H
+#define DESKTOP__FRAME_TRACE_WRITER_H
+
+#include <QString>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "base/macros_magic.h"
+#include "desktop/frame_trace_format.h"
+
+class QFile;
+
+namespace desktop {
+
+class Frame;
+
+// Records a sequence of captured frames to a trace file (see frame_trace_format.h). The trace can
+// be played back later with FrameTraceReader, for example, to reproduce a performance problem
+// with the same screen content.
+class FrameTraceWriter
+{
+public:
+    // Finishes the recording if it is not finished yet.
+    ~FrameTraceWriter();
+
+    static std::unique_ptr<FrameTraceWriter> create(const QString& file_path);
+
+    // Adds |frame| to the trace. The updated region and the moves of the frame are stored with it.
+    // The pixels outside of them must not differ from the previous frame.
+    bool addFrame(const Frame* frame, std::chrono::microseconds timestamp);
+
+    // Writes the index. No frames can be added after that.
+    bool finish();
+
+    int frameCount() const { return static_cast<int>(index_.size()); }
+
+private:
+    explicit FrameTraceWriter(std::unique_ptr<QFile> file);
+
+    bool write(const void* data, size_t size);
+
+    std::unique_ptr<QFile> file_;
+    bool is_finished_ = false;
+
+    // Copy of the previous frame. Delta frames are calculated relative to it.
+    std::unique_ptr<Frame> prev_frame_;
+    uint32_t key_frame_ = 0;
+
+    std::vector<TraceIndexEntry> index_;
+    std::vector<uint8_t> pixels_;
+    std::vector<uint8_t> compressed_;
+
+    DISALLOW_COPY_AND_ASSIGN(FrameTraceWriter);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_TRACE_WRITER_H
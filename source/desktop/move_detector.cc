@@ -0,0 +1,250 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/move_detector.h"
+
+#include "base/logging.h"
+#include "desktop/desktop_frame.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace desktop {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+
+// Searching in smaller areas does not pay off.
+const int kMinAreaSize = 64;
+
+// Minimum height (for vertical moves) or width (for horizontal moves) of the moved area.
+const int kMinMoveSize = 32;
+
+// Minimum number of changed rows (or columns) that must confirm the offset.
+const int kMinVotes = 8;
+
+const uint64_t kHashBasis = 0xCBF29CE484222325ULL;
+const uint64_t kHashPrime = 0x100000001B3ULL;
+
+uint64_t hashStep(uint64_t hash, uint64_t value)
+{
+    hash = (hash ^ value) * kHashPrime;
+    return hash ^ (hash >> 29);
+}
+
+uint64_t hashRow(const uint8_t* data, int width)
+{
+    const size_t size = width * kBytesPerPixel;
+    uint64_t hash = kHashBasis;
+    size_t pos = 0;
+
+    for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t))
+    {
+        uint64_t value;
+        memcpy(&value, data + pos, sizeof(value));
+        hash = hashStep(hash, value);
+    }
+
+    if (pos < size)
+    {
+        uint32_t value;
+        memcpy(&value, data + pos, sizeof(value));
+        hash = hashStep(hash, value);
+    }
+
+    return hash;
+}
+
+void hashColumns(const Frame* frame, const QRect& area, std::vector<uint64_t>* hashes)
+{
+    hashes->assign(area.width(), kHashBasis);
+
+    for (int y = area.top(); y <= area.bottom(); ++y)
+    {
+        const uint32_t* row =
+            reinterpret_cast<const uint32_t*>(frame->frameDataAtPos(area.left(), y));
+
+        for (int x = 0; x < area.width(); ++x)
+            (*hashes)[x] = hashStep((*hashes)[x], row[x]);
+    }
+}
+
+bool isEqualRows(const Frame* prev_frame, const Frame* curr_frame,
+                 const QRect& source_rect, const QPoint& target_pos, int row)
+{
+    return memcmp(prev_frame->frameDataAtPos(source_rect.left(), source_rect.top() + row),
+                  curr_frame->frameDataAtPos(target_pos.x(), target_pos.y() + row),
+                  source_rect.width() * kBytesPerPixel) == 0;
+}
+
+} // namespace
+
+void MoveDetector::detectMoves(const Frame* prev_frame, Frame* curr_frame)
+{
+    DCHECK(prev_frame->size() == curr_frame->size());
+    DCHECK_EQ(curr_frame->format().bytesPerPixel(), kBytesPerPixel);
+
+    QRegion* updated_region = curr_frame->updatedRegion();
+    if (updated_region->isEmpty())
+        return;
+
+    const QRect area = updated_region->boundingRect();
+    if (area.width() < kMinAreaSize || area.height() < kMinAreaSize)
+        return;
+
+    QRect source_rect;
+    QPoint target_pos;
+
+    if (!findVerticalMove(prev_frame, curr_frame, area, &source_rect, &target_pos) &&
+        !findHorizontalMove(prev_frame, curr_frame, area, &source_rect, &target_pos))
+    {
+        return;
+    }
+
+    curr_frame->moveList()->push_back({ source_rect, target_pos });
+
+    // The target area is restored by the move, there is no need to send it.
+    *updated_region -= QRect(target_pos, source_rect.size());
+}
+
+bool MoveDetector::findVerticalMove(const Frame* prev_frame, const Frame* curr_frame,
+                                    const QRect& area, QRect* source_rect, QPoint* target_pos)
+{
+    prev_hashes_.resize(area.height());
+    curr_hashes_.resize(area.height());
+
+    for (int y = 0; y < area.height(); ++y)
+    {
+        prev_hashes_[y] = hashRow(prev_frame->frameDataAtPos(area.left(), area.top() + y),
+                                  area.width());
+        curr_hashes_[y] = hashRow(curr_frame->frameDataAtPos(area.left(), area.top() + y),
+                                  area.width());
+    }
+
+    Shift shift;
+    if (!findShift(&shift))
+        return false;
+
+    *target_pos = QPoint(area.left(), area.top() + shift.start);
+    *source_rect = QRect(area.left(), area.top() + shift.start + shift.offset,
+                         area.width(), shift.length);
+
+    // Hashes may match for different rows. The area is cut off at the first row that does not
+    // match.
+    for (int y = 0; y < shift.length; ++y)
+    {
+        if (!isEqualRows(prev_frame, curr_frame, *source_rect, *target_pos, y))
+        {
+            source_rect->setHeight(y);
+            break;
+        }
+    }
+
+    return source_rect->height() >= kMinMoveSize;
+}
+
+bool MoveDetector::findHorizontalMove(const Frame* prev_frame, const Frame* curr_frame,
+                                      const QRect& area, QRect* source_rect, QPoint* target_pos)
+{
+    hashColumns(prev_frame, area, &prev_hashes_);
+    hashColumns(curr_frame, area, &curr_hashes_);
+
+    Shift shift;
+    if (!findShift(&shift))
+        return false;
+
+    *target_pos = QPoint(area.left() + shift.start, area.top());
+    *source_rect = QRect(area.left() + shift.start + shift.offset, area.top(),
+                         shift.length, area.height());
+
+    for (int y = 0; y < area.height(); ++y)
+    {
+        if (!isEqualRows(prev_frame, curr_frame, *source_rect, *target_pos, y))
+            return false;
+    }
+
+    return true;
+}
+
+bool MoveDetector::findShift(Shift* shift) const
+{
+    const int count = static_cast<int>(curr_hashes_.size());
+    DCHECK_EQ(prev_hashes_.size(), curr_hashes_.size());
+
+    // Position of each hash in the previous frame or -1 if the hash is not unique.
+    std::unordered_map<uint64_t, int> prev_positions;
+    prev_positions.reserve(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        auto result = prev_positions.emplace(prev_hashes_[i], i);
+        if (!result.second)
+            result.first->second = -1;
+    }
+
+    // Votes for offsets in the range [-(count - 1), count - 1].
+    std::vector<int> votes(count * 2 - 1);
+
+    for (int i = 0; i < count; ++i)
+    {
+        // Unchanged rows do not say anything about the offset.
+        if (curr_hashes_[i] == prev_hashes_[i])
+            continue;
+
+        auto prev_position = prev_positions.find(curr_hashes_[i]);
+        if (prev_position == prev_positions.end() || prev_position->second == -1)
+            continue;
+
+        ++votes[prev_position->second - i + count - 1];
+    }
+
+    auto best = std::max_element(votes.begin(), votes.end());
+    if (*best < kMinVotes)
+        return false;
+
+    const int offset = static_cast<int>(best - votes.begin()) - (count - 1);
+
+    // Search for the longest run of rows that match with the offset.
+    const int first = std::max(0, -offset);
+    const int last = std::min(count, count - offset);
+
+    int run_start = first;
+
+    shift->offset = offset;
+    shift->length = 0;
+
+    for (int i = first; i <= last; ++i)
+    {
+        if (i < last && curr_hashes_[i] == prev_hashes_[i + offset])
+            continue;
+
+        if (i - run_start > shift->length)
+        {
+            shift->start = run_start;
+            shift->length = i - run_start;
+        }
+
+        run_start = i + 1;
+    }
+
+    return shift->length >= kMinMoveSize;
+}
+
+} // namespace desktop
@@ -0,0 +1,74 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__MOVE_DETECTOR_H
+#define DESKTOP__MOVE_DETECTOR_H
+
+#include <QRect>
+
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace desktop {
+
+class Frame;
+
+// Searches for vertical and horizontal scrolling in the changed area of the screen.
+// The rows (or columns) of the bounding rectangle of the updated region are hashed in both
+// frames. Each changed row of the current frame that has a unique match in the previous frame
+// votes for the offset between them. The offset with the most votes is checked pixel by pixel
+// and the longest area that matches is reported as a move.
+class MoveDetector
+{
+public:
+    MoveDetector() = default;
+    ~MoveDetector() = default;
+
+    // Searches for the area of |prev_frame| that was moved in |curr_frame|. If the area is found,
+    // it is added to the move list of |curr_frame| and its target is excluded from the updated
+    // region. The frames must have the same size and a 32-bit pixel format.
+    void detectMoves(const Frame* prev_frame, Frame* curr_frame);
+
+private:
+    struct Shift
+    {
+        // Offset from the position in the current frame to the position in the previous frame.
+        int offset = 0;
+
+        // Range of matching rows (or columns) in the current frame.
+        int start = 0;
+        int length = 0;
+    };
+
+    bool findVerticalMove(const Frame* prev_frame, const Frame* curr_frame,
+                          const QRect& area, QRect* source_rect, QPoint* target_pos);
+    bool findHorizontalMove(const Frame* prev_frame, const Frame* curr_frame,
+                            const QRect& area, QRect* source_rect, QPoint* target_pos);
+
+    bool findShift(Shift* shift) const;
+
+    std::vector<uint64_t> prev_hashes_;
+    std::vector<uint64_t> curr_hashes_;
+
+    DISALLOW_COPY_AND_ASSIGN(MoveDetector);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__MOVE_DETECTOR_H
@@ -0,0 +1,176 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/differ.h"
+#include "desktop/move_detector.h"
+
+namespace desktop {
+
+namespace {
+
+const QSize kScreenSize(1024, 768);
+
+// The area in which the content is scrolled.
+const QRect kScrollArea(96, 64, 800, 640);
+
+std::unique_ptr<Frame> createFrame()
+{
+    std::unique_ptr<Frame> frame = FrameAligned::create(kScreenSize, PixelFormat::ARGB(), 32);
+    memset(frame->frameData(), 0, frame->stride() * kScreenSize.height());
+    return frame;
+}
+
+void fillRandom(Frame* frame, const QRect& rect, std::mt19937* random)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* pixel = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(rect.left(), y));
+
+        for (int x = 0; x < rect.width(); ++x)
+            pixel[x] = (*random)();
+    }
+}
+
+void copyRect(const Frame* source, Frame* target, const QRect& rect)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        memcpy(target->frameDataAtPos(rect.left(), y),
+               source->frameDataAtPos(rect.left(), y),
+               rect.width() * source->format().bytesPerPixel());
+    }
+}
+
+// Calculates the updated region and searches for moves in |curr|.
+void detectMoves(const Frame* prev, Frame* curr)
+{
+    Differ differ(kScreenSize, 1);
+    differ.calcDirtyRegion(prev->frameData(), curr->frameData(), curr->updatedRegion());
+
+    MoveDetector detector;
+    detector.detectMoves(prev, curr);
+}
+
+// Applies the moves and the updated region of |curr| to a copy of |prev| (as the client does)
+// and checks that the result is equal to |curr|.
+bool isRestored(const Frame* prev, const Frame* curr)
+{
+    std::unique_ptr<Frame> restored = createFrame();
+    copyRect(prev, restored.get(), QRect(QPoint(), kScreenSize));
+
+    for (const auto& move : curr->constMoveList())
+        restored->moveRect(move.source_rect, move.target_pos);
+
+    for (const auto& rect : curr->constUpdatedRegion())
+        copyRect(curr, restored.get(), rect);
+
+    return memcmp(restored->frameData(), curr->frameData(),
+                  curr->stride() * kScreenSize.height()) == 0;
+}
+
+} // namespace
+
+TEST(move_detector_test, vertical_scroll)
+{
+    std::mt19937 random;
+
+    for (int offset : { -100, -37, -1, 1, 16, 200 })
+    {
+        std::unique_ptr<Frame> prev = createFrame();
+        std::unique_ptr<Frame> curr = createFrame();
+
+        fillRandom(prev.get(), QRect(QPoint(), kScreenSize), &random);
+        copyRect(prev.get(), curr.get(), QRect(QPoint(), kScreenSize));
+
+        // Scroll the content of the area and fill the exposed rows.
+        QRect target(kScrollArea.left(), kScrollArea.top() + std::max(0, -offset),
+                     kScrollArea.width(), kScrollArea.height() - std::abs(offset));
+        QRect source = target.translated(0, offset);
+
+        curr->moveRect(source, target.topLeft());
+        fillRandom(curr.get(),
+                   QRect(kScrollArea.left(),
+                         offset > 0 ? target.bottom() + 1 : kScrollArea.top(),
+                         kScrollArea.width(), std::abs(offset)),
+                   &random);
+
+        detectMoves(prev.get(), curr.get());
+
+        ASSERT_EQ(1, curr->constMoveList().size());
+        EXPECT_EQ(source, curr->constMoveList().front().source_rect);
+        EXPECT_EQ(target.topLeft(), curr->constMoveList().front().target_pos);
+        EXPECT_FALSE(curr->constUpdatedRegion().intersects(target));
+        EXPECT_TRUE(isRestored(prev.get(), curr.get()));
+    }
+}
+
+TEST(move_detector_test, horizontal_scroll)
+{
+    std::mt19937 random;
+
+    for (int offset : { -64, 5, 120 })
+    {
+        std::unique_ptr<Frame> prev = createFrame();
+        std::unique_ptr<Frame> curr = createFrame();
+
+        fillRandom(prev.get(), QRect(QPoint(), kScreenSize), &random);
+        copyRect(prev.get(), curr.get(), QRect(QPoint(), kScreenSize));
+
+        QRect target(kScrollArea.left() + std::max(0, -offset), kScrollArea.top(),
+                     kScrollArea.width() - std::abs(offset), kScrollArea.height());
+        QRect source = target.translated(offset, 0);
+
+        curr->moveRect(source, target.topLeft());
+        fillRandom(curr.get(),
+                   QRect(offset > 0 ? target.right() + 1 : kScrollArea.left(),
+                         kScrollArea.top(), std::abs(offset), kScrollArea.height()),
+                   &random);
+
+        detectMoves(prev.get(), curr.get());
+
+        ASSERT_EQ(1, curr->constMoveList().size());
+        EXPECT_EQ(source, curr->constMoveList().front().source_rect);
+        EXPECT_EQ(target.topLeft(), curr->constMoveList().front().target_pos);
+        EXPECT_TRUE(isRestored(prev.get(), curr.get()));
+    }
+}
+
+TEST(move_detector_test, no_moves)
+{
+    std::mt19937 random;
+
+    std::unique_ptr<Frame> prev = createFrame();
+    std::unique_ptr<Frame> curr = createFrame();
+
+    fillRandom(prev.get(), QRect(QPoint(), kScreenSize), &random);
+    fillRandom(curr.get(), QRect(QPoint(), kScreenSize), &random);
+    copyRect(prev.get(), curr.get(), QRect(0, 0, kScreenSize.width(), 100));
+
+    detectMoves(prev.get(), curr.get());
+
+    EXPECT_TRUE(curr->constMoveList().isEmpty());
+    EXPECT_TRUE(isRestored(prev.get(), curr.get()));
+}
+
+} // namespace desktop
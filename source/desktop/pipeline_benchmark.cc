@@ -0,0 +1,494 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <benchmark/benchmark.h>
+#include <libyuv/convert_from_argb.h>
+
+#include <string>
+#include <vector>
+
+#include "codec/box_scaler.h"
+#include "codec/pixel_translator.h"
+#include "codec/scale_reducer.h"
+#include "codec/video_decoder_zstd.h"
+#include "codec/video_encoder_palette.h"
+#include "codec/video_encoder_vpx.h"
+#include "codec/video_encoder_zstd.h"
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/frame_generator.h"
+
+// Benchmarks of the processing stages that follow the capture: scaling of the captured frame,
+// translation of its pixels to the format requested by the client, lossless and VPX encoding.
+
+namespace desktop {
+
+namespace {
+
+const QSize kScreenSizes[] = { QSize(1920, 1080), QSize(2560, 1440), QSize(3840, 2160) };
+const int kScreenSizeCount = sizeof(kScreenSizes) / sizeof(kScreenSizes[0]);
+
+const int kScaleFactors[] = { 25, 50, 75, 90 };
+const int kScaleFactorCount = sizeof(kScaleFactors) / sizeof(kScaleFactors[0]);
+
+// The format of some X11 servers and of the frames with swapped channels.
+PixelFormat ABGR()
+{
+    return PixelFormat(32, 255, 255, 255, 0, 8, 16);
+}
+
+struct TargetFormat
+{
+    const char* name;
+    PixelFormat (*format)();
+};
+
+const TargetFormat kTargetFormats[] =
+{
+    { "ARGB",   PixelFormat::ARGB },
+    { "ABGR",   ABGR },
+    { "RGB565", PixelFormat::RGB565 },
+    { "RGB332", PixelFormat::RGB332 },
+    { "RGB222", PixelFormat::RGB222 },
+    { "RGB111", PixelFormat::RGB111 }
+};
+
+const int kTargetFormatCount = sizeof(kTargetFormats) / sizeof(kTargetFormats[0]);
+
+// Number of threads for the tiled ZSTD encoding. Zero means encoding without tiles.
+const int kTileThreadCounts[] = { 0, 1, 2, 4, 8 };
+const int kTileThreadCountCount = sizeof(kTileThreadCounts) / sizeof(kTileThreadCounts[0]);
+
+// Maximum numbers of threads for the VPX encoders.
+const int kVpxThreadCounts[] = { 1, 2, 4, 8 };
+const int kVpxThreadCountCount = sizeof(kVpxThreadCounts) / sizeof(kVpxThreadCounts[0]);
+
+// The compression level used by the client by default.
+const int kZstdCompressionLevel = 8;
+
+std::string sizeName(const QSize& size)
+{
+    return std::to_string(size.width()) + "x" + std::to_string(size.height());
+}
+
+void setFrameCounters(benchmark::State& state, const Frame* frame)
+{
+    const QSize& size = frame->size();
+
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(size.width()) *
+                            size.height() * frame->format().bytesPerPixel());
+    state.SetItemsProcessed(state.iterations());
+}
+
+void translateArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int format = 0; format < kTargetFormatCount; ++format)
+    {
+        for (int size = 0; size < kScreenSizeCount; ++size)
+        {
+            // The translator with lookup tables and the translator for the best instruction set.
+            benchmark->Args({ format, size, 0 });
+            benchmark->Args({ format, size, 1 });
+        }
+    }
+}
+
+void scaleArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int scale = 0; scale < kScaleFactorCount; ++scale)
+    {
+        for (int size = 0; size < kScreenSizeCount; ++size)
+            benchmark->Args({ scale, size });
+    }
+}
+
+void tileArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int threads = 0; threads < kTileThreadCountCount; ++threads)
+    {
+        for (int size = 0; size < kScreenSizeCount; ++size)
+            benchmark->Args({ threads, size });
+    }
+
+    benchmark->UseRealTime();
+}
+
+void tiledArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int tiled = 0; tiled <= 1; ++tiled)
+    {
+        for (int size = 0; size < kScreenSizeCount; ++size)
+            benchmark->Args({ tiled, size });
+    }
+
+    benchmark->UseRealTime();
+}
+
+void vpxArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int vp9 = 0; vp9 <= 1; ++vp9)
+    {
+        for (int size = 0; size < kScreenSizeCount; ++size)
+        {
+            for (int threads = 0; threads < kVpxThreadCountCount; ++threads)
+                benchmark->Args({ vp9, size, threads });
+        }
+    }
+
+    benchmark->UseRealTime();
+}
+
+void sceneArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int scene = 0; scene <= static_cast<int>(FrameGenerator::Scene::FULLSCREEN_VIDEO); ++scene)
+    {
+        for (int prediction = 0; prediction <= 1; ++prediction)
+        {
+            for (int persistent = 0; persistent <= 1; ++persistent)
+                benchmark->Args({ scene, prediction, persistent });
+        }
+    }
+}
+
+std::unique_ptr<codec::VideoEncoderZstd> createZstdEncoder(int thread_count)
+{
+    std::unique_ptr<codec::VideoEncoderZstd> encoder(
+        codec::VideoEncoderZstd::create(PixelFormat::ARGB(), kZstdCompressionLevel));
+
+    if (thread_count)
+        encoder->enableTiles(thread_count);
+
+    return encoder;
+}
+
+void BM_PixelTranslatorTranslate(benchmark::State& state)
+{
+    const TargetFormat& target = kTargetFormats[state.range(0)];
+    const QSize& size = kScreenSizes[state.range(1)];
+    const SimdLevel max_level = state.range(2) ? simdLevel() : SimdLevel::C;
+
+    FrameGenerator generator(FrameGenerator::Scene::SCROLLING, size);
+    const Frame* frame = generator.frame();
+
+    const PixelFormat target_format = target.format();
+    std::unique_ptr<codec::PixelTranslator> translator =
+        codec::PixelTranslator::create(frame->format(), target_format, max_level);
+
+    const int dst_stride = size.width() * target_format.bytesPerPixel();
+    std::vector<uint8_t> buffer(dst_stride * size.height());
+
+    for (auto _ : state)
+    {
+        translator->translate(frame->frameData(), frame->stride(),
+                              buffer.data(), dst_stride,
+                              size.width(), size.height());
+        benchmark::ClobberMemory();
+    }
+
+    setFrameCounters(state, frame);
+    state.SetLabel(std::string(target.name) + "/" + sizeName(size) +
+                   (state.range(2) ? "/simd" : "/table"));
+}
+
+BENCHMARK(BM_PixelTranslatorTranslate)->Apply(translateArguments);
+
+// Scales a frame in which the whole screen is changed.
+void BM_ScaleReducerScaleFrame(benchmark::State& state)
+{
+    const int scale_factor = kScaleFactors[state.range(0)];
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(FrameGenerator::Scene::SCROLLING, size);
+    const Frame* frame = generator.frame();
+
+    std::unique_ptr<codec::ScaleReducer> scale_reducer(codec::ScaleReducer::create(scale_factor));
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(scale_reducer->scaleFrame(frame));
+
+    setFrameCounters(state, frame);
+    state.SetLabel(std::to_string(scale_factor) + "%/" + sizeName(size));
+}
+
+BENCHMARK(BM_ScaleReducerScaleFrame)->Apply(scaleArguments);
+
+// I420 planes of the scaled frame as the VPX encoders use them.
+struct I420Image
+{
+    explicit I420Image(const QSize& size)
+        : y_stride(size.width()),
+          uv_stride((size.width() + 1) / 2),
+          y(y_stride * size.height()),
+          u(uv_stride * ((size.height() + 1) / 2)),
+          v(u.size())
+    {
+        // Nothing
+    }
+
+    const int y_stride;
+    const int uv_stride;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+};
+
+// Scales a frame with ScaleReducer and converts the scaled frame to I420 (two passes).
+void BM_ScaleThenConvertToI420(benchmark::State& state)
+{
+    const int scale_factor = kScaleFactors[state.range(0)];
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(FrameGenerator::Scene::SCROLLING, size);
+    const Frame* frame = generator.frame();
+
+    std::unique_ptr<codec::ScaleReducer> scale_reducer(codec::ScaleReducer::create(scale_factor));
+    I420Image image(scale_reducer->scaledSize(size));
+
+    for (auto _ : state)
+    {
+        const Frame* scaled_frame = scale_reducer->scaleFrame(frame);
+
+        libyuv::ARGBToI420(scaled_frame->frameData(), scaled_frame->stride(),
+                           image.y.data(), image.y_stride,
+                           image.u.data(), image.uv_stride,
+                           image.v.data(), image.uv_stride,
+                           scaled_frame->size().width(), scaled_frame->size().height());
+        benchmark::ClobberMemory();
+    }
+
+    setFrameCounters(state, frame);
+    state.SetLabel(std::to_string(scale_factor) + "%/" + sizeName(size));
+}
+
+BENCHMARK(BM_ScaleThenConvertToI420)->Apply(scaleArguments);
+
+// Scales a frame directly to I420 (one pass), as the VPX encoders do with a scale factor.
+void BM_ScaleToI420(benchmark::State& state)
+{
+    const int scale_factor = kScaleFactors[state.range(0)];
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(FrameGenerator::Scene::SCROLLING, size);
+    const Frame* frame = generator.frame();
+
+    std::unique_ptr<codec::ScaleReducer> scale_reducer(codec::ScaleReducer::create(scale_factor));
+    const QSize scaled_size = scale_reducer->scaledSize(size);
+    I420Image image(scaled_size);
+
+    for (auto _ : state)
+    {
+        codec::scaleARGBToI420(frame->frameData(), frame->stride(), size,
+                               scaled_size, QRect(QPoint(), scaled_size),
+                               image.y.data(), image.y_stride,
+                               image.u.data(), image.uv_stride,
+                               image.v.data(), image.uv_stride);
+        benchmark::ClobberMemory();
+    }
+
+    setFrameCounters(state, frame);
+    state.SetLabel(std::to_string(scale_factor) + "%/" + sizeName(size));
+}
+
+BENCHMARK(BM_ScaleToI420)->Apply(scaleArguments);
+
+// Encodes a frame in which the whole screen is changed.
+void BM_VideoEncoderZstdEncode(benchmark::State& state)
+{
+    const int thread_count = kTileThreadCounts[state.range(0)];
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(FrameGenerator::Scene::SCROLLING, size);
+    const Frame* frame = generator.frame();
+
+    std::unique_ptr<codec::VideoEncoderZstd> encoder = createZstdEncoder(thread_count);
+    proto::desktop::VideoPacket packet;
+
+    for (auto _ : state)
+    {
+        packet.Clear();
+        encoder->encode(frame, &packet);
+        benchmark::DoNotOptimize(packet);
+    }
+
+    setFrameCounters(state, frame);
+    state.counters["ratio"] = static_cast<double>(size.width()) * size.height() *
+        frame->format().bytesPerPixel() / packet.data().size();
+    const std::string mode = thread_count ? std::to_string(thread_count) + " threads" : "stream";
+    state.SetLabel(mode + "/" + sizeName(size));
+}
+
+BENCHMARK(BM_VideoEncoderZstdEncode)->Apply(tileArguments);
+
+// Encodes the consecutive frames of a scene with and without the prediction from the previous
+// frame, with a new stream for each packet or with the persistent stream. The generator reports
+// whole windows and text areas as updated, as the real capturers do for mixed content.
+void BM_VideoEncoderZstdScene(benchmark::State& state)
+{
+    const FrameGenerator::Scene scene = static_cast<FrameGenerator::Scene>(state.range(0));
+    const bool prediction = state.range(1) != 0;
+    const bool persistent = state.range(2) != 0;
+    const QSize& size = kScreenSizes[0];
+
+    FrameGenerator generator(scene, size);
+
+    std::unique_ptr<codec::VideoEncoderZstd> encoder = createZstdEncoder(0);
+    if (prediction)
+        encoder->enablePrediction();
+    if (persistent)
+        encoder->enablePersistentStreams();
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(generator.frame(), &packet);
+
+    int64_t input_bytes = 0;
+    int64_t output_bytes = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const Frame* frame = generator.nextFrame();
+        packet.Clear();
+        state.ResumeTiming();
+
+        encoder->encode(frame, &packet);
+
+        for (const auto& rect : frame->constUpdatedRegion())
+            input_bytes += rect.width() * rect.height() * frame->format().bytesPerPixel();
+
+        output_bytes += packet.data().size();
+    }
+
+    state.SetBytesProcessed(input_bytes);
+    state.counters["ratio"] = output_bytes ? static_cast<double>(input_bytes) / output_bytes : 0;
+    state.SetLabel(std::string(FrameGenerator::sceneName(scene)) +
+                   (prediction ? "/prediction" : "/raw") +
+                   (persistent ? "/persistent" : "/packet"));
+}
+
+BENCHMARK(BM_VideoEncoderZstdScene)->Apply(sceneArguments);
+
+// Encodes the consecutive frames of a scene with the palette encoder. The results are compared
+// with BM_VideoEncoderZstdScene without the prediction and with a new stream for each packet.
+void BM_VideoEncoderPaletteScene(benchmark::State& state)
+{
+    const FrameGenerator::Scene scene = static_cast<FrameGenerator::Scene>(state.range(0));
+    const QSize& size = kScreenSizes[0];
+
+    FrameGenerator generator(scene, size);
+
+    std::unique_ptr<codec::VideoEncoderPalette> encoder(
+        codec::VideoEncoderPalette::create(PixelFormat::ARGB(), kZstdCompressionLevel));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(generator.frame(), &packet);
+
+    int64_t input_bytes = 0;
+    int64_t output_bytes = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const Frame* frame = generator.nextFrame();
+        packet.Clear();
+        state.ResumeTiming();
+
+        encoder->encode(frame, &packet);
+
+        for (const auto& rect : frame->constUpdatedRegion())
+            input_bytes += rect.width() * rect.height() * frame->format().bytesPerPixel();
+
+        output_bytes += packet.data().size();
+    }
+
+    state.SetBytesProcessed(input_bytes);
+    state.counters["ratio"] = output_bytes ? static_cast<double>(input_bytes) / output_bytes : 0;
+    state.SetLabel(FrameGenerator::sceneName(scene));
+}
+
+BENCHMARK(BM_VideoEncoderPaletteScene)
+    ->DenseRange(0, static_cast<int>(FrameGenerator::Scene::FULLSCREEN_VIDEO));
+
+// Encodes the consecutive frames of a video on the whole screen. The time of an iteration is the
+// latency of the encoding of one frame with the given limit of the threads.
+void BM_VideoEncoderVpxEncode(benchmark::State& state)
+{
+    const bool vp9 = state.range(0) != 0;
+    const QSize& size = kScreenSizes[state.range(1)];
+    const int max_threads = kVpxThreadCounts[state.range(2)];
+
+    FrameGenerator generator(FrameGenerator::Scene::FULLSCREEN_VIDEO, size);
+
+    std::unique_ptr<codec::VideoEncoderVPX> encoder(
+        vp9 ? codec::VideoEncoderVPX::createVP9(max_threads)
+            : codec::VideoEncoderVPX::createVP8(max_threads));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(generator.frame(), &packet);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const Frame* frame = generator.nextFrame();
+        packet.Clear();
+        state.ResumeTiming();
+
+        encoder->encode(frame, &packet);
+    }
+
+    setFrameCounters(state, generator.frame());
+    state.SetLabel(std::string(vp9 ? "vp9/" : "vp8/") + sizeName(size) + "/" +
+                   std::to_string(max_threads) + "threads");
+}
+
+BENCHMARK(BM_VideoEncoderVpxEncode)->Apply(vpxArguments);
+
+// Decodes a packet in which the whole screen is changed. The tiles are decoded on all processor
+// cores.
+void BM_VideoDecoderZstdDecode(benchmark::State& state)
+{
+    const bool tiled = state.range(0) != 0;
+    const QSize& size = kScreenSizes[state.range(1)];
+
+    FrameGenerator generator(FrameGenerator::Scene::SCROLLING, size);
+    const Frame* frame = generator.frame();
+
+    proto::desktop::VideoPacket packet;
+    createZstdEncoder(tiled ? 1 : 0)->encode(frame, &packet);
+
+    std::unique_ptr<codec::VideoDecoderZstd> decoder = codec::VideoDecoderZstd::create();
+    std::unique_ptr<Frame> target_frame = FrameAligned::create(size, PixelFormat::ARGB(), 32);
+
+    for (auto _ : state)
+    {
+        if (!decoder->decode(packet, target_frame.get()))
+        {
+            state.SkipWithError("Unable to decode the packet");
+            break;
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    setFrameCounters(state, frame);
+    state.SetLabel(std::string(tiled ? "tiles/" : "stream/") + sizeName(size));
+}
+
+BENCHMARK(BM_VideoDecoderZstdDecode)->Apply(tiledArguments);
+
+} // namespace
+
+} // namespace desktop
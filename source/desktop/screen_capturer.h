@@ -28,6 +28,14 @@ class ScreenCapturer
 public:
     virtual ~ScreenCapturer() = default;
 
+    // Not all flags are supported by all capturers.
+    enum Flags
+    {
+        DISABLE_EFFECTS = 1,
+        DISABLE_WALLPAPER = 2,
+        DETECT_MOVES = 4
+    };
+
     using ScreenId = intptr_t;
 
     struct Screen
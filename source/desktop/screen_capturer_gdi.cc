@@ -26,6 +26,7 @@
 #include "desktop/win/wallpaper_disabler.h"
 #include "desktop/desktop_frame_dib.h"
 #include "desktop/differ.h"
+#include "desktop/move_detector.h"
 
 namespace desktop {
 
@@ -108,6 +109,7 @@ const Frame* ScreenCapturerGDI::captureFrame()
     }
 
     current->setTopLeft(screen_rect.topLeft());
+    current->moveList()->clear();
 
     if (!previous || previous->size() != current->size())
     {
@@ -119,6 +121,14 @@ const Frame* ScreenCapturerGDI::captureFrame()
         differ_->calcDirtyRegion(previous->frameData(),
                                  current->frameData(),
                                  current->updatedRegion());
+
+        if (flags_ & DETECT_MOVES)
+        {
+            if (!move_detector_)
+                move_detector_ = std::make_unique<MoveDetector>();
+
+            move_detector_->detectMoves(previous, current);
+        }
     }
 
     return current;
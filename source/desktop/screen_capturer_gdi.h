@@ -28,17 +28,12 @@ namespace desktop {
 
 class Differ;
 class EffectsDisabler;
+class MoveDetector;
 class WallpaperDisabler;
 
 class ScreenCapturerGDI : public ScreenCapturer
 {
 public:
-    enum Flags
-    {
-        DISABLE_EFFECTS = 1,
-        DISABLE_WALLPAPER = 2
-    };
-
     ScreenCapturerGDI(uint32_t flags);
     ~ScreenCapturerGDI();
 
@@ -60,6 +55,7 @@ private:
     QRect desktop_dc_rect_;
 
     std::unique_ptr<Differ> differ_;
+    std::unique_ptr<MoveDetector> move_detector_;
     std::unique_ptr<base::win::ScopedGetDC> desktop_dc_;
     base::win::ScopedCreateDC memory_dc_;
 
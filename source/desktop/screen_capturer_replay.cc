@@ -0,0 +1,251 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/screen_capturer_replay.h"
+
+#include "base/logging.h"
+#include "desktop/differ.h"
+#include "desktop/frame_pool.h"
+#include "desktop/frame_trace_reader.h"
+#include "desktop/move_detector.h"
+
+#include <cstring>
+
+namespace desktop {
+
+namespace {
+
+const ScreenCapturer::ScreenId kReplayScreenId = 0;
+
+class GeneratorSource : public ScreenCapturerReplay::Source
+{
+public:
+    GeneratorSource(FrameGenerator::Scene scene, const QSize& size)
+        : generator_(scene, size)
+    {
+        // Nothing
+    }
+
+    const Frame* nextFrame() override
+    {
+        // The first frame is the initial picture of the scene.
+        if (is_first_frame_)
+        {
+            is_first_frame_ = false;
+            return generator_.frame();
+        }
+
+        return generator_.nextFrame();
+    }
+
+private:
+    FrameGenerator generator_;
+    bool is_first_frame_ = true;
+
+    DISALLOW_COPY_AND_ASSIGN(GeneratorSource);
+};
+
+class TraceSource : public ScreenCapturerReplay::Source
+{
+public:
+    explicit TraceSource(std::unique_ptr<FrameTraceReader> reader)
+        : reader_(std::move(reader))
+    {
+        // Nothing
+    }
+
+    const Frame* nextFrame() override
+    {
+        if (next_index_ >= reader_->frameCount())
+            return nullptr;
+
+        return reader_->frame(next_index_++);
+    }
+
+private:
+    std::unique_ptr<FrameTraceReader> reader_;
+    int next_index_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(TraceSource);
+};
+
+void copyFrameData(const Frame* source, Frame* target)
+{
+    DCHECK(source->size() == target->size());
+    DCHECK(source->format() == target->format());
+
+    const int row_size = source->size().width() * source->format().bytesPerPixel();
+
+    for (int y = 0; y < source->size().height(); ++y)
+        memcpy(target->frameDataAtPos(0, y), source->frameDataAtPos(0, y), row_size);
+}
+
+} // namespace
+
+ScreenCapturerReplay::ScreenCapturerReplay(std::unique_ptr<Source> source, uint32_t flags)
+    : source_(std::move(source)),
+      flags_(flags)
+{
+    DCHECK(source_);
+}
+
+ScreenCapturerReplay::~ScreenCapturerReplay() = default;
+
+// static
+std::unique_ptr<ScreenCapturerReplay> ScreenCapturerReplay::createGenerated(
+    FrameGenerator::Scene scene, const QSize& size, uint32_t flags)
+{
+    return std::make_unique<ScreenCapturerReplay>(
+        std::make_unique<GeneratorSource>(scene, size), flags);
+}
+
+// static
+std::unique_ptr<ScreenCapturerReplay> ScreenCapturerReplay::createFromTrace(
+    const QString& file_path, uint32_t flags)
+{
+    std::unique_ptr<FrameTraceReader> reader = FrameTraceReader::open(file_path);
+    if (!reader)
+        return nullptr;
+
+    return std::make_unique<ScreenCapturerReplay>(
+        std::make_unique<TraceSource>(std::move(reader)), flags);
+}
+
+void ScreenCapturerReplay::setFrameRate(int frames_per_second)
+{
+    DCHECK_GE(frames_per_second, 0);
+
+    frame_rate_ = frames_per_second;
+    start_time_ = std::chrono::steady_clock::now();
+    source_frame_count_ = 0;
+}
+
+int ScreenCapturerReplay::screenCount()
+{
+    return 1;
+}
+
+bool ScreenCapturerReplay::screenList(ScreenList* screens)
+{
+    screens->push_back({ kReplayScreenId, QStringLiteral("Replay") });
+    return true;
+}
+
+bool ScreenCapturerReplay::selectScreen(ScreenId screen_id)
+{
+    return screen_id == kFullDesktopScreenId || screen_id == kReplayScreenId;
+}
+
+const Frame* ScreenCapturerReplay::captureFrame()
+{
+    queue_.moveToNextFrame();
+
+    readSource();
+    if (!source_frame_)
+        return nullptr;
+
+    const QSize& size = source_frame_->size();
+
+    if (!queue_.currentFrame() || queue_.currentFrame()->size() != size)
+    {
+        // The previous buffer is returned to the pool first, so it can be reused.
+        queue_.replaceCurrentFrame(nullptr);
+
+        std::unique_ptr<Frame> frame = FramePool::instance()->create(size, source_frame_->format());
+        if (!frame)
+        {
+            LOG(LS_WARNING) << "Failed to create frame buffer";
+            return nullptr;
+        }
+
+        queue_.replaceCurrentFrame(std::move(frame));
+    }
+
+    Frame* current = queue_.currentFrame();
+    Frame* previous = queue_.previousFrame();
+
+    // The frame is copied even if the source has not changed, as a real capturer does.
+    copyFrameData(source_frame_, current);
+
+    current->setTopLeft(source_frame_->topLeft());
+    current->moveList()->clear();
+
+    if (!previous || previous->size() != current->size())
+    {
+        differ_ = std::make_unique<Differ>(size);
+        *current->updatedRegion() = QRegion(QRect(QPoint(), size));
+    }
+    else
+    {
+        differ_->calcDirtyRegion(previous->frameData(),
+                                 current->frameData(),
+                                 current->updatedRegion(),
+                                 &damage_region_);
+
+        if (flags_ & DETECT_MOVES)
+        {
+            if (!move_detector_)
+                move_detector_ = std::make_unique<MoveDetector>();
+
+            move_detector_->detectMoves(previous, current);
+        }
+    }
+
+    damage_region_ = QRegion();
+    return current;
+}
+
+void ScreenCapturerReplay::readSource()
+{
+    int64_t target_count;
+
+    if (!frame_rate_)
+    {
+        target_count = source_frame_count_ + 1;
+    }
+    else
+    {
+        const int64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time_).count();
+
+        target_count = elapsed_ms * frame_rate_ / 1000 + 1;
+    }
+
+    // If the capture is slower than the sequence, the skipped frames are dropped as it happens
+    // with a real screen.
+    while (!source_finished_ && source_frame_count_ < target_count)
+    {
+        const Frame* frame = source_->nextFrame();
+        if (!frame)
+        {
+            // The last frame stays on the screen.
+            source_finished_ = true;
+            break;
+        }
+
+        damage_region_ += frame->constUpdatedRegion();
+
+        for (const auto& move : frame->constMoveList())
+            damage_region_ += QRect(move.target_pos, move.source_rect.size());
+
+        source_frame_ = frame;
+        ++source_frame_count_;
+    }
+}
+
+} // namespace desktop
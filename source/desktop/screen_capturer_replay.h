@@ -0,0 +1,105 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__SCREEN_CAPTURER_REPLAY_H
+#define DESKTOP__SCREEN_CAPTURER_REPLAY_H
+
+#include <chrono>
+#include <memory>
+
+#include "desktop/frame_generator.h"
+#include "desktop/screen_capturer.h"
+#include "desktop/screen_capture_frame_queue.h"
+
+namespace desktop {
+
+class Differ;
+class MoveDetector;
+
+// Plays back a sequence of frames instead of capturing a real screen. The frames are processed
+// in the same way as in the real capturers (the updated region is calculated by Differ and moves
+// are searched by MoveDetector), so the whole capture and encoding pipeline can be run and
+// profiled on a host without an interactive desktop. The host uses it if ASPIA_REPLAY_TRACE or
+// ASPIA_REPLAY_SCENE is set.
+class ScreenCapturerReplay : public ScreenCapturer
+{
+public:
+    // Provides the frames to play back.
+    class Source
+    {
+    public:
+        virtual ~Source() = default;
+
+        // Returns the next frame of the sequence or nullptr if the sequence is over. The frame
+        // must remain valid until the next call.
+        virtual const Frame* nextFrame() = 0;
+    };
+
+    // Only DETECT_MOVES is supported from |flags|.
+    ScreenCapturerReplay(std::unique_ptr<Source> source, uint32_t flags);
+    ~ScreenCapturerReplay();
+
+    // Creates a capturer that plays back the generated |scene|.
+    static std::unique_ptr<ScreenCapturerReplay> createGenerated(
+        FrameGenerator::Scene scene, const QSize& size, uint32_t flags);
+
+    // Creates a capturer that plays back the trace recorded by FrameTraceWriter. Returns nullptr
+    // if the trace can not be opened.
+    static std::unique_ptr<ScreenCapturerReplay> createFromTrace(
+        const QString& file_path, uint32_t flags);
+
+    // Sets the rate at which the sequence is played. If the rate is 0 (by default), each call of
+    // captureFrame() moves to the next frame of the sequence regardless of the time between the
+    // calls. This makes the captured frames deterministic.
+    void setFrameRate(int frames_per_second);
+
+    int screenCount() override;
+    bool screenList(ScreenList* screens) override;
+    bool selectScreen(ScreenId screen_id) override;
+
+    const Frame* captureFrame() override;
+
+private:
+    void readSource();
+
+    std::unique_ptr<Source> source_;
+    const uint32_t flags_;
+
+    int frame_rate_ = 0;
+    std::chrono::steady_clock::time_point start_time_;
+
+    // The last frame received from the source and the number of received frames.
+    const Frame* source_frame_ = nullptr;
+    int64_t source_frame_count_ = 0;
+    bool source_finished_ = false;
+
+    // The areas changed by the source since the last captured frame. It is used as the hint for
+    // Differ in the same way as the damage reported by the system.
+    QRegion damage_region_;
+
+    std::unique_ptr<Differ> differ_;
+    std::unique_ptr<MoveDetector> move_detector_;
+
+    ScreenCaptureFrameQueue queue_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScreenCapturerReplay);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__SCREEN_CAPTURER_REPLAY_H
@@ -0,0 +1,90 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "desktop/screen_capturer_replay.h"
+
+namespace desktop {
+
+namespace {
+
+const QSize kScreenSize(800, 600);
+const int kFrameCount = 10;
+
+} // namespace
+
+TEST(screen_capturer_replay_test, idle)
+{
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::createGenerated(
+        FrameGenerator::Scene::IDLE, kScreenSize, 0);
+
+    const Frame* frame = capturer->captureFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(kScreenSize, frame->size());
+    EXPECT_EQ(QRegion(QRect(QPoint(), kScreenSize)), frame->constUpdatedRegion());
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        frame = capturer->captureFrame();
+        ASSERT_TRUE(frame);
+        EXPECT_TRUE(frame->constUpdatedRegion().isEmpty());
+    }
+}
+
+TEST(screen_capturer_replay_test, typing)
+{
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::createGenerated(
+        FrameGenerator::Scene::TYPING, kScreenSize, 0);
+
+    ASSERT_TRUE(capturer->captureFrame());
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        const Frame* frame = capturer->captureFrame();
+        ASSERT_TRUE(frame);
+
+        // Only one character is changed.
+        const QRect bounding_rect = frame->constUpdatedRegion().boundingRect();
+        EXPECT_FALSE(bounding_rect.isEmpty());
+        EXPECT_LE(bounding_rect.width(), 32);
+        EXPECT_LE(bounding_rect.height(), 32);
+    }
+}
+
+TEST(screen_capturer_replay_test, scrolling)
+{
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::createGenerated(
+        FrameGenerator::Scene::SCROLLING, kScreenSize, ScreenCapturer::DETECT_MOVES);
+
+    ASSERT_TRUE(capturer->captureFrame());
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        const Frame* frame = capturer->captureFrame();
+        ASSERT_TRUE(frame);
+
+        ASSERT_EQ(1, frame->constMoveList().size());
+        EXPECT_EQ(0, frame->constMoveList().front().source_rect.left() -
+                     frame->constMoveList().front().target_pos.x());
+        EXPECT_LT(frame->constMoveList().front().target_pos.y(),
+                  frame->constMoveList().front().source_rect.top());
+    }
+}
+
+} // namespace desktop
@@ -0,0 +1,86 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/simd_dispatch.h"
+
+#include "base/logging.h"
+
+#include <libyuv/cpu_id.h>
+
+namespace desktop {
+
+namespace {
+
+SimdLevel detectSimdLevel()
+{
+    // libyuv also checks that the operating system saves the AVX registers.
+    if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX512BW))
+        return SimdLevel::AVX512BW;
+
+    if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+        return SimdLevel::AVX2;
+
+    if (libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+        return SimdLevel::SSSE3;
+
+    if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+        return SimdLevel::SSE2;
+
+    return SimdLevel::C;
+}
+
+} // namespace
+
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = []()
+    {
+        SimdLevel level = detectSimdLevel();
+        LOG(LS_INFO) << "SIMD level: " << simdLevelName(level);
+        return level;
+    }();
+
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::C:
+            return "C";
+
+        case SimdLevel::SSE2:
+            return "SSE2";
+
+        case SimdLevel::SSSE3:
+            return "SSSE3";
+
+        case SimdLevel::AVX2:
+            return "AVX2";
+
+        case SimdLevel::AVX512BW:
+            return "AVX512BW";
+
+        default:
+            NOTREACHED();
+            return "Unknown";
+    }
+}
+
+} // namespace desktop
@@ -0,0 +1,61 @@
+//
+// Aspia Project
+// Copyright (C) 2019 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__SIMD_DISPATCH_H
+#define DESKTOP__SIMD_DISPATCH_H
+
+namespace desktop {
+
+// Instruction sets for which optimized implementations exist. Each level includes the previous
+// ones.
+enum class SimdLevel
+{
+    C        = 0,
+    SSE2     = 1,
+    SSSE3    = 2,
+    AVX2     = 3,
+    AVX512BW = 4
+};
+
+const int kSimdLevelCount = 5;
+
+// Returns the best instruction set supported by the processor and the operating system.
+// The processor is checked once, at the first call.
+SimdLevel simdLevel();
+
+const char* simdLevelName(SimdLevel level);
+
+// Selects an implementation from |table| that is indexed by SimdLevel. If there is no
+// implementation for the supported level (the entry is nullptr), the entry for the nearest lower
+// level is used. The entry for SimdLevel::C is used if no other entry is found. It may be nullptr
+// if the caller has its own fallback.
+template <typename T>
+T simdDispatch(const T (&table)[kSimdLevelCount], SimdLevel max_level = simdLevel())
+{
+    for (int level = static_cast<int>(max_level); level > 0; --level)
+    {
+        if (table[level])
+            return table[level];
+    }
+
+    return table[0];
+}
+
+} // namespace desktop
+
+#endif // DESKTOP__SIMD_DISPATCH_H
@@ -22,6 +22,11 @@ namespace host {
 
 namespace {
 
+bool hasAdaptiveScale(const proto::desktop::Config& config)
+{
+    return config.video_features() & proto::desktop::VIDEO_FEATURE_ADAPTIVE_SCALE;
+}
+
 bool isEqualPixelFormat(const proto::desktop::PixelFormat& first,
                         const proto::desktop::PixelFormat& second)
 {
@@ -55,12 +60,24 @@ uint32_t DesktopConfigTracker::changesMask(const proto::desktop::Config& new_con
     if (old_config_->update_interval() != new_config.update_interval())
         result |= HAS_VIDEO;
 
-    if (old_config_->scale_factor() != new_config.scale_factor())
-        result |= HAS_VIDEO;
+    if (old_config_->scale_factor() != new_config.scale_factor() ||
+        old_config_->target_width() != new_config.target_width() ||
+        old_config_->target_height() != new_config.target_height())
+    {
+        // The video stream is restarted only if the client does not support the change of the
+        // scale during the session.
+        if (hasAdaptiveScale(*old_config_) && hasAdaptiveScale(new_config))
+            result |= HAS_SCALE;
+        else
+            result |= HAS_VIDEO;
+    }
 
     if (old_config_->compress_ratio() != new_config.compress_ratio())
         result |= HAS_VIDEO;
 
+    if (old_config_->video_features() != new_config.video_features())
+        result |= HAS_VIDEO;
+
     if ((old_config_->flags() & proto::desktop::ENABLE_CURSOR_SHAPE) !=
         (new_config.flags() & proto::desktop::ENABLE_CURSOR_SHAPE))
     {
@@ -35,7 +35,11 @@ public:
     {
         HAS_VIDEO     = 1,
         HAS_CLIPBOARD = 2,
-        HAS_INPUT     = 4
+        HAS_INPUT     = 4,
+
+        // Only the scale of the video is changed. It is applied without a restart of the video
+        // stream.
+        HAS_SCALE     = 8
     };
 
     uint32_t changesMask(const proto::desktop::Config& config);
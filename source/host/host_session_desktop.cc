@@ -71,9 +71,10 @@ void SessionDesktop::sessionStarted()
     // Create a configuration request.
     proto::desktop::ConfigRequest* request = outgoing_message_.mutable_config_request();
 
-    // Add supported extensions and video encodings.
+    // Add supported extensions, video encodings and video features.
     request->set_extensions(extensions);
     request->set_video_encodings(common::kSupportedVideoEncodings);
+    request->set_video_features(common::kSupportedVideoFeatures);
 
     // Send the request.
     sendMessage(common::serializeMessage(outgoing_message_));
@@ -162,6 +163,24 @@ void SessionDesktop::readClipboardEvent(const proto::desktop::ClipboardEvent& cl
 
 void SessionDesktop::readExtension(const proto::desktop::Extension& extension)
 {
+    // The network feedback is sent by the host service and is not in the list of the extensions
+    // supported by the client. The service does not forward it from the client.
+    if (extension.name() == common::kNetworkFeedbackExtension)
+    {
+        proto::desktop::NetworkFeedback feedback;
+
+        if (!feedback.ParseFromString(extension.data()))
+        {
+            LOG(LS_ERROR) << "Unable to parse network feedback extension data";
+            return;
+        }
+
+        if (screen_updater_)
+            screen_updater_->setNetworkFeedback(feedback);
+
+        return;
+    }
+
     if (!extensions_.contains(QString::fromStdString(extension.name())))
     {
         DLOG(LS_WARNING) << "Unsupported or disabled extensions: " << extension.name();
@@ -262,6 +281,10 @@ void SessionDesktop::readConfig(const proto::desktop::Config& config)
         if (!screen_updater_->start(config))
             stop();
     }
+    else if ((mask & DesktopConfigTracker::HAS_SCALE) && screen_updater_)
+    {
+        screen_updater_->setScale(config);
+    }
 }
 
 void SessionDesktop::sendSystemInfo()
@@ -18,6 +18,8 @@
 
 #include "host/host_session_fake_desktop.h"
 
+#include "codec/video_encoder_hybrid.h"
+#include "codec/video_encoder_palette.h"
 #include "codec/video_encoder_vpx.h"
 #include "codec/video_encoder_zstd.h"
 #include "codec/video_util.h"
@@ -27,6 +29,13 @@
 
 namespace host {
 
+namespace {
+
+// The fake session encodes a single frame, more threads are not needed.
+const int kVpxThreads = 1;
+
+} // namespace
+
 SessionFakeDesktop::SessionFakeDesktop(QObject* parent)
     : SessionFake(parent)
 {
@@ -84,16 +93,28 @@ codec::VideoEncoder* SessionFakeDesktop::createEncoder(const proto::desktop::Con
     switch (config.video_encoding())
     {
         case proto::desktop::VIDEO_ENCODING_VP8:
-            return codec::VideoEncoderVPX::createVP8();
+            return codec::VideoEncoderVPX::createVP8(kVpxThreads);
 
         case proto::desktop::VIDEO_ENCODING_VP9:
-            return codec::VideoEncoderVPX::createVP9();
+            return codec::VideoEncoderVPX::createVP9(kVpxThreads);
 
         case proto::desktop::VIDEO_ENCODING_ZSTD:
             return codec::VideoEncoderZstd::create(
                 codec::VideoUtil::fromVideoPixelFormat(
                     config.pixel_format()), config.compress_ratio());
 
+        case proto::desktop::VIDEO_ENCODING_PALETTE:
+            return codec::VideoEncoderPalette::create(
+                codec::VideoUtil::fromVideoPixelFormat(
+                    config.pixel_format()), config.compress_ratio());
+
+        case proto::desktop::VIDEO_ENCODING_HYBRID:
+            return codec::VideoEncoderHybrid::create(
+                std::unique_ptr<codec::VideoEncoder>(codec::VideoEncoderZstd::create(
+                    codec::VideoUtil::fromVideoPixelFormat(
+                        config.pixel_format()), config.compress_ratio())),
+                std::unique_ptr<codec::VideoEncoder>(codec::VideoEncoderVPX::createVP9(kVpxThreads)));
+
         default:
             LOG(LS_WARNING) << "Unsupported video encoding: " << config.video_encoding();
             return nullptr;
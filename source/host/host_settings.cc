@@ -150,4 +150,15 @@ void Settings::setUpdateServer(const QString& server)
     settings_.setValue(QStringLiteral("UpdateServer"), server);
 }
 
+int Settings::videoCpuBudget() const
+{
+    // By default the encoders use half of the cores, so the host stays responsive.
+    return settings_.value(QStringLiteral("VideoCpuBudget"), 50).toInt();
+}
+
+void Settings::setVideoCpuBudget(int percent)
+{
+    settings_.setValue(QStringLiteral("VideoCpuBudget"), percent);
+}
+
 } // namespace host
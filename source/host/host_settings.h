@@ -53,6 +53,10 @@ public:
     QString updateServer() const;
     void setUpdateServer(const QString& server);
 
+    // Share of the processor cores in percent that the VPX encoders may use for the threads.
+    int videoCpuBudget() const;
+    void setVideoCpuBudget(int percent);
+
 private:
     mutable QSettings settings_;
 
@@ -18,6 +18,8 @@
 
 #include "host/screen_updater.h"
 
+#include "base/logging.h"
+#include "codec/scale_reducer.h"
 #include "host/screen_updater_impl.h"
 
 namespace host {
@@ -33,23 +35,126 @@ ScreenUpdater::ScreenUpdater(Delegate* delegate, QObject* parent)
     // Nothing
 }
 
+ScreenUpdater::~ScreenUpdater()
+{
+    stopUpdaters();
+}
+
 bool ScreenUpdater::start(const proto::desktop::Config& config)
 {
-    impl_ = new ScreenUpdaterImpl(this);
-    return impl_->startUpdater(config);
+    config_ = config;
+    return startUpdaters();
 }
 
 void ScreenUpdater::selectScreen(int64_t screen_id)
 {
-    impl_->selectScreen(screen_id);
+    screen_id_ = screen_id;
+
+    if (has_screen_streams_ || useScreenStreams())
+    {
+        if (!startUpdaters())
+            LOG(LS_WARNING) << "Unable to start the updaters for screen " << screen_id;
+        return;
+    }
+
+    for (auto updater : updaters_)
+        updater->selectScreen(screen_id);
 }
 
-void ScreenUpdater::customEvent(QEvent* event)
+void ScreenUpdater::setScale(const proto::desktop::Config& config)
 {
-    if (event->type() != ScreenUpdaterImpl::MessageEvent::kType)
+    config_.set_scale_factor(config.scale_factor());
+    config_.set_target_width(config.target_width());
+    config_.set_target_height(config.target_height());
+
+    // The streams of the screens are not scaled.
+    if (has_screen_streams_ || useScreenStreams())
+    {
+        if (!startUpdaters())
+            LOG(LS_WARNING) << "Unable to start the updaters with the new scale";
         return;
+    }
+
+    for (auto updater : updaters_)
+        updater->setScale(config_);
+}
+
+void ScreenUpdater::setNetworkFeedback(const proto::desktop::NetworkFeedback& feedback)
+{
+    // Each of the streams adapts to its part of the network.
+    for (auto updater : updaters_)
+        updater->setNetworkFeedback(feedback);
+}
+
+void ScreenUpdater::customEvent(QEvent* event)
+{
+    if (event->type() == ScreenUpdaterImpl::MessageEvent::kType)
+    {
+        delegate_->onScreenUpdate(static_cast<ScreenUpdaterImpl::MessageEvent*>(event)->buffer());
+    }
+    else if (event->type() == ScreenUpdaterImpl::kScreensChangedEventType)
+    {
+        if (!startUpdaters())
+            LOG(LS_WARNING) << "Unable to start the updaters for the new screens";
+    }
+}
+
+bool ScreenUpdater::useScreenStreams() const
+{
+    return (config_.video_features() & proto::desktop::VIDEO_FEATURE_SCREEN_STREAMS) &&
+           screen_id_ == desktop::ScreenCapturer::kFullDesktopScreenId &&
+           config_.scale_factor() == codec::ScaleReducer::kDefScaleFactor &&
+           !config_.target_width() && !config_.target_height();
+}
+
+bool ScreenUpdater::startUpdaters()
+{
+    stopUpdaters();
+
+    desktop::ScreenCapturer::ScreenList screens;
+    if (useScreenStreams())
+        ScreenUpdaterImpl::screenList(&screens);
+
+    has_screen_streams_ = screens.size() > 1;
+
+    if (!has_screen_streams_)
+    {
+        ScreenUpdaterImpl* updater = new ScreenUpdaterImpl(this);
+        updaters_.push_back(updater);
+
+        if (screen_id_ != desktop::ScreenCapturer::kFullDesktopScreenId)
+            updater->selectScreen(screen_id_);
+
+        return updater->startUpdater(config_);
+    }
+
+    // The client composes the screens by their positions, so the streams are never scaled.
+    proto::desktop::Config stream_config = config_;
+    stream_config.set_video_features(
+        stream_config.video_features() & ~proto::desktop::VIDEO_FEATURE_ADAPTIVE_SCALE);
+
+    for (int i = 0; i < screens.size(); ++i)
+    {
+        ScreenUpdaterImpl* updater = new ScreenUpdaterImpl(this);
+        updaters_.push_back(updater);
+
+        updater->setStream(screens[i].id, i == 0, screens.size());
+
+        if (!updater->startUpdater(stream_config))
+            return false;
+    }
+
+    LOG(LS_INFO) << "Started " << screens.size() << " streams of the screens";
+    return true;
+}
+
+void ScreenUpdater::stopUpdaters()
+{
+    // The destructors wait for the threads of the updaters.
+    for (auto updater : updaters_)
+        delete updater;
 
-    delegate_->onScreenUpdate(static_cast<ScreenUpdaterImpl::MessageEvent*>(event)->buffer());
+    updaters_.clear();
 }
 
 } // namespace host
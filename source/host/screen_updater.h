@@ -21,8 +21,12 @@
 
 #include <QObject>
 
+#include <vector>
+
 #include "base/macros_magic.h"
+#include "desktop/screen_capturer.h"
 #include "proto/desktop_session.pb.h"
+#include "proto/desktop_session_extensions.pb.h"
 
 namespace host {
 
@@ -42,18 +46,32 @@ public:
     };
 
     ScreenUpdater(Delegate* delegate, QObject* parent = nullptr);
-    ~ScreenUpdater() = default;
+    ~ScreenUpdater();
 
 public slots:
     bool start(const proto::desktop::Config& config);
     void selectScreen(int64_t screen_id);
+    void setScale(const proto::desktop::Config& config);
+    void setNetworkFeedback(const proto::desktop::NetworkFeedback& feedback);
 
 protected:
     // QObject implementation.
     void customEvent(QEvent* event) override;
 
 private:
-    ScreenUpdaterImpl* impl_ = nullptr;
+    // If the client supports the streams of the screens and the full desktop is shown without the
+    // scaling, each screen is captured and encoded by its own updater in parallel. Otherwise one
+    // updater captures the selected screen.
+    bool useScreenStreams() const;
+    bool startUpdaters();
+    void stopUpdaters();
+
+    std::vector<ScreenUpdaterImpl*> updaters_;
+    bool has_screen_streams_ = false;
+
+    proto::desktop::Config config_;
+    desktop::ScreenCapturer::ScreenId screen_id_ = desktop::ScreenCapturer::kFullDesktopScreenId;
+
     Delegate* delegate_;
 
     DISALLOW_COPY_AND_ASSIGN(ScreenUpdater);
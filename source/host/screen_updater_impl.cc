@@ -20,20 +20,135 @@
 
 #include <QCoreApplication>
 
+#include <algorithm>
+#include <cstring>
+
+#include "build/build_config.h"
 #include "codec/cursor_encoder.h"
+#include "codec/rate_controller.h"
 #include "codec/scale_reducer.h"
+#include "codec/video_encoder_hybrid.h"
+#include "codec/video_encoder_palette.h"
 #include "codec/video_encoder_vpx.h"
 #include "codec/video_encoder_zstd.h"
 #include "codec/video_util.h"
+#include "codec/vpx_threading.h"
 #include "common/desktop_session_constants.h"
 #include "common/message_serialization.h"
 #include "desktop/capture_scheduler.h"
+#include "desktop/cursor_capturer.h"
+#include "desktop/frame_pool.h"
+#include "desktop/frame_trace_writer.h"
+#include "host/host_settings.h"
+#include "proto/desktop_session_extensions.pb.h"
+
+#include "desktop/screen_capturer_replay.h"
+
+#if defined(OS_WIN)
 #include "desktop/cursor_capturer_win.h"
 #include "desktop/screen_capturer_gdi.h"
-#include "proto/desktop_session_extensions.pb.h"
+#endif // defined(OS_WIN)
 
 namespace host {
 
+namespace {
+
+// Creates the ZSTD encoder with the features enabled by the client.
+codec::VideoEncoderZstd* createZstdEncoder(const proto::desktop::Config& config)
+{
+    codec::VideoEncoderZstd* encoder = codec::VideoEncoderZstd::create(
+        codec::VideoUtil::fromVideoPixelFormat(config.pixel_format()), config.compress_ratio());
+
+    if (encoder)
+    {
+        if (config.video_features() & proto::desktop::VIDEO_FEATURE_ZSTD_TILES)
+            encoder->enableTiles();
+
+        if (config.video_features() & proto::desktop::VIDEO_FEATURE_ZSTD_PREDICTION)
+            encoder->enablePrediction();
+
+        if (config.video_features() & proto::desktop::VIDEO_FEATURE_ZSTD_CONTEXT)
+            encoder->enablePersistentStreams();
+    }
+
+    return encoder;
+}
+
+void copyRegion(const desktop::Frame* source, desktop::Frame* target, const QRegion& region)
+{
+    const int bytes_per_pixel = source->format().bytesPerPixel();
+
+    for (const auto& rect : region.intersected(QRect(QPoint(), source->size())))
+    {
+        const uint8_t* source_row = source->frameDataAtPos(rect.topLeft());
+        uint8_t* target_row = target->frameDataAtPos(rect.topLeft());
+        const size_t row_size = rect.width() * bytes_per_pixel;
+
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            memcpy(target_row, source_row, row_size);
+
+            source_row += source->stride();
+            target_row += target->stride();
+        }
+    }
+}
+
+const QSize kReplayScreenSize(1920, 1080);
+
+// The scene is selected by the environment variable ASPIA_REPLAY_SCENE (for example,
+// "scrolling" or "video").
+desktop::FrameGenerator::Scene replayScene()
+{
+    using Scene = desktop::FrameGenerator::Scene;
+
+    const QByteArray name = qgetenv("ASPIA_REPLAY_SCENE");
+
+    for (int i = 0; i <= static_cast<int>(Scene::FULLSCREEN_VIDEO); ++i)
+    {
+        const Scene scene = static_cast<Scene>(i);
+
+        if (name == desktop::FrameGenerator::sceneName(scene))
+            return scene;
+    }
+
+    return Scene::MOVING_WINDOW;
+}
+
+// If the environment variable ASPIA_REPLAY_TRACE contains the path to a trace file, the trace is
+// played back. Otherwise a generated scene is played.
+std::unique_ptr<desktop::ScreenCapturer> createReplayCapturer(uint32_t flags)
+{
+    const QString trace_path = QString::fromLocal8Bit(qgetenv("ASPIA_REPLAY_TRACE"));
+    if (!trace_path.isEmpty())
+    {
+        std::unique_ptr<desktop::ScreenCapturer> capturer =
+            desktop::ScreenCapturerReplay::createFromTrace(trace_path, flags);
+        if (capturer)
+            return capturer;
+    }
+
+    return desktop::ScreenCapturerReplay::createGenerated(replayScene(), kReplayScreenSize, flags);
+}
+
+std::unique_ptr<desktop::ScreenCapturer> createScreenCapturer(uint32_t flags)
+{
+#if defined(OS_WIN)
+    // The recorded or generated frames are played back instead of the screen if one of the
+    // replay variables is set. The host then runs the whole pipeline without an interactive
+    // desktop (for example, on a build server) with reproducible input.
+    if (qEnvironmentVariableIsEmpty("ASPIA_REPLAY_TRACE") &&
+        qEnvironmentVariableIsEmpty("ASPIA_REPLAY_SCENE"))
+    {
+        return std::make_unique<desktop::ScreenCapturerGDI>(flags);
+    }
+#endif // defined(OS_WIN)
+
+    return createReplayCapturer(flags);
+}
+
+} // namespace
+
 ScreenUpdaterImpl::ScreenUpdaterImpl(QObject* parent)
     : QThread(parent)
 {
@@ -54,27 +169,76 @@ ScreenUpdaterImpl::~ScreenUpdaterImpl()
     wait();
 }
 
+// static
+bool ScreenUpdaterImpl::screenList(desktop::ScreenCapturer::ScreenList* screens)
+{
+    return createScreenCapturer(0)->screenList(screens);
+}
+
+void ScreenUpdaterImpl::setStream(desktop::ScreenCapturer::ScreenId screen_id, bool primary,
+                                  int stream_count)
+{
+    DCHECK(!isRunning());
+    DCHECK_GT(stream_count, 0);
+
+    is_stream_ = true;
+    is_primary_ = primary;
+    stream_count_ = stream_count;
+    stream_screen_id_ = screen_id;
+    screen_id_ = screen_id;
+}
+
 bool ScreenUpdaterImpl::startUpdater(const proto::desktop::Config& config)
 {
     scale_reducer_.reset(codec::ScaleReducer::create(config.scale_factor()));
     if (!scale_reducer_)
         return false;
 
+    adaptive_scale_ = config.video_features() & proto::desktop::VIDEO_FEATURE_ADAPTIVE_SCALE;
+    if (adaptive_scale_)
+        scale_reducer_->setTargetSize(QSize(config.target_width(), config.target_height()));
+
+    // The encoders of the streams work at the same time.
+    const int vpx_threads =
+        std::max(codec::vpxThreadLimit(Settings().videoCpuBudget()) / stream_count_, 1);
+
     switch (config.video_encoding())
     {
         case proto::desktop::VIDEO_ENCODING_VP8:
-            video_encoder_.reset(codec::VideoEncoderVPX::createVP8());
-            break;
-
         case proto::desktop::VIDEO_ENCODING_VP9:
-            video_encoder_.reset(codec::VideoEncoderVPX::createVP9());
-            break;
+        {
+            codec::VideoEncoderVPX* encoder =
+                (config.video_encoding() == proto::desktop::VIDEO_ENCODING_VP8) ?
+                codec::VideoEncoderVPX::createVP8(vpx_threads) :
+                codec::VideoEncoderVPX::createVP9(vpx_threads);
+
+            // The VPX encoders scale the frames while converting them to I420.
+            encoder->setScaleReducer(scale_reducer_.get());
+            encoder_scales_frames_ = true;
+
+            video_encoder_.reset(encoder);
+        }
+        break;
 
         case proto::desktop::VIDEO_ENCODING_ZSTD:
-            video_encoder_.reset(codec::VideoEncoderZstd::create(
+            video_encoder_.reset(createZstdEncoder(config));
+            break;
+
+        case proto::desktop::VIDEO_ENCODING_PALETTE:
+        {
+            video_encoder_.reset(codec::VideoEncoderPalette::create(
                 codec::VideoUtil::fromVideoPixelFormat(
                     config.pixel_format()), config.compress_ratio()));
-            break;
+        }
+        break;
+
+        case proto::desktop::VIDEO_ENCODING_HYBRID:
+        {
+            video_encoder_.reset(codec::VideoEncoderHybrid::create(
+                std::unique_ptr<codec::VideoEncoder>(createZstdEncoder(config)),
+                std::unique_ptr<codec::VideoEncoder>(codec::VideoEncoderVPX::createVP9(vpx_threads))));
+        }
+        break;
 
         default:
         {
@@ -88,20 +252,37 @@ bool ScreenUpdaterImpl::startUpdater(const proto::desktop::Config& config)
     if (!video_encoder_)
         return false;
 
-    if (config.flags() & proto::desktop::ENABLE_CURSOR_SHAPE)
+#if defined(OS_WIN)
+    if (is_primary_ && (config.flags() & proto::desktop::ENABLE_CURSOR_SHAPE))
     {
         cursor_capturer_.reset(new desktop::CursorCapturerWin());
         cursor_encoder_.reset(new codec::CursorEncoder());
+
+        if (config.video_features() & proto::desktop::VIDEO_FEATURE_ZSTD_CONTEXT)
+            cursor_encoder_->enablePersistentStream();
     }
+#endif // defined(OS_WIN)
 
     capture_scheduler_.reset(
         new desktop::CaptureScheduler(std::chrono::milliseconds(config.update_interval())));
+    rate_controller_.reset(
+        new codec::RateController(std::chrono::milliseconds(config.update_interval())));
 
     if (config.flags() & proto::desktop::DISABLE_DESKTOP_EFFECTS)
-        screen_capturer_flags_ |= desktop::ScreenCapturerGDI::DISABLE_EFFECTS;
+        screen_capturer_flags_ |= desktop::ScreenCapturer::DISABLE_EFFECTS;
 
     if (config.flags() & proto::desktop::DISABLE_DESKTOP_WALLPAPER)
-        screen_capturer_flags_ |= desktop::ScreenCapturerGDI::DISABLE_WALLPAPER;
+        screen_capturer_flags_ |= desktop::ScreenCapturer::DISABLE_WALLPAPER;
+
+    // Moves are transmitted only by the lossless encoders. VPX encoders always encode the target
+    // areas of the moves.
+    if ((config.video_features() & proto::desktop::VIDEO_FEATURE_MOVE_RECT) &&
+        (config.video_encoding() == proto::desktop::VIDEO_ENCODING_ZSTD ||
+         config.video_encoding() == proto::desktop::VIDEO_ENCODING_PALETTE ||
+         config.video_encoding() == proto::desktop::VIDEO_ENCODING_HYBRID))
+    {
+        screen_capturer_flags_ |= desktop::ScreenCapturer::DETECT_MOVES;
+    }
 
     start(QThread::HighPriority);
     return true;
@@ -118,9 +299,82 @@ void ScreenUpdaterImpl::selectScreen(desktop::ScreenCapturer::ScreenId screen_id
     event_condition_.notify_all();
 }
 
+void ScreenUpdaterImpl::setScale(const proto::desktop::Config& config)
+{
+    std::scoped_lock lock(event_lock_);
+    scale_factor_ = config.scale_factor();
+    target_size_ = QSize(config.target_width(), config.target_height());
+    scale_changed_ = true;
+}
+
+void ScreenUpdaterImpl::setNetworkFeedback(const proto::desktop::NetworkFeedback& feedback)
+{
+    std::scoped_lock lock(event_lock_);
+    network_feedback_ = feedback;
+    has_network_feedback_ = true;
+}
+
+void ScreenUpdaterImpl::updateRate()
+{
+    codec::RateController::Feedback feedback;
+
+    {
+        std::scoped_lock lock(event_lock_);
+
+        if (!has_network_feedback_)
+            return;
+
+        // The streams share the network, so each of them gets an equal part of the rate and of
+        // the queue.
+        feedback.pending_bytes = network_feedback_.pending_bytes() / stream_count_;
+        feedback.bytes_per_second = network_feedback_.bytes_per_second() / stream_count_;
+        feedback.send_delay = std::chrono::milliseconds(network_feedback_.send_delay());
+
+        has_network_feedback_ = false;
+    }
+
+    // Time required to send the queued data. The send delay includes the time the data waits
+    // in the queues before the network.
+    std::chrono::milliseconds latency = feedback.send_delay;
+    if (feedback.bytes_per_second)
+    {
+        latency = std::max(latency, std::chrono::milliseconds(
+            feedback.pending_bytes * 1000 / feedback.bytes_per_second));
+    }
+
+    capture_scheduler_->setLatency(latency);
+
+    rate_controller_->setMaxBitrate(max_bitrate_.load(std::memory_order_relaxed));
+
+    if (!rate_controller_->update(feedback))
+        return;
+
+    const codec::RateController::Settings& settings = rate_controller_->settings();
+
+    capture_scheduler_->setUpdateInterval(settings.update_interval);
+
+    // The encoder is used by the encoding stage and applies the limits before the next frame.
+    std::scoped_lock lock(event_lock_);
+    rate_settings_ = settings;
+    rate_settings_changed_ = true;
+}
+
 void ScreenUpdaterImpl::run()
 {
-    screen_capturer_.reset(new desktop::ScreenCapturerGDI(screen_capturer_flags_));
+    screen_capturer_ = createScreenCapturer(screen_capturer_flags_);
+
+    // If the environment variable ASPIA_TRACE_FILE is set, the captured frames are recorded to
+    // the file to reproduce the session later.
+    std::unique_ptr<desktop::FrameTraceWriter> trace_writer;
+
+    const QString trace_path = QString::fromLocal8Bit(qgetenv("ASPIA_TRACE_FILE"));
+    if (!trace_path.isEmpty())
+        trace_writer = desktop::FrameTraceWriter::create(trace_path);
+
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    encode_thread_ = std::thread(&ScreenUpdaterImpl::encodeThread, this);
+    send_thread_ = std::thread(&ScreenUpdaterImpl::sendThread, this);
 
     while (true)
     {
@@ -129,14 +383,27 @@ void ScreenUpdaterImpl::run()
         {
             std::scoped_lock lock(event_lock_);
 
-            screen_count_ = count;
+            if (is_stream_)
+            {
+                // The screen of the stream may be removed. The updaters are created again for
+                // the new list of screens.
+                if (screen_count_ && is_primary_)
+                {
+                    const QEvent::Type type = static_cast<QEvent::Type>(kScreensChangedEventType);
+                    QCoreApplication::postEvent(parent(), new QEvent(type));
+                }
+            }
+            else if (screen_count_)
+            {
+                // The list of screens has changed. We do not know which screen is removed or
+                // added. We display the full desktop and send a new list of screens.
+                screen_id_ = desktop::ScreenCapturer::kFullDesktopScreenId;
+            }
 
-            // The list of screens has changed. We do not know which screen is removed or added.
-            // We display the full desktop and send a new list of screens.
-            screen_id_ = desktop::ScreenCapturer::kFullDesktopScreenId;
+            screen_count_ = count;
 
             desktop::ScreenCapturer::ScreenList screens;
-            if (screen_capturer_->screenList(&screens))
+            if (is_primary_ && screen_capturer_->screenList(&screens))
             {
                 proto::desktop::ScreenList screen_list;
 
@@ -148,53 +415,56 @@ void ScreenUpdaterImpl::run()
                     item->set_title(screen.title.toStdString());
                 }
 
-                message_.Clear();
+                proto::desktop::HostToClient message;
 
-                proto::desktop::Extension* extension = message_.mutable_extension();
+                proto::desktop::Extension* extension = message.mutable_extension();
 
                 extension->set_name(common::kSelectScreenExtension);
                 extension->set_data(screen_list.SerializeAsString());
 
                 QCoreApplication::postEvent(
-                    parent(), new MessageEvent(common::serializeMessage(message_)));
+                    parent(), new MessageEvent(common::serializeMessage(message)));
             }
 
             screen_capturer_->selectScreen(screen_id_);
+
+            // The selected screen is already applied.
+            if (event_ == Event::SELECT_SCREEN)
+                event_ = Event::NO_EVENT;
         }
 
+        updateRate();
+
         capture_scheduler_->beginCapture();
 
+        const std::chrono::steady_clock::time_point capture_time =
+            std::chrono::steady_clock::now();
+
+        bool has_changes = false;
+
         const desktop::Frame* screen_frame = screen_capturer_->captureFrame();
         if (screen_frame)
         {
-            message_.Clear();
+            has_changes = !screen_frame->constUpdatedRegion().isEmpty() ||
+                          !screen_frame->constMoveList().isEmpty();
 
-            if (!screen_frame->constUpdatedRegion().isEmpty())
+            if (trace_writer)
             {
-                video_encoder_->encode(scale_reducer_->scaleFrame(screen_frame),
-                                       message_.mutable_video_packet());
-            }
+                std::chrono::microseconds timestamp =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        capture_time - start_time);
 
-            if (cursor_capturer_ && cursor_encoder_)
-            {
-                std::unique_ptr<desktop::MouseCursor> mouse_cursor(
-                    cursor_capturer_->captureCursor());
-                if (mouse_cursor)
-                {
-                    cursor_encoder_->encode(std::move(mouse_cursor),
-                                            message_.mutable_cursor_shape());
-                }
+                // Stop recording on an error (for example, if the disk is full).
+                if (!trace_writer->addFrame(screen_frame, timestamp))
+                    trace_writer.reset();
             }
 
-            if (message_.has_video_packet() || message_.has_cursor_shape())
-            {
-                QCoreApplication::postEvent(parent(),
-                                        new MessageEvent(common::serializeMessage(message_)),
-                                        Qt::HighEventPriority);
-            }
+            processFrame(screen_frame);
         }
 
-        capture_scheduler_->endCapture();
+        capture_stats_.addTime(std::chrono::steady_clock::now() - capture_time);
+
+        capture_scheduler_->endCapture(has_changes);
 
         std::unique_lock lock(event_lock_);
         event_condition_.wait_for(lock, capture_scheduler_->nextCaptureDelay());
@@ -205,7 +475,13 @@ void ScreenUpdaterImpl::run()
                 break;
 
             case Event::TERMINATE:
-                return;
+            {
+                lock.unlock();
+
+                stopPipeline();
+                logStats();
+            }
+            return;
 
             case Event::SELECT_SCREEN:
                 screen_capturer_->selectScreen(screen_id_);
@@ -216,4 +492,378 @@ void ScreenUpdaterImpl::run()
     }
 }
 
+void ScreenUpdaterImpl::StageStats::addTime(const std::chrono::steady_clock::duration& time)
+{
+    const std::chrono::microseconds microseconds =
+        std::chrono::duration_cast<std::chrono::microseconds>(time);
+
+    ++count;
+    total_time += microseconds;
+    max_time = std::max(max_time, microseconds);
+}
+
+void ScreenUpdaterImpl::processFrame(const desktop::Frame* screen_frame)
+{
+    mergeChanges(screen_frame);
+
+    if (cursor_capturer_ && cursor_encoder_)
+    {
+        std::unique_ptr<desktop::MouseCursor> mouse_cursor(cursor_capturer_->captureCursor());
+
+        // Only the last shape of the cursor is sent if the encoder is busy.
+        if (mouse_cursor)
+            pending_mouse_cursor_ = std::move(mouse_cursor);
+    }
+
+    if (!has_pending_frame_ && !pending_mouse_cursor_)
+        return;
+
+    passFrame(screen_frame);
+}
+
+void ScreenUpdaterImpl::mergeChanges(const desktop::Frame* screen_frame)
+{
+    const QRect screen_rect(QPoint(), screen_frame->size());
+
+    if (screen_size_ != screen_frame->size())
+    {
+        // The moves of the previous frames have no meaning for the new size of the screen. The
+        // frames of the previous size are created again, so they are not marked as stale.
+        screen_size_ = screen_frame->size();
+        pending_region_ = screen_rect;
+        pending_moves_.clear();
+        has_pending_frame_ = true;
+        return;
+    }
+
+    QRegion changed_region = screen_frame->constUpdatedRegion();
+
+    for (const auto& move : screen_frame->constMoveList())
+        changed_region += QRect(move.target_pos, move.source_rect.size());
+
+    changed_region = changed_region.intersected(screen_rect);
+    if (changed_region.isEmpty())
+    {
+        // The frame without changes is passed if the encoder refines the image, so the areas
+        // encoded with losses become exact when the screen is not changed.
+        if (!has_pending_frame_ && refinement_pending_.load(std::memory_order_relaxed))
+        {
+            pending_region_ = QRegion();
+            pending_moves_.clear();
+            has_pending_frame_ = true;
+        }
+        return;
+    }
+
+    // All the frames that are not updated get stale in the changed areas.
+    for (auto& slot : frame_slots_)
+        slot.stale_region += changed_region;
+
+    if (!has_pending_frame_)
+    {
+        pending_region_ = screen_frame->constUpdatedRegion();
+        pending_moves_ = screen_frame->constMoveList();
+        has_pending_frame_ = true;
+        return;
+    }
+
+    // The encoder has not taken the previous changes yet, and the frame is skipped. The moves of
+    // the skipped frame are applied before the merged region, so they stay correct. The moves of
+    // the new frame are applied after the skipped changes and are sent as changed areas.
+    pending_region_ += changed_region;
+    ++skipped_frames_;
+}
+
+bool ScreenUpdaterImpl::passFrame(const desktop::Frame* screen_frame)
+{
+    if (captured_queue_.isFull())
+        return false;
+
+    CapturedFrame captured_frame;
+
+    if (has_pending_frame_)
+    {
+        takeReturnedFrames();
+
+        FrameSlot* free_slot = nullptr;
+
+        for (auto& slot : frame_slots_)
+        {
+            if (!slot.frame_in_pipeline)
+            {
+                free_slot = &slot;
+                break;
+            }
+        }
+
+        if (!free_slot)
+            return false;
+
+        if (!free_slot->frame ||
+            free_slot->frame->size() != screen_frame->size() ||
+            free_slot->frame->format() != screen_frame->format())
+        {
+            free_slot->frame =
+                desktop::FramePool::instance()->create(screen_frame->size(), screen_frame->format());
+            if (!free_slot->frame)
+            {
+                LOG(LS_WARNING) << "Unable to create the frame";
+                return false;
+            }
+
+            free_slot->stale_region = QRect(QPoint(), screen_frame->size());
+        }
+
+        copyRegion(screen_frame, free_slot->frame.get(), free_slot->stale_region);
+        free_slot->stale_region = QRegion();
+
+        desktop::Frame* frame = free_slot->frame.get();
+
+        *frame->updatedRegion() = pending_region_;
+        *frame->moveList() = pending_moves_;
+        frame->setTopLeft(screen_frame->topLeft());
+
+        free_slot->frame_in_pipeline = frame;
+        captured_frame.frame = std::move(free_slot->frame);
+
+        pending_region_ = QRegion();
+        pending_moves_.clear();
+        has_pending_frame_ = false;
+    }
+
+    captured_frame.mouse_cursor = std::move(pending_mouse_cursor_);
+
+    const bool pushed = captured_queue_.tryPush(std::move(captured_frame));
+    DCHECK(pushed);
+
+    notifyPipeline();
+    return true;
+}
+
+void ScreenUpdaterImpl::takeReturnedFrames()
+{
+    std::unique_ptr<desktop::Frame> frame;
+
+    while (returned_queue_.tryPop(&frame))
+    {
+        for (auto& slot : frame_slots_)
+        {
+            if (slot.frame_in_pipeline == frame.get())
+            {
+                slot.frame = std::move(frame);
+                slot.frame_in_pipeline = nullptr;
+                break;
+            }
+        }
+    }
+}
+
+void ScreenUpdaterImpl::encodeThread()
+{
+    while (true)
+    {
+        CapturedFrame captured_frame;
+
+        if (waitPipeline([&]() { return captured_queue_.tryPop(&captured_frame); }))
+            return;
+
+        const std::chrono::steady_clock::time_point encode_time =
+            std::chrono::steady_clock::now();
+
+        applySettings();
+
+        std::unique_ptr<proto::desktop::HostToClient> message =
+            std::make_unique<proto::desktop::HostToClient>();
+
+        if (captured_frame.frame)
+        {
+            const desktop::Frame* source_frame = captured_frame.frame.get();
+            const desktop::Frame* scaled_frame = encoder_scales_frames_ ?
+                source_frame : scale_reducer_->scaleFrame(source_frame);
+
+            if (scaled_frame)
+            {
+                proto::desktop::VideoPacket* packet = message->mutable_video_packet();
+
+                video_encoder_->encode(scaled_frame, packet);
+                refinement_pending_.store(video_encoder_->hasRefinement(),
+                                          std::memory_order_relaxed);
+                max_bitrate_.store(video_encoder_->maxBitrate(), std::memory_order_relaxed);
+
+                const bool has_changes = !source_frame->constUpdatedRegion().isEmpty() ||
+                                         !source_frame->constMoveList().isEmpty();
+
+                if (!has_changes && !packet->has_format() && !packet->dirty_rect_size() &&
+                    !packet->part_size())
+                {
+                    // Nothing was refined in the frame without changes.
+                    message->clear_video_packet();
+                }
+                else
+                {
+                    if (is_stream_)
+                        packet->mutable_stream()->set_screen_id(stream_screen_id_);
+
+                    if (adaptive_scale_)
+                        fillSourceRect(source_frame, packet);
+                }
+            }
+
+            // The frame is copied again only in the areas that changed since this moment.
+            const bool returned = returned_queue_.tryPush(std::move(captured_frame.frame));
+            DCHECK(returned);
+        }
+
+        if (captured_frame.mouse_cursor && cursor_encoder_)
+        {
+            cursor_encoder_->encode(std::move(captured_frame.mouse_cursor),
+                                    message->mutable_cursor_shape());
+        }
+
+        encode_stats_.addTime(std::chrono::steady_clock::now() - encode_time);
+
+        if (!message->has_video_packet() && !message->has_cursor_shape())
+            continue;
+
+        if (waitPipeline([&]() { return message_queue_.tryPush(std::move(message)); }))
+            return;
+
+        notifyPipeline();
+    }
+}
+
+void ScreenUpdaterImpl::applySettings()
+{
+    std::scoped_lock lock(event_lock_);
+
+    if (rate_settings_changed_)
+    {
+        video_encoder_->setRateLimits(rate_settings_.bitrate,
+                                      rate_settings_.min_quantizer,
+                                      rate_settings_.max_quantizer);
+
+        // The frames are reduced on a slow network only if the client supports the change of the
+        // scale.
+        if (adaptive_scale_)
+            scale_reducer_->setReduction(rate_settings_.scale);
+
+        rate_settings_changed_ = false;
+    }
+
+    if (scale_changed_)
+    {
+        if (!scale_reducer_->setScaleFactor(scale_factor_))
+            LOG(LS_WARNING) << "Unsupported scale factor: " << scale_factor_;
+
+        scale_reducer_->setTargetSize(target_size_);
+        scale_changed_ = false;
+    }
+}
+
+void ScreenUpdaterImpl::fillSourceRect(const desktop::Frame* frame,
+                                       proto::desktop::VideoPacket* packet)
+{
+    const QRect source_rect(frame->topLeft(), frame->size());
+
+    // The scaled size is changed with the format of the packet.
+    if (!packet->has_format() && source_rect == source_rect_)
+        return;
+
+    source_rect_ = source_rect;
+    codec::VideoUtil::toVideoRect(source_rect, packet->mutable_source_rect());
+}
+
+void ScreenUpdaterImpl::sendThread()
+{
+    while (true)
+    {
+        std::unique_ptr<proto::desktop::HostToClient> message;
+
+        if (waitPipeline([&]() { return message_queue_.tryPop(&message); }))
+            return;
+
+        // The encoder can continue with the next frame.
+        notifyPipeline();
+
+        const std::chrono::steady_clock::time_point send_time = std::chrono::steady_clock::now();
+
+        QCoreApplication::postEvent(parent(),
+                                    new MessageEvent(common::serializeMessage(*message)),
+                                    Qt::HighEventPriority);
+
+        send_stats_.addTime(std::chrono::steady_clock::now() - send_time);
+    }
+}
+
+template <typename Condition>
+bool ScreenUpdaterImpl::waitPipeline(Condition condition)
+{
+    std::unique_lock lock(pipeline_lock_);
+
+    pipeline_condition_.wait(lock, [&]() { return pipeline_stopped_ || condition(); });
+    return pipeline_stopped_;
+}
+
+void ScreenUpdaterImpl::notifyPipeline()
+{
+    {
+        // The queues are changed without the lock. Taking the lock here guarantees that a stage
+        // which has just checked its queue is already waiting and receives the notification.
+        std::scoped_lock lock(pipeline_lock_);
+    }
+
+    pipeline_condition_.notify_all();
+}
+
+void ScreenUpdaterImpl::stopPipeline()
+{
+    {
+        std::scoped_lock lock(pipeline_lock_);
+        pipeline_stopped_ = true;
+    }
+
+    pipeline_condition_.notify_all();
+
+    if (encode_thread_.joinable())
+        encode_thread_.join();
+
+    if (send_thread_.joinable())
+        send_thread_.join();
+}
+
+void ScreenUpdaterImpl::logStats() const
+{
+    auto log_stage = [](const char* name, const StageStats& stats)
+    {
+        const int64_t average = stats.count ? stats.total_time.count() / stats.count : 0;
+
+        LOG(LS_INFO) << name << ": " << stats.count << " frames, average " << average
+                     << " us, max " << stats.max_time.count() << " us";
+    };
+
+    log_stage("Capture", capture_stats_);
+    log_stage("Encode", encode_stats_);
+    log_stage("Send", send_stats_);
+
+    LOG(LS_INFO) << "Skipped frames: " << skipped_frames_;
+
+    const desktop::CaptureScheduler::Stats& capture_stats = capture_scheduler_->stats();
+
+    LOG(LS_INFO) << "Capture scheduler: " << capture_stats.idle_captures << " idle captures, "
+                 << capture_stats.paused_captures << " paused captures";
+
+    desktop::FramePool::Stats stats = desktop::FramePool::instance()->stats();
+
+    LOG(LS_INFO) << "Frame pool: " << stats.hits << " hits, " << stats.misses
+                 << " misses, " << stats.cached_buffers << " cached buffers ("
+                 << stats.cached_bytes << " bytes)";
+
+    const codec::RateController::Stats& rate_stats = rate_controller_->stats();
+
+    LOG(LS_INFO) << "Rate control: " << rate_stats.congestions
+                 << " congestions, min bitrate " << rate_stats.min_bitrate
+                 << " kbps, max update interval "
+                 << rate_stats.max_update_interval.count() << " ms";
+}
+
 } // namespace host
@@ -22,8 +22,18 @@
 #include <QEvent>
 #include <QThread>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "base/spsc_queue.h"
+#include "codec/rate_controller.h"
+#include "desktop/mouse_cursor.h"
 #include "desktop/screen_capturer.h"
 #include "proto/desktop_session.pb.h"
+#include "proto/desktop_session_extensions.pb.h"
 
 namespace codec {
 class CursorEncoder;
@@ -63,9 +73,27 @@ public:
         DISALLOW_COPY_AND_ASSIGN(MessageEvent);
     };
 
+    // The list of the screens changed while the screens are captured by separate updaters. The
+    // event is sent to the parent, so it creates the updaters for the new screens.
+    static const int kScreensChangedEventType = QEvent::User + 2;
+
+    // Returns the list of the screens of the host.
+    static bool screenList(desktop::ScreenCapturer::ScreenList* screens);
+
+    // Captures only the screen |screen_id| and marks the packets as its stream (see
+    // VIDEO_FEATURE_SCREEN_STREAMS). Only the |primary| stream sends the list of the screens and
+    // the cursor. The |stream_count| streams share the network and the encoder threads equally.
+    // Must be called before startUpdater().
+    void setStream(desktop::ScreenCapturer::ScreenId screen_id, bool primary, int stream_count);
+
     bool startUpdater(const proto::desktop::Config& config);
     void selectScreen(desktop::ScreenCapturer::ScreenId screen_id);
 
+    // Changes the scale of the video without a restart of the video stream.
+    void setScale(const proto::desktop::Config& config);
+
+    void setNetworkFeedback(const proto::desktop::NetworkFeedback& feedback);
+
 protected:
     // QThread implementation.
     void run() override;
@@ -73,28 +101,161 @@ protected:
 private:
     enum class Event { NO_EVENT, SELECT_SCREEN, TERMINATE };
 
+    // The updater is a pipeline of three stages. The screen is captured on the thread of the
+    // updater, the frames are encoded on |encode_thread_| and the messages are serialized and
+    // sent on |send_thread_|. The stages are connected by bounded queues, so the next frame is
+    // captured while the previous one is encoded. If the encoder falls behind, the changes of
+    // the captured frames are merged and the encoder gets the latest frame.
+
+    // Captured frame passed from the capture stage to the encoding stage.
+    struct CapturedFrame
+    {
+        std::unique_ptr<desktop::Frame> frame;
+        std::unique_ptr<desktop::MouseCursor> mouse_cursor;
+    };
+
+    // Frame that receives a copy of the captured screen. The capturer reuses its frames, so the
+    // pixels are copied before the frame is passed to the encoder. Only the areas that changed
+    // since the previous use of the frame are copied.
+    struct FrameSlot
+    {
+        std::unique_ptr<desktop::Frame> frame;
+
+        // Frame while it is in the pipeline.
+        const desktop::Frame* frame_in_pipeline = nullptr;
+
+        // Areas in which the frame differs from the screen.
+        QRegion stale_region;
+    };
+
+    // Timing of a stage of the pipeline.
+    struct StageStats
+    {
+        void addTime(const std::chrono::steady_clock::duration& time);
+
+        int64_t count = 0;
+        std::chrono::microseconds total_time { 0 };
+        std::chrono::microseconds max_time { 0 };
+    };
+
+    static const int kFrameSlotCount = 3;
+
+    // Passes the changes of the captured frame and the cursor to the encoding stage.
+    void processFrame(const desktop::Frame* screen_frame);
+
+    // Adds the changes of |screen_frame| to the changes that are not yet passed to the encoder.
+    void mergeChanges(const desktop::Frame* screen_frame);
+
+    // Copies the screen to a free frame and passes it to the encoder. Returns false if the
+    // encoder is busy.
+    bool passFrame(const desktop::Frame* screen_frame);
+
+    // Takes the frames that are encoded back to the free frames.
+    void takeReturnedFrames();
+
+    void encodeThread();
+    void sendThread();
+
+    // Wakes up the stages waiting for the queues.
+    void notifyPipeline();
+    void stopPipeline();
+    void logStats() const;
+
+    // Applies the last network feedback to the capture scheduler. The limits of the encoder are
+    // applied in the encoding stage.
+    void updateRate();
+
+    // Applies the changes of the rate and the scale in the encoding stage.
+    void applySettings();
+
+    // Adds the position and size of the screen before the scaling to |packet| if they are changed.
+    void fillSourceRect(const desktop::Frame* frame, proto::desktop::VideoPacket* packet);
+
+    // Returns true if the pipeline must be stopped. Waits for |condition| otherwise.
+    template <typename Condition>
+    bool waitPipeline(Condition condition);
+
     uint32_t screen_capturer_flags_ = 0;
 
     std::unique_ptr<desktop::CaptureScheduler> capture_scheduler_;
+    std::unique_ptr<codec::RateController> rate_controller_;
 
     std::unique_ptr<desktop::ScreenCapturer> screen_capturer_;
     std::unique_ptr<codec::ScaleReducer> scale_reducer_;
     std::unique_ptr<codec::VideoEncoder> video_encoder_;
 
+    // If true, the encoder scales the frames itself with the settings of |scale_reducer_|.
+    bool encoder_scales_frames_ = false;
+
+    // Set by setStream().
+    bool is_stream_ = false;
+    bool is_primary_ = true;
+    int stream_count_ = 1;
+    desktop::ScreenCapturer::ScreenId stream_screen_id_ =
+        desktop::ScreenCapturer::kInvalidScreenId;
+
+    // If true, the scale is changed during the session (VIDEO_FEATURE_ADAPTIVE_SCALE).
+    bool adaptive_scale_ = false;
+    QRect source_rect_;
+
     std::unique_ptr<desktop::CursorCapturer> cursor_capturer_;
     std::unique_ptr<codec::CursorEncoder> cursor_encoder_;
 
+    // State of the capture stage.
+    FrameSlot frame_slots_[kFrameSlotCount];
+    QSize screen_size_;
+    QRegion pending_region_;
+    desktop::Frame::MoveList pending_moves_;
+    bool has_pending_frame_ = false;
+    std::unique_ptr<desktop::MouseCursor> pending_mouse_cursor_;
+
+    // Set by the encoding stage while the encoder refines the image in the frames without changes
+    // (see VideoEncoder::hasRefinement).
+    std::atomic_bool refinement_pending_ { false };
+
+    // The highest bitrate of the encoder (see VideoEncoder::maxBitrate). Set by the encoding stage
+    // and passed to the rate controller.
+    std::atomic_uint32_t max_bitrate_ { 0 };
+
+    // Queues between the stages. The encoding stage returns the frames to the capture stage.
+    base::SpscQueue<CapturedFrame> captured_queue_ { 1 };
+    base::SpscQueue<std::unique_ptr<desktop::Frame>> returned_queue_ { kFrameSlotCount };
+    base::SpscQueue<std::unique_ptr<proto::desktop::HostToClient>> message_queue_ { 2 };
+
+    std::thread encode_thread_;
+    std::thread send_thread_;
+
+    std::mutex pipeline_lock_;
+    std::condition_variable pipeline_condition_;
+    bool pipeline_stopped_ = false;
+
+    // Limits of the encoder changed by the rate controller. Protected by |event_lock_|.
+    codec::RateController::Settings rate_settings_;
+    bool rate_settings_changed_ = false;
+
+    // Scale requested by the client. Protected by |event_lock_|.
+    int scale_factor_ = 0;
+    QSize target_size_;
+    bool scale_changed_ = false;
+
+    StageStats capture_stats_;
+    StageStats encode_stats_;
+    StageStats send_stats_;
+    int64_t skipped_frames_ = 0;
+
     // By default, we capture the full screen.
     desktop::ScreenCapturer::ScreenId screen_id_ =
         desktop::ScreenCapturer::kFullDesktopScreenId;
     int screen_count_ = 0;
 
+    // The last network feedback. It is set from another thread and protected by |event_lock_|.
+    proto::desktop::NetworkFeedback network_feedback_;
+    bool has_network_feedback_ = false;
+
     Event event_ = Event::NO_EVENT;
     std::condition_variable event_condition_;
     std::mutex event_lock_;
 
-    proto::desktop::HostToClient message_;
-
     DISALLOW_COPY_AND_ASSIGN(ScreenUpdaterImpl);
 };
 
@@ -23,14 +23,26 @@
 
 #include <QCoreApplication>
 
+#include <algorithm>
+
 #include "base/qt_logging.h"
+#include "common/desktop_session_constants.h"
+#include "common/message_serialization.h"
 #include "host/host_session_fake.h"
 #include "ipc/ipc_channel.h"
 #include "ipc/ipc_server.h"
 #include "net/network_channel_host.h"
+#include "proto/desktop_session.pb.h"
+#include "proto/desktop_session_extensions.pb.h"
 
 namespace host {
 
+namespace {
+
+const std::chrono::milliseconds kNetworkFeedbackInterval(500);
+
+} // namespace
+
 Host::Host(QObject* parent)
     : QObject(parent)
 {
@@ -196,6 +208,10 @@ void Host::timerEvent(QTimerEvent* event)
         LOG(LS_WARNING) << "Timeout of session attachment";
         stop();
     }
+    else if (event->timerId() == feedback_timer_id_)
+    {
+        sendNetworkFeedback();
+    }
 }
 
 void Host::ipcServerStarted(const QString& channel_id)
@@ -271,17 +287,59 @@ void Host::ipcNewConnection(ipc::Channel* channel)
 
     connect(ipc_channel_, &ipc::Channel::disconnected, ipc_channel_, &ipc::Channel::deleteLater);
     connect(ipc_channel_, &ipc::Channel::messageReceived, network_channel_, &net::Channel::send);
-    connect(network_channel_, &net::Channel::messageReceived, ipc_channel_, &ipc::Channel::send);
+    // The connection remains after the session is detached.
+    connect(network_channel_, &net::Channel::messageReceived,
+            this, &Host::networkMessageReceived, Qt::UniqueConnection);
 
     LOG(LS_INFO) << "Host process is attached for session " << session_id_;
     state_ = State::ATTACHED;
 
+    // The desktop sessions adapt the rate of the video to the network.
+    if (network_channel_->sessionType() == proto::SESSION_TYPE_DESKTOP_MANAGE ||
+        network_channel_->sessionType() == proto::SESSION_TYPE_DESKTOP_VIEW)
+    {
+        const net::Channel::WriteStats stats = network_channel_->writeStats();
+
+        feedback_written_messages_ = stats.written_messages;
+        feedback_written_bytes_ = stats.written_bytes;
+        feedback_send_delay_ = stats.send_delay;
+        feedback_time_ = std::chrono::steady_clock::now();
+
+        feedback_timer_id_ = startTimer(kNetworkFeedbackInterval);
+        if (!feedback_timer_id_)
+            LOG(LS_WARNING) << "Could not start the network feedback timer";
+    }
+
     if (!network_channel_->isStarted())
         network_channel_->start();
 
     ipc_channel_->start();
 }
 
+void Host::networkMessageReceived(const QByteArray& buffer)
+{
+    if (!ipc_channel_)
+        return;
+
+    // The network feedback is sent to the desktop session only by the host. The same messages
+    // from the client are not forwarded.
+    if (network_channel_->sessionType() == proto::SESSION_TYPE_DESKTOP_MANAGE ||
+        network_channel_->sessionType() == proto::SESSION_TYPE_DESKTOP_VIEW)
+    {
+        proto::desktop::ClientToHost message;
+
+        if (common::parseMessage(buffer, message) &&
+            message.has_extension() &&
+            message.extension().name() == common::kNetworkFeedbackExtension)
+        {
+            LOG(LS_WARNING) << "Network feedback from the client is ignored";
+            return;
+        }
+    }
+
+    ipc_channel_->send(buffer);
+}
+
 void Host::sessionProcessError(HostProcess::ErrorCode error_code)
 {
     if (network_channel_->sessionType() == proto::SESSION_TYPE_FILE_TRANSFER &&
@@ -322,6 +380,12 @@ void Host::dettachSession()
     if (state_ != State::STOPPING)
         state_ = State::DETACHED;
 
+    if (feedback_timer_id_)
+    {
+        killTimer(feedback_timer_id_);
+        feedback_timer_id_ = 0;
+    }
+
     if (ipc_channel_)
     {
         LOG(LS_INFO) << "There is a valid IPC channel. Stopping";
@@ -378,4 +442,48 @@ bool Host::startFakeSession()
     return true;
 }
 
+void Host::sendNetworkFeedback()
+{
+    if (!ipc_channel_)
+        return;
+
+    const net::Channel::WriteStats stats = network_channel_->writeStats();
+    const std::chrono::steady_clock::time_point current_time = std::chrono::steady_clock::now();
+
+    const int64_t elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        current_time - feedback_time_).count();
+    if (elapsed_time <= 0)
+        return;
+
+    // Average delay of the messages sent since the previous feedback. If the queue is stuck, the
+    // delay of the oldest queued message is larger.
+    std::chrono::milliseconds send_delay = stats.queue_delay;
+
+    const int64_t written_messages = stats.written_messages - feedback_written_messages_;
+    if (written_messages > 0)
+    {
+        send_delay = std::max(send_delay,
+                              (stats.send_delay - feedback_send_delay_) / written_messages);
+    }
+
+    proto::desktop::NetworkFeedback feedback;
+    feedback.set_pending_bytes(static_cast<uint32_t>(stats.pending_bytes));
+    feedback.set_bytes_per_second(static_cast<uint32_t>(
+        (stats.written_bytes - feedback_written_bytes_) * 1000 / elapsed_time));
+    feedback.set_send_delay(static_cast<uint32_t>(send_delay.count()));
+
+    feedback_written_messages_ = stats.written_messages;
+    feedback_written_bytes_ = stats.written_bytes;
+    feedback_send_delay_ = stats.send_delay;
+    feedback_time_ = current_time;
+
+    proto::desktop::ClientToHost message;
+
+    proto::desktop::Extension* extension = message.mutable_extension();
+    extension->set_name(common::kNetworkFeedbackExtension);
+    extension->set_data(feedback.SerializeAsString());
+
+    ipc_channel_->send(common::serializeMessage(message));
+}
+
 } // namespace host
@@ -22,6 +22,8 @@
 #include <QPointer>
 #include <QUuid>
 
+#include <chrono>
+
 #include "base/macros_magic.h"
 #include "host/win/host_process.h"
 #include "proto/common.pb.h"
@@ -74,12 +76,14 @@ protected:
 private slots:
     void ipcServerStarted(const QString& channel_id);
     void ipcNewConnection(ipc::Channel* channel);
+    void networkMessageReceived(const QByteArray& buffer);
     void sessionProcessError(HostProcess::ErrorCode error_code);
     void attachSession(uint32_t session_id);
     void dettachSession();
 
 private:
     bool startFakeSession();
+    void sendNetworkFeedback();
 
     enum class State { STOPPED, STARTING, STOPPING, DETACHED, ATTACHED };
     static const uint32_t kInvalidSessionId = 0xFFFFFFFF;
@@ -88,6 +92,15 @@ private:
 
     uint32_t session_id_ = kInvalidSessionId;
     int attach_timer_id_ = 0;
+
+    // Timer of sending the network statistics to the desktop session process.
+    int feedback_timer_id_ = 0;
+    std::chrono::steady_clock::time_point feedback_time_;
+
+    // Statistics of the network channel at the time of the previous feedback.
+    int64_t feedback_written_messages_ = 0;
+    int64_t feedback_written_bytes_ = 0;
+    std::chrono::milliseconds feedback_send_delay_ { 0 };
     State state_ = State::STOPPED;
 
     net::ChannelHost* network_channel_ = nullptr;
@@ -108,6 +108,20 @@ QVersionNumber Channel::peerVersion() const
     return peer_version_;
 }
 
+Channel::WriteStats Channel::writeStats() const
+{
+    WriteStats stats = write_stats_;
+
+    // If the network does not accept the data, the delay is shown by the oldest queued message.
+    if (!write_.queue_time.isEmpty())
+    {
+        stats.queue_delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - write_.queue_time.front());
+    }
+
+    return stats;
+}
+
 void Channel::start()
 {
     if (isStarted())
@@ -149,6 +163,8 @@ void Channel::send(const QByteArray& buffer)
 
     // Add the buffer to the queue for sending.
     write_.queue.push_back(buffer);
+    write_.queue_time.push_back(std::chrono::steady_clock::now());
+    write_stats_.pending_bytes += buffer.size();
 
     if (schedule_write)
         scheduleWrite();
@@ -314,8 +330,15 @@ void Channel::onMessageWritten()
     {
         DCHECK(!write_.queue.empty());
 
+        write_stats_.pending_bytes -= write_.queue.front().size();
+        write_stats_.written_bytes += write_.queue.front().size();
+        write_stats_.send_delay += std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - write_.queue_time.front());
+        ++write_stats_.written_messages;
+
         // Delete the sent message from the queue.
         write_.queue.pop_front();
+        write_.queue_time.pop_front();
 
         // If the queue is not empty, then we send the following message.
         if (!write_.queue.isEmpty())
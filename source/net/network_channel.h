@@ -26,6 +26,8 @@
 
 #include "base/macros_magic.h"
 
+#include <chrono>
+
 namespace crypto {
 class Cryptor;
 } // namespace crypto
@@ -59,6 +61,22 @@ public:
         SESSION_TYPE_NOT_ALLOWED  // The specified session type is not allowed for the user.
     };
 
+    struct WriteStats
+    {
+        // Number of bytes of the messages waiting in the sending queue.
+        int64_t pending_bytes = 0;
+
+        // Total number and size of the sent messages.
+        int64_t written_messages = 0;
+        int64_t written_bytes = 0;
+
+        // Total time from the queuing to the end of writing of the sent messages.
+        std::chrono::milliseconds send_delay { 0 };
+
+        // Time the oldest message waits in the sending queue.
+        std::chrono::milliseconds queue_delay { 0 };
+    };
+
     virtual ~Channel() = default;
 
     // Returns the state of the data channel.
@@ -73,6 +91,10 @@ public:
     // Returns the version of the connected peer.
     QVersionNumber peerVersion() const;
 
+    // Returns the statistics of sending the messages. The statistics show how fast the network
+    // accepts the data and are used to adapt the rate of the sent data.
+    WriteStats writeStats() const;
+
 signals:
     // Emits when the connection is aborted.
     void disconnected();
@@ -137,6 +159,9 @@ private:
         // The queue contains unencrypted source messages.
         QQueue<QByteArray> queue;
 
+        // Time of queuing of each message in |queue|.
+        QQueue<std::chrono::steady_clock::time_point> queue_time;
+
         // The buffer contains an encrypted message that is being sent to the current moment.
         QByteArray buffer;
 
@@ -164,6 +189,7 @@ private:
 
     ReadContext read_;
     WriteContext write_;
+    WriteStats write_stats_;
 
     DISALLOW_COPY_AND_ASSIGN(Channel);
 };